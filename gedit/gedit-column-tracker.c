@@ -0,0 +1,398 @@
+/*
+ * gedit-column-tracker.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "gedit-column-tracker.h"
+
+/* The char gtk uses for pixbufs and child anchors */
+#define OBJECT_CHAR "\xef\xbf\xbc"
+
+typedef struct
+{
+	gint offset;	/* in the line */
+	gint column;	/* after the tab */
+} Tab;
+
+struct _GeditColumnTracker
+{
+	GtkTextBuffer *buffer;
+
+	/* The indexed line, -1 if there is none */
+	gint line;
+	GArray *tabs;
+
+	/* The columns from this tab on must be computed again */
+	guint first_dirty;
+	guint tab_size;
+};
+
+static void
+invalidate (GeditColumnTracker *tracker)
+{
+	tracker->line = -1;
+	g_array_set_size (tracker->tabs, 0);
+}
+
+static void
+build_index (GeditColumnTracker *tracker,
+	     const GtkTextIter  *iter)
+{
+	GtkTextIter start, end;
+	gchar *text;
+	const gchar *p;
+	const gchar *tab;
+	gint offset = 0;
+
+	start = *iter;
+	gtk_text_iter_set_line_offset (&start, 0);
+
+	end = start;
+	if (!gtk_text_iter_ends_line (&end))
+		gtk_text_iter_forward_to_line_end (&end);
+
+	text = gtk_text_iter_get_slice (&start, &end);
+
+	g_array_set_size (tracker->tabs, 0);
+
+	for (p = text; (tab = strchr (p, '\t')) != NULL; p = tab + 1)
+	{
+		Tab t;
+
+		offset += g_utf8_strlen (p, tab - p);
+
+		t.offset = offset++;
+		t.column = 0;
+
+		g_array_append_val (tracker->tabs, t);
+	}
+
+	g_free (text);
+
+	tracker->line = gtk_text_iter_get_line (iter);
+	tracker->first_dirty = 0;
+}
+
+static void
+update_columns (GeditColumnTracker *tracker,
+		guint               tab_size)
+{
+	guint i;
+
+	if (tab_size != tracker->tab_size)
+	{
+		tracker->tab_size = tab_size;
+		tracker->first_dirty = 0;
+	}
+
+	for (i = tracker->first_dirty; i < tracker->tabs->len; i++)
+	{
+		Tab *t = &g_array_index (tracker->tabs, Tab, i);
+		gint col;
+
+		if (i > 0)
+		{
+			Tab *prev = &g_array_index (tracker->tabs, Tab, i - 1);
+
+			col = prev->column + (t->offset - prev->offset - 1);
+		}
+		else
+		{
+			col = t->offset;
+		}
+
+		t->column = col + (tab_size - (col % tab_size));
+	}
+
+	tracker->first_dirty = tracker->tabs->len;
+}
+
+/* The index of the first tab at or after @offset */
+static guint
+find_tab (GeditColumnTracker *tracker,
+	  gint                offset)
+{
+	guint lo = 0;
+	guint hi = tracker->tabs->len;
+
+	while (lo < hi)
+	{
+		guint mid = (lo + hi) / 2;
+
+		if (g_array_index (tracker->tabs, Tab, mid).offset < offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static void
+shift_tabs (GeditColumnTracker *tracker,
+	    guint               from,
+	    gint                delta)
+{
+	guint i;
+
+	for (i = from; i < tracker->tabs->len; i++)
+		g_array_index (tracker->tabs, Tab, i).offset += delta;
+
+	tracker->first_dirty = MIN (tracker->first_dirty, from);
+}
+
+static gboolean
+has_line_break (const gchar *text,
+		gint         len)
+{
+	gint i;
+
+	for (i = 0; i < len; i++)
+	{
+		if (text[i] == '\n' || text[i] == '\r')
+			return TRUE;
+
+		/* paragraph separator */
+		if ((guchar) text[i] == 0xe2 && i + 2 < len &&
+		    (guchar) text[i + 1] == 0x80 && (guchar) text[i + 2] == 0xa9)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Whether @iter is between a \r and a \n, where inserting splits the
+ * line break and deleting may join two */
+static gboolean
+in_crlf (const GtkTextIter *iter)
+{
+	GtkTextIter prev = *iter;
+
+	return gtk_text_iter_get_char (iter) == '\n' &&
+	       gtk_text_iter_backward_char (&prev) &&
+	       gtk_text_iter_get_char (&prev) == '\r';
+}
+
+static void
+insert (GeditColumnTracker *tracker,
+	GtkTextIter        *location,
+	const gchar        *text,
+	gint                len)
+{
+	GArray *new_tabs;
+	const gchar *p;
+	const gchar *end;
+	gint offset;
+	gint line;
+	guint i;
+
+	if (tracker->line < 0)
+		return;
+
+	line = gtk_text_iter_get_line (location);
+
+	if (line > tracker->line)
+		return;
+
+	if (has_line_break (text, len) || in_crlf (location))
+	{
+		invalidate (tracker);
+		return;
+	}
+
+	if (line < tracker->line)
+		return;
+
+	offset = gtk_text_iter_get_line_offset (location);
+	i = find_tab (tracker, offset);
+
+	shift_tabs (tracker, i, g_utf8_strlen (text, len));
+
+	new_tabs = g_array_new (FALSE, FALSE, sizeof (Tab));
+	end = text + len;
+
+	for (p = text; p < end; p = g_utf8_next_char (p), offset++)
+	{
+		if (*p == '\t')
+		{
+			Tab t = { offset, 0 };
+
+			g_array_append_val (new_tabs, t);
+		}
+	}
+
+	g_array_insert_vals (tracker->tabs, i, new_tabs->data, new_tabs->len);
+	g_array_free (new_tabs, TRUE);
+}
+
+static void
+insert_text_cb (GtkTextBuffer      *buffer,
+		GtkTextIter        *location,
+		const gchar        *text,
+		gint                len,
+		GeditColumnTracker *tracker)
+{
+	insert (tracker, location, text, len);
+}
+
+static void
+insert_object_cb (GtkTextBuffer      *buffer,
+		  GtkTextIter        *location,
+		  gpointer            object,
+		  GeditColumnTracker *tracker)
+{
+	insert (tracker, location, OBJECT_CHAR, strlen (OBJECT_CHAR));
+}
+
+static void
+delete_range_cb (GtkTextBuffer      *buffer,
+		 GtkTextIter        *start,
+		 GtkTextIter        *end,
+		 GeditColumnTracker *tracker)
+{
+	gint line;
+	gint start_offset;
+	gint end_offset;
+	guint i, j;
+
+	if (tracker->line < 0)
+		return;
+
+	line = gtk_text_iter_get_line (start);
+
+	if (line > tracker->line)
+		return;
+
+	if (line != gtk_text_iter_get_line (end))
+	{
+		invalidate (tracker);
+		return;
+	}
+
+	/* a \r before and a \n after make a single line break */
+	if (gtk_text_iter_get_char (end) == '\n')
+	{
+		GtkTextIter prev = *start;
+
+		if (gtk_text_iter_backward_char (&prev) &&
+		    gtk_text_iter_get_char (&prev) == '\r')
+		{
+			invalidate (tracker);
+			return;
+		}
+	}
+
+	if (line < tracker->line)
+		return;
+
+	start_offset = gtk_text_iter_get_line_offset (start);
+	end_offset = gtk_text_iter_get_line_offset (end);
+
+	i = find_tab (tracker, start_offset);
+	j = find_tab (tracker, end_offset);
+
+	g_array_remove_range (tracker->tabs, i, j - i);
+	shift_tabs (tracker, i, start_offset - end_offset);
+}
+
+GeditColumnTracker *
+gedit_column_tracker_new (GtkTextBuffer *buffer)
+{
+	GeditColumnTracker *tracker;
+
+	g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), NULL);
+
+	tracker = g_slice_new0 (GeditColumnTracker);
+
+	tracker->buffer = buffer;
+	tracker->line = -1;
+	tracker->tabs = g_array_new (FALSE, FALSE, sizeof (Tab));
+
+	/* the iters are still valid before the default handlers */
+	g_signal_connect (buffer,
+			  "insert-text",
+			  G_CALLBACK (insert_text_cb),
+			  tracker);
+	g_signal_connect (buffer,
+			  "insert-pixbuf",
+			  G_CALLBACK (insert_object_cb),
+			  tracker);
+	g_signal_connect (buffer,
+			  "insert-child-anchor",
+			  G_CALLBACK (insert_object_cb),
+			  tracker);
+	g_signal_connect (buffer,
+			  "delete-range",
+			  G_CALLBACK (delete_range_cb),
+			  tracker);
+
+	return tracker;
+}
+
+void
+gedit_column_tracker_free (GeditColumnTracker *tracker)
+{
+	if (tracker == NULL)
+		return;
+
+	g_signal_handlers_disconnect_matched (tracker->buffer,
+					      G_SIGNAL_MATCH_DATA,
+					      0, 0, NULL, NULL,
+					      tracker);
+
+	g_array_free (tracker->tabs, TRUE);
+
+	g_slice_free (GeditColumnTracker, tracker);
+}
+
+gint
+gedit_column_tracker_get_column (GeditColumnTracker *tracker,
+				 const GtkTextIter  *iter,
+				 guint               tab_size)
+{
+	const Tab *t;
+	gint offset;
+	guint i;
+
+	g_return_val_if_fail (tracker != NULL, 0);
+	g_return_val_if_fail (iter != NULL, 0);
+	g_return_val_if_fail (tab_size > 0, 0);
+
+	if (gtk_text_iter_get_line (iter) != tracker->line)
+		build_index (tracker, iter);
+
+	update_columns (tracker, tab_size);
+
+	offset = gtk_text_iter_get_line_offset (iter);
+	i = find_tab (tracker, offset);
+
+	if (i == 0)
+		return offset;
+
+	t = &g_array_index (tracker->tabs, Tab, i - 1);
+
+	return t->column + (offset - t->offset - 1);
+}
@@ -0,0 +1,49 @@
+/*
+ * gedit-column-tracker.h
+ * This file is part of gedit
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GEDIT_COLUMN_TRACKER_H__
+#define __GEDIT_COLUMN_TRACKER_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/* Gives the visual column of an iter, with the tabs expanded. The tabs
+ * of the last line asked for are indexed with the column after each of
+ * them, so that the column of any offset in that line is found by a
+ * binary search. The index follows the edits made inside the line and
+ * is dropped by the ones that change the lines. */
+typedef struct _GeditColumnTracker	GeditColumnTracker;
+
+GeditColumnTracker	*gedit_column_tracker_new	(GtkTextBuffer      *buffer);
+
+void			 gedit_column_tracker_free	(GeditColumnTracker *tracker);
+
+/* Columns start at 0 */
+gint			 gedit_column_tracker_get_column
+							(GeditColumnTracker *tracker,
+							 const GtkTextIter  *iter,
+							 guint               tab_size);
+
+G_END_DECLS
+
+#endif /* __GEDIT_COLUMN_TRACKER_H__ */
@@ -72,56 +72,6 @@ _gedit_cmd_file_new (GtkAction   *action,
 	gedit_window_create_tab (window, TRUE);
 }
 
-static GeditTab *
-get_tab_from_file (GList *docs, GFile *file)
-{
-	GeditTab *tab = NULL;
-
-	while (docs != NULL)
-	{
-		gchar *u;
-		GeditDocument *d;
-
-		d = GEDIT_DOCUMENT (docs->data);
-
-		u = gedit_document_get_uri (d);
-		if (u != NULL)
-		{
-			GFile *f;
-
-			f = g_file_new_for_uri (u);
-			g_free (u);
-
-			if (g_file_equal (f, file))
-			{
-				tab = gedit_tab_get_from_document (d);
-				g_object_unref (f);
-				break;
-			}
-
-			g_object_unref (f);
-		}
-
-		docs = g_list_next (docs);
-	}
-
-	return tab;
-}
-
-static gboolean
-is_duplicated_file (GSList *files, GFile *file)
-{
-	while (files != NULL)
-	{
-		if (g_file_equal (files->data, file))
-			return TRUE;
-
-		files = g_slist_next (files);
-	}
-
-	return FALSE;
-}
-
 /* File loading */
 static gint
 load_file_list (GeditWindow         *window,
@@ -133,21 +83,23 @@ load_file_list (GeditWindow         *window,
 	GeditTab      *tab;
 	gint           loaded_files = 0; /* Number of files to load */
 	gboolean       jump_to = TRUE; /* Whether to jump to the new tab */
-	GList         *win_docs;
+	GHashTable    *seen;
 	GSList        *files_to_load = NULL;
 	GSList        *l;
 
 	gedit_debug (DEBUG_COMMANDS);
 
-	win_docs = gedit_window_get_documents (window);
+	seen = g_hash_table_new (g_file_hash, (GEqualFunc) g_file_equal);
 
 	/* Remove the uris corresponding to documents already open
 	 * in "window" and remove duplicates from "uris" list */
 	for (l = files; l != NULL; l = l->next)
 	{
-		if (!is_duplicated_file (files_to_load, l->data))
+		if (g_hash_table_lookup (seen, l->data) == NULL)
 		{
-			tab = get_tab_from_file (win_docs, l->data);
+			g_hash_table_insert (seen, l->data, l->data);
+
+			tab = gedit_window_get_tab_from_location (window, l->data);
 			if (tab != NULL)
 			{
 				if (l == files)
@@ -179,7 +131,7 @@ load_file_list (GeditWindow         *window,
 		}
 	}
 
-	g_list_free (win_docs);
+	g_hash_table_destroy (seen);
 
 	if (files_to_load == NULL)
 		return loaded_files;
@@ -223,12 +175,21 @@ load_file_list (GeditWindow         *window,
 
 		// FIXME: pass the GFile to tab when api is there
 		uri = g_file_get_uri (l->data);
-		tab = gedit_window_create_tab_from_uri (window,
-							uri,
-							encoding,
-							line_pos,
-							create,
-							jump_to);
+
+		/* the tabs that are not shown are loaded when activated */
+		if (jump_to)
+			tab = gedit_window_create_tab_from_uri (window,
+								uri,
+								encoding,
+								line_pos,
+								create,
+								TRUE);
+		else
+			tab = _gedit_window_create_dormant_tab (window,
+								uri,
+								encoding,
+								line_pos,
+								create);
 		g_free (uri);
 
 		if (tab != NULL)
@@ -842,6 +803,14 @@ file_save (GeditTab    *tab,
 	doc = gedit_tab_get_document (tab);
 	g_return_if_fail (GEDIT_IS_DOCUMENT (doc));
 
+	/* the document of a dormant tab is not loaded, so it is unchanged */
+	if (_gedit_tab_is_dormant (tab))
+	{
+		gedit_debug_message (DEBUG_COMMANDS, "Dormant");
+
+		return;
+	}
+
 	if (gedit_document_is_untitled (doc) || 
 	    gedit_document_get_readonly (doc))
 	{
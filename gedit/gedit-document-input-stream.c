@@ -0,0 +1,596 @@
+/*
+ * gedit-document-input-stream.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <gio/gio.h>
+
+#include "gedit-document-input-stream.h"
+
+/* Number of characters in each segment of a snapshot */
+#define SEGMENT_CHARS 65536
+
+#define GEDIT_DOCUMENT_INPUT_STREAM_GET_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE((object), GEDIT_TYPE_DOCUMENT_INPUT_STREAM, GeditDocumentInputStreamPrivate))
+
+typedef struct
+{
+	/* Start of the segment in the buffer, while it is not copied */
+	GtkTextMark *mark;
+
+	gchar       *text;
+	gsize        len;
+} Segment;
+
+/*
+ * Taking a snapshot only puts a mark at the start of each segment. The
+ * text of a segment is copied from the buffer when it is read, and freed
+ * once read, or right before an edit changes it, and then kept. So the
+ * snapshot costs no copy of the whole text, only of the edited segments.
+ *
+ * The buffer is only used in the main thread: a reader in another thread
+ * asks the main loop for the text of the segment and waits for it.
+ */
+struct _GeditTextSnapshot
+{
+	gint           ref_count;
+
+	GMutex        *mutex;
+	GCond         *cond;
+	GThread       *main_thread;
+
+	/* NULL once detached */
+	GtkTextBuffer *buffer;
+	GtkTextMark   *end_mark;
+
+	GArray        *segments;
+
+	/* The segments of the buffer, without the final newline */
+	guint          n_buffer_segments;
+	gsize          length;
+
+	/* Segment copied in the main loop for a reader */
+	gboolean       fetching;
+	guint          fetch_segment;
+	gchar         *fetched;
+	gsize          fetched_len;
+};
+
+struct _GeditDocumentInputStreamPrivate
+{
+	GeditTextSnapshot *snapshot;
+
+	/* Position of the next byte to read */
+	guint              segment;
+	gsize              segment_read;
+
+	/* Text of the current segment */
+	const gchar       *text;
+	gsize              text_len;
+	gchar             *text_copy;
+};
+
+G_DEFINE_TYPE (GeditDocumentInputStream, gedit_document_input_stream, G_TYPE_INPUT_STREAM)
+
+static gssize	gedit_document_input_stream_read	(GInputStream  *stream,
+							 void          *buffer,
+							 gsize          count,
+							 GCancellable  *cancellable,
+							 GError       **error);
+static gboolean	gedit_document_input_stream_close	(GInputStream  *stream,
+							 GCancellable  *cancellable,
+							 GError       **error);
+
+/* Copies the text of a segment from the buffer, in the main thread */
+static gchar *
+copy_segment (GeditTextSnapshot *snapshot,
+	      guint              i,
+	      gsize             *len)
+{
+	GtkTextIter start;
+	GtkTextIter end;
+	GtkTextMark *end_mark;
+	gchar *text;
+
+	if (i + 1 < snapshot->n_buffer_segments)
+		end_mark = g_array_index (snapshot->segments, Segment, i + 1).mark;
+	else
+		end_mark = snapshot->end_mark;
+
+	gtk_text_buffer_get_iter_at_mark (snapshot->buffer,
+					  &start,
+					  g_array_index (snapshot->segments, Segment, i).mark);
+	gtk_text_buffer_get_iter_at_mark (snapshot->buffer, &end, end_mark);
+
+	text = gtk_text_buffer_get_slice (snapshot->buffer, &start, &end, TRUE);
+	*len = strlen (text);
+
+	return text;
+}
+
+static gint
+get_segment_offset (GeditTextSnapshot *snapshot,
+		    guint              i)
+{
+	GtkTextIter iter;
+
+	gtk_text_buffer_get_iter_at_mark (snapshot->buffer,
+					  &iter,
+					  g_array_index (snapshot->segments, Segment, i).mark);
+
+	return gtk_text_iter_get_offset (&iter);
+}
+
+/* Copies the segments which have text from @start to @end, before the
+ * buffer changes it */
+static void
+keep_segments (GeditTextSnapshot *snapshot,
+	       gint               start,
+	       gint               end)
+{
+	guint lo = 0;
+	guint hi = snapshot->n_buffer_segments;
+	guint i;
+
+	/* the first segment starting after @start */
+	while (lo < hi)
+	{
+		guint mid = (lo + hi) / 2;
+
+		if (get_segment_offset (snapshot, mid) <= start)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	/* the segments are closed on both sides, so a change at the
+	 * boundary of two segments keeps both */
+	i = (lo > 0) ? lo - 1 : 0;
+	if (i > 0 && get_segment_offset (snapshot, i) == start)
+		i--;
+
+	for (; i < snapshot->n_buffer_segments; i++)
+	{
+		Segment *segment = &g_array_index (snapshot->segments, Segment, i);
+		gchar *text;
+		gsize len;
+
+		if (get_segment_offset (snapshot, i) > end)
+			break;
+
+		if (segment->text != NULL)
+			continue;
+
+		text = copy_segment (snapshot, i, &len);
+
+		g_mutex_lock (snapshot->mutex);
+		segment->text = text;
+		segment->len = len;
+		g_mutex_unlock (snapshot->mutex);
+	}
+}
+
+static void
+insert_text_cb (GtkTextBuffer     *buffer,
+		GtkTextIter       *pos,
+		const gchar       *text,
+		gint               len,
+		GeditTextSnapshot *snapshot)
+{
+	gint offset;
+
+	offset = gtk_text_iter_get_offset (pos);
+	keep_segments (snapshot, offset, offset);
+}
+
+/* for the pixbufs and the child anchors */
+static void
+insert_object_cb (GtkTextBuffer     *buffer,
+		  GtkTextIter       *pos,
+		  gpointer           object,
+		  GeditTextSnapshot *snapshot)
+{
+	gint offset;
+
+	offset = gtk_text_iter_get_offset (pos);
+	keep_segments (snapshot, offset, offset);
+}
+
+static void
+delete_range_cb (GtkTextBuffer     *buffer,
+		 GtkTextIter       *start,
+		 GtkTextIter       *end,
+		 GeditTextSnapshot *snapshot)
+{
+	keep_segments (snapshot,
+		       gtk_text_iter_get_offset (start),
+		       gtk_text_iter_get_offset (end));
+}
+
+GeditTextSnapshot *
+gedit_text_snapshot_new (GtkTextBuffer *buffer)
+{
+	GeditTextSnapshot *snapshot;
+	GtkTextIter iter;
+	gint n_chars;
+	gint offset;
+
+	g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), NULL);
+
+	snapshot = g_slice_new0 (GeditTextSnapshot);
+	snapshot->ref_count = 1;
+	snapshot->mutex = g_mutex_new ();
+	snapshot->cond = g_cond_new ();
+	snapshot->main_thread = g_thread_self ();
+	snapshot->buffer = g_object_ref (buffer);
+	snapshot->segments = g_array_new (FALSE, FALSE, sizeof (Segment));
+
+	n_chars = gtk_text_buffer_get_char_count (buffer);
+
+	for (offset = 0; offset < n_chars; offset += SEGMENT_CHARS)
+	{
+		Segment segment;
+
+		gtk_text_buffer_get_iter_at_offset (buffer, &iter, offset);
+
+		segment.mark = gtk_text_buffer_create_mark (buffer, NULL, &iter, TRUE);
+		segment.text = NULL;
+		segment.len = 0;
+
+		g_array_append_val (snapshot->segments, segment);
+	}
+
+	snapshot->n_buffer_segments = snapshot->segments->len;
+	snapshot->length = n_chars;
+
+	gtk_text_buffer_get_end_iter (buffer, &iter);
+	snapshot->end_mark = gtk_text_buffer_create_mark (buffer, NULL, &iter, TRUE);
+
+	/* make sure files are always terminated with \n (see bug #95676).
+	   Note that we strip the trailing \n when loading the file */
+	if (n_chars > 0)
+	{
+		Segment newline;
+
+		newline.mark = NULL;
+		newline.text = g_strdup ("\n");
+		newline.len = 1;
+
+		g_array_append_val (snapshot->segments, newline);
+		snapshot->length += 1;
+	}
+
+	g_signal_connect (buffer,
+			  "insert-text",
+			  G_CALLBACK (insert_text_cb),
+			  snapshot);
+	g_signal_connect (buffer,
+			  "insert-pixbuf",
+			  G_CALLBACK (insert_object_cb),
+			  snapshot);
+	g_signal_connect (buffer,
+			  "insert-child-anchor",
+			  G_CALLBACK (insert_object_cb),
+			  snapshot);
+	g_signal_connect (buffer,
+			  "delete-range",
+			  G_CALLBACK (delete_range_cb),
+			  snapshot);
+
+	return snapshot;
+}
+
+GeditTextSnapshot *
+gedit_text_snapshot_ref (GeditTextSnapshot *snapshot)
+{
+	g_return_val_if_fail (snapshot != NULL, NULL);
+
+	g_atomic_int_inc (&snapshot->ref_count);
+
+	return snapshot;
+}
+
+void
+gedit_text_snapshot_unref (GeditTextSnapshot *snapshot)
+{
+	guint i;
+
+	g_return_if_fail (snapshot != NULL);
+
+	if (!g_atomic_int_dec_and_test (&snapshot->ref_count))
+		return;
+
+	/* the buffer can only be used in the main thread */
+	g_warn_if_fail (snapshot->buffer == NULL);
+
+	for (i = 0; i < snapshot->segments->len; i++)
+		g_free (g_array_index (snapshot->segments, Segment, i).text);
+
+	g_array_free (snapshot->segments, TRUE);
+	g_free (snapshot->fetched);
+	g_mutex_free (snapshot->mutex);
+	g_cond_free (snapshot->cond);
+
+	g_slice_free (GeditTextSnapshot, snapshot);
+}
+
+void
+gedit_text_snapshot_detach (GeditTextSnapshot *snapshot)
+{
+	GtkTextBuffer *buffer;
+	guint i;
+
+	g_return_if_fail (snapshot != NULL);
+	g_return_if_fail (g_thread_self () == snapshot->main_thread);
+
+	buffer = snapshot->buffer;
+	if (buffer == NULL)
+		return;
+
+	g_signal_handlers_disconnect_by_func (buffer, insert_text_cb, snapshot);
+	g_signal_handlers_disconnect_by_func (buffer, insert_object_cb, snapshot);
+	g_signal_handlers_disconnect_by_func (buffer, delete_range_cb, snapshot);
+
+	for (i = 0; i < snapshot->n_buffer_segments; i++)
+	{
+		Segment *segment = &g_array_index (snapshot->segments, Segment, i);
+
+		gtk_text_buffer_delete_mark (buffer, segment->mark);
+		segment->mark = NULL;
+	}
+
+	gtk_text_buffer_delete_mark (buffer, snapshot->end_mark);
+	snapshot->end_mark = NULL;
+
+	/* wake up a reader waiting for a segment which is lost */
+	g_mutex_lock (snapshot->mutex);
+	snapshot->buffer = NULL;
+	g_cond_broadcast (snapshot->cond);
+	g_mutex_unlock (snapshot->mutex);
+
+	g_object_unref (buffer);
+}
+
+gsize
+gedit_text_snapshot_get_length (GeditTextSnapshot *snapshot)
+{
+	g_return_val_if_fail (snapshot != NULL, 0);
+
+	return snapshot->length;
+}
+
+static gboolean
+fetch_segment_idle (GeditTextSnapshot *snapshot)
+{
+	Segment *segment;
+	gchar *text = NULL;
+	gsize len = 0;
+	guint i;
+
+	g_mutex_lock (snapshot->mutex);
+	i = snapshot->fetch_segment;
+	segment = &g_array_index (snapshot->segments, Segment, i);
+	g_mutex_unlock (snapshot->mutex);
+
+	/* only the main thread changes the buffer and the segments */
+	if (snapshot->buffer != NULL && segment->text == NULL)
+		text = copy_segment (snapshot, i, &len);
+
+	g_mutex_lock (snapshot->mutex);
+	snapshot->fetched = text;
+	snapshot->fetched_len = len;
+	snapshot->fetching = FALSE;
+	g_cond_broadcast (snapshot->cond);
+	g_mutex_unlock (snapshot->mutex);
+
+	return FALSE;
+}
+
+/*
+ * Returns the text of the segment @i, or NULL if the snapshot was
+ * detached before it was read. If the text was copied for the reader,
+ * it is returned in @copy as well and has to be freed.
+ */
+static const gchar *
+get_segment_text (GeditTextSnapshot *snapshot,
+		  guint              i,
+		  gsize             *len,
+		  gchar            **copy)
+{
+	Segment *segment = &g_array_index (snapshot->segments, Segment, i);
+	const gchar *text = NULL;
+
+	*copy = NULL;
+
+	g_mutex_lock (snapshot->mutex);
+
+	if (segment->text == NULL &&
+	    snapshot->buffer != NULL &&
+	    g_thread_self () == snapshot->main_thread)
+	{
+		g_mutex_unlock (snapshot->mutex);
+
+		*copy = copy_segment (snapshot, i, len);
+
+		return *copy;
+	}
+
+	while (segment->text == NULL && snapshot->buffer != NULL)
+	{
+		if (snapshot->fetching)
+		{
+			g_cond_wait (snapshot->cond, snapshot->mutex);
+			continue;
+		}
+
+		if (snapshot->fetched != NULL)
+		{
+			*copy = snapshot->fetched;
+			*len = snapshot->fetched_len;
+			snapshot->fetched = NULL;
+
+			break;
+		}
+
+		snapshot->fetching = TRUE;
+		snapshot->fetch_segment = i;
+
+		g_idle_add_full (G_PRIORITY_DEFAULT,
+				 (GSourceFunc) fetch_segment_idle,
+				 gedit_text_snapshot_ref (snapshot),
+				 (GDestroyNotify) gedit_text_snapshot_unref);
+	}
+
+	if (*copy != NULL)
+	{
+		text = *copy;
+	}
+	else if (segment->text != NULL)
+	{
+		text = segment->text;
+		*len = segment->len;
+	}
+
+	g_mutex_unlock (snapshot->mutex);
+
+	return text;
+}
+
+static void
+gedit_document_input_stream_finalize (GObject *object)
+{
+	GeditDocumentInputStream *dstream = GEDIT_DOCUMENT_INPUT_STREAM (object);
+
+	g_free (dstream->priv->text_copy);
+	gedit_text_snapshot_unref (dstream->priv->snapshot);
+
+	G_OBJECT_CLASS (gedit_document_input_stream_parent_class)->finalize (object);
+}
+
+static void
+gedit_document_input_stream_class_init (GeditDocumentInputStreamClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	GInputStreamClass *stream_class = G_INPUT_STREAM_CLASS (klass);
+
+	object_class->finalize = gedit_document_input_stream_finalize;
+
+	stream_class->read_fn = gedit_document_input_stream_read;
+	stream_class->close_fn = gedit_document_input_stream_close;
+
+	g_type_class_add_private (object_class, sizeof (GeditDocumentInputStreamPrivate));
+}
+
+static void
+gedit_document_input_stream_init (GeditDocumentInputStream *dstream)
+{
+	dstream->priv = GEDIT_DOCUMENT_INPUT_STREAM_GET_PRIVATE (dstream);
+}
+
+static gssize
+gedit_document_input_stream_read (GInputStream  *stream,
+				  void          *buffer,
+				  gsize          count,
+				  GCancellable  *cancellable,
+				  GError       **error)
+{
+	GeditDocumentInputStreamPrivate *priv = GEDIT_DOCUMENT_INPUT_STREAM (stream)->priv;
+	GArray *segments = priv->snapshot->segments;
+	gsize n = 0;
+
+	if (g_cancellable_set_error_if_cancelled (cancellable, error))
+		return -1;
+
+	while (n < count && priv->segment < segments->len)
+	{
+		gsize len;
+
+		if (priv->text == NULL)
+		{
+			priv->text = get_segment_text (priv->snapshot,
+						       priv->segment,
+						       &priv->text_len,
+						       &priv->text_copy);
+
+			if (priv->text == NULL)
+			{
+				g_set_error_literal (error,
+						     G_IO_ERROR,
+						     G_IO_ERROR_CANCELLED,
+						     "The document changed before it was saved");
+				return -1;
+			}
+		}
+
+		len = MIN (count - n, priv->text_len - priv->segment_read);
+
+		memcpy ((gchar *)buffer + n, priv->text + priv->segment_read, len);
+
+		n += len;
+		priv->segment_read += len;
+
+		/* the copies made for reading are not kept */
+		if (priv->segment_read == priv->text_len)
+		{
+			g_free (priv->text_copy);
+			priv->text_copy = NULL;
+			priv->text = NULL;
+
+			priv->segment++;
+			priv->segment_read = 0;
+		}
+	}
+
+	return n;
+}
+
+static gboolean
+gedit_document_input_stream_close (GInputStream  *stream,
+				   GCancellable  *cancellable,
+				   GError       **error)
+{
+	GeditDocumentInputStreamPrivate *priv = GEDIT_DOCUMENT_INPUT_STREAM (stream)->priv;
+
+	g_free (priv->text_copy);
+	priv->text_copy = NULL;
+	priv->text = NULL;
+
+	priv->segment = priv->snapshot->segments->len;
+	priv->segment_read = 0;
+
+	return TRUE;
+}
+
+GInputStream *
+gedit_document_input_stream_new (GeditTextSnapshot *snapshot)
+{
+	GeditDocumentInputStream *dstream;
+
+	g_return_val_if_fail (snapshot != NULL, NULL);
+
+	dstream = g_object_new (GEDIT_TYPE_DOCUMENT_INPUT_STREAM, NULL);
+	dstream->priv->snapshot = gedit_text_snapshot_ref (snapshot);
+
+	return G_INPUT_STREAM (dstream);
+}
@@ -0,0 +1,84 @@
+/*
+ * gedit-document-input-stream.h
+ * This file is part of gedit
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GEDIT_DOCUMENT_INPUT_STREAM_H__
+#define __GEDIT_DOCUMENT_INPUT_STREAM_H__
+
+#include <gio/gio.h>
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define GEDIT_TYPE_DOCUMENT_INPUT_STREAM		(gedit_document_input_stream_get_type ())
+#define GEDIT_DOCUMENT_INPUT_STREAM(obj)		(G_TYPE_CHECK_INSTANCE_CAST ((obj), GEDIT_TYPE_DOCUMENT_INPUT_STREAM, GeditDocumentInputStream))
+#define GEDIT_DOCUMENT_INPUT_STREAM_CONST(obj)		(G_TYPE_CHECK_INSTANCE_CAST ((obj), GEDIT_TYPE_DOCUMENT_INPUT_STREAM, GeditDocumentInputStream const))
+#define GEDIT_DOCUMENT_INPUT_STREAM_CLASS(klass)	(G_TYPE_CHECK_CLASS_CAST ((klass), GEDIT_TYPE_DOCUMENT_INPUT_STREAM, GeditDocumentInputStreamClass))
+#define GEDIT_IS_DOCUMENT_INPUT_STREAM(obj)		(G_TYPE_CHECK_INSTANCE_TYPE ((obj), GEDIT_TYPE_DOCUMENT_INPUT_STREAM))
+#define GEDIT_IS_DOCUMENT_INPUT_STREAM_CLASS(klass)	(G_TYPE_CHECK_CLASS_TYPE ((klass), GEDIT_TYPE_DOCUMENT_INPUT_STREAM))
+#define GEDIT_DOCUMENT_INPUT_STREAM_GET_CLASS(obj)	(G_TYPE_INSTANCE_GET_CLASS ((obj), GEDIT_TYPE_DOCUMENT_INPUT_STREAM, GeditDocumentInputStreamClass))
+
+/* The text of a buffer at one time, which can be read from any thread
+ * while the buffer keeps being edited. The text is only copied when it
+ * is read, or before it is edited, until the snapshot is detached. */
+typedef struct _GeditTextSnapshot			GeditTextSnapshot;
+
+typedef struct _GeditDocumentInputStream		GeditDocumentInputStream;
+typedef struct _GeditDocumentInputStreamClass		GeditDocumentInputStreamClass;
+typedef struct _GeditDocumentInputStreamPrivate		GeditDocumentInputStreamPrivate;
+
+struct _GeditDocumentInputStream
+{
+	GInputStream parent;
+	
+	GeditDocumentInputStreamPrivate *priv;
+};
+
+struct _GeditDocumentInputStreamClass
+{
+	GInputStreamClass parent_class;
+};
+
+GeditTextSnapshot *gedit_text_snapshot_new			(GtkTextBuffer     *buffer);
+
+GeditTextSnapshot *gedit_text_snapshot_ref			(GeditTextSnapshot *snapshot);
+
+void		 gedit_text_snapshot_unref			(GeditTextSnapshot *snapshot);
+
+/* Stops following the edits of the buffer, in the main thread. The text
+ * which was not copied yet can not be read anymore. */
+void		 gedit_text_snapshot_detach			(GeditTextSnapshot *snapshot);
+
+/* Length in characters of the text, including the final newline. It is
+ * the length in bytes of the utf8 text only for ascii text, and a lower
+ * bound otherwise. */
+gsize		 gedit_text_snapshot_get_length			(GeditTextSnapshot *snapshot);
+
+GType		 gedit_document_input_stream_get_type		(void) G_GNUC_CONST;
+
+/* Reads the text of @snapshot as utf8, followed by a newline if it is not
+ * empty. The stream can be read in a thread, as long as the main loop
+ * runs. */
+GInputStream	*gedit_document_input_stream_new		(GeditTextSnapshot *snapshot);
+
+G_END_DECLS
+
+#endif /* __GEDIT_DOCUMENT_INPUT_STREAM_H__ */
@@ -38,8 +38,8 @@
 #include <glib/gi18n.h>
 
 #include "gedit-document-saver.h"
+#include "gedit-document-input-stream.h"
 #include "gedit-debug.h"
-#include "gedit-convert.h"
 #include "gedit-prefs-manager.h"
 #include "gedit-marshal.h"
 #include "gedit-utils.h"
@@ -48,6 +48,9 @@
 #include "gedit-local-document-saver.h"
 #include "gedit-gio-document-saver.h"
 
+/* Size of the chunks the document is converted and written in */
+#define WRITE_CHUNK_SIZE 65536
+
 G_DEFINE_ABSTRACT_TYPE(GeditDocumentSaver, gedit_document_saver, G_TYPE_OBJECT)
 
 /* Signals */
@@ -136,6 +139,9 @@ gedit_document_saver_finalize (GObject *object)
 	g_free (saver->uri);
 	g_free (saver->backup_ext);
 
+	if (saver->snapshot != NULL)
+		gedit_text_snapshot_unref (saver->snapshot);
+
 	G_OBJECT_CLASS (gedit_document_saver_parent_class)->finalize (object);
 }
 
@@ -150,6 +156,9 @@ gedit_document_saver_dispose (GObject *object)
 		saver->info = NULL;
 	}
 
+	if (saver->snapshot != NULL)
+		gedit_text_snapshot_detach (saver->snapshot);
+
 	G_OBJECT_CLASS (gedit_document_saver_parent_class)->dispose (object);
 }
 
@@ -253,98 +262,184 @@ gedit_document_saver_new (GeditDocument       *doc,
 	return saver;
 }
 
-gchar *
-gedit_document_saver_get_end_newline (GeditDocumentSaver *saver,
-				      gsize 	         *len)
+/* Turns the errors of the charset converter into the ones the
+ * callers expect from a failed conversion */
+static void
+convert_error (GError **error)
 {
-	gchar *n_buffer = NULL;
-	gsize n_len = 0;
+	gint code;
 
-	if (saver->encoding != gedit_encoding_get_utf8 ())
-	{
-		n_buffer = gedit_convert_from_utf8 ("\n", 
-						    -1, 
-						    saver->encoding, 
-						    &n_len, 
-						    NULL);
+	if (error == NULL || *error == NULL || (*error)->domain != G_IO_ERROR)
+		return;
 
-		if (n_buffer == NULL)
-		{
-			/* we do not error out for this */
-			g_warning ("Cannot convert '\\n' to the desired encoding.");
-		}
+	switch ((*error)->code)
+	{
+		case G_IO_ERROR_INVALID_DATA:
+		case G_IO_ERROR_PARTIAL_INPUT:
+			code = G_CONVERT_ERROR_ILLEGAL_SEQUENCE;
+			break;
+		case G_IO_ERROR_NOT_SUPPORTED:
+			code = G_CONVERT_ERROR_NO_CONVERSION;
+			break;
+		default:
+			return;
 	}
-	else
+
+	(*error)->domain = G_CONVERT_ERROR;
+	(*error)->code = code;
+}
+
+/*
+ * Returns a stream with the document contents in the encoding of the
+ * saver, ending with a newline. The text is read from the snapshot taken
+ * when the save started and converted a chunk at a time, so the stream
+ * can be read in a thread while the main loop runs.
+ */
+GInputStream *
+gedit_document_saver_get_contents_stream (GeditDocumentSaver  *saver,
+					  GError             **error)
+{
+	GInputStream *stream;
+	GCharsetConverter *converter;
+	GInputStream *converter_stream;
+
+	g_return_val_if_fail (saver->snapshot != NULL, NULL);
+
+	stream = gedit_document_input_stream_new (saver->snapshot);
+
+	if (saver->encoding == gedit_encoding_get_utf8 ())
+		return stream;
+
+	converter = g_charset_converter_new (gedit_encoding_get_charset (saver->encoding),
+					     "UTF-8",
+					     error);
+
+	if (converter == NULL)
 	{
-		n_buffer = g_strdup ("\n");
-		n_len = 1;
+		convert_error (error);
+		g_object_unref (stream);
+
+		return NULL;
 	}
 
-	*len = n_len;
-	return n_buffer;
+	converter_stream = g_converter_input_stream_new (stream,
+							 G_CONVERTER (converter));
+
+	g_object_unref (converter);
+	g_object_unref (stream);
+
+	return converter_stream;
 }
 
-/* FIXME: we should rework the code to not need to fetch the
-   whole buffer in memory. Also encoding conversion should
-   be done in chunks */
-gchar *
-gedit_document_saver_get_document_contents (GeditDocumentSaver *saver,
-					    gsize 	       *len,
-					    GError 	      **error)
+gssize
+gedit_document_saver_read_contents (GeditDocumentSaver  *saver,
+				    GInputStream        *stream,
+				    gchar               *buffer,
+				    gsize                size,
+				    GError             **error)
 {
-	GtkTextBuffer *buffer = GTK_TEXT_BUFFER (saver->document);
-	GtkTextIter start_iter;
-	GtkTextIter end_iter;
-	gchar *contents;
-	
-	gtk_text_buffer_get_bounds (buffer, &start_iter, &end_iter);
-	contents = gtk_text_buffer_get_slice (buffer, &start_iter, &end_iter, TRUE);
+	gssize bytes_read;
 
-	*len = strlen (contents);
+	bytes_read = g_input_stream_read (stream, buffer, size, NULL, error);
+
+	if (bytes_read == -1)
+		convert_error (error);
+
+	return bytes_read;
+}
+
+/*
+ * Converts the whole document without keeping the result, so that a
+ * conversion error is found before the file is touched.
+ */
+gboolean
+gedit_document_saver_check_encoding (GeditDocumentSaver  *saver,
+				     GError             **error)
+{
+	GInputStream *stream;
+	gchar *buffer;
+	gssize bytes_read;
 
-	if (saver->encoding != gedit_encoding_get_utf8 ())
+	/* the buffer always contains valid utf8 */
+	if (saver->encoding == gedit_encoding_get_utf8 ())
+		return TRUE;
+
+	gedit_debug (DEBUG_SAVER);
+
+	stream = gedit_document_saver_get_contents_stream (saver, error);
+	if (stream == NULL)
+		return FALSE;
+
+	buffer = g_malloc (WRITE_CHUNK_SIZE);
+
+	do
 	{
-		gchar *converted_contents;
-		gsize new_len;
+		bytes_read = gedit_document_saver_read_contents (saver,
+								 stream,
+								 buffer,
+								 WRITE_CHUNK_SIZE,
+								 error);
+	}
+	while (bytes_read > 0);
 
-		converted_contents = gedit_convert_from_utf8 (contents, 
-							      *len, 
-							      saver->encoding,
-							      &new_len,
-							      error);
-		g_free (contents);
+	g_free (buffer);
+	g_object_unref (stream);
 
-		if (*error != NULL)
-		{
-			/* Conversion error */
-			return NULL;
-		}
-		else
+	return bytes_read == 0;
+}
+
+static gboolean
+write_all (gint          fd,
+	   const gchar  *buffer,
+	   gsize         len)
+{
+	while (len > 0)
+	{
+		gssize written;
+
+		written = write (fd, buffer, len);
+		if (written == -1)
 		{
-			contents = converted_contents;
-			*len = new_len;
+			if (errno == EINTR)
+				continue;
+
+			return FALSE;
 		}
+
+		len -= written;
+		buffer += written;
 	}
-	
-	return contents;
+
+	return TRUE;
 }
 
 /*
- * Write the document contents in fd.
+ * Write the document contents in fd. This does not use the document, so
+ * it can be called in a thread.
  */
 gboolean
-gedit_document_saver_write_document_contents (GeditDocumentSaver  *saver,
-					      gint                 fd,
-					      GError             **error)
+gedit_document_saver_write_document_contents (GeditDocumentSaver    *saver,
+					      gint                   fd,
+					      GFileProgressCallback  progress_callback,
+					      gpointer               progress_callback_data,
+					      GError               **error)
 {
-	gsize len;
-	gssize written;
+	GInputStream *stream;
+	gchar *buffer;
+	gssize bytes_read;
+	goffset written = 0;
+	goffset total = 0;
 	gboolean res;
-	gchar *contents;
 
 	gedit_debug (DEBUG_SAVER);
 
-	contents = gedit_document_saver_get_document_contents (saver, &len, error);
+	/* find conversion errors before truncating the file */
+	if (!gedit_document_saver_check_encoding (saver, error))
+		return FALSE;
+
+	stream = gedit_document_saver_get_contents_stream (saver, error);
+	if (stream == NULL)
+		return FALSE;
 
 	/* make sure we are at the start */
 	res = (lseek (fd, 0, SEEK_SET) != -1);
@@ -355,62 +450,48 @@ gedit_document_saver_write_document_contents (GeditDocumentSaver  *saver,
 		res = (ftruncate (fd, 0) == 0);
 	}
 
-	/* Save the file content */
-	if (len > 0)
+	/* without conversion the size is about the length of the text */
+	if (saver->encoding == gedit_encoding_get_utf8 ())
+		total = gedit_text_snapshot_get_length (saver->snapshot);
+
+	buffer = g_malloc (WRITE_CHUNK_SIZE);
+
+	/* Save the file content, only one chunk of it is ever in memory */
+	while (res)
 	{
-		if (res)
+		bytes_read = gedit_document_saver_read_contents (saver,
+								 stream,
+								 buffer,
+								 WRITE_CHUNK_SIZE,
+								 error);
+
+		if (bytes_read == -1)
 		{
-			const gchar *write_buffer = contents;
-			gssize to_write = len;
-
-			do
-			{
-				written = write (fd, write_buffer, to_write);
-				if (written == -1)
-				{
-					if (errno == EINTR)
-						continue;
-
-					res = FALSE;
-
-					break;
-				}
-
-				to_write -= written;
-				write_buffer += written;
-			}
-			while (to_write > 0);
+			g_free (buffer);
+			g_object_unref (stream);
+
+			return FALSE;
 		}
 
-		/* make sure files are always terminated with \n (see bug #95676). Note
-		   that we strip the trailing \n when loading the file */
-		if (res)
+		if (bytes_read == 0)
+			break;
+
+		res = write_all (fd, buffer, bytes_read);
+
+		if (res && progress_callback != NULL)
 		{
-			gchar *n_buf;
-			gsize n_len;
-
-			n_buf = gedit_document_saver_get_end_newline (saver, &n_len);
-			if (n_buf != NULL)
-			{
-				written = write (fd, n_buf, n_len);
-				res = (written != -1 && (gsize) written == n_len);
-				g_free (n_buf);
-			}
-			else
-			{
-				g_warning ("Cannot add '\\n' at the end of the file.");
-			}
+			written += bytes_read;
+			progress_callback (written, total, progress_callback_data);
 		}
 	}
 
+	g_free (buffer);
+	g_object_unref (stream);
+
 #ifdef HAVE_FSYNC
 	/* Ensure that all the data reaches disk */
 	if (res && fsync (fd) != 0)
 	{
-		g_set_error (error,
-			     G_IO_ERROR,
-			     g_io_error_from_errno (errno),
-			     "%s", g_strerror (errno));
 		res = FALSE;
 	}
 #endif
@@ -423,8 +504,6 @@ gedit_document_saver_write_document_contents (GeditDocumentSaver  *saver,
 			     "%s", g_strerror (errno));
 	}
 
-	g_free (contents);
-
 	return res;
 }
 
@@ -439,6 +518,10 @@ gedit_document_saver_saving (GeditDocumentSaver *saver,
 	if (completed)
 	{
 		g_object_ref (saver);
+
+		/* everything has been read, stop copying the edits */
+		if (saver->snapshot != NULL)
+			gedit_text_snapshot_detach (saver->snapshot);
 	}
 
 	g_signal_emit (saver, signals[SAVING], 0, completed, error);
@@ -483,6 +566,9 @@ gedit_document_saver_save (GeditDocumentSaver     *saver,
 	/* TODO: add support for configurable backup dir */
 	saver->backups_in_curr_dir = TRUE;
 
+	/* the document can be edited again while the save goes on */
+	saver->snapshot = gedit_text_snapshot_new (GTK_TEXT_BUFFER (saver->document));
+
 	GEDIT_DOCUMENT_SAVER_GET_CLASS (saver)->save (saver, old_mtime);
 }
 
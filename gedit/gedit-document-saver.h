@@ -33,6 +33,7 @@
 #define __GEDIT_DOCUMENT_SAVER_H__
 
 #include <gedit/gedit-document.h>
+#include <gedit/gedit-document-input-stream.h>
 
 G_BEGIN_DECLS
 
@@ -60,6 +61,9 @@ struct _GeditDocumentSaver
 	GeditDocument		 *document;
 	gboolean		  used;
 
+	/* The text to save, taken when the save starts */
+	GeditTextSnapshot	 *snapshot;
+
 	gchar			 *uri;
 	const GeditEncoding      *encoding;
 
@@ -102,17 +106,24 @@ GeditDocumentSaver 	*gedit_document_saver_new 		(GeditDocument        *doc,
 								 const GeditEncoding  *encoding,
 								 GeditDocumentSaveFlags flags);
 
-gchar			*gedit_document_saver_get_document_contents (
+GInputStream		*gedit_document_saver_get_contents_stream (
 								 GeditDocumentSaver  *saver,
-								 gsize		     *len,
 								 GError             **error);
 
-gchar			*gedit_document_saver_get_end_newline	(GeditDocumentSaver *saver,
-								 gsize              *len);
+gssize			 gedit_document_saver_read_contents	(GeditDocumentSaver  *saver,
+								 GInputStream        *stream,
+								 gchar               *buffer,
+								 gsize                size,
+								 GError             **error);
+
+gboolean		 gedit_document_saver_check_encoding	(GeditDocumentSaver  *saver,
+								 GError             **error);
 
 gboolean		 gedit_document_saver_write_document_contents (
 								 GeditDocumentSaver  *saver,
 								 gint                 fd,
+								 GFileProgressCallback progress_callback,
+								 gpointer             progress_callback_data,
 								 GError             **error);
 
 void			 gedit_document_saver_saving		(GeditDocumentSaver *saver,
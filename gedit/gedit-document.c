@@ -38,7 +38,6 @@
 #include <stdlib.h>
 
 #include <glib/gi18n.h>
-#include <gtksourceview/gtksourceiter.h>
 
 #include "gedit-prefs-manager-app.h"
 #include "gedit-document.h"
@@ -52,6 +51,8 @@
 #include "gedit-marshal.h"
 #include "gedit-enum-types.h"
 #include "gedittextregion.h"
+#include "gedit-text-search.h"
+#include "gedit-file-change-tracker.h"
 
 #ifdef G_OS_WIN32
 #include "gedit-metadata-manager.h"
@@ -141,6 +142,13 @@ struct _GeditDocumentPrivate
 	gint language_set_by_user : 1;
 	gint stop_cursor_moved_emission : 1;
 	gint dispose_has_run : 1;
+
+	/* the document has an uri but its text was not loaded yet */
+	gint not_loaded : 1;
+
+	/* the saver works on a snapshot, so the document can be edited
+	 * while it is being saved */
+	gint changed_while_saving : 1;
 };
 
 enum {
@@ -218,6 +226,25 @@ release_untitled_number (gint n)
 	g_hash_table_remove (allocated_untitled_numbers, GINT_TO_POINTER (n));
 }
 
+/* The tracker keeps the mtime of the file current */
+static void
+track_uri (const gchar *uri,
+	   gboolean     track)
+{
+	GFile *location;
+
+	location = g_file_new_for_uri (uri);
+
+	if (track)
+		gedit_file_change_tracker_watch (gedit_file_change_tracker_get_default (),
+						 location);
+	else
+		gedit_file_change_tracker_unwatch (gedit_file_change_tracker_get_default (),
+						   location);
+
+	g_object_unref (location);
+}
+
 static void
 gedit_document_dispose (GObject *object)
 {
@@ -228,8 +255,10 @@ gedit_document_dispose (GObject *object)
 	/* Metadata must be saved here and not in finalize
 	 * because the language is gone by the time finalize runs.
 	 * beside if some plugin prevents proper finalization by
-	 * holding a ref to the doc, we still save the metadata */
-	if ((!doc->priv->dispose_has_run) && (doc->priv->uri != NULL))
+	 * holding a ref to the doc, we still save the metadata.
+	 * A document which was not loaded keeps the saved position */
+	if ((!doc->priv->dispose_has_run) && (doc->priv->uri != NULL) &&
+	    !doc->priv->not_loaded)
 	{
 		GtkTextIter iter;
 		gchar *position;
@@ -277,6 +306,9 @@ gedit_document_dispose (GObject *object)
 		doc->priv->metadata_info = NULL;
 	}
 
+	if ((!doc->priv->dispose_has_run) && (doc->priv->uri != NULL))
+		track_uri (doc->priv->uri, FALSE);
+
 	doc->priv->dispose_has_run = TRUE;
 
 	G_OBJECT_CLASS (gedit_document_parent_class)->dispose (object);
@@ -399,7 +431,12 @@ gedit_document_mark_set (GtkTextBuffer     *buffer,
 static void
 gedit_document_changed (GtkTextBuffer *buffer)
 {
-	emit_cursor_moved (GEDIT_DOCUMENT (buffer));
+	GeditDocument *doc = GEDIT_DOCUMENT (buffer);
+
+	if (doc->priv->saver != NULL)
+		doc->priv->changed_while_saving = TRUE;
+
+	emit_cursor_moved (doc);
 
 	GTK_TEXT_BUFFER_CLASS (gedit_document_parent_class)->changed (buffer);
 }
@@ -922,9 +959,14 @@ set_uri (GeditDocument *doc,
 		if (doc->priv->uri == uri)
 			return;
 
+		if (doc->priv->uri != NULL)
+			track_uri (doc->priv->uri, FALSE);
+
 		g_free (doc->priv->uri);
 		doc->priv->uri = g_strdup (uri);
 
+		track_uri (doc->priv->uri, TRUE);
+
 		if (doc->priv->untitled_number > 0)
 		{
 			release_untitled_number (doc->priv->untitled_number);
@@ -979,6 +1021,20 @@ gedit_document_set_uri (GeditDocument *doc,
 	set_content_type (doc, NULL);
 }
 
+/* Gives an empty document the uri it is going to be loaded from,
+ * without loading it yet */
+void
+_gedit_document_set_uri_not_loaded (GeditDocument *doc,
+				    const gchar   *uri)
+{
+	g_return_if_fail (GEDIT_IS_DOCUMENT (doc));
+	g_return_if_fail (uri != NULL);
+
+	gedit_document_set_uri (doc, uri);
+
+	doc->priv->not_loaded = TRUE;
+}
+
 /* Never returns NULL */
 gchar *
 gedit_document_get_uri_for_display (GeditDocument *doc)
@@ -1073,12 +1129,15 @@ gedit_document_get_readonly (GeditDocument *doc)
 	return doc->priv->readonly;
 }
 
+/* Answered from the mtime kept by the change tracker, so that it does
+ * not block on slow or stalled mounts. A change found by the query it
+ * starts in the background is reported by its "changed" signal. */
 gboolean
 _gedit_document_check_externally_modified (GeditDocument *doc)
 {
 	GFile *gfile;
-	GFileInfo *info;
 	GTimeVal timeval;
+	gboolean known;
 
 	g_return_val_if_fail (GEDIT_IS_DOCUMENT (doc), FALSE);
 
@@ -1088,21 +1147,16 @@ _gedit_document_check_externally_modified (GeditDocument *doc)
 	}
 
 	gfile = g_file_new_for_uri (doc->priv->uri);
-	info = g_file_query_info (gfile,
-				  G_FILE_ATTRIBUTE_TIME_MODIFIED,
-				  G_FILE_QUERY_INFO_NONE,
-				  NULL, NULL);
+	known = gedit_file_change_tracker_get_mtime (gedit_file_change_tracker_get_default (),
+						     gfile,
+						     &timeval);
 	g_object_unref (gfile);
 
-	if (info == NULL ||
-	    !g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_TIME_MODIFIED))
+	if (!known)
 	{
 		return FALSE;
 	}
 
-	g_file_info_get_modification_time (info, &timeval);
-	g_object_unref (info);
-	
 	return (timeval.tv_sec > doc->priv->mtime.tv_sec) ||
 	       (timeval.tv_sec == doc->priv->mtime.tv_sec && 
 	       timeval.tv_usec > doc->priv->mtime.tv_usec);
@@ -1280,6 +1334,7 @@ gedit_document_load_real (GeditDocument       *doc,
 	doc->priv->create = create;
 	doc->priv->requested_encoding = encoding;
 	doc->priv->requested_line_pos = line_pos;
+	doc->priv->not_loaded = FALSE;
 
 	set_uri (doc, uri);
 	set_content_type (doc, NULL);
@@ -1368,8 +1423,10 @@ document_saver_saving (GeditDocumentSaver *saver,
 
 			_gedit_document_set_readonly (doc, FALSE);
 
+			/* what has been edited after the snapshot is not
+			 * saved yet */
 			gtk_text_buffer_set_modified (GTK_TEXT_BUFFER (doc),
-						      FALSE);
+						      doc->priv->changed_while_saving);
 
 			set_encoding (doc, 
 				      doc->priv->requested_encoding, 
@@ -1413,6 +1470,7 @@ gedit_document_save_real (GeditDocument          *doc,
 
 	/* create a saver, it will be destroyed once saving is complete */
 	doc->priv->saver = gedit_document_saver_new (doc, uri, encoding, flags);
+	doc->priv->changed_while_saving = FALSE;
 
 	g_signal_connect (doc->priv->saver,
 			  "saving",
@@ -1721,7 +1779,7 @@ gedit_document_search_forward (GeditDocument     *doc,
 			       GtkTextIter       *match_end)
 {
 	GtkTextIter iter;
-	GtkSourceSearchFlags search_flags;
+	GeditTextSearch *search;
 	gboolean found = FALSE;
 	GtkTextIter m_start;
 	GtkTextIter m_end;
@@ -1745,21 +1803,17 @@ gedit_document_search_forward (GeditDocument     *doc,
 	else
 		iter = *start;
 		
-	search_flags = GTK_SOURCE_SEARCH_VISIBLE_ONLY | GTK_SOURCE_SEARCH_TEXT_ONLY;
-
-	if (!GEDIT_SEARCH_IS_CASE_SENSITIVE (doc->priv->search_flags))
-	{
-		search_flags = search_flags | GTK_SOURCE_SEARCH_CASE_INSENSITIVE;
-	}
+	search = gedit_text_search_new (GTK_TEXT_BUFFER (doc),
+					doc->priv->search_text,
+					GEDIT_SEARCH_IS_CASE_SENSITIVE (doc->priv->search_flags));
 		
 	while (!found)
 	{
-		found = gtk_source_iter_forward_search (&iter,
-							doc->priv->search_text, 
-							search_flags,
-                        	                	&m_start, 
-                        	                	&m_end,
-                                	               	end);
+		found = gedit_text_search_forward (search,
+						   &iter,
+						   end,
+						   &m_start,
+						   &m_end);
       	               	
 		if (found && GEDIT_SEARCH_IS_ENTIRE_WORD (doc->priv->search_flags))
 		{
@@ -1772,6 +1826,8 @@ gedit_document_search_forward (GeditDocument     *doc,
 		else
 			break;
 	}
+
+	gedit_text_search_free (search);
 	
 	if (found && (match_start != NULL))
 		*match_start = m_start;
@@ -1790,7 +1846,7 @@ gedit_document_search_backward (GeditDocument     *doc,
 				GtkTextIter       *match_end)
 {
 	GtkTextIter iter;
-	GtkSourceSearchFlags search_flags;
+	GeditTextSearch *search;
 	gboolean found = FALSE;
 	GtkTextIter m_start;
 	GtkTextIter m_end;
@@ -1814,21 +1870,17 @@ gedit_document_search_backward (GeditDocument     *doc,
 	else
 		iter = *end;
 		
-	search_flags = GTK_SOURCE_SEARCH_VISIBLE_ONLY | GTK_SOURCE_SEARCH_TEXT_ONLY;
-
-	if (!GEDIT_SEARCH_IS_CASE_SENSITIVE (doc->priv->search_flags))
-	{
-		search_flags = search_flags | GTK_SOURCE_SEARCH_CASE_INSENSITIVE;
-	}
+	search = gedit_text_search_new (GTK_TEXT_BUFFER (doc),
+					doc->priv->search_text,
+					GEDIT_SEARCH_IS_CASE_SENSITIVE (doc->priv->search_flags));
 
 	while (!found)
 	{
-		found = gtk_source_iter_backward_search (&iter,
-							 doc->priv->search_text, 
-							 search_flags,
-                        	                	 &m_start, 
-                        	                	 &m_end,
-                                	               	 start);
+		found = gedit_text_search_backward (search,
+						    &iter,
+						    start,
+						    &m_start,
+						    &m_end);
       	               	
 		if (found && GEDIT_SEARCH_IS_ENTIRE_WORD (doc->priv->search_flags))
 		{
@@ -1841,6 +1893,8 @@ gedit_document_search_backward (GeditDocument     *doc,
 		else
 			break;
 	}
+
+	gedit_text_search_free (search);
 	
 	if (found && (match_start != NULL))
 		*match_start = m_start;
@@ -1851,6 +1905,108 @@ gedit_document_search_backward (GeditDocument     *doc,
 	return found;		      
 }
 
+/* Matches closer than this are replaced together, copying the text
+ * between them, so that replacing many matches does not cost one
+ * buffer change each */
+#define REPLACE_ALL_MAX_GAP 1024
+
+typedef struct _ReplaceMatch
+{
+	gint start;
+	gint end;
+
+	/* replaced together with the previous match */
+	gboolean joined;
+} ReplaceMatch;
+
+/* Whether the text from @start to @end can be deleted and inserted
+ * again: a mark in it would be moved and a tag on it would be lost */
+static gboolean
+gap_is_plain (const GtkTextIter *start,
+	      const GtkTextIter *end)
+{
+	GtkTextIter iter;
+
+	if (gtk_text_iter_get_offset (end) - gtk_text_iter_get_offset (start) >= REPLACE_ALL_MAX_GAP)
+		return FALSE;
+
+	iter = *start;
+
+	while (TRUE)
+	{
+		GSList *marks;
+
+		if (gtk_text_iter_toggles_tag (&iter, NULL))
+			return FALSE;
+
+		marks = gtk_text_iter_get_marks (&iter);
+		if (marks != NULL)
+		{
+			g_slist_free (marks);
+			return FALSE;
+		}
+
+		if (gtk_text_iter_compare (&iter, end) >= 0)
+			return TRUE;
+
+		gtk_text_iter_forward_char (&iter);
+	}
+}
+
+/* Replaces the matches from @matches[0] to @matches[n_matches - 1]
+ * with a single delete and insert of the whole range */
+static void
+replace_region (GtkTextBuffer      *buffer,
+		const ReplaceMatch *matches,
+		guint               n_matches,
+		const gchar        *replace_text,
+		gint                replace_text_len)
+{
+	GtkTextIter start;
+	GtkTextIter end;
+	GString *text;
+	gchar *slice;
+	const gchar *p;
+	gint offset;
+	guint i;
+
+	gtk_text_buffer_get_iter_at_offset (buffer, &start, matches[0].start);
+	gtk_text_buffer_get_iter_at_offset (buffer, &end, matches[n_matches - 1].end);
+
+	if (n_matches == 1)
+	{
+		gtk_text_buffer_delete (buffer, &start, &end);
+		gtk_text_buffer_insert (buffer, &start, replace_text, replace_text_len);
+
+		return;
+	}
+
+	slice = gtk_text_iter_get_slice (&start, &end);
+	text = g_string_sized_new (strlen (slice) + n_matches * replace_text_len);
+
+	p = slice;
+	offset = matches[0].start;
+
+	for (i = 0; i < n_matches; i++)
+	{
+		const gchar *match;
+
+		match = g_utf8_offset_to_pointer (p, matches[i].start - offset);
+
+		g_string_append_len (text, p, match - p);
+		g_string_append_len (text, replace_text, replace_text_len);
+
+		p = g_utf8_offset_to_pointer (match, matches[i].end - matches[i].start);
+		offset = matches[i].end;
+	}
+
+	gtk_text_buffer_delete (buffer, &start, &end);
+	gtk_text_buffer_insert (buffer, &start, text->str, text->len);
+
+	g_string_free (text, TRUE);
+	g_free (slice);
+}
+
 gint 
 gedit_document_replace_all (GeditDocument       *doc,
 			    const gchar         *find, 
@@ -1860,9 +2016,11 @@ gedit_document_replace_all (GeditDocument       *doc,
 	GtkTextIter iter;
 	GtkTextIter m_start;
 	GtkTextIter m_end;
-	GtkSourceSearchFlags search_flags = 0;
-	gboolean found = TRUE;
+	GtkTextIter prev_end;
+	GeditTextSearch *search;
+	GArray *matches;
 	gint cont = 0;
+	gint region_end;
 	gchar *search_text;
 	gchar *replace_text;
 	gint replace_text_len;
@@ -1885,14 +2043,45 @@ gedit_document_replace_all (GeditDocument       *doc,
 
 	gtk_text_buffer_get_start_iter (buffer, &iter);
 
-	search_flags = GTK_SOURCE_SEARCH_VISIBLE_ONLY | GTK_SOURCE_SEARCH_TEXT_ONLY;
+	search = gedit_text_search_new (buffer,
+					search_text,
+					GEDIT_SEARCH_IS_CASE_SENSITIVE (flags));
+
+	replace_text_len = strlen (replace_text);
+
+	/* find all the matches first, the buffer is not changed until
+	 * we know what to replace */
+	matches = g_array_new (FALSE, FALSE, sizeof (ReplaceMatch));
 
-	if (!GEDIT_SEARCH_IS_CASE_SENSITIVE (flags))
+	while (gedit_text_search_forward (search, &iter, NULL, &m_start, &m_end))
 	{
-		search_flags = search_flags | GTK_SOURCE_SEARCH_CASE_INSENSITIVE;
+		ReplaceMatch match;
+
+		iter = m_end;
+
+		if (GEDIT_SEARCH_IS_ENTIRE_WORD (flags) &&
+		    !(gtk_text_iter_starts_word (&m_start) &&
+		      gtk_text_iter_ends_word (&m_end)))
+		{
+			continue;
+		}
+
+		match.start = gtk_text_iter_get_offset (&m_start);
+		match.end = gtk_text_iter_get_offset (&m_end);
+		match.joined = (matches->len > 0) &&
+			       gap_is_plain (&prev_end, &m_start);
+
+		g_array_append_val (matches, match);
+
+		prev_end = m_end;
 	}
 
-	replace_text_len = strlen (replace_text);
+	gedit_text_search_free (search);
+
+	cont = matches->len;
+
+	if (cont == 0)
+		goto out;
 
 	/* disable cursor_moved emission until the end of the
 	 * replace_all so that we don't spend all the time
@@ -1910,45 +2099,26 @@ gedit_document_replace_all (GeditDocument       *doc,
 
 	gtk_text_buffer_begin_user_action (buffer);
 
-	do
-	{
-		found = gtk_source_iter_forward_search (&iter,
-							search_text, 
-							search_flags,
-                        	                	&m_start, 
-                        	                	&m_end,
-                                	               	NULL);
-
-		if (found && GEDIT_SEARCH_IS_ENTIRE_WORD (flags))
-		{
-			gboolean word;
-
-			word = gtk_text_iter_starts_word (&m_start) && 
-			       gtk_text_iter_ends_word (&m_end);
+	/* replace from the end, so that the offsets of the matches
+	 * before are still valid. Only the runs of matches without marks
+	 * and tags between them are replaced together */
+	region_end = matches->len;
 
-			if (!word)
-			{
-				iter = m_end;
-				continue;
-			}
-		}
-
-		if (found)
-		{
-			++cont;
+	while (region_end > 0)
+	{
+		gint region_start = region_end - 1;
 
-			gtk_text_buffer_delete (buffer, 
-						&m_start,
-						&m_end);
-			gtk_text_buffer_insert (buffer,
-						&m_start,
-						replace_text,
-						replace_text_len);
+		while (g_array_index (matches, ReplaceMatch, region_start).joined)
+			--region_start;
 
-			iter = m_start;
-		}		
+		replace_region (buffer,
+				&g_array_index (matches, ReplaceMatch, region_start),
+				region_end - region_start,
+				replace_text,
+				replace_text_len);
 
-	} while (found);
+		region_end = region_start;
+	}
 
 	gtk_text_buffer_end_user_action (buffer);
 
@@ -1962,6 +2132,8 @@ gedit_document_replace_all (GeditDocument       *doc,
 							   brackets_highlighting);
 	gedit_document_set_enable_search_highlighting (doc, search_highliting);
 
+ out:
+	g_array_free (matches, TRUE);
 	g_free (search_text);
 	g_free (replace_text);
 
@@ -2116,7 +2288,7 @@ search_region (GeditDocument *doc,
 	GtkTextIter iter;
 	GtkTextIter m_start;
 	GtkTextIter m_end;	
-	GtkSourceSearchFlags search_flags = 0;
+	GeditTextSearch *search;
 	gboolean found = TRUE;
 
 	GtkTextBuffer *buffer;	
@@ -2175,25 +2347,21 @@ search_region (GeditDocument *doc,
 		return;
 
 	iter = *start;
-		
-	search_flags = GTK_SOURCE_SEARCH_VISIBLE_ONLY | GTK_SOURCE_SEARCH_TEXT_ONLY;
 
-	if (!GEDIT_SEARCH_IS_CASE_SENSITIVE (doc->priv->search_flags))
-	{
-		search_flags = search_flags | GTK_SOURCE_SEARCH_CASE_INSENSITIVE;
-	}
+	search = gedit_text_search_new (buffer,
+					doc->priv->search_text,
+					GEDIT_SEARCH_IS_CASE_SENSITIVE (doc->priv->search_flags));
 	
 	do
 	{
 		if ((end != NULL) && gtk_text_iter_is_end (end))
 			end = NULL;
 			
-		found = gtk_source_iter_forward_search (&iter,
-							doc->priv->search_text, 
-							search_flags,
-                        	                	&m_start, 
-                        	                	&m_end,
-                                	               	end);
+		found = gedit_text_search_forward (search,
+						   &iter,
+						   end,
+						   &m_start,
+						   &m_end);
 				
 		iter = m_end;
 						      	               	
@@ -2217,6 +2385,8 @@ search_region (GeditDocument *doc,
 		}		
 
 	} while (found);
+
+	gedit_text_search_free (search);
 }
 
 static void
@@ -280,6 +280,10 @@ gboolean	_gedit_document_check_externally_modified
 void		_gedit_document_search_region   (GeditDocument       *doc,
 						 const GtkTextIter   *start,
 						 const GtkTextIter   *end);
+
+void		_gedit_document_set_uri_not_loaded
+						(GeditDocument       *doc,
+						 const gchar         *uri);
 						  
 /* Search macros */
 #define GEDIT_SEARCH_IS_DONT_SET_FLAGS(sflags) ((sflags & GEDIT_SEARCH_DONT_SET_FLAGS) != 0)
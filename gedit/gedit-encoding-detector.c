@@ -0,0 +1,850 @@
+/*
+ * gedit-encoding-detector.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/*
+ * The detector looks at a sample of the text once, collecting byte
+ * statistics and running a small state machine for each multibyte
+ * family, and then gives a confidence to every candidate encoding from
+ * those statistics. This replaces trying a full conversion for each
+ * candidate in turn: the caller only needs to confirm the best ones.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "gedit-encoding-detector.h"
+
+/* Bytes with the high bit set, or NUL, end an ASCII run: g_utf8_validate
+ * does not accept NUL either when a length is given */
+#define ASCII_ONES  ((gsize) -1 / 0xff)
+#define ASCII_HIGHS (ASCII_ONES * 0x80)
+
+typedef enum
+{
+	FAMILY_EUC,
+	FAMILY_EUC_JP,
+	FAMILY_EUC_TW,
+	FAMILY_GBK,
+	FAMILY_GB18030,
+	FAMILY_BIG5,
+	FAMILY_SJIS,
+	FAMILY_JOHAB,
+	N_FAMILIES
+} MultibyteFamily;
+
+typedef struct
+{
+	guchar  lo;
+	guchar  hi;
+	gdouble weight;
+} LeadRange;
+
+/* The lead bytes which are typical (or not) of the language usually
+ * written in each encoding */
+typedef struct
+{
+	const gchar     *charset;
+	MultibyteFamily  family;
+	LeadRange        ranges[3];
+} MultibyteEncoding;
+
+static const MultibyteEncoding multibyte_encodings[] =
+{
+	{ "EUC-JP",     FAMILY_EUC_JP,  { { 0xa4, 0xa5,  2.0 } } },
+	{ "EUC-JP-MS",  FAMILY_EUC_JP,  { { 0xa4, 0xa5,  2.0 } } },
+	{ "EUC-KR",     FAMILY_EUC,     { { 0xb0, 0xc8,  1.0 }, { 0xc9, 0xfe, -2.0 }, { 0xa4, 0xa5, -2.0 } } },
+	{ "GB2312",     FAMILY_EUC,     { { 0xc9, 0xf7,  2.0 }, { 0xa4, 0xa5, -2.0 } } },
+	{ "EUC-TW",     FAMILY_EUC_TW,  { { 0xc4, 0xfd,  1.0 } } },
+	{ "GBK",        FAMILY_GBK,     { { 0xc9, 0xf7,  1.5 }, { 0x81, 0xa0,  1.0 }, { 0xa4, 0xa5, -2.0 } } },
+	{ "GB18030",    FAMILY_GB18030, { { 0xc9, 0xf7,  1.5 }, { 0x81, 0xa0,  1.0 }, { 0xa4, 0xa5, -2.0 } } },
+	{ "UHC",        FAMILY_GBK,     { { 0xb0, 0xc8,  1.0 }, { 0x81, 0xa0,  0.5 }, { 0xc9, 0xfe, -2.0 } } },
+	{ "BIG5",       FAMILY_BIG5,    { { 0xa4, 0xc6,  1.0 }, { 0xc9, 0xf9,  0.5 } } },
+	{ "BIG5-HKSCS", FAMILY_BIG5,    { { 0xa4, 0xc6,  1.0 }, { 0xc9, 0xf9,  0.5 } } },
+	{ "SHIFT_JIS",  FAMILY_SJIS,    { { 0x82, 0x83,  2.0 } } },
+	{ "CP932",      FAMILY_SJIS,    { { 0x82, 0x83,  2.0 } } },
+	{ "JOHAB",      FAMILY_JOHAB,   { { 0x88, 0xd3,  1.0 } } }
+};
+
+typedef struct
+{
+	const gchar *charset;
+
+	/* Written mostly with ASCII letters and some accented ones, as
+	 * opposed to scripts where whole words are made of high bytes */
+	gboolean     latin;
+
+	/* 0x80 - 0x9f are printable characters and not C1 controls */
+	gboolean     c1_printable;
+
+	/* Where the most frequent (lowercase) letters are, if anywhere */
+	guchar       lower_lo;
+	guchar       lower_hi;
+
+	/* Pairs of bytes delimiting ranges which cannot be converted */
+	const gchar *undefined;
+} SingleByteEncoding;
+
+static const SingleByteEncoding single_byte_encodings[] =
+{
+	{ "ISO-8859-1",       TRUE,  FALSE, 0xe0, 0xff, NULL },
+	{ "ISO-8859-2",       TRUE,  FALSE, 0xe0, 0xfe, NULL },
+	{ "ISO-8859-3",       TRUE,  FALSE, 0xe0, 0xfe, "\xa5\xa5\xae\xae\xbe\xbe\xc3\xc3\xd0\xd0\xe3\xe3\xf0\xf0" },
+	{ "ISO-8859-4",       TRUE,  FALSE, 0xe0, 0xfe, NULL },
+	{ "ISO-8859-5",       FALSE, FALSE, 0xd0, 0xef, NULL },
+	{ "ISO-8859-6",       FALSE, FALSE, 0xc1, 0xf2, "\xa1\xa3\xa5\xab\xae\xba\xbc\xbe\xc0\xc0\xdb\xdf\xf3\xff" },
+	{ "ISO-8859-7",       FALSE, FALSE, 0xdc, 0xfe, "\xae\xae\xd2\xd2\xff\xff" },
+	{ "ISO-8859-8",       FALSE, FALSE, 0xe0, 0xfa, "\xa1\xa1\xbf\xde\xfb\xfc\xff\xff" },
+	{ "ISO-8859-9",       TRUE,  FALSE, 0xe0, 0xff, NULL },
+	{ "ISO-8859-10",      TRUE,  FALSE, 0xe0, 0xff, NULL },
+	{ "ISO-8859-13",      TRUE,  FALSE, 0xe0, 0xfe, NULL },
+	{ "ISO-8859-14",      TRUE,  FALSE, 0xe0, 0xff, NULL },
+	{ "ISO-8859-15",      TRUE,  FALSE, 0xe0, 0xff, NULL },
+	{ "ISO-8859-16",      TRUE,  FALSE, 0xe0, 0xff, NULL },
+	{ "ARMSCII-8",        FALSE, FALSE, 0xb2, 0xfe, NULL },
+	{ "CP866",            FALSE, TRUE,  0xa0, 0xef, NULL },
+	{ "GEORGIAN-ACADEMY", FALSE, TRUE,  0xc0, 0xe6, NULL },
+	{ "IBM850",           TRUE,  TRUE,  0x80, 0xa5, NULL },
+	{ "IBM852",           TRUE,  TRUE,  0x80, 0xaf, NULL },
+	{ "IBM855",           FALSE, TRUE,  0,    0,    NULL },
+	{ "IBM857",           TRUE,  TRUE,  0x80, 0xa7, NULL },
+	{ "IBM862",           FALSE, TRUE,  0x80, 0x9a, NULL },
+	{ "IBM864",           FALSE, TRUE,  0,    0,    NULL },
+	{ "ISO-IR-111",       FALSE, FALSE, 0xc0, 0xdf, NULL },
+	{ "KOI8R",            FALSE, TRUE,  0xc0, 0xdf, NULL },
+	{ "KOI8-R",           FALSE, TRUE,  0xc0, 0xdf, NULL },
+	{ "KOI8U",            FALSE, TRUE,  0xc0, 0xdf, NULL },
+	{ "TCVN",             TRUE,  TRUE,  0,    0,    NULL },
+	{ "TIS-620",          FALSE, FALSE, 0xa1, 0xfb, "\x80\xa0\xdb\xde\xfc\xff" },
+	{ "VISCII",           TRUE,  TRUE,  0,    0,    NULL },
+	{ "WINDOWS-1250",     TRUE,  TRUE,  0xe0, 0xfe, "\x81\x81\x83\x83\x88\x88\x90\x90\x98\x98" },
+	{ "WINDOWS-1251",     FALSE, TRUE,  0xe0, 0xff, "\x98\x98" },
+	{ "WINDOWS-1252",     TRUE,  TRUE,  0xe0, 0xff, "\x81\x81\x8d\x8d\x8f\x90\x9d\x9d" },
+	{ "WINDOWS-1253",     FALSE, TRUE,  0xdc, 0xfe, "\x81\x81\x88\x88\x8a\x8a\x8c\x90\x98\x98\x9a\x9a\x9c\x9f\xaa\xaa\xd2\xd2\xff\xff" },
+	{ "WINDOWS-1254",     TRUE,  TRUE,  0xe0, 0xff, "\x81\x81\x8d\x90\x9d\x9e" },
+	{ "WINDOWS-1255",     FALSE, TRUE,  0xe0, 0xfa, "\x81\x81\x8a\x8a\x8c\x90\x9a\x9a\x9c\x9f\xca\xca\xd9\xdf\xfb\xfc\xff\xff" },
+	{ "WINDOWS-1256",     FALSE, TRUE,  0xc1, 0xff, NULL },
+	{ "WINDOWS-1257",     TRUE,  TRUE,  0xe0, 0xfe, "\x81\x81\x83\x83\x88\x88\x8a\x8a\x8c\x8c\x90\x90\x98\x98\x9a\x9a\x9c\x9c\x9f\x9f\xa1\xa1\xa5\xa5" },
+	{ "WINDOWS-1258",     TRUE,  TRUE,  0xe0, 0xff, "\x81\x81\x8a\x8a\x8d\x90\x9a\x9a\x9d\x9e" }
+};
+
+/* State of the validation of the text as one of the multibyte families */
+typedef struct
+{
+	guchar lead;
+	guint  pos;
+	guint  remaining;
+
+	gsize  chars;
+	gsize  errors;
+
+	/* Occurrences of each lead byte >= 0x80 */
+	gsize  leads[128];
+} MultibyteCheck;
+
+typedef struct
+{
+	gsize  len;
+
+	gsize  counts[256];
+	gsize  zeros[4];
+	gsize  high;
+	gsize  high_pairs;
+
+	gboolean       utf8_valid;
+
+	guint          families;
+	MultibyteCheck checks[N_FAMILIES];
+} Statistics;
+
+gsize
+gedit_encoding_detector_ascii_length (const gchar *text,
+				      gsize        len)
+{
+	const guchar *buf = (const guchar *)text;
+	gsize i = 0;
+
+#ifdef __AVX2__
+	for (; i + 32 <= len; i += 32)
+	{
+		__m256i v;
+
+		v = _mm256_loadu_si256 ((const __m256i *)(buf + i));
+		v = _mm256_or_si256 (v, _mm256_cmpeq_epi8 (v, _mm256_setzero_si256 ()));
+
+		if (_mm256_movemask_epi8 (v) != 0)
+			break;
+	}
+#endif
+
+#ifdef __SSE2__
+	for (; i + 16 <= len; i += 16)
+	{
+		__m128i v;
+
+		v = _mm_loadu_si128 ((const __m128i *)(buf + i));
+		v = _mm_or_si128 (v, _mm_cmpeq_epi8 (v, _mm_setzero_si128 ()));
+
+		if (_mm_movemask_epi8 (v) != 0)
+			break;
+	}
+#endif
+
+	/* scalar fallback, a word at a time */
+	for (; i + sizeof (gsize) <= len; i += sizeof (gsize))
+	{
+		gsize w;
+
+		memcpy (&w, buf + i, sizeof (gsize));
+
+		if (((w | ((w - ASCII_ONES) & ~w)) & ASCII_HIGHS) != 0)
+			break;
+	}
+
+	while (i < len && buf[i] != 0 && buf[i] < 0x80)
+		i++;
+
+	return i;
+}
+
+/* Length of the utf8 sequence starting at p, or 0 if it is not valid or
+ * it is truncated. Overlong forms, surrogates and code points after
+ * U+10FFFF are rejected like g_utf8_validate does. */
+static gsize
+utf8_sequence_length (const guchar *p,
+		      gsize         len)
+{
+	guchar min = 0x80;
+	guchar max = 0xbf;
+	gsize n;
+	gsize i;
+
+	if (p[0] < 0xc2)
+		return 0;
+	else if (p[0] < 0xe0)
+		n = 2;
+	else if (p[0] < 0xf0)
+	{
+		n = 3;
+
+		if (p[0] == 0xe0)
+			min = 0xa0;
+		else if (p[0] == 0xed)
+			max = 0x9f;
+	}
+	else if (p[0] < 0xf5)
+	{
+		n = 4;
+
+		if (p[0] == 0xf0)
+			min = 0x90;
+		else if (p[0] == 0xf4)
+			max = 0x8f;
+	}
+	else
+		return 0;
+
+	if (len < n)
+		return 0;
+
+	if (p[1] < min || p[1] > max)
+		return 0;
+
+	for (i = 2; i < n; i++)
+	{
+		if (p[i] < 0x80 || p[i] > 0xbf)
+			return 0;
+	}
+
+	return n;
+}
+
+gboolean
+gedit_encoding_detector_validate_utf8 (const gchar  *text,
+				       gsize         len,
+				       const gchar **end)
+{
+	const guchar *p = (const guchar *)text;
+	const guchar *stop = p + len;
+	gboolean valid = TRUE;
+
+	while (p < stop)
+	{
+		p += gedit_encoding_detector_ascii_length ((const gchar *)p, stop - p);
+
+		/* CJK and the like: stay in the scalar loop until the
+		 * next ASCII byte */
+		while (p < stop && *p >= 0x80)
+		{
+			gsize n;
+
+			n = utf8_sequence_length (p, stop - p);
+			if (n == 0)
+				break;
+
+			p += n;
+		}
+
+		if (p < stop && (*p == 0 || *p >= 0x80))
+		{
+			valid = FALSE;
+			break;
+		}
+	}
+
+	if (end != NULL)
+		*end = (const gchar *)p;
+
+	return valid;
+}
+
+#define IN_RANGE(c,lo,hi) ((c) >= (lo) && (c) <= (hi))
+
+/* Length of the sequence starting with the given lead byte, 0 if the
+ * byte cannot start a sequence */
+static guint
+lead_length (MultibyteFamily family,
+	     guchar          c)
+{
+	switch (family)
+	{
+		case FAMILY_EUC:
+			return IN_RANGE (c, 0xa1, 0xfe) ? 2 : 0;
+		case FAMILY_EUC_JP:
+			if (c == 0x8e)
+				return 2;
+			if (c == 0x8f)
+				return 3;
+			return IN_RANGE (c, 0xa1, 0xfe) ? 2 : 0;
+		case FAMILY_EUC_TW:
+			if (c == 0x8e)
+				return 4;
+			return IN_RANGE (c, 0xa1, 0xfe) ? 2 : 0;
+		case FAMILY_GBK:
+		case FAMILY_GB18030:
+		case FAMILY_BIG5:
+			return IN_RANGE (c, 0x81, 0xfe) ? 2 : 0;
+		case FAMILY_SJIS:
+			/* half width katakana */
+			if (IN_RANGE (c, 0xa1, 0xdf))
+				return 1;
+			return (IN_RANGE (c, 0x81, 0x9f) || IN_RANGE (c, 0xe0, 0xfc)) ? 2 : 0;
+		case FAMILY_JOHAB:
+			return (IN_RANGE (c, 0x84, 0xd3) ||
+				IN_RANGE (c, 0xd8, 0xde) ||
+				IN_RANGE (c, 0xe0, 0xf9)) ? 2 : 0;
+		default:
+			g_return_val_if_reached (0);
+	}
+}
+
+/* Whether c is valid at position pos (starting from 1) of the sequence */
+static gboolean
+trail_valid (MultibyteFamily family,
+	     guchar          lead,
+	     guint           pos,
+	     guchar          c)
+{
+	switch (family)
+	{
+		case FAMILY_EUC:
+			return IN_RANGE (c, 0xa1, 0xfe);
+		case FAMILY_EUC_JP:
+			if (lead == 0x8e)
+				return IN_RANGE (c, 0xa1, 0xdf);
+			return IN_RANGE (c, 0xa1, 0xfe);
+		case FAMILY_EUC_TW:
+			if (lead == 0x8e && pos == 1)
+				return IN_RANGE (c, 0xa1, 0xb0);
+			return IN_RANGE (c, 0xa1, 0xfe);
+		case FAMILY_GBK:
+			return IN_RANGE (c, 0x40, 0xfe) && c != 0x7f;
+		case FAMILY_GB18030:
+			if (pos == 1)
+				return (IN_RANGE (c, 0x40, 0xfe) && c != 0x7f) ||
+				       IN_RANGE (c, 0x30, 0x39);
+			if (pos == 2)
+				return IN_RANGE (c, 0x81, 0xfe);
+			return IN_RANGE (c, 0x30, 0x39);
+		case FAMILY_BIG5:
+			return IN_RANGE (c, 0x40, 0x7e) || IN_RANGE (c, 0xa1, 0xfe);
+		case FAMILY_SJIS:
+			return IN_RANGE (c, 0x40, 0x7e) || IN_RANGE (c, 0x80, 0xfc);
+		case FAMILY_JOHAB:
+			return IN_RANGE (c, 0x31, 0x7e) || IN_RANGE (c, 0x81, 0xfe);
+		default:
+			g_return_val_if_reached (FALSE);
+	}
+}
+
+static void
+multibyte_check_feed (MultibyteCheck  *check,
+		      MultibyteFamily  family,
+		      guchar           c)
+{
+	if (check->remaining > 0)
+	{
+		if (trail_valid (family, check->lead, check->pos, c))
+		{
+			/* four bytes GB18030 sequence */
+			if (family == FAMILY_GB18030 && check->pos == 1 &&
+			    IN_RANGE (c, 0x30, 0x39))
+			{
+				check->remaining += 2;
+			}
+
+			check->pos++;
+			check->remaining--;
+
+			if (check->remaining == 0)
+				check->chars++;
+
+			return;
+		}
+
+		/* broken sequence, c may start a new one */
+		check->errors++;
+		check->remaining = 0;
+	}
+
+	if (c < 0x80)
+		return;
+
+	check->leads[c - 0x80]++;
+
+	switch (lead_length (family, c))
+	{
+		case 0:
+			check->errors++;
+			break;
+		case 1:
+			check->chars++;
+			break;
+		default:
+			check->lead = c;
+			check->pos = 1;
+			check->remaining = lead_length (family, c) - 1;
+			break;
+	}
+}
+
+static const MultibyteEncoding *
+find_multibyte_encoding (const gchar *charset)
+{
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (multibyte_encodings); i++)
+	{
+		if (g_ascii_strcasecmp (charset, multibyte_encodings[i].charset) == 0)
+			return &multibyte_encodings[i];
+	}
+
+	return NULL;
+}
+
+static const SingleByteEncoding *
+find_single_byte_encoding (const gchar *charset)
+{
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (single_byte_encodings); i++)
+	{
+		if (g_ascii_strcasecmp (charset, single_byte_encodings[i].charset) == 0)
+			return &single_byte_encodings[i];
+	}
+
+	return NULL;
+}
+
+static void
+collect_statistics (Statistics   *stats,
+		    const guchar *text,
+		    gsize         len)
+{
+	const gchar *end;
+	guchar prev = 0;
+	gsize i;
+
+	stats->len = len;
+
+	/* the last char may have been cut by the sample */
+	stats->utf8_valid = gedit_encoding_detector_validate_utf8 ((const gchar *)text, len, &end) ||
+			    len - (end - (const gchar *)text) < 6;
+
+	for (i = 0; i < len; i++)
+	{
+		guchar c = text[i];
+		guint f;
+
+		stats->counts[c]++;
+
+		if (c == 0)
+		{
+			stats->zeros[i & 3]++;
+		}
+		else if (c >= 0x80)
+		{
+			stats->high++;
+
+			if (prev >= 0x80)
+				stats->high_pairs++;
+		}
+
+		for (f = 0; f < N_FAMILIES; f++)
+		{
+			if (stats->families & (1 << f))
+				multibyte_check_feed (&stats->checks[f], f, c);
+		}
+
+		prev = c;
+	}
+}
+
+static gsize
+count_range (const gsize *counts,
+	     guchar       lo,
+	     guchar       hi)
+{
+	gsize n = 0;
+	guint c;
+
+	for (c = lo; c <= hi; c++)
+		n += counts[c];
+
+	return n;
+}
+
+/* C0 controls which are not expected in text */
+static gsize
+count_controls (const Statistics *stats)
+{
+	return count_range (stats->counts, 0x01, 0x08) +
+	       count_range (stats->counts, 0x0e, 0x1a) +
+	       count_range (stats->counts, 0x1c, 0x1f) +
+	       stats->counts[0x7f];
+}
+
+static gdouble
+utf16_confidence (const Statistics *stats,
+		  gboolean          big_endian)
+{
+	gsize even, odd;
+	gdouble units;
+
+	if (stats->len < 2 || stats->len % 2 != 0)
+		return 0.05;
+
+	units = stats->len / 2;
+	even = stats->zeros[0] + stats->zeros[2];
+	odd = stats->zeros[1] + stats->zeros[3];
+
+	/* ASCII characters have their high byte first in big endian */
+	if (big_endian && even > odd)
+		return 0.5 + 0.45 * (even - odd) / units;
+	if (!big_endian && odd > even)
+		return 0.5 + 0.45 * (odd - even) / units;
+
+	return 0.05;
+}
+
+static gdouble
+utf32_confidence (const Statistics *stats,
+		  gboolean          big_endian)
+{
+	gsize expected;
+
+	if (stats->len < 4 || stats->len % 4 != 0)
+		return 0.05;
+
+	if (big_endian)
+		expected = stats->zeros[0] + stats->zeros[1] + stats->zeros[2];
+	else
+		expected = stats->zeros[1] + stats->zeros[2] + stats->zeros[3];
+
+	return 0.05 + 0.9 * expected / (stats->len * 3.0 / 4.0);
+}
+
+static gdouble
+unicode_confidence (const Statistics *stats,
+		    const gchar      *charset,
+		    const guchar     *text)
+{
+	if (g_ascii_strcasecmp (charset, "UTF-16BE") == 0)
+		return utf16_confidence (stats, TRUE);
+
+	if (g_ascii_strcasecmp (charset, "UTF-16LE") == 0)
+		return utf16_confidence (stats, FALSE);
+
+	if (g_ascii_strcasecmp (charset, "UTF-16") == 0 ||
+	    g_ascii_strcasecmp (charset, "UCS-2") == 0)
+	{
+		gdouble factor = 1.0;
+
+		/* with a BOM iconv knows the byte order */
+		if (stats->len >= 2 &&
+		    ((text[0] == 0xfe && text[1] == 0xff) ||
+		     (text[0] == 0xff && text[1] == 0xfe)))
+		{
+			return 1.0;
+		}
+
+		/* UCS-2 is a subset, prefer UTF-16 when both are candidates */
+		if (g_ascii_strcasecmp (charset, "UCS-2") == 0)
+			factor = 0.9;
+
+		return factor * MAX (utf16_confidence (stats, TRUE),
+				  utf16_confidence (stats, FALSE));
+	}
+
+	/* UTF-32 and UCS-4 */
+	if (stats->len >= 4 &&
+	    ((text[0] == 0 && text[1] == 0 && text[2] == 0xfe && text[3] == 0xff) ||
+	     (text[0] == 0xff && text[1] == 0xfe && text[2] == 0 && text[3] == 0)))
+	{
+		return 1.0;
+	}
+
+	return MAX (utf32_confidence (stats, TRUE),
+		    utf32_confidence (stats, FALSE));
+}
+
+static gdouble
+multibyte_confidence (const Statistics        *stats,
+		      const MultibyteEncoding *mb)
+{
+	const MultibyteCheck *check = &stats->checks[mb->family];
+	gsize leads = 0;
+	gdouble lang = 0.0;
+	guint i;
+
+	if (check->errors > 0 || check->chars == 0)
+		return 0.0;
+
+	for (i = 0; i < 128; i++)
+		leads += check->leads[i];
+
+	for (i = 0; i < G_N_ELEMENTS (mb->ranges); i++)
+	{
+		const LeadRange *r = &mb->ranges[i];
+
+		if (r->weight == 0.0)
+			continue;
+
+		lang += r->weight * count_range (check->leads, r->lo - 0x80, r->hi - 0x80) / leads;
+	}
+
+	return 0.55 + 0.4 * CLAMP (lang, 0.0, 1.0);
+}
+
+static gdouble
+single_byte_confidence (const Statistics         *stats,
+			const SingleByteEncoding *sb)
+{
+	gdouble runs;
+	gdouble script;
+	gdouble lower = 0.5;
+	gdouble confidence;
+
+	if (sb->undefined != NULL)
+	{
+		const guchar *p;
+
+		for (p = (const guchar *)sb->undefined; *p != '\0'; p += 2)
+		{
+			if (count_range (stats->counts, p[0], p[1]) > 0)
+				return 0.0;
+		}
+	}
+
+	/* how many of the high bytes are next to another one */
+	runs = MIN (1.0, 2.0 * stats->high_pairs / stats->high);
+	script = sb->latin ? 1.0 - runs : runs;
+
+	if (sb->lower_lo != 0)
+		lower = (gdouble)count_range (stats->counts, sb->lower_lo, sb->lower_hi) / stats->high;
+
+	confidence = 0.15 + 0.2 * script + 0.15 * lower;
+
+	/* C1 controls are almost never found in text */
+	if (!sb->c1_printable && count_range (stats->counts, 0x80, 0x9f) > 0)
+		confidence *= 0.1;
+
+	return confidence;
+}
+
+static gboolean
+is_unicode (const gchar *charset)
+{
+	return g_ascii_strncasecmp (charset, "UTF-16", 6) == 0 ||
+	       g_ascii_strncasecmp (charset, "UTF-32", 6) == 0 ||
+	       g_ascii_strncasecmp (charset, "UCS-", 4) == 0;
+}
+
+static gdouble
+get_confidence (const Statistics    *stats,
+		const GeditEncoding *enc,
+		const guchar        *text)
+{
+	const gchar *charset;
+	const MultibyteEncoding *mb;
+	const SingleByteEncoding *sb;
+	gdouble confidence;
+
+	charset = gedit_encoding_get_charset (enc);
+
+	if (is_unicode (charset))
+		return unicode_confidence (stats, charset, text);
+
+	/* NUL is not valid in any other encoding */
+	if (stats->zeros[0] + stats->zeros[1] + stats->zeros[2] + stats->zeros[3] > 0)
+		return 0.0;
+
+	if (enc == gedit_encoding_get_utf8 ())
+	{
+		if (!stats->utf8_valid)
+			return 0.0;
+
+		/* valid non ASCII utf8 is very unlikely to be anything else */
+		confidence = stats->high > 0 ? 1.0 : 0.9;
+	}
+	else if (g_ascii_strcasecmp (charset, "UTF-7") == 0)
+	{
+		if (stats->high > 0)
+			return 0.0;
+
+		confidence = stats->counts['+'] > 0 ? 0.5 : 0.9;
+	}
+	else if (g_ascii_strncasecmp (charset, "ISO-2022", 8) == 0)
+	{
+		if (stats->high > 0)
+			return 0.0;
+
+		confidence = stats->counts[0x1b] > 0 ? 0.95 : 0.9;
+	}
+	else if (stats->high == 0)
+	{
+		/* plain ASCII is the same in every other encoding */
+		confidence = 0.9;
+	}
+	else if ((mb = find_multibyte_encoding (charset)) != NULL)
+	{
+		confidence = multibyte_confidence (stats, mb);
+	}
+	else if ((sb = find_single_byte_encoding (charset)) != NULL)
+	{
+		confidence = single_byte_confidence (stats, sb);
+	}
+	else
+	{
+		/* we know nothing about it, let the conversion decide */
+		confidence = 0.25;
+	}
+
+	if (count_controls (stats) > 0)
+		confidence *= 0.5;
+
+	return confidence;
+}
+
+static gint
+compare_guesses (const GeditEncodingGuess *a,
+		 const GeditEncodingGuess *b)
+{
+	if (a->confidence > b->confidence)
+		return -1;
+	if (a->confidence < b->confidence)
+		return 1;
+
+	return 0;
+}
+
+GSList *
+gedit_encoding_detector_guess (const gchar  *text,
+			       gsize         len,
+			       gsize         sample_size,
+			       const GSList *candidates)
+{
+	Statistics *stats;
+	GSList *guesses = NULL;
+	const GSList *l;
+
+	g_return_val_if_fail (text != NULL || len == 0, NULL);
+
+	if (sample_size == 0)
+		sample_size = GEDIT_ENCODING_DETECTOR_DEFAULT_SAMPLE_SIZE;
+
+	len = MIN (len, sample_size);
+
+	stats = g_slice_new0 (Statistics);
+
+	/* only run the state machines needed by the candidates */
+	for (l = candidates; l != NULL; l = g_slist_next (l))
+	{
+		const MultibyteEncoding *mb;
+
+		mb = find_multibyte_encoding (gedit_encoding_get_charset (l->data));
+
+		if (mb != NULL)
+			stats->families |= 1 << mb->family;
+	}
+
+	collect_statistics (stats, (const guchar *)text, len);
+
+	for (l = candidates; l != NULL; l = g_slist_next (l))
+	{
+		GeditEncodingGuess *guess;
+
+		guess = g_slice_new (GeditEncodingGuess);
+		guess->encoding = l->data;
+		guess->confidence = get_confidence (stats, l->data, (const guchar *)text);
+
+		guesses = g_slist_prepend (guesses, guess);
+	}
+
+	g_slice_free (Statistics, stats);
+
+	/* g_slist_sort is stable, so the user order breaks ties */
+	return g_slist_sort (g_slist_reverse (guesses),
+			     (GCompareFunc) compare_guesses);
+}
+
+static void
+free_guess (GeditEncodingGuess *guess)
+{
+	g_slice_free (GeditEncodingGuess, guess);
+}
+
+void
+gedit_encoding_detector_free_guesses (GSList *guesses)
+{
+	g_slist_foreach (guesses, (GFunc) free_guess, NULL);
+	g_slist_free (guesses);
+}
@@ -0,0 +1,66 @@
+/*
+ * gedit-encoding-detector.h
+ * This file is part of gedit
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GEDIT_ENCODING_DETECTOR_H__
+#define __GEDIT_ENCODING_DETECTOR_H__
+
+#include <glib.h>
+
+#include "gedit-encodings.h"
+
+G_BEGIN_DECLS
+
+/* Number of bytes looked at when no sample size is given */
+#define GEDIT_ENCODING_DETECTOR_DEFAULT_SAMPLE_SIZE (64 * 1024)
+
+typedef struct _GeditEncodingGuess GeditEncodingGuess;
+
+struct _GeditEncodingGuess
+{
+	const GeditEncoding *encoding;
+
+	/* Between 0 and 1, 0 means the text cannot be in this encoding */
+	gdouble              confidence;
+};
+
+/* Returns a list of GeditEncodingGuess, one for each candidate, sorted by
+ * decreasing confidence. Candidates with the same confidence keep the
+ * order they have in @candidates. */
+GSList		*gedit_encoding_detector_guess		(const gchar  *text,
+							 gsize         len,
+							 gsize         sample_size,
+							 const GSList *candidates);
+
+void		 gedit_encoding_detector_free_guesses	(GSList       *guesses);
+
+/* Length of the ASCII (without NUL) prefix of @text */
+gsize		 gedit_encoding_detector_ascii_length	(const gchar  *text,
+							 gsize         len);
+
+/* Same as g_utf8_validate with a length, but faster on ASCII runs */
+gboolean	 gedit_encoding_detector_validate_utf8	(const gchar  *text,
+							 gsize         len,
+							 const gchar **end);
+
+G_END_DECLS
+
+#endif /* __GEDIT_ENCODING_DETECTOR_H__ */
@@ -0,0 +1,382 @@
+/*
+ * gedit-file-change-tracker.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gedit-file-change-tracker.h"
+#include "gedit-debug.h"
+
+#define GEDIT_FILE_CHANGE_TRACKER_GET_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE((object), GEDIT_TYPE_FILE_CHANGE_TRACKER, GeditFileChangeTrackerPrivate))
+
+typedef struct
+{
+	GeditFileChangeTracker *tracker;
+
+	GFile        *location;
+	GFileMonitor *monitor;
+
+	/* of the running query, NULL if there is none */
+	GCancellable *cancellable;
+	GTimer       *timer;
+
+	GTimeVal      mtime;
+	guint         refs;
+
+	guint         mtime_known : 1;
+	/* the file changed while it was queried */
+	guint         requery : 1;
+	/* unwatched while it was queried, freed when the query ends */
+	guint         removed : 1;
+} WatchedFile;
+
+struct _GeditFileChangeTrackerPrivate
+{
+	/* GFile -> WatchedFile */
+	GHashTable *files;
+
+	GeditFileChangeTrackerStats stats;
+};
+
+enum
+{
+	CHANGED,
+	LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+G_DEFINE_TYPE(GeditFileChangeTracker, gedit_file_change_tracker, G_TYPE_OBJECT)
+
+static void
+watched_file_free (WatchedFile *file)
+{
+	if (file->monitor != NULL)
+	{
+		g_file_monitor_cancel (file->monitor);
+		g_object_unref (file->monitor);
+	}
+
+	g_object_unref (file->location);
+	g_timer_destroy (file->timer);
+
+	g_slice_free (WatchedFile, file);
+}
+
+/* A running query still uses the file, it is freed when it ends */
+static void
+watched_file_release (WatchedFile *file)
+{
+	if (file->cancellable != NULL)
+	{
+		file->removed = TRUE;
+		g_cancellable_cancel (file->cancellable);
+	}
+	else
+	{
+		watched_file_free (file);
+	}
+}
+
+static void start_query (WatchedFile *file);
+
+static void
+query_info_cb (GFile        *location,
+	       GAsyncResult *res,
+	       WatchedFile  *file)
+{
+	GeditFileChangeTrackerStats *stats;
+	GFileInfo *info;
+	GTimeVal mtime = { 0, 0 };
+	gboolean known;
+	gboolean changed;
+	gdouble latency;
+
+	info = g_file_query_info_finish (location, res, NULL);
+
+	g_object_unref (file->cancellable);
+	file->cancellable = NULL;
+
+	if (file->removed)
+	{
+		if (info != NULL)
+			g_object_unref (info);
+
+		watched_file_free (file);
+		return;
+	}
+
+	latency = g_timer_elapsed (file->timer, NULL);
+
+	stats = &file->tracker->priv->stats;
+	stats->queries++;
+	stats->total_latency += latency;
+	stats->max_latency = MAX (stats->max_latency, latency);
+
+	gedit_debug_message (DEBUG_DOCUMENT,
+			     "Queried in %.6f s (%u queries, %.6f s on average, %.6f s at most, "
+			     "%u checks, %u before the mtime was known)",
+			     latency,
+			     stats->queries,
+			     stats->total_latency / stats->queries,
+			     stats->max_latency,
+			     stats->lookups,
+			     stats->misses);
+
+	/* a file that cannot be read anymore is not reported as changed,
+	 * like the blocking check did */
+	known = (info != NULL &&
+		 g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_TIME_MODIFIED));
+
+	if (known)
+		g_file_info_get_modification_time (info, &mtime);
+
+	changed = known &&
+		  (!file->mtime_known ||
+		   mtime.tv_sec != file->mtime.tv_sec ||
+		   mtime.tv_usec != file->mtime.tv_usec);
+
+	file->mtime_known = known;
+
+	if (known)
+		file->mtime = mtime;
+
+	if (info != NULL)
+		g_object_unref (info);
+
+	if (file->requery)
+	{
+		file->requery = FALSE;
+		start_query (file);
+	}
+
+	if (changed)
+	{
+		GeditFileChangeTracker *tracker = file->tracker;
+
+		/* the handlers may unwatch the file */
+		location = g_object_ref (file->location);
+
+		g_signal_emit (tracker, signals[CHANGED], 0, location);
+
+		g_object_unref (location);
+	}
+}
+
+static void
+start_query (WatchedFile *file)
+{
+	/* the events come in bursts while a file is written, one more
+	 * query after the running one is enough */
+	if (file->cancellable != NULL)
+	{
+		file->requery = TRUE;
+		return;
+	}
+
+	file->cancellable = g_cancellable_new ();
+	g_timer_start (file->timer);
+
+	g_file_query_info_async (file->location,
+				 G_FILE_ATTRIBUTE_TIME_MODIFIED,
+				 G_FILE_QUERY_INFO_NONE,
+				 G_PRIORITY_DEFAULT,
+				 file->cancellable,
+				 (GAsyncReadyCallback) query_info_cb,
+				 file);
+}
+
+static void
+monitor_changed_cb (GFileMonitor      *monitor,
+		    GFile             *location,
+		    GFile             *other_location,
+		    GFileMonitorEvent  event_type,
+		    WatchedFile       *file)
+{
+	if (event_type == G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT)
+		return;
+
+	start_query (file);
+}
+
+static void
+gedit_file_change_tracker_finalize (GObject *object)
+{
+	GeditFileChangeTracker *tracker = GEDIT_FILE_CHANGE_TRACKER (object);
+
+	g_hash_table_destroy (tracker->priv->files);
+
+	G_OBJECT_CLASS (gedit_file_change_tracker_parent_class)->finalize (object);
+}
+
+static void
+gedit_file_change_tracker_class_init (GeditFileChangeTrackerClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->finalize = gedit_file_change_tracker_finalize;
+
+	signals[CHANGED] =
+		g_signal_new ("changed",
+			      G_OBJECT_CLASS_TYPE (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GeditFileChangeTrackerClass, changed),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__OBJECT,
+			      G_TYPE_NONE,
+			      1,
+			      G_TYPE_FILE);
+
+	g_type_class_add_private (object_class, sizeof (GeditFileChangeTrackerPrivate));
+}
+
+static void
+gedit_file_change_tracker_init (GeditFileChangeTracker *tracker)
+{
+	tracker->priv = GEDIT_FILE_CHANGE_TRACKER_GET_PRIVATE (tracker);
+
+	tracker->priv->files = g_hash_table_new_full (g_file_hash,
+						      (GEqualFunc) g_file_equal,
+						      NULL,
+						      (GDestroyNotify) watched_file_release);
+}
+
+GeditFileChangeTracker *
+gedit_file_change_tracker_get_default (void)
+{
+	static GeditFileChangeTracker *default_tracker = NULL;
+
+	if (G_UNLIKELY (default_tracker == NULL))
+	{
+		default_tracker = g_object_new (GEDIT_TYPE_FILE_CHANGE_TRACKER, NULL);
+		g_object_add_weak_pointer (G_OBJECT (default_tracker),
+					   (gpointer) &default_tracker);
+	}
+
+	return default_tracker;
+}
+
+void
+gedit_file_change_tracker_watch (GeditFileChangeTracker *tracker,
+				 GFile                  *location)
+{
+	WatchedFile *file;
+
+	g_return_if_fail (GEDIT_IS_FILE_CHANGE_TRACKER (tracker));
+	g_return_if_fail (G_IS_FILE (location));
+
+	file = g_hash_table_lookup (tracker->priv->files, location);
+
+	if (file != NULL)
+	{
+		file->refs++;
+		return;
+	}
+
+	file = g_slice_new0 (WatchedFile);
+	file->tracker = tracker;
+	file->location = g_object_ref (location);
+	file->timer = g_timer_new ();
+	file->refs = 1;
+
+	/* monitoring remote files would poll them, they are only queried
+	 * when checked */
+	if (g_file_is_native (location))
+		file->monitor = g_file_monitor_file (location,
+						     G_FILE_MONITOR_NONE,
+						     NULL,
+						     NULL);
+
+	if (file->monitor != NULL)
+		g_signal_connect (file->monitor,
+				  "changed",
+				  G_CALLBACK (monitor_changed_cb),
+				  file);
+
+	g_hash_table_insert (tracker->priv->files, file->location, file);
+
+	start_query (file);
+}
+
+void
+gedit_file_change_tracker_unwatch (GeditFileChangeTracker *tracker,
+				   GFile                  *location)
+{
+	WatchedFile *file;
+
+	g_return_if_fail (GEDIT_IS_FILE_CHANGE_TRACKER (tracker));
+	g_return_if_fail (G_IS_FILE (location));
+
+	file = g_hash_table_lookup (tracker->priv->files, location);
+	g_return_if_fail (file != NULL);
+
+	if (--file->refs == 0)
+		g_hash_table_remove (tracker->priv->files, location);
+}
+
+gboolean
+gedit_file_change_tracker_get_mtime (GeditFileChangeTracker *tracker,
+				     GFile                  *location,
+				     GTimeVal               *mtime)
+{
+	WatchedFile *file;
+
+	g_return_val_if_fail (GEDIT_IS_FILE_CHANGE_TRACKER (tracker), FALSE);
+	g_return_val_if_fail (G_IS_FILE (location), FALSE);
+	g_return_val_if_fail (mtime != NULL, FALSE);
+
+	tracker->priv->stats.lookups++;
+
+	file = g_hash_table_lookup (tracker->priv->files, location);
+
+	if (file == NULL)
+	{
+		tracker->priv->stats.misses++;
+		return FALSE;
+	}
+
+	/* the monitor misses the changes made by other hosts to network
+	 * mounts, and remote files are not monitored at all: query the
+	 * file again, "changed" is emitted if it was modified */
+	start_query (file);
+
+	if (!file->mtime_known)
+	{
+		tracker->priv->stats.misses++;
+		return FALSE;
+	}
+
+	*mtime = file->mtime;
+
+	return TRUE;
+}
+
+void
+gedit_file_change_tracker_get_stats (GeditFileChangeTracker      *tracker,
+				     GeditFileChangeTrackerStats *stats)
+{
+	g_return_if_fail (GEDIT_IS_FILE_CHANGE_TRACKER (tracker));
+	g_return_if_fail (stats != NULL);
+
+	*stats = tracker->priv->stats;
+}
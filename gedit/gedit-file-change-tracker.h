@@ -0,0 +1,92 @@
+/*
+ * gedit-file-change-tracker.h
+ * This file is part of gedit
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GEDIT_FILE_CHANGE_TRACKER_H__
+#define __GEDIT_FILE_CHANGE_TRACKER_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define GEDIT_TYPE_FILE_CHANGE_TRACKER			(gedit_file_change_tracker_get_type ())
+#define GEDIT_FILE_CHANGE_TRACKER(obj)			(G_TYPE_CHECK_INSTANCE_CAST ((obj), GEDIT_TYPE_FILE_CHANGE_TRACKER, GeditFileChangeTracker))
+#define GEDIT_FILE_CHANGE_TRACKER_CLASS(klass)		(G_TYPE_CHECK_CLASS_CAST ((klass), GEDIT_TYPE_FILE_CHANGE_TRACKER, GeditFileChangeTrackerClass))
+#define GEDIT_IS_FILE_CHANGE_TRACKER(obj)		(G_TYPE_CHECK_INSTANCE_TYPE ((obj), GEDIT_TYPE_FILE_CHANGE_TRACKER))
+#define GEDIT_IS_FILE_CHANGE_TRACKER_CLASS(klass)	(G_TYPE_CHECK_CLASS_TYPE ((klass), GEDIT_TYPE_FILE_CHANGE_TRACKER))
+#define GEDIT_FILE_CHANGE_TRACKER_GET_CLASS(obj)	(G_TYPE_INSTANCE_GET_CLASS ((obj), GEDIT_TYPE_FILE_CHANGE_TRACKER, GeditFileChangeTrackerClass))
+
+typedef struct _GeditFileChangeTracker		GeditFileChangeTracker;
+typedef struct _GeditFileChangeTrackerClass	GeditFileChangeTrackerClass;
+typedef struct _GeditFileChangeTrackerPrivate	GeditFileChangeTrackerPrivate;
+
+/* Keeps the modification time of the files of the open documents, so
+ * that checking if a file changed on disk never blocks. The local files
+ * are monitored, and every check queries the file again in the
+ * background, which also covers the files that cannot be monitored.
+ * "changed" is emitted when a new modification time is known. */
+struct _GeditFileChangeTracker
+{
+	GObject parent;
+
+	GeditFileChangeTrackerPrivate *priv;
+};
+
+struct _GeditFileChangeTrackerClass
+{
+	GObjectClass parent_class;
+
+	void (* changed)	(GeditFileChangeTracker *tracker,
+				 GFile                  *location);
+};
+
+typedef struct
+{
+	guint	lookups;	/* checks answered */
+	guint	misses;		/* checks made before the mtime was known */
+	guint	queries;	/* queries of the files that completed */
+	gdouble	total_latency;	/* seconds spent waiting for the queries */
+	gdouble	max_latency;
+} GeditFileChangeTrackerStats;
+
+GType			 gedit_file_change_tracker_get_type	(void) G_GNUC_CONST;
+
+GeditFileChangeTracker	*gedit_file_change_tracker_get_default	(void);
+
+/* Each watch must be balanced by an unwatch */
+void			 gedit_file_change_tracker_watch	(GeditFileChangeTracker      *tracker,
+								 GFile                       *location);
+
+void			 gedit_file_change_tracker_unwatch	(GeditFileChangeTracker      *tracker,
+								 GFile                       *location);
+
+/* Returns FALSE if the modification time of @location is not known
+ * yet, or if it could not be read */
+gboolean		 gedit_file_change_tracker_get_mtime	(GeditFileChangeTracker      *tracker,
+								 GFile                       *location,
+								 GTimeVal                    *mtime);
+
+void			 gedit_file_change_tracker_get_stats	(GeditFileChangeTracker      *tracker,
+								 GeditFileChangeTrackerStats *stats);
+
+G_END_DECLS
+
+#endif /* __GEDIT_FILE_CHANGE_TRACKER_H__ */
@@ -34,6 +34,7 @@
 #include <config.h>
 #endif
 
+#include <string.h>
 #include <glib/gi18n.h>
 #include <glib/gstdio.h>
 #include <gio/gio.h>
@@ -52,7 +53,50 @@ typedef struct
 	gboolean		tried_mount;
 } AsyncData;
 
-#define READ_CHUNK_SIZE 8192
+typedef struct
+{
+	gchar *text;
+	gsize  len;
+} ReadChunk;
+
+/* The file is read and converted to utf8 by a worker thread which queues
+ * the chunks, the main thread only drains the queue into the document */
+typedef struct
+{
+	volatile gint	ref_count;
+
+	/* Used only by the worker */
+	GInputStream   *stream;
+	GSeekable      *base_stream;
+
+	GCancellable   *cancellable;
+
+	/* Used only in the main thread */
+	AsyncData      *async;
+
+	/* Protected by the mutex */
+	GMutex         *mutex;
+	GCond          *cond;
+	GQueue         *chunks;
+	goffset		bytes_read;
+	GError         *error;
+	guint		finished : 1;
+	guint		drain_pending : 1;
+} ReadPipeline;
+
+#define READ_CHUNK_SIZE 65536
+
+/* Maximum number of converted chunks waiting to be inserted */
+#define MAX_QUEUED_CHUNKS 16
+
+/* The read chunks are accumulated in a staging buffer which is inserted
+ * in the document in a few big batches: every gtk_text_buffer_insert
+ * rebalances the btree and runs the insert-text handlers */
+#define INSERT_BATCH_SIZE (4 * 1024 * 1024)
+
+/* Minimum interval in seconds between two "loading" progress signals */
+#define PROGRESS_INTERVAL 0.1
+
 #define REMOTE_QUERY_ATTRIBUTES G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE "," \
 				G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
 				G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
@@ -71,19 +115,27 @@ static goffset      gedit_gio_document_loader_get_bytes_read	(GeditDocumentLoade
 
 static void open_async_read (AsyncData *async);
 
+static void read_pipeline_unref (ReadPipeline *pipeline);
+static void read_pipeline_wake_up (ReadPipeline *pipeline);
+
 struct _GeditGioDocumentLoaderPrivate
 {
 	/* Info on the current file */
 	GFile            *gfile;
 
-	goffset           bytes_read;
-
 	/* Handle for remote files */
 	GCancellable 	 *cancellable;
 	GInputStream	 *stream;
 	GeditSmartCharsetConverter *converter;
 
-	gchar             buffer[READ_CHUNK_SIZE];
+	ReadPipeline     *pipeline;
+
+	/* Text waiting to be inserted in the document */
+	gchar            *staging;
+	gsize             staging_size;
+	gsize             staging_len;
+
+	GTimer           *progress_timer;
 
 	GError           *error;
 
@@ -106,6 +158,13 @@ gedit_gio_document_loader_dispose (GObject *object)
 		priv->cancellable = NULL;
 	}
 
+	if (priv->pipeline != NULL)
+	{
+		read_pipeline_wake_up (priv->pipeline);
+		read_pipeline_unref (priv->pipeline);
+		priv->pipeline = NULL;
+	}
+
 	if (priv->stream != NULL)
 	{
 		g_object_unref (priv->stream);
@@ -130,12 +189,20 @@ gedit_gio_document_loader_dispose (GObject *object)
 		priv->error = NULL;
 	}
 
+	if (priv->progress_timer != NULL)
+	{
+		g_timer_destroy (priv->progress_timer);
+		priv->progress_timer = NULL;
+	}
+
 	G_OBJECT_CLASS (gedit_gio_document_loader_parent_class)->dispose (object);
 }
 
 static void
 gedit_gio_document_loader_finalize (GObject *object)
 {
+	g_free (GEDIT_GIO_DOCUMENT_LOADER (object)->priv->staging);
+
 	G_OBJECT_CLASS (gedit_gio_document_loader_parent_class)->finalize (object);
 }
 
@@ -161,7 +228,12 @@ gedit_gio_document_loader_init (GeditGioDocumentLoader *gvloader)
 	gvloader->priv = GEDIT_GIO_DOCUMENT_LOADER_GET_PRIVATE (gvloader);
 
 	gvloader->priv->converter = NULL;
+	gvloader->priv->pipeline = NULL;
 	gvloader->priv->error = NULL;
+	gvloader->priv->staging = NULL;
+	gvloader->priv->staging_size = 0;
+	gvloader->priv->staging_len = 0;
+	gvloader->priv->progress_timer = NULL;
 	gvloader->priv->started_insert = FALSE;
 }
 
@@ -237,7 +309,8 @@ remote_load_completed_or_failed (GeditGioDocumentLoader *gvloader, AsyncData *as
 	if (async)
 		async_data_free (async);
 
-	if (gvloader->priv->stream)
+	/* when reading in the worker, it closes the stream itself */
+	if (gvloader->priv->stream && gvloader->priv->pipeline == NULL)
 		g_input_stream_close_async (G_INPUT_STREAM (gvloader->priv->stream),
 					    G_PRIORITY_HIGH, NULL, NULL, NULL);
 
@@ -246,9 +319,6 @@ remote_load_completed_or_failed (GeditGioDocumentLoader *gvloader, AsyncData *as
 				       gvloader->priv->error);
 }
 
-/* prototype, because they call each other... isn't C lovely */
-static void	read_file_chunk		(AsyncData *async);
-
 static void
 async_failed (AsyncData *async, GError *error)
 {
@@ -257,17 +327,47 @@ async_failed (AsyncData *async, GError *error)
 }
 
 static void
-append_text_to_document (GeditDocumentLoader *loader,
-			 const gchar         *text,
-			 gint                 len)
+flush_staging_buffer (GeditGioDocumentLoader *gvloader)
 {
-	GeditDocument *doc = loader->document;
+	GeditDocument *doc = GEDIT_DOCUMENT_LOADER (gvloader)->document;
 	GtkTextIter end;
 
+	if (gvloader->priv->staging_len == 0)
+		return;
+
+	gedit_debug_message (DEBUG_LOADER, "inserting %" G_GSIZE_FORMAT " bytes",
+			     gvloader->priv->staging_len);
+
 	/* Insert text in the buffer */
 	gtk_text_buffer_get_end_iter (GTK_TEXT_BUFFER (doc), &end);
-	
-	gtk_text_buffer_insert (GTK_TEXT_BUFFER (doc), &end, text, len);
+
+	gtk_text_buffer_insert (GTK_TEXT_BUFFER (doc),
+				&end,
+				gvloader->priv->staging,
+				gvloader->priv->staging_len);
+
+	gvloader->priv->staging_len = 0;
+}
+
+static void
+emit_loading_progress (GeditGioDocumentLoader *gvloader)
+{
+	/* The progress signal blocks the read, so we do not emit it for
+	 * every chunk but at most once every PROGRESS_INTERVAL */
+	if (gvloader->priv->progress_timer == NULL)
+	{
+		gvloader->priv->progress_timer = g_timer_new ();
+	}
+	else if (g_timer_elapsed (gvloader->priv->progress_timer, NULL) < PROGRESS_INTERVAL)
+	{
+		return;
+	}
+
+	g_timer_start (gvloader->priv->progress_timer);
+
+	gedit_document_loader_loading (GEDIT_DOCUMENT_LOADER (gvloader),
+				       FALSE,
+				       NULL);
 }
 
 static void
@@ -275,6 +375,8 @@ end_append_text_to_document (GeditDocumentLoader *loader)
 {
 	GtkTextIter start, end;
 
+	flush_staging_buffer (GEDIT_GIO_DOCUMENT_LOADER (loader));
+
 	/* If the last char is a newline, remove it from the buffer (otherwise
 	   GtkTextView shows it as an empty line). See bug #324942. */
 	gtk_text_buffer_get_end_iter (GTK_TEXT_BUFFER (loader->document), &end);
@@ -299,122 +401,273 @@ end_append_text_to_document (GeditDocumentLoader *loader)
 }
 
 static void
-async_read_cb (GInputStream *stream,
-	       GAsyncResult *res,
-	       AsyncData    *async)
+read_chunk_free (ReadChunk *chunk)
 {
-	gedit_debug (DEBUG_LOADER);
-	GeditGioDocumentLoader *gvloader;
-	GeditDocumentLoader *loader;
-	gssize bytes_read;
-	GError *error = NULL;
+	g_free (chunk->text);
+	g_slice_free (ReadChunk, chunk);
+}
 
-	gvloader = async->loader;
-	loader = GEDIT_DOCUMENT_LOADER (gvloader);
+static ReadPipeline *
+read_pipeline_ref (ReadPipeline *pipeline)
+{
+	g_atomic_int_inc (&pipeline->ref_count);
 
-	/* manually check cancelled state */
-	if (g_cancellable_is_cancelled (async->cancellable))
-	{
-		end_append_text_to_document (GEDIT_DOCUMENT_LOADER (gvloader));
-		remote_load_completed_or_failed (gvloader, async);
+	return pipeline;
+}
+
+static void
+read_pipeline_unref (ReadPipeline *pipeline)
+{
+	if (!g_atomic_int_dec_and_test (&pipeline->ref_count))
 		return;
-	}
 
-	bytes_read = g_input_stream_read_finish (stream, res, &error);
-	
-	/* error occurred */
-	if (bytes_read == -1)
+	g_queue_foreach (pipeline->chunks, (GFunc) read_chunk_free, NULL);
+	g_queue_free (pipeline->chunks);
+
+	if (pipeline->error != NULL)
+		g_error_free (pipeline->error);
+
+	g_object_unref (pipeline->stream);
+
+	if (pipeline->base_stream != NULL)
+		g_object_unref (pipeline->base_stream);
+
+	g_object_unref (pipeline->cancellable);
+
+	g_mutex_free (pipeline->mutex);
+	g_cond_free (pipeline->cond);
+
+	g_slice_free (ReadPipeline, pipeline);
+}
+
+/* The worker may be waiting for room in the queue, wake it up so that
+ * it notices it has been cancelled */
+static void
+read_pipeline_wake_up (ReadPipeline *pipeline)
+{
+	g_mutex_lock (pipeline->mutex);
+	g_cond_broadcast (pipeline->cond);
+	g_mutex_unlock (pipeline->mutex);
+}
+
+static void
+append_chunk (GeditGioDocumentLoader *gvloader,
+	      ReadChunk              *chunk)
+{
+	/* insert the staged text if the chunk does not fit */
+	if (gvloader->priv->staging_len + chunk->len > gvloader->priv->staging_size)
 	{
-		async_failed (async, error);
-		return;
+		flush_staging_buffer (gvloader);
 	}
 
-	/* Check for the extremely unlikely case where the file size overflows. */
-	if (gvloader->priv->bytes_read + bytes_read < gvloader->priv->bytes_read)
+	memcpy (gvloader->priv->staging + gvloader->priv->staging_len,
+		chunk->text,
+		chunk->len);
+
+	gvloader->priv->staging_len += chunk->len;
+}
+
+static gboolean
+drain_chunks_cb (ReadPipeline *pipeline)
+{
+	GeditGioDocumentLoader *gvloader;
+	GeditDocumentLoader *loader;
+	GQueue *chunks;
+	GError *error;
+	gboolean finished;
+
+	gedit_debug (DEBUG_LOADER);
+
+	g_mutex_lock (pipeline->mutex);
+
+	chunks = pipeline->chunks;
+	pipeline->chunks = g_queue_new ();
+
+	finished = pipeline->finished;
+	error = pipeline->error;
+	pipeline->error = NULL;
+	pipeline->drain_pending = FALSE;
+
+	/* there is room in the queue again */
+	g_cond_signal (pipeline->cond);
+
+	g_mutex_unlock (pipeline->mutex);
+
+	/* manually check cancelled state: the loader may be already gone,
+	 * we just have to release the async data when the worker is done */
+	if (g_cancellable_is_cancelled (pipeline->cancellable))
 	{
-		g_set_error (&gvloader->priv->error,
-			     GEDIT_DOCUMENT_ERROR,
-			     GEDIT_DOCUMENT_ERROR_TOO_BIG,
-			     "File too big");
+		g_queue_foreach (chunks, (GFunc) read_chunk_free, NULL);
+		g_queue_free (chunks);
 
-		end_append_text_to_document (GEDIT_DOCUMENT_LOADER (gvloader));
-		remote_load_completed_or_failed (gvloader, async);
+		if (error != NULL)
+			g_error_free (error);
 
-		return;
+		if (finished)
+		{
+			async_data_free (pipeline->async);
+			pipeline->async = NULL;
+		}
+
+		return FALSE;
 	}
 
-	/* Bump the size. */
-	gvloader->priv->bytes_read += bytes_read;
+	gvloader = pipeline->async->loader;
+	loader = GEDIT_DOCUMENT_LOADER (gvloader);
 
-	/* end of the file, we are done! */
-	if (bytes_read == 0)
+	while (!g_queue_is_empty (chunks))
+	{
+		ReadChunk *chunk;
+
+		chunk = g_queue_pop_head (chunks);
+		append_chunk (gvloader, chunk);
+		read_chunk_free (chunk);
+	}
+
+	g_queue_free (chunks);
+
+	/* emit progress and wait for some more */
+	if (!finished)
 	{
-		GEDIT_DOCUMENT_LOADER (gvloader)->auto_detected_encoding =
-			gedit_smart_charset_converter_get_guessed (gvloader->priv->converter);
+		emit_loading_progress (gvloader);
 
-		loader->auto_detected_encoding = gedit_smart_charset_converter_get_guessed (gvloader->priv->converter);
+		return FALSE;
+	}
 
-		/* Check if we needed some fallback char, if so, check if there was
-		   a previous error and if not set a fallback used error */
-		/* FIXME Uncomment this when we want to manage conversion fallback */
-		/*if ((gedit_smart_charset_converter_get_num_fallbacks (gvloader->priv->converter) != 0) &&
-		    gvloader->priv->error == NULL)
+	/* error occurred */
+	if (error != NULL)
+	{
+		if (g_error_matches (error,
+				     GEDIT_DOCUMENT_ERROR,
+				     GEDIT_DOCUMENT_ERROR_TOO_BIG))
 		{
-			g_set_error_literal (&gvloader->priv->error,
-					     GEDIT_DOCUMENT_ERROR,
-					     GEDIT_DOCUMENT_ERROR_CONVERSION_FALLBACK,
-					     "There was a conversion error and it was "
-					     "needed to use a fallback char");
-		}*/
-
-		end_append_text_to_document (GEDIT_DOCUMENT_LOADER (gvloader));
+			end_append_text_to_document (loader);
+		}
 
-		remote_load_completed_or_failed (gvloader, async);
+		async_failed (pipeline->async, error);
+		pipeline->async = NULL;
 
-		return;
+		return FALSE;
 	}
 
-	append_text_to_document (GEDIT_DOCUMENT_LOADER (gvloader),
-				 gvloader->priv->buffer,
-				 bytes_read);
+	/* end of the file, we are done! */
+	loader->auto_detected_encoding = gedit_smart_charset_converter_get_guessed (gvloader->priv->converter);
 
-	/* otherwise emit progress and read some more */
+	/* Check if we needed some fallback char, if so, check if there was
+	   a previous error and if not set a fallback used error */
+	/* FIXME Uncomment this when we want to manage conversion fallback */
+	/*if ((gedit_smart_charset_converter_get_num_fallbacks (gvloader->priv->converter) != 0) &&
+	    gvloader->priv->error == NULL)
+	{
+		g_set_error_literal (&gvloader->priv->error,
+				     GEDIT_DOCUMENT_ERROR,
+				     GEDIT_DOCUMENT_ERROR_CONVERSION_FALLBACK,
+				     "There was a conversion error and it was "
+				     "needed to use a fallback char");
+	}*/
 
-	/* note that this signal blocks the read... check if it isn't
-	 * a performance problem
-	 */
-	gedit_document_loader_loading (GEDIT_DOCUMENT_LOADER (gvloader),
-				       FALSE,
-				       NULL);
+	end_append_text_to_document (loader);
+
+	remote_load_completed_or_failed (gvloader, pipeline->async);
+	pipeline->async = NULL;
 
-	read_file_chunk (async);
+	return FALSE;
 }
 
+/* Called with the pipeline mutex held */
 static void
-read_file_chunk (AsyncData *async)
+schedule_drain (GIOSchedulerJob *job,
+		ReadPipeline    *pipeline)
 {
-	GeditGioDocumentLoader *gvloader;
-	
-	gvloader = async->loader;
+	if (pipeline->drain_pending)
+		return;
+
+	pipeline->drain_pending = TRUE;
 
-	if (!gvloader->priv->started_insert)
+	g_io_scheduler_job_send_to_mainloop_async (job,
+						   (GSourceFunc) drain_chunks_cb,
+						   read_pipeline_ref (pipeline),
+						   (GDestroyNotify) read_pipeline_unref);
+}
+
+/* Runs in a thread */
+static gboolean
+read_job (GIOSchedulerJob *job,
+	  GCancellable    *unused,
+	  ReadPipeline    *pipeline)
+{
+	gboolean done = FALSE;
+
+	while (!done)
 	{
-		GeditDocumentLoader *loader;
+		ReadChunk *chunk;
+		GError *error = NULL;
+		gssize bytes_read;
+
+		/* wait for the main thread to make room in the queue */
+		g_mutex_lock (pipeline->mutex);
+
+		while (g_queue_get_length (pipeline->chunks) >= MAX_QUEUED_CHUNKS &&
+		       !g_cancellable_is_cancelled (pipeline->cancellable))
+		{
+			g_cond_wait (pipeline->cond, pipeline->mutex);
+		}
+
+		g_mutex_unlock (pipeline->mutex);
+
+		chunk = g_slice_new (ReadChunk);
+		chunk->text = g_malloc (READ_CHUNK_SIZE);
 
-		loader = GEDIT_DOCUMENT_LOADER (gvloader);
+		/* this is where the smart converter does its work */
+		bytes_read = g_input_stream_read (pipeline->stream,
+						  chunk->text,
+						  READ_CHUNK_SIZE,
+						  pipeline->cancellable,
+						  &error);
+
+		g_mutex_lock (pipeline->mutex);
+
+		/* Check for the extremely unlikely case where the file size overflows. */
+		if (bytes_read > 0 &&
+		    pipeline->bytes_read + bytes_read < pipeline->bytes_read)
+		{
+			g_set_error (&error,
+				     GEDIT_DOCUMENT_ERROR,
+				     GEDIT_DOCUMENT_ERROR_TOO_BIG,
+				     "File too big");
 
-		/* Init the undoable action */
-		gtk_source_buffer_begin_not_undoable_action (GTK_SOURCE_BUFFER (loader->document));
-		gvloader->priv->started_insert = TRUE;
+			bytes_read = -1;
+		}
+
+		if (bytes_read > 0)
+		{
+			chunk->len = bytes_read;
+			g_queue_push_tail (pipeline->chunks, chunk);
+
+			/* report what has been read from the file, not the
+			 * size of the converted text */
+			if (pipeline->base_stream != NULL)
+				pipeline->bytes_read = g_seekable_tell (pipeline->base_stream);
+			else
+				pipeline->bytes_read += bytes_read;
+		}
+		else
+		{
+			read_chunk_free (chunk);
+
+			pipeline->error = error;
+			pipeline->finished = TRUE;
+			done = TRUE;
+		}
+
+		schedule_drain (job, pipeline);
+
+		g_mutex_unlock (pipeline->mutex);
 	}
 
-	g_input_stream_read_async (G_INPUT_STREAM (gvloader->priv->stream),
-				   gvloader->priv->buffer,
-				   READ_CHUNK_SIZE,
-				   G_PRIORITY_HIGH,
-				   async->cancellable,
-				   (GAsyncReadyCallback) async_read_cb,
-				   async);
+	g_input_stream_close (pipeline->stream, NULL, NULL);
+
+	return FALSE;
 }
 
 static GSList *
@@ -441,6 +694,8 @@ finish_query_info (AsyncData *async)
 	GeditDocumentLoader *loader;
 	GInputStream *utf8_stream;
 	GInputStream *conv_stream;
+	GSeekable *base_stream = NULL;
+	ReadPipeline *pipeline;
 	GFileInfo *info;
 	GSList *candidate_encodings;
 	
@@ -475,7 +730,11 @@ finish_query_info (AsyncData *async)
 
 	gvloader->priv->converter = gedit_smart_charset_converter_new (candidate_encodings);
 	g_slist_free (candidate_encodings);
-	
+
+	/* keep the file stream to know how much of the file has been read */
+	if (G_IS_SEEKABLE (gvloader->priv->stream))
+		base_stream = g_object_ref (gvloader->priv->stream);
+
 	conv_stream = g_converter_input_stream_new (gvloader->priv->stream,
 						    G_CONVERTER (gvloader->priv->converter));
 	g_object_unref (gvloader->priv->stream);
@@ -485,8 +744,45 @@ finish_query_info (AsyncData *async)
 
 	gvloader->priv->stream = utf8_stream;
 
-	/* start reading */
-	read_file_chunk (async);
+	/* small files are inserted at once, without wasting a full batch */
+	gvloader->priv->staging_size = INSERT_BATCH_SIZE;
+
+	if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_SIZE))
+	{
+		goffset size;
+
+		size = g_file_info_get_attribute_uint64 (info,
+							 G_FILE_ATTRIBUTE_STANDARD_SIZE);
+
+		if (size + READ_CHUNK_SIZE < INSERT_BATCH_SIZE)
+			gvloader->priv->staging_size = size + READ_CHUNK_SIZE;
+	}
+
+	gvloader->priv->staging = g_malloc (gvloader->priv->staging_size);
+
+	/* Init the undoable action */
+	gtk_source_buffer_begin_not_undoable_action (GTK_SOURCE_BUFFER (loader->document));
+	gvloader->priv->started_insert = TRUE;
+
+	pipeline = g_slice_new0 (ReadPipeline);
+	pipeline->ref_count = 1;
+	pipeline->stream = g_object_ref (utf8_stream);
+	pipeline->base_stream = base_stream;
+	pipeline->cancellable = g_object_ref (async->cancellable);
+	pipeline->async = async;
+	pipeline->mutex = g_mutex_new ();
+	pipeline->cond = g_cond_new ();
+	pipeline->chunks = g_queue_new ();
+
+	gvloader->priv->pipeline = pipeline;
+
+	/* start reading: the job always runs to the end, even when
+	 * cancelled, so that the last drain releases the async data */
+	g_io_scheduler_push_job ((GIOSchedulerJobFunc) read_job,
+				 read_pipeline_ref (pipeline),
+				 (GDestroyNotify) read_pipeline_unref,
+				 G_PRIORITY_HIGH,
+				 NULL);
 }
 
 static void
@@ -669,7 +965,19 @@ gedit_gio_document_loader_load (GeditDocumentLoader *loader)
 static goffset
 gedit_gio_document_loader_get_bytes_read (GeditDocumentLoader *loader)
 {
-	return GEDIT_GIO_DOCUMENT_LOADER (loader)->priv->bytes_read;
+	ReadPipeline *pipeline;
+	goffset bytes_read;
+
+	pipeline = GEDIT_GIO_DOCUMENT_LOADER (loader)->priv->pipeline;
+
+	if (pipeline == NULL)
+		return 0;
+
+	g_mutex_lock (pipeline->mutex);
+	bytes_read = pipeline->bytes_read;
+	g_mutex_unlock (pipeline->mutex);
+
+	return bytes_read;
 }
 
 static gboolean
@@ -682,11 +990,17 @@ gedit_gio_document_loader_cancel (GeditDocumentLoader *loader)
 
 	g_cancellable_cancel (gvloader->priv->cancellable);
 
+	if (gvloader->priv->pipeline != NULL)
+		read_pipeline_wake_up (gvloader->priv->pipeline);
+
 	g_set_error (&gvloader->priv->error,
 		     G_IO_ERROR,
 		     G_IO_ERROR_CANCELLED,
 		     "Operation cancelled");
 
+	if (gvloader->priv->started_insert)
+		end_append_text_to_document (loader);
+
 	remote_load_completed_or_failed (gvloader, NULL);
 
 	return TRUE;
@@ -37,19 +37,23 @@
 #include <gio/gio.h>
 #include <string.h>
 
-#include "gedit-convert.h"
 #include "gedit-gio-document-saver.h"
 #include "gedit-debug.h"
 
 typedef struct
 {
 	GeditGioDocumentSaver *saver;
-	gchar 		      *buffer;
 	GCancellable 	      *cancellable;
 	gboolean	       tried_mount;
+
+	/* the converted document, read a chunk at a time */
+	GInputStream	      *contents;
+	gchar 		      *buffer;
+	gsize		       buffer_len;
+	gsize		       buffer_written;
 } AsyncData;
 
-#define WRITE_CHUNK_SIZE 8192
+#define WRITE_CHUNK_SIZE 65536
 #define REMOTE_QUERY_ATTRIBUTES G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE "," \
 				G_FILE_ATTRIBUTE_TIME_MODIFIED
 				
@@ -111,9 +115,12 @@ async_data_new (GeditGioDocumentSaver *gvsaver)
 	
 	async = g_slice_new (AsyncData);
 	async->saver = gvsaver;
-	async->buffer = NULL;
 	async->cancellable = g_object_ref (gvsaver->priv->cancellable);
 	async->tried_mount = FALSE;
+	async->contents = NULL;
+	async->buffer = NULL;
+	async->buffer_len = 0;
+	async->buffer_written = 0;
 	
 	return async;
 }
@@ -122,6 +129,10 @@ static void
 async_data_free (AsyncData *async)
 {
 	g_object_unref (async->cancellable);
+
+	if (async->contents != NULL)
+		g_object_unref (async->contents);
+
 	g_free (async->buffer);
 	g_slice_free (AsyncData, async);
 }
@@ -331,6 +342,9 @@ remote_get_info_cb (GFileOutputStream *stream,
 static void
 write_complete (AsyncData *async)
 {
+	/* now we know how big the file is */
+	async->saver->priv->size = async->saver->priv->bytes_written;
+
 	/* document is succesfully saved. we know requery for the mime type and
 	 * the mtime. I'm not sure this is actually necessary, can't we just use
 	 * g_content_type_guess (since we have the file name and the data)
@@ -377,15 +391,9 @@ async_write_cb (GOutputStream *stream,
 	}
 	
 	gvsaver->priv->bytes_written += bytes_written;
-	
-	/* if nothing is written we're done */
-	if (gvsaver->priv->bytes_written == gvsaver->priv->size)
-	{
-		write_complete (async);
-		return;
-	}
-	
-	/* otherwise emit progress and write some more */
+	async->buffer_written += bytes_written;
+
+	/* emit progress and write some more */
 
 	/* note that this signal blocks the write... check if it isn't
 	 * a performance problem
@@ -404,14 +412,42 @@ write_file_chunk (AsyncData *async)
 
 	gvsaver = async->saver;
 
+	/* convert the next chunk when the previous one has been written */
+	if (async->buffer_written == async->buffer_len)
+	{
+		GError *error = NULL;
+		gssize bytes_read;
+
+		bytes_read = gedit_document_saver_read_contents (GEDIT_DOCUMENT_SAVER (gvsaver),
+								 async->contents,
+								 async->buffer,
+								 WRITE_CHUNK_SIZE,
+								 &error);
+
+		if (bytes_read == -1)
+		{
+			async_failed (async, error);
+			return;
+		}
+
+		/* if nothing is left we're done */
+		if (bytes_read == 0)
+		{
+			write_complete (async);
+			return;
+		}
+
+		async->buffer_len = bytes_read;
+		async->buffer_written = 0;
+	}
+
 	gedit_debug_message (DEBUG_SAVER,
-			     "Writing next chunk: %" G_GINT64_FORMAT "/%" G_GINT64_FORMAT,
-			     gvsaver->priv->bytes_written, gvsaver->priv->size);
+			     "Writing next chunk: %" G_GINT64_FORMAT " written",
+			     gvsaver->priv->bytes_written);
 
 	g_output_stream_write_async (G_OUTPUT_STREAM (gvsaver->priv->stream),
-				     async->buffer + gvsaver->priv->bytes_written,
-				     MIN (WRITE_CHUNK_SIZE, gvsaver->priv->size - 
-				     			    gvsaver->priv->bytes_written),
+				     async->buffer + async->buffer_written,
+				     async->buffer_len - async->buffer_written,
 				     G_PRIORITY_HIGH,
 				     async->cancellable,
 				     (GAsyncReadyCallback) async_write_cb,
@@ -448,56 +484,10 @@ async_replace_ready_callback (GFile        *source,
 	write_file_chunk (async);
 }
 
-/* returns a pointer to the reallocated buffer */
-static gchar *
-append_new_line (GeditGioDocumentSaver  *gvsaver, 
-		 gchar 		        *buffer, 
-		 gsize 		        *len, 
-		 GError 	       **error)
-{
-	GeditDocumentSaver *saver = GEDIT_DOCUMENT_SAVER (gvsaver);
-	gsize n_len;
-	gchar *n_buffer;
-	gchar *res;
-
-	res = buffer;
-
-	n_buffer = gedit_document_saver_get_end_newline (saver, &n_len);
-	if (n_buffer != NULL)
-	{
-		gchar *new_buffer;
-
-		new_buffer = g_try_realloc (buffer, *len + n_len + 1);
-
-		if (new_buffer == NULL)
-		{
-			/* we do not error out, just use the buffer
-			   without the ending newline */
-			g_free (n_buffer);
-			g_warning ("Cannot add '\\n' at the end of the file.");
-
-			return res;
-		}
-
-		/* Copy newline */
-		memcpy (new_buffer + *len, n_buffer, n_len);
-		g_free (n_buffer);
-		*len += n_len;
-
-		new_buffer[*len] = '\0';
-
-		res = new_buffer;
-	}
-
-	return res;
-}
-
 static void
 begin_write (AsyncData *async)
 {
 	GeditGioDocumentSaver *gvsaver;
-	gchar *buffer;
-	gsize len;
 	GError *error = NULL;
 
 	gedit_debug_message (DEBUG_SAVER, "Start replacing file contents");
@@ -506,23 +496,33 @@ begin_write (AsyncData *async)
 	 * backup as of yet
 	 */
 	gvsaver = async->saver;
-	buffer = gedit_document_saver_get_document_contents (GEDIT_DOCUMENT_SAVER (gvsaver), &len, &error);
-	if (buffer != NULL && len > 0)
+
+	/* find conversion errors before replacing the file */
+	if (!gedit_document_saver_check_encoding (GEDIT_DOCUMENT_SAVER (gvsaver), &error))
 	{
-		/* Append new line to buffer */
-		buffer = append_new_line (gvsaver, buffer, &len, &error);
+		async_failed (async, error);
+		return;
 	}
 
-	if (!buffer)
+	async->contents = gedit_document_saver_get_contents_stream (GEDIT_DOCUMENT_SAVER (gvsaver),
+								    &error);
+	if (async->contents == NULL)
 	{
 		async_failed (async, error);
 		return;
 	}
 
-	async->buffer = buffer;
-	gvsaver->priv->size = len;
+	async->buffer = g_malloc (WRITE_CHUNK_SIZE);
+
+	/* without conversion the size is about the length of the text,
+	 * otherwise it is not known until everything is converted */
+	if (GEDIT_DOCUMENT_SAVER (gvsaver)->encoding == gedit_encoding_get_utf8 ())
+		gvsaver->priv->size = gedit_text_snapshot_get_length (GEDIT_DOCUMENT_SAVER (gvsaver)->snapshot);
+	else
+		gvsaver->priv->size = 0;
+
+	gvsaver->priv->bytes_written = 0;
 
-	gedit_debug_message (DEBUG_SAVER, "File contents size: %" G_GINT64_FORMAT, gvsaver->priv->size);
 	gedit_debug_message (DEBUG_SAVER, "Calling replace_async");
 
 	g_file_replace_async (gvsaver->priv->gfile, 
@@ -33,14 +33,25 @@
 #include <config.h>
 #endif
 
+/* for copy_file_range */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
 
+#ifdef HAVE_LINUX_FS_H
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+
 #include <glib/gi18n.h>
 #include <glib.h>
+#include <gio/gio.h>
 
 #include "gedit-local-document-saver.h"
 #include "gedit-debug.h"
@@ -65,7 +76,15 @@ static goffset		 gedit_local_document_saver_get_bytes_written	(GeditDocumentSave
 
 struct _GeditLocalDocumentSaverPrivate
 {
+	/* progress, updated by the saving thread */
+	GMutex   *mutex;
+	goffset	  size;
 	goffset	  bytes_written;
+	gboolean  progress_pending;
+
+	GIOSchedulerJob *job;
+	gboolean  existing;
+	gboolean  completed;
 
 	/* temp data for local files */
 	gint	  fd;
@@ -86,6 +105,8 @@ gedit_local_document_saver_finalize (GObject *object)
 	g_free (priv->local_path);
 	g_free (priv->content_type);
 
+	g_mutex_free (priv->mutex);
+
 	if (priv->error)
 		g_error_free (priv->error);
 
@@ -117,6 +138,8 @@ gedit_local_document_saver_init (GeditLocalDocumentSaver *lsaver)
 	lsaver->priv->fd = -1;
 
 	lsaver->priv->error = NULL;
+
+	lsaver->priv->mutex = g_mutex_new ();
 }
 
 static gchar *
@@ -170,10 +193,127 @@ remove_file (const gchar *name)
 	return res == 0 || (res == -1 && errno == ENOENT);
 }
 
+/* Gives @backup_filename to the file without copying anything: the file
+ * is linked to a tmp name which is then renamed over the backup, so an
+ * old backup is replaced atomically. Fails when the filesystem does not
+ * support hard links. */
 static gboolean
-copy_file_data (gint     sfd,
-		gint     dfd,
-		GError **error)
+link_backup (const gchar *filename,
+	     const gchar *backup_filename)
+{
+	gchar *dirname;
+	gchar *tmp_filename;
+	gboolean ret = FALSE;
+	gint i;
+
+	dirname = g_path_get_dirname (backup_filename);
+
+	for (i = 0; i < 100; i++)
+	{
+		gchar *basename;
+		gint save_errno;
+
+		basename = g_strdup_printf (".gedit-backup-%08x", g_random_int ());
+		tmp_filename = g_build_filename (dirname, basename, NULL);
+		g_free (basename);
+
+		save_errno = (link (filename, tmp_filename) == 0) ? 0 : errno;
+
+		if (save_errno == 0)
+		{
+			ret = (rename (tmp_filename, backup_filename) == 0);
+
+			if (!ret)
+				unlink (tmp_filename);
+
+			g_free (tmp_filename);
+			break;
+		}
+
+		g_free (tmp_filename);
+
+		if (save_errno != EEXIST)
+			break;
+	}
+
+	g_free (dirname);
+
+	return ret;
+}
+
+typedef enum
+{
+	COPY_DONE,
+	COPY_NOT_SUPPORTED,
+	COPY_FAILED
+} CopyResult;
+
+/* Lets the kernel copy the data, sharing the extents when the
+ * filesystem supports reflinks. COPY_NOT_SUPPORTED means nothing
+ * was copied and the data has to be read and written by hand. */
+static CopyResult
+kernel_copy_file_data (gint     sfd,
+		       gint     dfd,
+		       GError **error)
+{
+#ifdef FICLONE
+	if (ioctl (dfd, FICLONE, sfd) == 0)
+	{
+		gedit_debug_message (DEBUG_SAVER, "cloned the file");
+
+		return COPY_DONE;
+	}
+#endif
+
+#ifdef HAVE_COPY_FILE_RANGE
+	{
+		gboolean first = TRUE;
+		ssize_t bytes_copied;
+
+		do
+		{
+			bytes_copied = copy_file_range (sfd, NULL, dfd, NULL,
+							G_MAXSSIZE, 0);
+
+			if (bytes_copied == -1)
+			{
+				if (errno == EINTR)
+					continue;
+
+				/* e.g. not the same filesystem on old kernels */
+				if (first &&
+				    (errno == ENOSYS || errno == EXDEV ||
+				     errno == EINVAL || errno == EOPNOTSUPP ||
+				     errno == EBADF))
+				{
+					return COPY_NOT_SUPPORTED;
+				}
+
+				g_set_error (error,
+					     G_IO_ERROR,
+					     g_io_error_from_errno (errno),
+					     "%s", g_strerror (errno));
+
+				return COPY_FAILED;
+			}
+
+			first = FALSE;
+		}
+		while (bytes_copied != 0);
+
+		gedit_debug_message (DEBUG_SAVER, "copied with copy_file_range");
+
+		return COPY_DONE;
+	}
+#else
+	return COPY_NOT_SUPPORTED;
+#endif
+}
+
+static gboolean
+read_write_file_data (gint     sfd,
+		      gint     dfd,
+		      GError **error)
 {
 	gboolean ret = TRUE;
 	gpointer buffer;
@@ -182,8 +322,6 @@ copy_file_data (gint     sfd,
 	ssize_t bytes_to_write;
 	ssize_t bytes_written;
 
-	gedit_debug (DEBUG_SAVER);
-
 	buffer = g_malloc (BUFSIZE);
 
 	do
@@ -229,6 +367,33 @@ copy_file_data (gint     sfd,
 
 	} while ((bytes_read != 0) && (ret == TRUE));
 
+	g_free (buffer);
+
+	return ret;
+}
+
+static gboolean
+copy_file_data (gint     sfd,
+		gint     dfd,
+		GError **error)
+{
+	gboolean ret;
+
+	gedit_debug (DEBUG_SAVER);
+
+	switch (kernel_copy_file_data (sfd, dfd, error))
+	{
+		case COPY_DONE:
+			ret = TRUE;
+			break;
+		case COPY_FAILED:
+			ret = FALSE;
+			break;
+		default:
+			ret = read_write_file_data (sfd, dfd, error);
+			break;
+	}
+
 #ifdef HAVE_FSYNC
 	if (ret)
 	{
@@ -244,8 +409,6 @@ copy_file_data (gint     sfd,
 	}
 #endif
 
-	g_free (buffer);
-
 	return ret;
 }
 
@@ -313,6 +476,53 @@ set_saver_info (GeditLocalDocumentSaver *lsaver)
 }
 
 static gboolean
+notify_progress (GeditLocalDocumentSaver *lsaver)
+{
+	g_mutex_lock (lsaver->priv->mutex);
+	lsaver->priv->progress_pending = FALSE;
+	g_mutex_unlock (lsaver->priv->mutex);
+
+	if (!lsaver->priv->completed)
+	{
+		gedit_document_saver_saving (GEDIT_DOCUMENT_SAVER (lsaver),
+					     FALSE,
+					     NULL);
+	}
+
+	return FALSE;
+}
+
+/* Called in the saving thread after each written chunk */
+static void
+write_progress (goffset                  current,
+		goffset                  total,
+		GeditLocalDocumentSaver *lsaver)
+{
+	gboolean pending;
+
+	g_mutex_lock (lsaver->priv->mutex);
+
+	lsaver->priv->bytes_written = current;
+	lsaver->priv->size = total;
+
+	/* the main loop has not caught up yet, it will see the new
+	 * values anyway */
+	pending = lsaver->priv->progress_pending;
+	lsaver->priv->progress_pending = TRUE;
+
+	g_mutex_unlock (lsaver->priv->mutex);
+
+	if (!pending)
+	{
+		g_io_scheduler_job_send_to_mainloop_async (lsaver->priv->job,
+							   (GSourceFunc) notify_progress,
+							   g_object_ref (lsaver),
+							   g_object_unref);
+	}
+}
+
+/* Runs in the saving thread */
+static void
 save_existing_local_file (GeditLocalDocumentSaver *lsaver)
 {
 	GeditDocumentSaver *saver = GEDIT_DOCUMENT_SAVER (lsaver);
@@ -399,14 +609,16 @@ save_existing_local_file (GeditLocalDocumentSaver *lsaver)
 
 	/* We now use two backup strategies.
 	 * The first one (which is faster) consist in saving to a
-	 * tmp file then rename the original file to the backup and the
-	 * tmp file to the original name. This is fast but doesn't work
-	 * when the file is a link (hard or symbolic) or when we can't
-	 * write to the current dir or can't set the permissions on the
-	 * new file. We also do not use it when the backup is not in the
-	 * current dir, since if it isn't on the same FS rename wont work.
+	 * tmp file then link (or rename) the original file to the
+	 * backup and rename the tmp file to the original name. This is
+	 * fast but doesn't work when the file is a link (hard or
+	 * symbolic) or when we can't write to the current dir or can't
+	 * set the permissions on the new file. We also do not use it
+	 * when the backup is not in the current dir, since if it isn't
+	 * on the same FS rename wont work.
 	 * The second strategy consist simply in copying the old file
-	 * to a backup file and rewrite the contents of the file.
+	 * to a backup file (cloning it when the filesystem can) and
+	 * rewrite the contents of the file.
 	 */
 
 	if (saver->backups_in_curr_dir &&
@@ -416,6 +628,7 @@ save_existing_local_file (GeditLocalDocumentSaver *lsaver)
 		gchar *dirname;
 		gchar *tmp_filename;
 		gint tmpfd;
+		gboolean backup_renamed = FALSE;
 
 		gedit_debug_message (DEBUG_SAVER, "tmp file moving strategy");
 
@@ -481,6 +694,8 @@ save_existing_local_file (GeditLocalDocumentSaver *lsaver)
 		if (!gedit_document_saver_write_document_contents (
 							saver,
 							tmpfd,
+							(GFileProgressCallback) write_progress,
+							lsaver,
 							&lsaver->priv->error))
 		{
 			gedit_debug_message (DEBUG_SAVER, "could not write tmp file");
@@ -492,21 +707,31 @@ save_existing_local_file (GeditLocalDocumentSaver *lsaver)
 			goto out;
 		}
 
-		/* original -> backup */
-		if (rename (lsaver->priv->local_path, backup_filename) != 0)
+		/* original -> backup: prefer a new link so that the
+		 * original name is never missing, the rename below replaces
+		 * it atomically. No backup is needed if we don't keep it. */
+		if (saver->keep_backup &&
+		    !link_backup (lsaver->priv->local_path, backup_filename))
 		{
-			gedit_debug_message (DEBUG_SAVER, "could not rename original -> backup");
+			gedit_debug_message (DEBUG_SAVER, "could not link original -> backup");
 
-			g_set_error (&lsaver->priv->error,
-				     G_IO_ERROR,
-				     g_io_error_from_errno (errno),
-				     "%s", g_strerror (errno));
+			if (rename (lsaver->priv->local_path, backup_filename) != 0)
+			{
+				gedit_debug_message (DEBUG_SAVER, "could not rename original -> backup");
 
-			close (tmpfd);
-			unlink (tmp_filename);
-			g_free (tmp_filename);
+				g_set_error (&lsaver->priv->error,
+					     G_IO_ERROR,
+					     g_io_error_from_errno (errno),
+					     "%s", g_strerror (errno));
 
-			goto out;
+				close (tmpfd);
+				unlink (tmp_filename);
+				g_free (tmp_filename);
+
+				goto out;
+			}
+
+			backup_renamed = TRUE;
 		}
 
 		/* tmp -> original */
@@ -520,7 +745,8 @@ save_existing_local_file (GeditLocalDocumentSaver *lsaver)
 				     "%s", g_strerror (errno));
 
 			/* try to restore... no error checking */
-			rename (backup_filename, lsaver->priv->local_path);
+			if (backup_renamed)
+				rename (backup_filename, lsaver->priv->local_path);
 
 			close (tmpfd);
 			unlink (tmp_filename);
@@ -562,10 +788,6 @@ save_existing_local_file (GeditLocalDocumentSaver *lsaver)
 				chmod (backup_filename, new_mode);
 			}
 		}
-		else
-		{
-			unlink (backup_filename);
-		}
 
 		close (tmpfd);
 
@@ -706,6 +928,8 @@ save_existing_local_file (GeditLocalDocumentSaver *lsaver)
 	/* finally overwrite the original */
 	if (!gedit_document_saver_write_document_contents (saver,
 							   lsaver->priv->fd,
+							   (GFileProgressCallback) write_progress,
+							   lsaver,
 							   &lsaver->priv->error))
 	{
 		/* FIXME: restore the backup? */
@@ -743,16 +967,10 @@ save_existing_local_file (GeditLocalDocumentSaver *lsaver)
 	lsaver->priv->fd = -1;
 
 	g_free (backup_filename);
-
-	set_saver_info (lsaver);
-
-	gedit_document_saver_saving (saver, TRUE, lsaver->priv->error);
-
-	/* stop the timeout */
-	return FALSE;
 }
 
-static gboolean
+/* Runs in the saving thread */
+static void
 save_new_local_file (GeditLocalDocumentSaver *lsaver)
 {
 	struct stat statbuf;
@@ -762,6 +980,8 @@ save_new_local_file (GeditLocalDocumentSaver *lsaver)
 	if (!gedit_document_saver_write_document_contents (
 						GEDIT_DOCUMENT_SAVER (lsaver),
 						lsaver->priv->fd,
+						(GFileProgressCallback) write_progress,
+						lsaver,
 						&lsaver->priv->error))
 	{
 		goto out;
@@ -791,6 +1011,12 @@ save_new_local_file (GeditLocalDocumentSaver *lsaver)
 			   g_strerror (errno));
 
 	lsaver->priv->fd = -1;
+}
+
+static gboolean
+save_completed (GeditLocalDocumentSaver *lsaver)
+{
+	lsaver->priv->completed = TRUE;
 
 	set_saver_info (lsaver);
 
@@ -798,7 +1024,31 @@ save_new_local_file (GeditLocalDocumentSaver *lsaver)
 				     TRUE,
 				     lsaver->priv->error);
 
-	/* stop the timeout */
+	return FALSE;
+}
+
+/* Writing, fsync and the backup copy can block for a long time on slow
+ * disks, so they are done in a thread. Everything it needs from the
+ * document is in the snapshot. */
+static gboolean
+save_job (GIOSchedulerJob         *job,
+	  GCancellable            *cancellable,
+	  GeditLocalDocumentSaver *lsaver)
+{
+	lsaver->priv->job = job;
+
+	if (lsaver->priv->existing)
+		save_existing_local_file (lsaver);
+	else
+		save_new_local_file (lsaver);
+
+	/* the ref taken when the job was pushed is dropped once the
+	 * completion is handled */
+	g_io_scheduler_job_send_to_mainloop_async (job,
+						   (GSourceFunc) save_completed,
+						   lsaver,
+						   g_object_unref);
+
 	return FALSE;
 }
 
@@ -817,7 +1067,6 @@ static void
 save_file (GeditLocalDocumentSaver *lsaver)
 {
 	GeditDocumentSaver *saver = GEDIT_DOCUMENT_SAVER (lsaver);
-	GSourceFunc next_phase;
 
 	gedit_debug (DEBUG_SAVER);
 
@@ -830,7 +1079,7 @@ save_file (GeditLocalDocumentSaver *lsaver)
 			         0666);
 	if (lsaver->priv->fd != -1)
 	{
-		next_phase = (GSourceFunc) save_new_local_file;
+		lsaver->priv->existing = FALSE;
 		goto out;
 	}
 
@@ -849,7 +1098,7 @@ save_file (GeditLocalDocumentSaver *lsaver)
 
 		if (lsaver->priv->fd != -1)
 		{
-			next_phase = (GSourceFunc) save_existing_local_file;
+			lsaver->priv->existing = TRUE;
 			goto out;
 		}
 	}
@@ -860,14 +1109,21 @@ save_file (GeditLocalDocumentSaver *lsaver)
 		     g_io_error_from_errno (errno),
 		     "%s", g_strerror (errno));
 
-	next_phase = (GSourceFunc) open_local_failed;
-
- out:
 	g_timeout_add_full (G_PRIORITY_HIGH,
 			    0,
-			    next_phase,
+			    (GSourceFunc) open_local_failed,
 			    saver,
 			    NULL);
+
+	return;
+
+ out:
+	/* the job needs the saver until save_completed runs */
+	g_io_scheduler_push_job ((GIOSchedulerJobFunc) save_job,
+				 g_object_ref (lsaver),
+				 NULL,
+				 G_PRIORITY_HIGH,
+				 NULL);
 }
 
 
@@ -900,11 +1156,25 @@ gedit_local_document_saver_save (GeditDocumentSaver *saver,
 static goffset
 gedit_local_document_saver_get_file_size (GeditDocumentSaver *saver)
 {
-	return 0;
+	GeditLocalDocumentSaverPrivate *priv = GEDIT_LOCAL_DOCUMENT_SAVER (saver)->priv;
+	goffset size;
+
+	g_mutex_lock (priv->mutex);
+	size = priv->size;
+	g_mutex_unlock (priv->mutex);
+
+	return size;
 }
 
 static goffset
 gedit_local_document_saver_get_bytes_written (GeditDocumentSaver *saver)
 {
-	return GEDIT_LOCAL_DOCUMENT_SAVER (saver)->priv->bytes_written;
+	GeditLocalDocumentSaverPrivate *priv = GEDIT_LOCAL_DOCUMENT_SAVER (saver)->priv;
+	goffset bytes_written;
+
+	g_mutex_lock (priv->mutex);
+	bytes_written = priv->bytes_written;
+	g_mutex_unlock (priv->mutex);
+
+	return bytes_written;
 }
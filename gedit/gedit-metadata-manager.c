@@ -33,6 +33,9 @@
 
 #include <time.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <glib/gstdio.h>
 #include <libxml/xmlreader.h>
 #include "gedit-metadata-manager.h"
 #include "gedit-debug.h"
@@ -42,9 +45,31 @@
 #define GEDIT_METADATA_VERBOSE_DEBUG	1
 */
 
-#define METADATA_FILE 	"gedit-metadata.xml"
+/* The metadata are kept in a binary log of records, each one holding
+ * all the values of a document or telling that it has been removed.
+ * Saving only appends the documents changed since the last save, the
+ * whole file is written again when the log gets too long. */
+#define METADATA_FILE 	"gedit-metadata"
+#define METADATA_MAGIC	"GEDITMD\1"
+#define METADATA_MAGIC_LEN 8
 
-#define MAX_ITEMS	50
+/* Imported once if there is no binary file yet */
+#define METADATA_XML_FILE "gedit-metadata.xml"
+
+#define MAX_ITEMS	10000
+
+/* Records that can be in the log on top of twice the items before
+ * it gets compacted */
+#define MAX_STALE_RECORDS 100
+
+typedef enum
+{
+	RECORD_ITEM = 1,
+	RECORD_REMOVE = 2
+} RecordType;
+
+/* type + atime */
+#define RECORD_HEADER_LEN 9
 
 typedef struct _GeditMetadataManager GeditMetadataManager;
 
@@ -52,9 +77,13 @@ typedef struct _Item Item;
 
 struct _Item
 {
+	gchar		*uri;
+
 	time_t	 	 atime; /* time of last access */
 
 	GHashTable	*values;
+
+	GList		*link; /* in the lru queue */
 };
 	
 struct _GeditMetadataManager
@@ -65,6 +94,18 @@ struct _GeditMetadataManager
 	guint 		 timeout_id;
 
 	GHashTable	*items;
+
+	/* Items, the most recently used first */
+	GQueue		*lru;
+
+	/* Items changed and uris removed since the last save */
+	GHashTable	*dirty;
+	GSList		*removed;
+
+	/* Records in the file, and whether it must be written again
+	 * from scratch instead of appending to it */
+	guint		 n_records;
+	gboolean	 rewrite;
 };
 
 static gboolean gedit_metadata_manager_save (gpointer data);
@@ -88,9 +129,75 @@ item_free (gpointer data)
 	if (item->values != NULL)
 		g_hash_table_destroy (item->values);
 
+	g_free (item->uri);
 	g_free (item);
 }
 
+static Item *
+item_new (const gchar *uri)
+{
+	Item *item;
+
+	item = g_new0 (Item, 1);
+
+	item->uri = g_strdup (uri);
+	item->values = g_hash_table_new_full (g_str_hash, 
+					      g_str_equal, 
+					      g_free, 
+					      g_free);
+
+	g_queue_push_head (gedit_metadata_manager->lru, item);
+	item->link = gedit_metadata_manager->lru->head;
+
+	g_hash_table_insert (gedit_metadata_manager->items,
+			     item->uri,
+			     item);
+
+	return item;
+}
+
+static void
+item_remove (Item     *item,
+	     gboolean  log)
+{
+	g_hash_table_remove (gedit_metadata_manager->dirty, item->uri);
+	g_queue_delete_link (gedit_metadata_manager->lru, item->link);
+
+	if (log && !gedit_metadata_manager->rewrite)
+		gedit_metadata_manager->removed =
+			g_slist_prepend (gedit_metadata_manager->removed,
+					 g_strdup (item->uri));
+
+	/* frees the item */
+	g_hash_table_remove (gedit_metadata_manager->items, item->uri);
+}
+
+static void
+item_touch (Item *item)
+{
+	item->atime = time (NULL);
+
+	g_queue_unlink (gedit_metadata_manager->lru, item->link);
+	g_queue_push_head_link (gedit_metadata_manager->lru, item->link);
+
+	g_hash_table_insert (gedit_metadata_manager->dirty, item->uri, item);
+}
+
+static void
+resize_items (void)
+{
+	while (g_hash_table_size (gedit_metadata_manager->items) > MAX_ITEMS)
+	{
+		Item *oldest;
+
+		oldest = g_queue_peek_tail (gedit_metadata_manager->lru);
+
+		g_return_if_fail (oldest != NULL);
+
+		item_remove (oldest, TRUE);
+	}
+}
+
 static void
 gedit_metadata_manager_arm_timeout (void)
 {
@@ -120,9 +227,14 @@ gedit_metadata_manager_init (void)
 	gedit_metadata_manager->items = 
 		g_hash_table_new_full (g_str_hash, 
 				       g_str_equal, 
-				       g_free,
+				       NULL,
 				       item_free);
 
+	gedit_metadata_manager->lru = g_queue_new ();
+
+	gedit_metadata_manager->dirty =
+		g_hash_table_new (g_str_hash, g_str_equal);
+
 	return TRUE;
 }
 
@@ -142,6 +254,12 @@ gedit_metadata_manager_shutdown (void)
 		gedit_metadata_manager_save (NULL);
 	}
 
+	g_hash_table_destroy (gedit_metadata_manager->dirty);
+	g_queue_free (gedit_metadata_manager->lru);
+
+	g_slist_foreach (gedit_metadata_manager->removed, (GFunc)g_free, NULL);
+	g_slist_free (gedit_metadata_manager->removed);
+
 	if (gedit_metadata_manager->items != NULL)
 		g_hash_table_destroy (gedit_metadata_manager->items);
 
@@ -175,14 +293,13 @@ parseItem (xmlDocPtr doc, xmlNodePtr cur)
 		return;
 	}
 
-	item = g_new0 (Item, 1);
+	item = g_hash_table_lookup (gedit_metadata_manager->items, uri);
+	if (item != NULL)
+		item_remove (item, FALSE);
 
-	item->atime = g_ascii_strtoull ((char *)atime, NULL, 0);
+	item = item_new ((gchar *)uri);
 
-	item->values = g_hash_table_new_full (g_str_hash, 
-					      g_str_equal, 
-					      g_free, 
-					      g_free);
+	item->atime = g_ascii_strtoull ((char *)atime, NULL, 0);
 
 	cur = cur->xmlChildrenNode;
 
@@ -210,16 +327,12 @@ parseItem (xmlDocPtr doc, xmlNodePtr cur)
 		cur = cur->next;
 	}
 
-	g_hash_table_insert (gedit_metadata_manager->items,
-			     g_strdup ((gchar *)uri),
-			     item);
-
 	xmlFree (uri);
 	xmlFree (atime);
 }
 
 static gchar *
-get_metadata_filename (void)
+get_metadata_filename (const gchar *name)
 {
 	gchar *cache_dir;
 	gchar *metadata;
@@ -227,7 +340,7 @@ get_metadata_filename (void)
 	cache_dir = gedit_dirs_get_user_cache_dir ();
 
 	metadata = g_build_filename (cache_dir,
-				     METADATA_FILE,
+				     name,
 				     NULL);
 
 	g_free (cache_dir);
@@ -236,7 +349,7 @@ get_metadata_filename (void)
 }
 
 static gboolean
-load_values (void)
+import_xml_values (void)
 {
 	xmlDocPtr doc;
 	xmlNodePtr cur;
@@ -244,15 +357,10 @@ load_values (void)
 
 	gedit_debug (DEBUG_METADATA);
 
-	g_return_val_if_fail (gedit_metadata_manager != NULL, FALSE);
-	g_return_val_if_fail (gedit_metadata_manager->values_loaded == FALSE, FALSE);
-
-	gedit_metadata_manager->values_loaded = TRUE;
-		
 	xmlKeepBlanksDefault (0);
 
 	/* FIXME: file locking - Paolo */
-	file_name = get_metadata_filename ();
+	file_name = get_metadata_filename (METADATA_XML_FILE);
 	if ((file_name == NULL) ||
 	    (!g_file_test (file_name, G_FILE_TEST_EXISTS)))
 	{
@@ -271,7 +379,7 @@ load_values (void)
 	cur = xmlDocGetRootElement (doc);
 	if (cur == NULL) 
 	{
-		g_message ("The metadata file '%s' is empty", METADATA_FILE);
+		g_message ("The metadata file '%s' is empty", METADATA_XML_FILE);
 		xmlFreeDoc (doc);
 	
 		return FALSE;
@@ -279,7 +387,7 @@ load_values (void)
 
 	if (xmlStrcmp (cur->name, (const xmlChar *) "metadata")) 
 	{
-		g_message ("File '%s' is of the wrong type", METADATA_FILE);
+		g_message ("File '%s' is of the wrong type", METADATA_XML_FILE);
 		xmlFreeDoc (doc);
 		
 		return FALSE;
@@ -300,6 +408,200 @@ load_values (void)
 	return TRUE;
 }
 
+static const gchar *
+read_string (const gchar **p,
+	     const gchar  *end)
+{
+	const gchar *str = *p;
+	const gchar *nul;
+
+	nul = memchr (str, '\0', end - str);
+	if (nul == NULL)
+		return NULL;
+
+	*p = nul + 1;
+
+	return str;
+}
+
+static gboolean
+read_record (const gchar *data,
+	     gsize        len)
+{
+	const gchar *p = data + RECORD_HEADER_LEN;
+	const gchar *end = data + len;
+	const gchar *uri;
+	guint64 atime;
+	Item *item;
+
+	memcpy (&atime, data + 1, sizeof (atime));
+	atime = GUINT64_FROM_LE (atime);
+
+	uri = read_string (&p, end);
+	if (uri == NULL)
+		return FALSE;
+
+	item = g_hash_table_lookup (gedit_metadata_manager->items, uri);
+
+	switch (data[0])
+	{
+		case RECORD_REMOVE:
+			if (item != NULL)
+				item_remove (item, FALSE);
+			break;
+
+		case RECORD_ITEM:
+			if (item != NULL)
+				item_remove (item, FALSE);
+
+			item = item_new (uri);
+			item->atime = (time_t) atime;
+
+			while (p < end)
+			{
+				const gchar *key;
+				const gchar *value;
+
+				key = read_string (&p, end);
+				value = key != NULL ? read_string (&p, end) : NULL;
+
+				if (value == NULL)
+				{
+					item_remove (item, FALSE);
+					return FALSE;
+				}
+
+				g_hash_table_insert (item->values,
+						     g_strdup (key),
+						     g_strdup (value));
+			}
+			break;
+
+		default:
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gint
+compare_atime (const Item *a,
+	       const Item *b,
+	       gpointer    data)
+{
+	if (a->atime > b->atime)
+		return -1;
+	if (a->atime < b->atime)
+		return 1;
+
+	return 0;
+}
+
+static gboolean
+load_store (const gchar *file_name)
+{
+	GMappedFile *mapped;
+	const gchar *contents;
+	const gchar *p;
+	const gchar *end;
+	GError *error = NULL;
+
+	mapped = g_mapped_file_new (file_name, FALSE, &error);
+	if (mapped == NULL)
+	{
+		g_message ("Cannot read the metadata file: %s", error->message);
+		g_error_free (error);
+
+		return FALSE;
+	}
+
+	contents = g_mapped_file_get_contents (mapped);
+	end = contents + g_mapped_file_get_length (mapped);
+
+	if (contents == NULL ||
+	    end - contents < METADATA_MAGIC_LEN ||
+	    memcmp (contents, METADATA_MAGIC, METADATA_MAGIC_LEN) != 0)
+	{
+		g_message ("File '%s' is of the wrong type", METADATA_FILE);
+		g_mapped_file_unref (mapped);
+
+		return FALSE;
+	}
+
+	p = contents + METADATA_MAGIC_LEN;
+
+	while (end - p >= (gssize) sizeof (guint32))
+	{
+		guint32 len;
+
+		memcpy (&len, p, sizeof (len));
+		len = GUINT32_FROM_LE (len);
+
+		if (len <= RECORD_HEADER_LEN ||
+		    len > end - p - sizeof (guint32) ||
+		    !read_record (p + sizeof (guint32), len))
+		{
+			break;
+		}
+
+		p += sizeof (guint32) + len;
+		gedit_metadata_manager->n_records++;
+	}
+
+	/* Do not append after a truncated record */
+	if (p != end)
+	{
+		g_message ("The metadata file '%s' is damaged", METADATA_FILE);
+		gedit_metadata_manager->rewrite = TRUE;
+	}
+
+	g_mapped_file_unref (mapped);
+
+	/* Records are in the order they were saved, later records win
+	 * the ties on atime */
+	g_queue_sort (gedit_metadata_manager->lru,
+		      (GCompareDataFunc)compare_atime,
+		      NULL);
+
+	return TRUE;
+}
+
+static void
+load_values (void)
+{
+	gchar *file_name;
+
+	gedit_debug (DEBUG_METADATA);
+
+	g_return_if_fail (gedit_metadata_manager != NULL);
+	g_return_if_fail (gedit_metadata_manager->values_loaded == FALSE);
+
+	gedit_metadata_manager->values_loaded = TRUE;
+
+	file_name = get_metadata_filename (METADATA_FILE);
+
+	if (!g_file_test (file_name, G_FILE_TEST_EXISTS) ||
+	    !load_store (file_name))
+	{
+		gedit_metadata_manager->rewrite = TRUE;
+
+		if (import_xml_values ())
+		{
+			/* write the binary file soon, so that the xml
+			 * file is not read again */
+			g_queue_sort (gedit_metadata_manager->lru,
+				      (GCompareDataFunc)compare_atime,
+				      NULL);
+
+			gedit_metadata_manager_arm_timeout ();
+		}
+	}
+
+	g_free (file_name);
+
+	resize_items ();
+}
+
 gchar *
 gedit_metadata_manager_get (const gchar *uri,
 			    const gchar *key)
@@ -315,14 +617,7 @@ gedit_metadata_manager_get (const gchar *uri,
 	gedit_metadata_manager_init ();
 
 	if (!gedit_metadata_manager->values_loaded)
-	{
-		gboolean res;
-
-		res = load_values ();
-
-		if (!res)
-			return NULL;
-	}
+		load_values ();
 
 	item = (Item *)g_hash_table_lookup (gedit_metadata_manager->items,
 					    uri);
@@ -330,10 +625,8 @@ gedit_metadata_manager_get (const gchar *uri,
 	if (item == NULL)
 		return NULL;
 
-	item->atime = time (NULL);
-	
-	if (item->values == NULL)
-		return NULL;
+	/* the new atime is saved with the next change */
+	item_touch (item);
 
 	value = g_hash_table_lookup (item->values, key);
 
@@ -358,32 +651,14 @@ gedit_metadata_manager_set (const gchar *uri,
 	gedit_metadata_manager_init ();
 
 	if (!gedit_metadata_manager->values_loaded)
-	{
-		gboolean res;
-
-		res = load_values ();
-
-		if (!res)
-			return;
-	}
+		load_values ();
 
 	item = (Item *)g_hash_table_lookup (gedit_metadata_manager->items,
 					    uri);
 
 	if (item == NULL)
-	{
-		item = g_new0 (Item, 1);
+		item = item_new (uri);
 
-		g_hash_table_insert (gedit_metadata_manager->items,
-				     g_strdup (uri),
-				     item);
-	}
-	
-	if (item->values == NULL)
-		 item->values = g_hash_table_new_full (g_str_hash, 
-				 		       g_str_equal, 
-						       g_free, 
-						       g_free);
 	if (value != NULL)
 		g_hash_table_insert (item->values,
 				     g_strdup (key),
@@ -392,172 +667,195 @@ gedit_metadata_manager_set (const gchar *uri,
 		g_hash_table_remove (item->values,
 				     key);
 
-	item->atime = time (NULL);
+	item_touch (item);
+
+	resize_items ();
 
 	gedit_metadata_manager_arm_timeout ();
 }
 
 static void
-save_values (const gchar *key, const gchar *value, xmlNodePtr parent)
+append_record (GString     *buffer,
+	       RecordType   type,
+	       const Item  *item,
+	       const gchar *uri)
 {
-	xmlNodePtr xml_node;
+	gsize start;
+	guint32 len;
+	guint64 atime;
 
-#ifdef GEDIT_METADATA_VERBOSE_DEBUG
-	gedit_debug (DEBUG_METADATA);
-#endif	
+	start = buffer->len;
 
-	g_return_if_fail (key != NULL);
-	
-	if (value == NULL)
-		return;
-		
-	xml_node = xmlNewChild (parent,
-				NULL,
-				(const xmlChar *)"entry",
-				NULL);
-
-	xmlSetProp (xml_node,
-		    (const xmlChar *)"key",
-		    (const xmlChar *)key);
-	xmlSetProp (xml_node,
-		    (const xmlChar *)"value",
-		    (const xmlChar *)value);
+	/* the length is filled in at the end */
+	g_string_append_len (buffer, "\0\0\0\0", sizeof (len));
+	g_string_append_c (buffer, type);
 
-#ifdef GEDIT_METADATA_VERBOSE_DEBUG
-	gedit_debug_message (DEBUG_METADATA, "entry: %s = %s", key, value);
-#endif	
-}
+	atime = GUINT64_TO_LE (item != NULL ? (guint64) item->atime : 0);
+	g_string_append_len (buffer, (const gchar *)&atime, sizeof (atime));
 
-static void
-save_item (const gchar *key, const gpointer *data, xmlNodePtr parent)
-{
-	xmlNodePtr xml_node;
-	const Item *item = (const Item *)data;
-	gchar *atime;
+	g_string_append_len (buffer, uri, strlen (uri) + 1);
+
+	if (item != NULL)
+	{
+		GHashTableIter iter;
+		gpointer key, value;
+
+		g_hash_table_iter_init (&iter, item->values);
+
+		while (g_hash_table_iter_next (&iter, &key, &value))
+		{
+			g_string_append_len (buffer, key, strlen (key) + 1);
+			g_string_append_len (buffer, value, strlen (value) + 1);
 
 #ifdef GEDIT_METADATA_VERBOSE_DEBUG
-	gedit_debug (DEBUG_METADATA);
+			gedit_debug_message (DEBUG_METADATA, "entry: %s = %s",
+					     (gchar *)key, (gchar *)value);
 #endif
+		}
+	}
 
-	g_return_if_fail (key != NULL);
+	len = GUINT32_TO_LE (buffer->len - start - sizeof (len));
+	memcpy (buffer->str + start, &len, sizeof (len));
+}
 
-	if (item == NULL)
-		return;
+static gboolean
+write_all (const gchar *file_name)
+{
+	GString *buffer;
+	GList *l;
+	GError *error = NULL;
+	gboolean ret;
 
-	xml_node = xmlNewChild (parent, NULL, (const xmlChar *)"document", NULL);
+	buffer = g_string_new_len (METADATA_MAGIC, METADATA_MAGIC_LEN);
 
-	xmlSetProp (xml_node, (const xmlChar *)"uri", (const xmlChar *)key);
+	/* the oldest first, so that the order is kept on load */
+	for (l = gedit_metadata_manager->lru->tail; l != NULL; l = l->prev)
+	{
+		Item *item = (Item *)l->data;
 
-#ifdef GEDIT_METADATA_VERBOSE_DEBUG
-	gedit_debug_message (DEBUG_METADATA, "uri: %s", key);
-#endif	
+		append_record (buffer, RECORD_ITEM, item, item->uri);
+	}
 
-	atime = g_strdup_printf ("%ld", item->atime);
-	xmlSetProp (xml_node, (const xmlChar *)"atime", (const xmlChar *)atime);	
+	ret = g_file_set_contents (file_name, buffer->str, buffer->len, &error);
 
-#ifdef GEDIT_METADATA_VERBOSE_DEBUG
-	gedit_debug_message (DEBUG_METADATA, "atime: %s", atime);
-#endif	
+	if (!ret)
+	{
+		g_message ("Cannot save the metadata: %s", error->message);
+		g_error_free (error);
+	}
 
-	g_free (atime);
+	g_string_free (buffer, TRUE);
 
-    	g_hash_table_foreach (item->values,
-			      (GHFunc)save_values,
-			      xml_node);
+	return ret;
 }
 
-static void
-get_oldest (const gchar *key, const gpointer value, const gchar ** key_to_remove)
+static gboolean
+write_changes (const gchar *file_name)
 {
-	const Item *item = (const Item *)value;
+	GString *buffer;
+	GSList *l;
+	GHashTableIter iter;
+	gpointer item;
+	FILE *file;
+	gboolean ret;
+
+	buffer = g_string_new (NULL);
+
+	/* removals come first, the uri may have been set again */
+	gedit_metadata_manager->removed =
+		g_slist_reverse (gedit_metadata_manager->removed);
 
-	if (*key_to_remove == NULL)
+	for (l = gedit_metadata_manager->removed; l != NULL; l = l->next)
 	{
-		*key_to_remove = key;
+		append_record (buffer, RECORD_REMOVE, NULL, l->data);
+		gedit_metadata_manager->n_records++;
 	}
-	else
+
+	g_hash_table_iter_init (&iter, gedit_metadata_manager->dirty);
+
+	while (g_hash_table_iter_next (&iter, NULL, &item))
 	{
-		const Item *item_to_remove = 
-			g_hash_table_lookup (gedit_metadata_manager->items,
-					     *key_to_remove);
+		append_record (buffer, RECORD_ITEM, item, ((Item *)item)->uri);
+		gedit_metadata_manager->n_records++;
+	}
 
-		g_return_if_fail (item_to_remove != NULL);
+	file = g_fopen (file_name, "ab");
+	ret = file != NULL;
 
-		if (item->atime < item_to_remove->atime)
-		{
-			*key_to_remove = key;
-		}
-	}	
-}
+	/* the file was removed since it was loaded, it starts again
+	 * with the header */
+	if (ret && fseek (file, 0, SEEK_END) == 0 && ftell (file) == 0)
+		g_string_prepend_len (buffer, METADATA_MAGIC, METADATA_MAGIC_LEN);
 
-static void
-resize_items (void)
-{
-	while (g_hash_table_size (gedit_metadata_manager->items) > MAX_ITEMS)
+	if (ret)
 	{
-		gpointer key_to_remove = NULL;
+		ret = fwrite (buffer->str, 1, buffer->len, file) == buffer->len;
+		ret = (fclose (file) == 0) && ret;
+	}
 
-		g_hash_table_foreach (gedit_metadata_manager->items,
-				      (GHFunc)get_oldest,
-				      &key_to_remove);
+	if (!ret)
+		g_message ("Cannot save the metadata: %s", g_strerror (errno));
 
-		g_return_if_fail (key_to_remove != NULL);
-		
-		g_hash_table_remove (gedit_metadata_manager->items,
-				     key_to_remove);
-	}
+	g_string_free (buffer, TRUE);
+
+	return ret;
 }
 
 static gboolean
 gedit_metadata_manager_save (gpointer data)
 {	
-	xmlDocPtr  doc;
-	xmlNodePtr root;
 	gchar *file_name;
+	gchar *cache_dir;
+	gboolean res;
 
 	gedit_debug (DEBUG_METADATA);
 
 	gedit_metadata_manager->timeout_id = 0;
 
 	resize_items ();
-		
-	xmlIndentTreeOutput = TRUE;
 
-	doc = xmlNewDoc ((const xmlChar *)"1.0");
-	if (doc == NULL)
-		return TRUE;
+	/* make sure the cache dir exists */
+	cache_dir = gedit_dirs_get_user_cache_dir ();
+	res = g_mkdir_with_parents (cache_dir, 0755) != -1;
+	g_free (cache_dir);
 
-	/* Create metadata root */
-	root = xmlNewDocNode (doc, NULL, (const xmlChar *)"metadata", NULL);
-	xmlDocSetRootElement (doc, root);
+	/* FIXME: lock file - Paolo */
+	file_name = get_metadata_filename (METADATA_FILE);
 
-    	g_hash_table_foreach (gedit_metadata_manager->items,
-			      (GHFunc)save_item,
-			      root);        
+	if (gedit_metadata_manager->n_records >
+	    2 * g_hash_table_size (gedit_metadata_manager->items) + MAX_STALE_RECORDS)
+	{
+		gedit_metadata_manager->rewrite = TRUE;
+	}
 
-	/* FIXME: lock file - Paolo */
-	file_name = get_metadata_filename ();
-	if (file_name != NULL)
+	if (res)
 	{
-		gchar *cache_dir;
-		int res;
+		if (gedit_metadata_manager->rewrite)
+		{
+			res = write_all (file_name);
 
-		/* make sure the cache dir exists */
-		cache_dir = gedit_dirs_get_user_cache_dir ();
-		res = g_mkdir_with_parents (cache_dir, 0755);
-		if (res != -1)
+			if (res)
+				gedit_metadata_manager->n_records =
+					g_hash_table_size (gedit_metadata_manager->items);
+		}
+		else
 		{
-			xmlSaveFormatFile (file_name, doc, 1);
+			res = write_changes (file_name);
 		}
-
-		g_free (cache_dir);
-		g_free (file_name);
 	}
 
-	xmlFreeDoc (doc); 
+	/* a partial write leaves a damaged record at the end */
+	gedit_metadata_manager->rewrite = !res;
+
+	g_hash_table_remove_all (gedit_metadata_manager->dirty);
+
+	g_slist_foreach (gedit_metadata_manager->removed, (GFunc)g_free, NULL);
+	g_slist_free (gedit_metadata_manager->removed);
+	gedit_metadata_manager->removed = NULL;
+
+	g_free (file_name);
 
 	gedit_debug_message (DEBUG_METADATA, "DONE");
 
 	return FALSE;
 }
-
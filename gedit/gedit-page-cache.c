@@ -0,0 +1,187 @@
+/*
+ * gedit-page-cache.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gedit-page-cache.h"
+
+typedef struct
+{
+	gint		    page;
+	double		    scale;
+	GtkPageOrientation  orientation;
+	cairo_surface_t	   *surface;
+	gsize		    size;
+
+	GList		   *link; /* in the lru queue */
+} PageEntry;
+
+struct _GeditPageCache
+{
+	/* page number -> PageEntry */
+	GHashTable *pages;
+
+	/* most recently used first */
+	GQueue	   *lru;
+
+	gsize	    size;
+	gsize	    budget;
+};
+
+static gsize
+get_surface_size (cairo_surface_t *surface)
+{
+	if (cairo_surface_get_type (surface) != CAIRO_SURFACE_TYPE_IMAGE)
+		return 0;
+
+	return (gsize) cairo_image_surface_get_stride (surface) *
+	       cairo_image_surface_get_height (surface);
+}
+
+static void
+entry_free (PageEntry *entry)
+{
+	cairo_surface_destroy (entry->surface);
+	g_slice_free (PageEntry, entry);
+}
+
+static void
+entry_remove (GeditPageCache *cache,
+	      PageEntry      *entry)
+{
+	g_queue_delete_link (cache->lru, entry->link);
+	cache->size -= entry->size;
+
+	/* frees the entry */
+	g_hash_table_remove (cache->pages, GINT_TO_POINTER (entry->page));
+}
+
+GeditPageCache *
+gedit_page_cache_new (gsize budget)
+{
+	GeditPageCache *cache;
+
+	cache = g_slice_new (GeditPageCache);
+
+	cache->pages = g_hash_table_new_full (g_direct_hash,
+					      g_direct_equal,
+					      NULL,
+					      (GDestroyNotify) entry_free);
+	cache->lru = g_queue_new ();
+	cache->size = 0;
+	cache->budget = budget;
+
+	return cache;
+}
+
+void
+gedit_page_cache_free (GeditPageCache *cache)
+{
+	if (cache == NULL)
+		return;
+
+	g_hash_table_destroy (cache->pages);
+	g_queue_free (cache->lru);
+
+	g_slice_free (GeditPageCache, cache);
+}
+
+void
+gedit_page_cache_clear (GeditPageCache *cache)
+{
+	g_return_if_fail (cache != NULL);
+
+	g_hash_table_remove_all (cache->pages);
+	g_queue_clear (cache->lru);
+	cache->size = 0;
+}
+
+void
+gedit_page_cache_insert (GeditPageCache    *cache,
+			 gint               page,
+			 double             scale,
+			 GtkPageOrientation orientation,
+			 cairo_surface_t   *surface)
+{
+	PageEntry *entry;
+
+	g_return_if_fail (cache != NULL);
+	g_return_if_fail (surface != NULL);
+
+	entry = g_hash_table_lookup (cache->pages, GINT_TO_POINTER (page));
+	if (entry != NULL)
+		entry_remove (cache, entry);
+
+	entry = g_slice_new (PageEntry);
+	entry->page = page;
+	entry->scale = scale;
+	entry->orientation = orientation;
+	entry->surface = cairo_surface_reference (surface);
+	entry->size = get_surface_size (surface);
+
+	g_hash_table_insert (cache->pages, GINT_TO_POINTER (page), entry);
+	g_queue_push_head (cache->lru, entry);
+	entry->link = cache->lru->head;
+	cache->size += entry->size;
+
+	/* the new page is kept even if it is bigger than the budget,
+	 * since it is about to be drawn */
+	while (cache->size > cache->budget &&
+	       cache->lru->tail != entry->link)
+	{
+		entry_remove (cache, g_queue_peek_tail (cache->lru));
+	}
+}
+
+cairo_surface_t *
+gedit_page_cache_lookup (GeditPageCache    *cache,
+			 gint               page,
+			 GtkPageOrientation orientation,
+			 double            *scale)
+{
+	PageEntry *entry;
+
+	g_return_val_if_fail (cache != NULL, NULL);
+
+	entry = g_hash_table_lookup (cache->pages, GINT_TO_POINTER (page));
+	if (entry == NULL || entry->orientation != orientation)
+		return NULL;
+
+	g_queue_unlink (cache->lru, entry->link);
+	g_queue_push_head_link (cache->lru, entry->link);
+
+	if (scale != NULL)
+		*scale = entry->scale;
+
+	return entry->surface;
+}
+
+gsize
+gedit_page_cache_get_size (GeditPageCache *cache)
+{
+	g_return_val_if_fail (cache != NULL, 0);
+
+	return cache->size;
+}
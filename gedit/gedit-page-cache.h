@@ -0,0 +1,62 @@
+/*
+ * gedit-page-cache.h
+ * This file is part of gedit
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef __GEDIT_PAGE_CACHE_H__
+#define __GEDIT_PAGE_CACHE_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/* Keeps the last rendered surface of each page of a print preview, with
+ * the scale and the orientation it was rendered at. The least recently
+ * used surfaces are dropped when their size goes over the budget. */
+typedef struct _GeditPageCache		GeditPageCache;
+
+GeditPageCache	*gedit_page_cache_new		(gsize               budget);
+
+void		 gedit_page_cache_free		(GeditPageCache    *cache);
+
+void		 gedit_page_cache_clear		(GeditPageCache    *cache);
+
+/* Takes a reference on @surface, which replaces the one of @page */
+void		 gedit_page_cache_insert	(GeditPageCache    *cache,
+						 gint               page,
+						 double             scale,
+						 GtkPageOrientation orientation,
+						 cairo_surface_t   *surface);
+
+/* Returns the surface of @page if it was rendered with @orientation,
+ * and the scale it was rendered at in @scale. The cache keeps the
+ * reference. */
+cairo_surface_t	*gedit_page_cache_lookup	(GeditPageCache    *cache,
+						 gint               page,
+						 GtkPageOrientation orientation,
+						 double            *scale);
+
+/* Size in bytes of the surfaces in the cache */
+gsize		 gedit_page_cache_get_size	(GeditPageCache    *cache);
+
+G_END_DECLS
+
+#endif /* __GEDIT_PAGE_CACHE_H__ */
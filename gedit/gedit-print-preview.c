@@ -40,9 +40,13 @@
 #include <cairo-pdf.h>
 
 #include "gedit-print-preview.h"
+#include "gedit-page-cache.h"
 
 #define PRINTER_DPI (72.)
 
+/* about 18 A4 pages at 96 dpi and 100% zoom */
+#define PAGE_CACHE_SIZE (64 * 1024 * 1024)
+
 struct _GeditPrintPreviewPrivate
 {
 	GtkPrintOperation *operation;
@@ -82,6 +86,13 @@ struct _GeditPrintPreviewPrivate
 
 	guint n_pages;
 	guint cur_page;
+
+	/* rendered pages, and the idle rendering the visible pages that
+	 * were drawn scaled and the ones after them in the direction
+	 * the user is moving */
+	GeditPageCache *cache;
+	guint render_idle_id;
+	gint direction;
 };
 
 G_DEFINE_TYPE (GeditPrintPreview, gedit_print_preview, GTK_TYPE_VBOX)
@@ -118,10 +129,26 @@ gedit_print_preview_set_property (GObject      *object,
 	}
 }
 
+static void
+gedit_print_preview_dispose (GObject *object)
+{
+	GeditPrintPreview *preview = GEDIT_PRINT_PREVIEW (object);
+
+	if (preview->priv->render_idle_id != 0)
+	{
+		g_source_remove (preview->priv->render_idle_id);
+		preview->priv->render_idle_id = 0;
+	}
+
+	G_OBJECT_CLASS (gedit_print_preview_parent_class)->dispose (object);
+}
+
 static void
 gedit_print_preview_finalize (GObject *object)
 {
-	//GeditPrintPreview *preview = GEDIT_PRINT_PREVIEW (object);
+	GeditPrintPreview *preview = GEDIT_PRINT_PREVIEW (object);
+
+	gedit_page_cache_free (preview->priv->cache);
 
 	G_OBJECT_CLASS (gedit_print_preview_parent_class)->finalize (object);
 }
@@ -147,6 +174,7 @@ gedit_print_preview_class_init (GeditPrintPreviewClass *klass)
 
 	object_class->get_property = gedit_print_preview_get_property;
 	object_class->set_property = gedit_print_preview_set_property;
+	object_class->dispose = gedit_print_preview_dispose;
 	object_class->finalize = gedit_print_preview_finalize;
 
 	widget_class->grab_focus = gedit_print_preview_grab_focus;
@@ -228,6 +256,9 @@ update_tile_size (GeditPrintPreview *preview)
 	}
 }
 
+#define ZOOM_MIN (0.1)
+#define ZOOM_MAX (10.0)
+
 /* Zoom should always be set with one of these two function
  * so that the tile size is properly updated */
 
@@ -239,7 +270,7 @@ set_zoom_factor (GeditPrintPreview *preview,
 
 	priv = preview->priv;
 
-	priv->scale = zoom;
+	priv->scale = CLAMP (zoom, ZOOM_MIN, ZOOM_MAX);
 
 	update_tile_size (preview);
 	update_layout_size (preview);
@@ -329,6 +360,7 @@ goto_page (GeditPrintPreview *preview, gint page)
 
 	if (page != preview->priv->cur_page)
 	{
+		preview->priv->direction = (page > preview->priv->cur_page) ? 1 : -1;
 		preview->priv->cur_page = page;
 		if (preview->priv->n_pages > 0)
 			gtk_widget_queue_draw (preview->priv->layout);
@@ -1008,6 +1040,10 @@ gedit_print_preview_init (GeditPrintPreview *preview)
 	priv->scale = 1.0;
 	priv->rows = 1;
 	priv->cols = 1;
+
+	priv->cache = gedit_page_cache_new (PAGE_CACHE_SIZE);
+	priv->render_idle_id = 0;
+	priv->direction = 1;
 }
 
 static void
@@ -1084,6 +1120,159 @@ draw_page_frame (cairo_t            *cr,
 	cairo_stroke (cr);
 }
 
+/* size of the page in pixels at the current zoom, rotated */
+static void
+get_page_pixel_size (GeditPrintPreview *preview,
+		     gint              *width,
+		     gint              *height)
+{
+	double w, h;
+
+	w = preview->priv->scale * get_paper_width (preview);
+	h = preview->priv->scale * get_paper_height (preview);
+
+	if ((preview->priv->orientation == GTK_PAGE_ORIENTATION_LANDSCAPE) ||
+	    (preview->priv->orientation == GTK_PAGE_ORIENTATION_REVERSE_LANDSCAPE))
+	{
+		double tmp;
+
+		tmp = w;
+		w = h;
+		h = tmp;
+	}
+
+	*width = MAX (1, ceil (w));
+	*height = MAX (1, ceil (h));
+}
+
+/* Whether @n_pages pages at the current zoom fit in the cache. The
+ * visible pages are drawn directly when they do not, since they would
+ * evict each other and be rendered again on every redraw. */
+static gboolean
+pages_fit_cache (GeditPrintPreview *preview,
+		 gint               n_pages)
+{
+	gint w, h;
+
+	get_page_pixel_size (preview, &w, &h);
+
+	return (gdouble) n_pages * w * h * 4 <= PAGE_CACHE_SIZE;
+}
+
+/* Renders the page at the current zoom and orientation into a surface
+ * with a transparent background, which is drawn over the page frame */
+static cairo_surface_t *
+render_page (GeditPrintPreview *preview,
+	     gint               page_number)
+{
+	cairo_surface_t *surface;
+	cairo_t *cr;
+	gint w, h;
+
+	get_page_pixel_size (preview, &w, &h);
+
+	surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, w, h);
+
+	cr = cairo_create (surface);
+	draw_page_content (cr, page_number, preview);
+	cairo_destroy (cr);
+
+	gedit_page_cache_insert (preview->priv->cache,
+				 page_number,
+				 preview->priv->scale,
+				 preview->priv->orientation,
+				 surface);
+
+	/* the cache keeps a reference */
+	cairo_surface_destroy (surface);
+
+	return surface;
+}
+
+/* Whether @page_number has to be rendered again at the current zoom */
+static gboolean
+page_needs_render (GeditPrintPreview *preview,
+		   gint               page_number)
+{
+	cairo_surface_t *surface;
+	double scale;
+
+	surface = gedit_page_cache_lookup (preview->priv->cache,
+					   page_number,
+					   preview->priv->orientation,
+					   &scale);
+
+	return (surface == NULL) || (scale != preview->priv->scale);
+}
+
+static gboolean
+render_idle (GeditPrintPreview *preview)
+{
+	GeditPrintPreviewPrivate *priv;
+	gint n_visible;
+	gint first;
+	gint pg;
+	gint i;
+
+	priv = preview->priv;
+
+	n_visible = priv->cols * priv->rows;
+	first = get_first_page_displayed (preview);
+
+	/* the pages are drawn directly at this zoom */
+	if (!pages_fit_cache (preview, n_visible))
+	{
+		priv->render_idle_id = 0;
+
+		return FALSE;
+	}
+
+	/* one page per iteration: the visible pages that were drawn
+	 * scaled first, then a screen of pages ahead as long as they
+	 * do not evict the visible ones */
+	for (i = 0; i < 2 * n_visible && pages_fit_cache (preview, i + 1); i++)
+	{
+		if (i < n_visible || priv->direction > 0)
+			pg = first + i;
+		else
+			pg = first - (i - n_visible) - 1;
+
+		if (pg < 0 || pg >= (gint) priv->n_pages)
+			continue;
+
+		if (!gtk_print_operation_preview_is_selected (priv->gtk_preview, pg))
+			continue;
+
+		if (page_needs_render (preview, pg))
+		{
+			render_page (preview, pg);
+
+			if (i < n_visible)
+				gtk_widget_queue_draw (priv->layout);
+
+			return TRUE;
+		}
+	}
+
+	priv->render_idle_id = 0;
+
+	return FALSE;
+}
+
+static void
+queue_render (GeditPrintPreview *preview)
+{
+	if (preview->priv->render_idle_id != 0)
+		return;
+
+	/* below the redraws, so that scrolling and zooming stay smooth */
+	preview->priv->render_idle_id =
+		g_idle_add_full (G_PRIORITY_LOW,
+				 (GSourceFunc) render_idle,
+				 preview,
+				 NULL);
+}
+
 static void
 draw_page (cairo_t           *cr,
 	   double             x,
@@ -1091,13 +1280,45 @@ draw_page (cairo_t           *cr,
 	   gint	              page_number,
 	   GeditPrintPreview *preview)
 {
+	cairo_surface_t *surface;
+	double scale;
+
 	cairo_save (cr);
 
 	/* move to the page top left corner */
 	cairo_translate (cr, x + PAGE_PAD, y + PAGE_PAD);
 
 	draw_page_frame (cr, preview);
-	draw_page_content (cr, page_number, preview);
+
+	if (!pages_fit_cache (preview, preview->priv->cols * preview->priv->rows))
+	{
+		draw_page_content (cr, page_number, preview);
+		cairo_restore (cr);
+
+		return;
+	}
+
+	surface = gedit_page_cache_lookup (preview->priv->cache,
+					   page_number,
+					   preview->priv->orientation,
+					   &scale);
+
+	if (surface == NULL)
+	{
+		surface = render_page (preview, page_number);
+		scale = preview->priv->scale;
+	}
+
+	/* after a zoom the page is scaled until it is rendered again */
+	if (scale != preview->priv->scale)
+	{
+		cairo_scale (cr,
+			     preview->priv->scale / scale,
+			     preview->priv->scale / scale);
+	}
+
+	cairo_set_source_surface (cr, surface, 0, 0);
+	cairo_paint (cr);
 
 	cairo_restore (cr);
 }
@@ -1151,6 +1372,8 @@ preview_expose (GtkWidget         *widget,
 	}
 	cairo_destroy (cr);
 
+	queue_render (preview);
+
 	return TRUE;
 }
 
@@ -1201,6 +1424,9 @@ preview_ready (GtkPrintOperationPreview *gtk_preview,
 	/* figure out the dpi */
 	preview->priv->dpi = get_screen_dpi (preview);
 
+	/* the pages were paginated again */
+	gedit_page_cache_clear (preview->priv->cache);
+
 	set_zoom_factor (preview, 1.0);
 
 	/* let the default gtklayout handler clear the background */
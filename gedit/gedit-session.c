@@ -550,12 +550,19 @@ parse_window (GKeyFile *state_file, const char *group_name)
 					     "URI: %s (%s)",
 					     documents[i],
 					     jump_to ? "active" : "not active");
-			gedit_window_create_tab_from_uri (window,
-							  documents[i],
-							  NULL,
-							  0,
-							  FALSE,
-							  jump_to);
+			if (jump_to)
+				gedit_window_create_tab_from_uri (window,
+								  documents[i],
+								  NULL,
+								  0,
+								  FALSE,
+								  TRUE);
+			else
+				_gedit_window_create_dormant_tab (window,
+								  documents[i],
+								  NULL,
+								  0,
+								  FALSE);
 		}
 		g_strfreev (documents);
 	}
@@ -23,10 +23,15 @@
 #include "gedit-smart-charset-converter.h"
 #include "gedit-debug.h"
 
+#include <string.h>
 #include <gio/gio.h>
 #include <glib/gi18n.h>
 
 #include "gedit-convert.h"
+#include "gedit-encoding-detector.h"
+
+/* Size of the buffer used for the trial conversions */
+#define TRY_CONVERT_BUFFER_SIZE 4096
 
 #define GEDIT_SMART_CHARSET_CONVERTER_GET_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE((object), GEDIT_TYPE_SMART_CHARSET_CONVERTER, GeditSmartCharsetConverterPrivate))
 
@@ -37,6 +42,8 @@ struct _GeditSmartCharsetConverterPrivate
 	GSList *encodings;
 	GSList *current_encoding;
 
+	gsize sample_size;
+
 	guint is_utf8 : 1;
 	guint use_first : 1;
 };
@@ -95,36 +102,25 @@ gedit_smart_charset_converter_init (GeditSmartCharsetConverter *smart)
 	smart->priv->charset_conv = NULL;
 	smart->priv->encodings = NULL;
 	smart->priv->current_encoding = NULL;
+	smart->priv->sample_size = GEDIT_ENCODING_DETECTOR_DEFAULT_SAMPLE_SIZE;
 	smart->priv->is_utf8 = FALSE;
 	smart->priv->use_first = FALSE;
 
 	gedit_debug_message (DEBUG_UTILS, "initializing smart charset converter");
 }
 
-static const GeditEncoding *
-get_encoding (GeditSmartCharsetConverter *smart)
+/* Encodings in which any ASCII text (without NUL) converts successfully,
+ * so that the trial conversion of an ASCII block can be skipped */
+static gboolean
+is_ascii_compatible (const GeditEncoding *enc)
 {
-	if (smart->priv->current_encoding == NULL)
-	{
-		smart->priv->current_encoding = smart->priv->encodings;
-	}
-	else
-	{
-		smart->priv->current_encoding = g_slist_next (smart->priv->current_encoding);
-	}
-
-	if (smart->priv->current_encoding != NULL)
-		return (const GeditEncoding *)smart->priv->current_encoding->data;
+	const gchar *charset;
 
-#if 0
-	FIXME: uncomment this when using fallback
-	/* If we tried all encodings, we return the first encoding */
-	smart->priv->use_first = TRUE;
-	smart->priv->current_encoding = smart->priv->encodings;
+	charset = gedit_encoding_get_charset (enc);
 
-	return (const GeditEncoding *)smart->priv->current_encoding->data;
-#endif
-	return NULL;
+	return !g_str_has_prefix (charset, "UTF-") &&
+	       !g_str_has_prefix (charset, "UCS-") &&
+	       !g_str_has_prefix (charset, "ISO-2022");
 }
 
 static gboolean
@@ -134,32 +130,36 @@ try_convert (GCharsetConverter *converter,
 {
 	GError *err;
 	gsize bytes_read, nread;
-	gsize bytes_written, nwritten;
+	gsize bytes_written;
 	GConverterResult res;
-	gchar *out;
+	gchar out[TRY_CONVERT_BUFFER_SIZE];
 	gboolean ret;
-	gsize out_size;
+	gboolean valid = TRUE;
 
 	err = NULL;
 	nread = 0;
-	nwritten = 0;
-	out_size = inbuf_size * 4;
-	out = g_malloc (out_size);
 
+	/* iconv only writes whole characters, so we can convert into a
+	 * small buffer and validate each piece of output on its own */
 	do
 	{
 		res = g_converter_convert (G_CONVERTER (converter),
 		                           inbuf + nread,
 		                           inbuf_size - nread,
-		                           out + nwritten,
-		                           out_size - nwritten,
+		                           out,
+		                           TRY_CONVERT_BUFFER_SIZE,
 		                           G_CONVERTER_INPUT_AT_END,
 		                           &bytes_read,
 		                           &bytes_written,
 		                           &err);
 
 		nread += bytes_read;
-		nwritten += bytes_written;
+
+		if (err == NULL && !gedit_encoding_detector_validate_utf8 (out, bytes_written, NULL))
+		{
+			valid = FALSE;
+			break;
+		}
 	} while (res != G_CONVERTER_FINISHED && res != G_CONVERTER_ERROR && err == NULL);
 
 	if (err != NULL)
@@ -184,13 +184,11 @@ try_convert (GCharsetConverter *converter,
 	}
 
 	/* FIXME: Check the remainder? */
-	if (ret == TRUE && !g_utf8_validate (out, nwritten, NULL))
+	if (!valid)
 	{
 		ret = FALSE;
 	}
 
-	g_free (out);
-
 	return ret;
 }
 
@@ -200,74 +198,81 @@ guess_encoding (GeditSmartCharsetConverter *smart,
 		gsize                       inbuf_size)
 {
 	GCharsetConverter *conv = NULL;
+	GSList *guesses;
+	GSList *l;
+	gsize sample_size;
+	gboolean is_ascii;
 
+	/* With only one candidate there is nothing to guess */
 	if (smart->priv->encodings != NULL &&
 	    smart->priv->encodings->next == NULL)
-		smart->priv->use_first = TRUE;
-
-	/* We just check the first block */
-	while (TRUE)
 	{
-		const GeditEncoding *enc;
+		const GeditEncoding *enc = smart->priv->encodings->data;
+
+		smart->priv->use_first = TRUE;
+		smart->priv->current_encoding = smart->priv->encodings;
 
-		if (conv != NULL)
+		if (enc == gedit_encoding_get_utf8 ())
 		{
-			g_object_unref (conv);
-			conv = NULL;
+			smart->priv->is_utf8 = TRUE;
+			return NULL;
 		}
 
-		/* We get an encoding from the list */
-		enc = get_encoding (smart);
+		return g_charset_converter_new ("UTF-8",
+						gedit_encoding_get_charset (enc),
+						NULL);
+	}
 
-		/* if it is NULL we didn't guess anything */
-		if (enc == NULL)
-		{
+	/* We just check the first block */
+	sample_size = MIN (inbuf_size, smart->priv->sample_size);
+	is_ascii = gedit_encoding_detector_ascii_length (inbuf, sample_size) == sample_size;
+
+	guesses = gedit_encoding_detector_guess (inbuf,
+						 sample_size,
+						 sample_size,
+						 smart->priv->encodings);
+
+	/* The detector only looks at byte statistics, confirm the most
+	   likely encodings with a real conversion */
+	for (l = guesses; l != NULL; l = g_slist_next (l))
+	{
+		GeditEncodingGuess *guess = l->data;
+		const GeditEncoding *enc = guess->encoding;
+
+		if (guess->confidence <= 0.0)
 			break;
-		}
 
-		gedit_debug_message (DEBUG_UTILS, "trying charset: %s",
-				     gedit_encoding_get_charset (smart->priv->current_encoding->data));
+		gedit_debug_message (DEBUG_UTILS, "trying charset: %s (confidence %.2f)",
+				     gedit_encoding_get_charset (enc),
+				     guess->confidence);
 
+		/* The detector already validated the sample */
 		if (enc == gedit_encoding_get_utf8 ())
 		{
-			gsize remainder;
-			const gchar *end;
-			
-			if (g_utf8_validate (inbuf, inbuf_size, &end) ||
-			    smart->priv->use_first)
-			{
-				smart->priv->is_utf8 = TRUE;
-				break;
-			}
-
-			/* Check if the end is less than one char */
-			remainder = inbuf_size - (end - (gchar *)inbuf);
-			if (remainder < 6)
-			{
-				smart->priv->is_utf8 = TRUE;
-				break;
-			}
-
-			continue;
+			smart->priv->is_utf8 = TRUE;
+			smart->priv->current_encoding = g_slist_find (smart->priv->encodings, enc);
+			break;
 		}
 
 		conv = g_charset_converter_new ("UTF-8",
 						gedit_encoding_get_charset (enc),
 						NULL);
 
-		/* If we tried all encodings we use the first one */
-		if (smart->priv->use_first)
+		/* An ASCII block is valid in this encoding, no need to
+		   convert it */
+		if ((is_ascii && is_ascii_compatible (enc)) ||
+		    try_convert (conv, inbuf, sample_size))
 		{
+			smart->priv->current_encoding = g_slist_find (smart->priv->encodings, enc);
 			break;
 		}
 
-		/* Try to convert */
-		if (try_convert (conv, inbuf, inbuf_size))
-		{
-			break;
-		}
+		g_object_unref (conv);
+		conv = NULL;
 	}
 
+	gedit_encoding_detector_free_guesses (guesses);
+
 	if (conv != NULL)
 	{
 		g_converter_reset (G_CONVERTER (conv));
@@ -310,7 +315,8 @@ gedit_smart_charset_converter_convert (GConverter *converter,
 		}
 	}
 
-	/* Now if the encoding is utf8 just redirect the input to the output */
+	/* Now if the encoding is utf8 just redirect the input to the output,
+	   without validating or converting it again */
 	if (smart->priv->is_utf8)
 	{
 		gsize size;
@@ -381,6 +387,17 @@ gedit_smart_charset_converter_new (GSList *candidate_encodings)
 	return smart;
 }
 
+/* How many bytes of the first block are looked at to guess the encoding */
+void
+gedit_smart_charset_converter_set_sample_size (GeditSmartCharsetConverter *smart,
+					       gsize                       sample_size)
+{
+	g_return_if_fail (GEDIT_IS_SMART_CHARSET_CONVERTER (smart));
+	g_return_if_fail (sample_size > 0);
+
+	smart->priv->sample_size = sample_size;
+}
+
 const GeditEncoding *
 gedit_smart_charset_converter_get_guessed (GeditSmartCharsetConverter *smart)
 {
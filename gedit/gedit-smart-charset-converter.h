@@ -57,6 +57,9 @@ GType gedit_smart_charset_converter_get_type (void) G_GNUC_CONST;
 
 GeditSmartCharsetConverter	*gedit_smart_charset_converter_new		(GSList *candidate_encodings);
 
+void				 gedit_smart_charset_converter_set_sample_size	(GeditSmartCharsetConverter *smart,
+										 gsize                       sample_size);
+
 const GeditEncoding		*gedit_smart_charset_converter_get_guessed	(GeditSmartCharsetConverter *smart);
 
 guint				 gedit_smart_charset_converter_get_num_fallbacks(GeditSmartCharsetConverter *smart);
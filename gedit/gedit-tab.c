@@ -45,6 +45,7 @@
 #include "gedit-prefs-manager-app.h"
 #include "gedit-convert.h"
 #include "gedit-enum-types.h"
+#include "gedit-file-change-tracker.h"
 
 #if !GTK_CHECK_VERSION (2, 17, 1)
 #include "gedit-message-area.h"
@@ -85,6 +86,10 @@ struct _GeditTabPrivate
 	gint                    auto_save : 1;
 
 	gint                    ask_if_externally_modified : 1;
+
+	/* the document is loaded the first time the tab is shown */
+	gint                    dormant : 1;
+	gint                    dormant_create : 1;
 };
 
 G_DEFINE_TYPE(GeditTab, gedit_tab, GTK_TYPE_VBOX)
@@ -99,6 +104,9 @@ enum
 };
 
 static gboolean gedit_tab_auto_save (GeditTab *tab);
+static void file_changed (GeditFileChangeTracker *tracker,
+			  GFile                  *location,
+			  GeditTab               *tab);
 
 static void
 install_auto_save_timeout (GeditTab *tab)
@@ -225,6 +233,16 @@ gedit_tab_set_property (GObject      *object,
 	}
 }
 
+static void
+gedit_tab_dispose (GObject *object)
+{
+	g_signal_handlers_disconnect_by_func (gedit_file_change_tracker_get_default (),
+					      G_CALLBACK (file_changed),
+					      object);
+
+	G_OBJECT_CLASS (gedit_tab_parent_class)->dispose (object);
+}
+
 static void
 gedit_tab_finalize (GObject *object)
 {
@@ -241,14 +259,49 @@ gedit_tab_finalize (GObject *object)
 	G_OBJECT_CLASS (gedit_tab_parent_class)->finalize (object);
 }
 
+static void
+load_dormant_document (GeditTab *tab)
+{
+	gchar *uri;
+
+	tab->priv->dormant = FALSE;
+
+	/* the uri may have been changed meanwhile, e.g. by a rename */
+	uri = gedit_document_get_uri (gedit_tab_get_document (tab));
+
+	_gedit_tab_load (tab,
+			 uri,
+			 tab->priv->tmp_encoding,
+			 tab->priv->tmp_line_pos,
+			 tab->priv->dormant_create);
+
+	g_free (uri);
+}
+
+/* Only the current page of the notebook is mapped */
+static void
+gedit_tab_map (GtkWidget *widget)
+{
+	GeditTab *tab = GEDIT_TAB (widget);
+
+	GTK_WIDGET_CLASS (gedit_tab_parent_class)->map (widget);
+
+	if (tab->priv->dormant)
+		load_dormant_document (tab);
+}
+
 static void 
 gedit_tab_class_init (GeditTabClass *klass)
 {
 	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
 
+	object_class->dispose = gedit_tab_dispose;
 	object_class->finalize = gedit_tab_finalize;
 	object_class->get_property = gedit_tab_get_property;
 	object_class->set_property = gedit_tab_set_property;
+
+	widget_class->map = gedit_tab_map;
 	
 	g_object_class_install_property (object_class,
 					 PROP_NAME,
@@ -321,7 +374,6 @@ set_cursor_according_to_state (GtkTextView   *view,
 
 	if ((state == GEDIT_TAB_STATE_LOADING)          ||
 	    (state == GEDIT_TAB_STATE_REVERTING)        ||
-	    (state == GEDIT_TAB_STATE_SAVING)           ||
 	    (state == GEDIT_TAB_STATE_PRINTING)         ||
 	    (state == GEDIT_TAB_STATE_PRINT_PREVIEWING) ||
 	    (state == GEDIT_TAB_STATE_CLOSING))
@@ -365,7 +417,10 @@ set_view_properties_according_to_state (GeditTab      *tab,
 {
 	gboolean val;
 
-	val = ((state == GEDIT_TAB_STATE_NORMAL) &&
+	/* the document is saved from a snapshot, it can be edited while
+	 * the save goes on */
+	val = ((state == GEDIT_TAB_STATE_NORMAL ||
+		state == GEDIT_TAB_STATE_SAVING) &&
 	       (tab->priv->print_preview == NULL) &&
 	       !tab->priv->not_editable);
 	gtk_text_view_set_editable (GTK_TEXT_VIEW (tab->priv->view), val);
@@ -810,7 +865,9 @@ message_area_set_progress (GeditTab *tab,
 	{
 		gdouble frac;
 
-		frac = (gdouble)size / (gdouble)total_size;
+		/* the size of a save is only a lower bound when the
+		 * text is not ascii */
+		frac = MIN ((gdouble)size / (gdouble)total_size, 1.0);
 
 		gedit_progress_message_area_set_fraction (
 				GEDIT_PROGRESS_MESSAGE_AREA (tab->priv->message_area),
@@ -1465,47 +1522,69 @@ display_externally_modified_notification (GeditTab *tab)
 			  tab);
 }
 
-static gboolean
-view_focused_in (GtkWidget     *widget,
-                 GdkEventFocus *event,
-                 GeditTab      *tab)
+static void
+check_externally_modified (GeditTab *tab)
 {
 	GeditDocument *doc;
 
-	g_return_val_if_fail (GEDIT_IS_TAB (tab), FALSE);
-
 	/* we try to detect file changes only in the normal state */
 	if (tab->priv->state != GEDIT_TAB_STATE_NORMAL)
 	{
-		return FALSE;
+		return;
 	}
 
 	/* we already asked, don't bug the user again */
 	if (!tab->priv->ask_if_externally_modified)
 	{
-		return FALSE;
+		return;
 	}
 
 	doc = gedit_tab_get_document (tab);
 
-	/* If file was never saved or is remote we do not check */
-	if (!gedit_document_is_local (doc))
-	{
-		return FALSE;
-	}
-
+	/* The check does not block, so remote files are checked too */
 	if (_gedit_document_check_externally_modified (doc))
 	{
 		gedit_tab_set_state (tab, GEDIT_TAB_STATE_EXTERNALLY_MODIFIED_NOTIFICATION);
 
 		display_externally_modified_notification (tab);
-
-		return FALSE;
 	}
+}
+
+static gboolean
+view_focused_in (GtkWidget     *widget,
+                 GdkEventFocus *event,
+                 GeditTab      *tab)
+{
+	g_return_val_if_fail (GEDIT_IS_TAB (tab), FALSE);
+
+	check_externally_modified (tab);
 
 	return FALSE;
 }
 
+/* The change tracker found out about a change after the focus-in check,
+ * or while the view has the focus */
+static void
+file_changed (GeditFileChangeTracker *tracker,
+	      GFile                  *location,
+	      GeditTab               *tab)
+{
+	GFile *doc_location;
+
+	if (!GTK_WIDGET_HAS_FOCUS (tab->priv->view))
+		return;
+
+	doc_location = gedit_document_get_location (gedit_tab_get_document (tab));
+
+	if (doc_location == NULL)
+		return;
+
+	if (g_file_equal (location, doc_location))
+		check_externally_modified (tab);
+
+	g_object_unref (doc_location);
+}
+
 static GMountOperation *
 tab_mount_operation_factory (GeditDocument *doc,
 			     gpointer userdata)
@@ -1605,6 +1684,11 @@ gedit_tab_init (GeditTab *tab)
 				"realize",
 				G_CALLBACK (view_realized),
 				tab);
+
+	g_signal_connect (gedit_file_change_tracker_get_default (),
+			  "changed",
+			  G_CALLBACK (file_changed),
+			  tab);
 }
 
 GtkWidget *
@@ -1636,6 +1720,38 @@ _gedit_tab_new_from_uri (const gchar         *uri,
 	return GTK_WIDGET (tab);
 }		
 
+/* The document of a dormant tab is loaded the first time the tab is
+ * shown. Until then it is empty, but it already has its uri. */
+GtkWidget *
+_gedit_tab_new_dormant (const gchar         *uri,
+			const GeditEncoding *encoding,
+			gint                 line_pos,
+			gboolean             create)
+{
+	GeditTab *tab;
+
+	g_return_val_if_fail (uri != NULL, NULL);
+
+	tab = GEDIT_TAB (_gedit_tab_new ());
+
+	_gedit_document_set_uri_not_loaded (gedit_tab_get_document (tab), uri);
+
+	tab->priv->dormant = TRUE;
+	tab->priv->tmp_encoding = encoding;
+	tab->priv->tmp_line_pos = line_pos;
+	tab->priv->dormant_create = (create != FALSE);
+
+	return GTK_WIDGET (tab);
+}
+
+gboolean
+_gedit_tab_is_dormant (GeditTab *tab)
+{
+	g_return_val_if_fail (GEDIT_IS_TAB (tab), FALSE);
+
+	return tab->priv->dormant;
+}
+
 /**
  * gedit_tab_get_view:
  * @tab: a #GeditTab
@@ -1729,6 +1845,15 @@ _gedit_tab_get_tooltips	(GeditTab *tab)
 	ruri = 	gedit_utils_replace_home_dir_with_tilde (uri);
 	g_free (uri);
 
+	/* the type and the encoding are not known before loading */
+	if (tab->priv->dormant)
+	{
+		tip = g_markup_printf_escaped ("<b>%s</b> %s", _("Name:"), ruri);
+		g_free (ruri);
+
+		return tip;
+	}
+
 	ruri_markup = g_markup_printf_escaped ("<i>%s</i>", ruri);
 
 	switch (tab->priv->state)
@@ -1962,12 +2087,16 @@ _gedit_tab_get_icon (GeditTab *tab)
 
 		default:
 		{
-			GFile *location;
+			GFile *location = NULL;
 			GeditDocument *doc;
 
 			doc = gedit_tab_get_document (tab);
 
-			location = gedit_document_get_location (doc);
+			/* looking up the icon of a dormant tab would query
+			 * its file */
+			if (!tab->priv->dormant)
+				location = gedit_document_get_location (doc);
+
 			pixbuf = get_icon (theme, location, icon_size);
 
 			if (location)
@@ -2078,6 +2207,7 @@ _gedit_tab_save (GeditTab *tab)
 			  (tab->priv->state == GEDIT_TAB_STATE_SHOWING_PRINT_PREVIEW));
 	g_return_if_fail (tab->priv->tmp_save_uri == NULL);
 	g_return_if_fail (tab->priv->tmp_encoding == NULL);
+	g_return_if_fail (!tab->priv->dormant);
 
 	doc = gedit_tab_get_document (tab);
 	g_return_if_fail (GEDIT_IS_DOCUMENT (doc));
@@ -2192,6 +2322,7 @@ _gedit_tab_save_as (GeditTab            *tab,
 
 	g_return_if_fail (tab->priv->tmp_save_uri == NULL);
 	g_return_if_fail (tab->priv->tmp_encoding == NULL);
+	g_return_if_fail (!tab->priv->dormant);
 
 	doc = gedit_tab_get_document (tab);
 	g_return_if_fail (GEDIT_IS_DOCUMENT (doc));
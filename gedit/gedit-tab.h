@@ -132,6 +132,11 @@ GtkWidget	*_gedit_tab_new_from_uri	(const gchar         *uri,
 						 const GeditEncoding *encoding,
 						 gint                 line_pos,
 						 gboolean             create);
+GtkWidget	*_gedit_tab_new_dormant		(const gchar         *uri,
+						 const GeditEncoding *encoding,
+						 gint                 line_pos,
+						 gboolean             create);
+gboolean	 _gedit_tab_is_dormant		(GeditTab            *tab);
 gchar 		*_gedit_tab_get_name		(GeditTab            *tab);
 gchar 		*_gedit_tab_get_tooltips	(GeditTab            *tab);
 GdkPixbuf 	*_gedit_tab_get_icon		(GeditTab            *tab);
@@ -0,0 +1,568 @@
+/*
+ * gedit-text-search.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <gtksourceview/gtksourceiter.h>
+
+#include "gedit-text-search.h"
+
+/* Segments start small, so that finding a match close to the start
+ * is cheap, and double up to the max size while nothing is found */
+#define MIN_SEGMENT_CHARS 256
+#define MAX_SEGMENT_CHARS (64 * 1024)
+
+struct _GeditTextSearch
+{
+	GtkTextBuffer	    *buffer;
+
+	gchar		    *text;
+	GtkSourceSearchFlags flags;
+
+	/* The bytes we look for, casefolded if the search is not case
+	 * sensitive. NULL if we have to use gtk_source_iter_*_search */
+	gchar		    *needle;
+	gsize		     needle_len;
+	gint		     needle_chars;
+	gsize		     skip[256];
+
+	/* Text of the buffer between two char offsets, kept between
+	 * forward searches and casefolded like the needle */
+	gchar		    *segment;
+	gsize		     segment_len;
+	gint		     segment_start;
+	gint		     segment_end;
+	gint		     segment_chars;
+
+	/* the last offset converted in the segment, to convert the
+	 * next one from there */
+	gint		     last_char;
+	gsize		     last_byte;
+
+	guint		     case_sensitive : 1;
+	guint		     segment_valid : 1;
+	guint		     segment_ascii : 1;
+};
+
+/* Whether the tag table of a buffer has invisible tags, kept on the
+ * table until its tags change */
+#define INVISIBLE_TEXT_KEY "gedit-text-search-invisible-text"
+
+typedef struct
+{
+	gboolean valid;
+	gboolean invisible;
+} InvisibleText;
+
+static void
+check_invisible_tag (GtkTextTag *tag,
+		     gboolean   *invisible)
+{
+	gboolean invisible_set;
+
+	g_object_get (tag, "invisible-set", &invisible_set, NULL);
+
+	if (invisible_set)
+		*invisible = TRUE;
+}
+
+static void
+invalidate_invisible_text (InvisibleText *cache)
+{
+	cache->valid = FALSE;
+}
+
+/* Searching the raw text would find matches in hidden text */
+static gboolean
+has_invisible_text (GtkTextBuffer *buffer)
+{
+	GtkTextTagTable *table;
+	InvisibleText *cache;
+
+	table = gtk_text_buffer_get_tag_table (buffer);
+	cache = g_object_get_data (G_OBJECT (table), INVISIBLE_TEXT_KEY);
+
+	if (cache == NULL)
+	{
+		cache = g_new0 (InvisibleText, 1);
+
+		g_object_set_data_full (G_OBJECT (table),
+					INVISIBLE_TEXT_KEY,
+					cache,
+					g_free);
+
+		/* tag-changed is emitted when any property of a tag is set */
+		g_signal_connect_swapped (table,
+					  "tag-added",
+					  G_CALLBACK (invalidate_invisible_text),
+					  cache);
+		g_signal_connect_swapped (table,
+					  "tag-changed",
+					  G_CALLBACK (invalidate_invisible_text),
+					  cache);
+		g_signal_connect_swapped (table,
+					  "tag-removed",
+					  G_CALLBACK (invalidate_invisible_text),
+					  cache);
+	}
+
+	if (!cache->valid)
+	{
+		cache->invisible = FALSE;
+
+		gtk_text_tag_table_foreach (table,
+					    (GtkTextTagTableForeach) check_invisible_tag,
+					    &cache->invisible);
+
+		cache->valid = TRUE;
+	}
+
+	return cache->invisible;
+}
+
+static gboolean
+is_ascii (const gchar *text)
+{
+	const gchar *p;
+
+	for (p = text; *p != '\0'; p++)
+	{
+		if ((guchar) *p >= 0x80)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* In place, the length does not change */
+static void
+ascii_casefold (gchar *text,
+		gsize  len)
+{
+	gsize i;
+
+	for (i = 0; i < len; i++)
+	{
+		if (text[i] >= 'A' && text[i] <= 'Z')
+			text[i] += 'a' - 'A';
+	}
+}
+
+GeditTextSearch *
+gedit_text_search_new (GtkTextBuffer *buffer,
+		       const gchar   *text,
+		       gboolean       case_sensitive)
+{
+	GeditTextSearch *search;
+	gsize i;
+
+	g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), NULL);
+	g_return_val_if_fail (text != NULL, NULL);
+
+	search = g_slice_new0 (GeditTextSearch);
+
+	search->buffer = buffer;
+	search->text = g_strdup (text);
+	search->case_sensitive = (case_sensitive != FALSE);
+	search->segment_chars = MIN_SEGMENT_CHARS;
+
+	search->flags = GTK_SOURCE_SEARCH_VISIBLE_ONLY | GTK_SOURCE_SEARCH_TEXT_ONLY;
+
+	if (!case_sensitive)
+		search->flags |= GTK_SOURCE_SEARCH_CASE_INSENSITIVE;
+
+	/* Folding ascii text keeps the byte offsets, other needles need
+	 * the real casefolding and normalization done by gtksourceview.
+	 * Some other chars fold to ascii ones too (the kelvin sign to
+	 * "k", the sharp s to "ss"), so the segments that are not ascii
+	 * are also left to gtksourceview when the case is ignored. */
+	if (*text == '\0' ||
+	    (!case_sensitive && !is_ascii (text)) ||
+	    has_invisible_text (buffer))
+	{
+		return search;
+	}
+
+	search->needle = g_strdup (text);
+	search->needle_len = strlen (text);
+	search->needle_chars = g_utf8_strlen (text, -1);
+
+	if (!case_sensitive)
+		ascii_casefold (search->needle, search->needle_len);
+
+	/* Horspool skip table */
+	for (i = 0; i < G_N_ELEMENTS (search->skip); i++)
+		search->skip[i] = search->needle_len;
+
+	for (i = 0; i + 1 < search->needle_len; i++)
+		search->skip[(guchar) search->needle[i]] = search->needle_len - 1 - i;
+
+	return search;
+}
+
+void
+gedit_text_search_free (GeditTextSearch *search)
+{
+	if (search == NULL)
+		return;
+
+	g_free (search->text);
+	g_free (search->needle);
+	g_free (search->segment);
+
+	g_slice_free (GeditTextSearch, search);
+}
+
+void
+gedit_text_search_invalidate (GeditTextSearch *search)
+{
+	g_return_if_fail (search != NULL);
+
+	search->segment_valid = FALSE;
+	search->segment_chars = MIN_SEGMENT_CHARS;
+}
+
+static void
+load_segment (GeditTextSearch *search,
+	      gint             start,
+	      gint             end)
+{
+	GtkTextIter start_iter;
+	GtkTextIter end_iter;
+
+	g_free (search->segment);
+
+	gtk_text_buffer_get_iter_at_offset (search->buffer, &start_iter, start);
+	gtk_text_buffer_get_iter_at_offset (search->buffer, &end_iter, end);
+
+	/* a slice has one char for each offset, even for pixbufs */
+	search->segment = gtk_text_iter_get_slice (&start_iter, &end_iter);
+	search->segment_len = strlen (search->segment);
+	search->segment_start = start;
+	search->segment_end = end;
+	search->segment_ascii = (search->segment_len == (gsize) (end - start));
+	search->segment_valid = TRUE;
+
+	search->last_char = start;
+	search->last_byte = 0;
+
+	if (!search->case_sensitive)
+		ascii_casefold (search->segment, search->segment_len);
+}
+
+static gsize
+char_to_byte (GeditTextSearch *search,
+	      gint             offset)
+{
+	const gchar *p;
+
+	if (search->segment_ascii)
+		return offset - search->segment_start;
+
+	if (offset < search->last_char)
+	{
+		search->last_char = search->segment_start;
+		search->last_byte = 0;
+	}
+
+	p = g_utf8_offset_to_pointer (search->segment + search->last_byte,
+				      offset - search->last_char);
+
+	search->last_char = offset;
+	search->last_byte = p - search->segment;
+
+	return search->last_byte;
+}
+
+static gint
+byte_to_char (GeditTextSearch *search,
+	      gsize            byte)
+{
+	if (search->segment_ascii)
+		return search->segment_start + byte;
+
+	if (byte < search->last_byte)
+	{
+		search->last_char = search->segment_start;
+		search->last_byte = 0;
+	}
+
+	search->last_char += g_utf8_pointer_to_offset (search->segment + search->last_byte,
+						       search->segment + byte);
+	search->last_byte = byte;
+
+	return search->last_char;
+}
+
+/* Returns the byte offset of the first match in the segment after
+ * @from, or -1. The needle is valid utf8, so a match always starts on
+ * a char boundary. */
+static gssize
+find_forward (GeditTextSearch *search,
+	      gsize            from)
+{
+	const guchar *text = (const guchar *) search->segment;
+	const guchar *needle = (const guchar *) search->needle;
+	gsize len = search->segment_len;
+	gsize n = search->needle_len;
+	gsize i;
+
+	if (from + n > len)
+		return -1;
+
+	/* Horspool does not skip much with short needles, while memchr
+	 * is vectorized by the libc */
+	if (n < 4)
+	{
+		const guchar *p = text + from;
+		const guchar *last = text + len - n;
+
+		while (p <= last)
+		{
+			p = memchr (p, needle[0], last - p + 1);
+
+			if (p == NULL)
+				break;
+
+			if (memcmp (p + 1, needle + 1, n - 1) == 0)
+				return p - text;
+
+			p++;
+		}
+
+		return -1;
+	}
+
+	for (i = from; i + n <= len; i += search->skip[text[i + n - 1]])
+	{
+		if (text[i + n - 1] == needle[n - 1] &&
+		    memcmp (text + i, needle, n - 1) == 0)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static gssize
+find_backward (GeditTextSearch *search)
+{
+	gssize found = -1;
+	gssize next;
+
+	while ((next = find_forward (search, found + 1)) != -1)
+		found = next;
+
+	return found;
+}
+
+static void
+set_match (GeditTextSearch *search,
+	   gint             start,
+	   GtkTextIter     *match_start,
+	   GtkTextIter     *match_end)
+{
+	if (match_start != NULL)
+		gtk_text_buffer_get_iter_at_offset (search->buffer,
+						    match_start,
+						    start);
+
+	if (match_end != NULL)
+		gtk_text_buffer_get_iter_at_offset (search->buffer,
+						    match_end,
+						    start + search->needle_chars);
+}
+
+gboolean
+gedit_text_search_forward (GeditTextSearch   *search,
+			   const GtkTextIter *iter,
+			   const GtkTextIter *limit,
+			   GtkTextIter       *match_start,
+			   GtkTextIter       *match_end)
+{
+	gint pos;
+	gint lim;
+	gint n;
+	gboolean reuse;
+
+	g_return_val_if_fail (search != NULL, FALSE);
+	g_return_val_if_fail (iter != NULL, FALSE);
+
+	if (search->needle == NULL)
+		return gtk_source_iter_forward_search (iter,
+						       search->text,
+						       search->flags,
+						       match_start,
+						       match_end,
+						       limit);
+
+	n = search->needle_chars;
+	pos = gtk_text_iter_get_offset (iter);
+
+	if (limit != NULL)
+		lim = gtk_text_iter_get_offset (limit);
+	else
+		lim = gtk_text_buffer_get_char_count (search->buffer);
+
+	/* searching for the next match usually starts in the segment
+	 * where the previous one was found */
+	reuse = search->segment_valid &&
+		pos >= search->segment_start &&
+		pos < search->segment_end;
+
+	while (TRUE)
+	{
+		gssize found;
+
+		if (!reuse)
+		{
+			if (pos + n > lim)
+				return FALSE;
+
+			load_segment (search,
+				      pos,
+				      MIN (lim, pos + search->segment_chars + n - 1));
+
+			search->segment_chars = MIN (search->segment_chars * 2,
+						     MAX_SEGMENT_CHARS);
+		}
+
+		reuse = FALSE;
+
+		if (!search->case_sensitive && !search->segment_ascii)
+		{
+			GtkTextIter from;
+
+			/* no match starts before pos */
+			gtk_text_buffer_get_iter_at_offset (search->buffer, &from, pos);
+
+			return gtk_source_iter_forward_search (&from,
+							       search->text,
+							       search->flags,
+							       match_start,
+							       match_end,
+							       limit);
+		}
+
+		found = find_forward (search, char_to_byte (search, pos));
+
+		if (found != -1)
+		{
+			gint start;
+
+			start = byte_to_char (search, found);
+
+			/* the segment may come from a search with a
+			 * farther limit */
+			if (start + n > lim)
+				return FALSE;
+
+			set_match (search, start, match_start, match_end);
+
+			return TRUE;
+		}
+
+		if (search->segment_end >= lim)
+			return FALSE;
+
+		/* a match across the end of the segment starts in its
+		 * last n - 1 chars */
+		pos = MAX (pos, search->segment_end - n + 1);
+	}
+}
+
+gboolean
+gedit_text_search_backward (GeditTextSearch   *search,
+			    const GtkTextIter *iter,
+			    const GtkTextIter *limit,
+			    GtkTextIter       *match_start,
+			    GtkTextIter       *match_end)
+{
+	gint pos;
+	gint lim;
+	gint n;
+	gint chars = MIN_SEGMENT_CHARS;
+
+	g_return_val_if_fail (search != NULL, FALSE);
+	g_return_val_if_fail (iter != NULL, FALSE);
+
+	if (search->needle == NULL)
+		return gtk_source_iter_backward_search (iter,
+							search->text,
+							search->flags,
+							match_start,
+							match_end,
+							limit);
+
+	n = search->needle_chars;
+	pos = gtk_text_iter_get_offset (iter);
+	lim = (limit != NULL) ? gtk_text_iter_get_offset (limit) : 0;
+
+	while (pos - n >= lim)
+	{
+		gssize found;
+		gint start;
+
+		start = MAX (lim, pos - chars - n + 1);
+		load_segment (search, start, pos);
+
+		if (!search->case_sensitive && !search->segment_ascii)
+		{
+			GtkTextIter from;
+
+			/* no match ends after pos */
+			gtk_text_buffer_get_iter_at_offset (search->buffer, &from, pos);
+
+			return gtk_source_iter_backward_search (&from,
+								search->text,
+								search->flags,
+								match_start,
+								match_end,
+								limit);
+		}
+
+		found = find_backward (search);
+
+		if (found != -1)
+		{
+			set_match (search,
+				   byte_to_char (search, found),
+				   match_start,
+				   match_end);
+
+			return TRUE;
+		}
+
+		if (start == lim)
+			return FALSE;
+
+		pos = start + n - 1;
+		chars = MIN (chars * 2, MAX_SEGMENT_CHARS);
+	}
+
+	return FALSE;
+}
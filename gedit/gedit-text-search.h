@@ -0,0 +1,60 @@
+/*
+ * gedit-text-search.h
+ * This file is part of gedit
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GEDIT_TEXT_SEARCH_H__
+#define __GEDIT_TEXT_SEARCH_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/* Searches a text in a buffer. The buffer text is copied in segments
+ * and scanned as flat utf8, matches are turned into GtkTextIters only
+ * when found. Gives the same results as gtk_source_iter_forward_search
+ * with GTK_SOURCE_SEARCH_VISIBLE_ONLY | GTK_SOURCE_SEARCH_TEXT_ONLY,
+ * which is used instead when the text cannot be searched as bytes. */
+typedef struct _GeditTextSearch		GeditTextSearch;
+
+GeditTextSearch	*gedit_text_search_new		(GtkTextBuffer     *buffer,
+						 const gchar       *text,
+						 gboolean           case_sensitive);
+
+void		 gedit_text_search_free		(GeditTextSearch   *search);
+
+/* Must be called when the buffer text changes between two searches */
+void		 gedit_text_search_invalidate	(GeditTextSearch   *search);
+
+gboolean	 gedit_text_search_forward	(GeditTextSearch   *search,
+						 const GtkTextIter *iter,
+						 const GtkTextIter *limit,
+						 GtkTextIter       *match_start,
+						 GtkTextIter       *match_end);
+
+gboolean	 gedit_text_search_backward	(GeditTextSearch   *search,
+						 const GtkTextIter *iter,
+						 const GtkTextIter *limit,
+						 GtkTextIter       *match_start,
+						 GtkTextIter       *match_end);
+
+G_END_DECLS
+
+#endif /* __GEDIT_TEXT_SEARCH_H__ */
@@ -80,7 +80,8 @@ struct _GeditWindowPrivate
 	GtkActionGroup *panes_action_group;
 	GtkActionGroup *languages_action_group;
 	GtkActionGroup *documents_list_action_group;
-	guint           documents_list_menu_ui_id;
+	GArray         *documents_list_menu_ui_ids;
+	GPtrArray      *documents_list_tabs;
 	GtkWidget      *toolbar;
 	GtkWidget      *toolbar_recent_menu;
 	GtkWidget      *menubar;
@@ -111,6 +112,9 @@ struct _GeditWindowPrivate
 
 	GFile          *default_location;
 
+	/* GFile -> GeditTab of the documents that have a location */
+	GHashTable     *tabs_by_location;
+
 	gboolean        removing_tabs : 1;
 	gboolean        dispose_has_run : 1;
 
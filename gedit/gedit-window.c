@@ -56,6 +56,7 @@
 #include "gedit-enum-types.h"
 #include "gedit-dirs.h"
 #include "gedit-status-combo-box.h"
+#include "gedit-column-tracker.h"
 
 #ifdef OS_OSX
 #include "osx/gedit-osx.h"
@@ -65,6 +66,8 @@
 #define GEDIT_UIFILE "gedit-ui.xml"
 #define TAB_WIDTH_DATA "GeditWindowTabWidthData"
 #define LANGUAGE_DATA "GeditWindowLanguageData"
+#define COLUMN_TRACKER_KEY "GeditWindowColumnTracker"
+#define TAB_LOCATION_KEY "GeditWindowTabLocation"
 #define FULLSCREEN_ANIMATION_SPEED 4
 
 #define GEDIT_WINDOW_GET_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE ((object),\
@@ -295,6 +298,13 @@ gedit_window_dispose (GObject *object)
 	G_OBJECT_CLASS (gedit_window_parent_class)->dispose (object);
 }
 
+static void
+free_tabs_list (GFile  *location,
+		GSList *tabs)
+{
+	g_slist_free (tabs);
+}
+
 static void
 gedit_window_finalize (GObject *object)
 {
@@ -307,6 +317,13 @@ gedit_window_finalize (GObject *object)
 	if (window->priv->default_location != NULL)
 		g_object_unref (window->priv->default_location);
 
+	g_array_free (window->priv->documents_list_menu_ui_ids, TRUE);
+	g_ptr_array_free (window->priv->documents_list_tabs, TRUE);
+	g_hash_table_foreach (window->priv->tabs_by_location,
+			      (GHFunc) free_tabs_list,
+			      NULL);
+	g_hash_table_destroy (window->priv->tabs_by_location);
+
 	G_OBJECT_CLASS (gedit_window_parent_class)->finalize (object);
 }
 
@@ -665,12 +682,13 @@ received_clipboard_contents (GtkClipboard     *clipboard,
 	if (window->priv->active_tab != NULL)
 	{
 		GeditTabState state;
-		gboolean state_normal;
+		gboolean editing_allowed;
 
 		state = gedit_tab_get_state (window->priv->active_tab);
-		state_normal = (state == GEDIT_TAB_STATE_NORMAL);
+		editing_allowed = (state == GEDIT_TAB_STATE_NORMAL) ||
+				  (state == GEDIT_TAB_STATE_SAVING);
 
-		sens = state_normal &&
+		sens = editing_allowed &&
 		       gtk_selection_data_targets_include_text (selection_data);
 	}
 	else
@@ -723,6 +741,7 @@ set_sensitivity_according_to_tab (GeditWindow *window,
 	GtkAction     *action;
 	gboolean       b;
 	gboolean       state_normal;
+	gboolean       editing_allowed;
 	gboolean       editable;
 	GeditTabState  state;
 	GtkClipboard  *clipboard;
@@ -737,6 +756,10 @@ set_sensitivity_according_to_tab (GeditWindow *window,
 	state = gedit_tab_get_state (tab);
 	state_normal = (state == GEDIT_TAB_STATE_NORMAL);
 
+	/* the document is saved from a snapshot, so it can be
+	 * edited meanwhile */
+	editing_allowed = state_normal || (state == GEDIT_TAB_STATE_SAVING);
+
 	view = gedit_tab_get_view (tab);
 	editable = gtk_text_view_get_editable (GTK_TEXT_VIEW (view));
 
@@ -797,19 +820,19 @@ set_sensitivity_according_to_tab (GeditWindow *window,
 	action = gtk_action_group_get_action (window->priv->action_group,
 					      "EditUndo");
 	gtk_action_set_sensitive (action, 
-				  state_normal &&
+				  editing_allowed &&
 				  gtk_source_buffer_can_undo (GTK_SOURCE_BUFFER (doc)));
 
 	action = gtk_action_group_get_action (window->priv->action_group,
 					      "EditRedo");
 	gtk_action_set_sensitive (action, 
-				  state_normal &&
+				  editing_allowed &&
 				  gtk_source_buffer_can_redo (GTK_SOURCE_BUFFER (doc)));
 
 	action = gtk_action_group_get_action (window->priv->action_group,
 					      "EditCut");
 	gtk_action_set_sensitive (action,
-				  state_normal &&
+				  editing_allowed &&
 				  editable &&
 				  gtk_text_buffer_get_has_selection (GTK_TEXT_BUFFER (doc)));
 
@@ -822,7 +845,7 @@ set_sensitivity_according_to_tab (GeditWindow *window,
 				  
 	action = gtk_action_group_get_action (window->priv->action_group,
 					      "EditPaste");
-	if (state_normal && editable)
+	if (editing_allowed && editable)
 	{
 		set_paste_sensitivity_according_to_clipboard (window,
 							      clipboard);
@@ -835,7 +858,7 @@ set_sensitivity_according_to_tab (GeditWindow *window,
 	action = gtk_action_group_get_action (window->priv->action_group,
 					      "EditDelete");
 	gtk_action_set_sensitive (action,
-				  state_normal &&
+				  editing_allowed &&
 				  editable &&
 				  gtk_text_buffer_get_has_selection (GTK_TEXT_BUFFER (doc)));
 
@@ -1700,105 +1723,204 @@ get_menu_tip_for_tab (GeditTab *tab)
 }
 
 static void
-update_documents_list_menu (GeditWindow *window)
+sync_documents_list_item (GeditWindow *window,
+			  GeditTab    *tab,
+			  gint         n)
+{
+	GtkAction *action;
+	gchar *action_name;
+	gchar *tab_name;
+	gchar *escaped_name;
+	gchar *tip;
+
+	action_name = g_strdup_printf ("Tab_%d", n);
+	action = gtk_action_group_get_action (window->priv->documents_list_action_group,
+					      action_name);
+	g_free (action_name);
+
+	g_return_if_fail (action != NULL);
+
+	tab_name = _gedit_tab_get_name (tab);
+	escaped_name = gedit_utils_escape_underscores (tab_name, -1);
+	tip =  get_menu_tip_for_tab (tab);
+
+	g_object_set (action, "label", escaped_name, NULL);
+	g_object_set (action, "tooltip", tip, NULL);
+
+	g_free (tab_name);
+	g_free (escaped_name);
+	g_free (tip);
+}
+
+static void
+add_documents_list_item (GeditWindow *window)
 {
 	GeditWindowPrivate *p = window->priv;
-	GList *actions, *l;
-	gint n, i;
+	GtkRadioAction *action;
+	GtkAction *first;
+	gchar *action_name;
+	gchar *accel;
 	guint id;
-	GSList *group = NULL;
+	gint i;
 
-	gedit_debug (DEBUG_WINDOW);
+	i = p->documents_list_menu_ui_ids->len;
 
-	g_return_if_fail (p->documents_list_action_group != NULL);
+	/* NOTE: the action is associated to the position of the tab in
+	 * the notebook not to the tab itself! This is needed to work
+	 * around the gtk+ bug #170727: gtk leaves around the accels
+	 * of the action. Since the accel depends on the tab position
+	 * the problem is worked around, action with the same name always
+	 * get the same accel.
+	 */
+	action_name = g_strdup_printf ("Tab_%d", i);
 
-	if (p->documents_list_menu_ui_id != 0)
-		gtk_ui_manager_remove_ui (p->manager,
-					  p->documents_list_menu_ui_id);
+	/* alt + 1, 2, 3... 0 to switch to the first ten tabs */
+	accel = (i < 10) ? g_strdup_printf ("<alt>%d", (i + 1) % 10) : NULL;
 
-	actions = gtk_action_group_list_actions (p->documents_list_action_group);
-	for (l = actions; l != NULL; l = l->next)
+	/* the label and the tip are set by sync_documents_list_item */
+	action = gtk_radio_action_new (action_name,
+				       NULL,
+				       NULL,
+				       NULL,
+				       i);
+
+	first = gtk_action_group_get_action (p->documents_list_action_group,
+					     "Tab_0");
+	if (first != NULL)
+		gtk_radio_action_set_group (action,
+					    gtk_radio_action_get_group (GTK_RADIO_ACTION (first)));
+
+	gtk_action_group_add_action_with_accel (p->documents_list_action_group,
+						GTK_ACTION (action),
+						accel);
+
+	g_signal_connect (action,
+			  "activate",
+			  G_CALLBACK (documents_list_menu_activate),
+			  window);
+
+	/* each item has its own merge id, so that it can be removed
+	 * without rebuilding the others */
+	id = gtk_ui_manager_new_merge_id (p->manager);
+
+	gtk_ui_manager_add_ui (p->manager,
+			       id,
+			       "/MenuBar/DocumentsMenu/DocumentsListPlaceholder",
+			       action_name, action_name,
+			       GTK_UI_MANAGER_MENUITEM,
+			       FALSE);
+
+	g_array_append_val (p->documents_list_menu_ui_ids, id);
+	g_ptr_array_add (p->documents_list_tabs, NULL);
+
+	g_object_unref (action);
+
+	g_free (action_name);
+	g_free (accel);
+}
+
+static void
+remove_documents_list_item (GeditWindow *window)
+{
+	GeditWindowPrivate *p = window->priv;
+	GtkAction *action;
+	gchar *action_name;
+	guint i;
+
+	i = p->documents_list_menu_ui_ids->len - 1;
+
+	gtk_ui_manager_remove_ui (p->manager,
+				  g_array_index (p->documents_list_menu_ui_ids, guint, i));
+
+	action_name = g_strdup_printf ("Tab_%d", i);
+	action = gtk_action_group_get_action (p->documents_list_action_group,
+					      action_name);
+	g_free (action_name);
+
+	if (action != NULL)
 	{
-		g_signal_handlers_disconnect_by_func (GTK_ACTION (l->data),
+		g_signal_handlers_disconnect_by_func (action,
 						      G_CALLBACK (documents_list_menu_activate),
 						      window);
- 		gtk_action_group_remove_action (p->documents_list_action_group,
-						GTK_ACTION (l->data));
+		gtk_action_group_remove_action (p->documents_list_action_group,
+						action);
 	}
-	g_list_free (actions);
-
-	n = gtk_notebook_get_n_pages (GTK_NOTEBOOK (p->notebook));
 
-	id = (n > 0) ? gtk_ui_manager_new_merge_id (p->manager) : 0;
+	g_array_set_size (p->documents_list_menu_ui_ids, i);
+	g_ptr_array_set_size (p->documents_list_tabs, i);
+}
 
-	for (i = 0; i < n; i++)
-	{
-		GtkWidget *tab;
-		GtkRadioAction *action;
-		gchar *action_name;
-		gchar *tab_name;
-		gchar *name;
-		gchar *tip;
-		gchar *accel;
+/* Only the items whose position changed are synced, so that opening or
+ * closing a tab does not rebuild the whole menu */
+static void
+update_documents_list_menu (GeditWindow *window)
+{
+	GeditWindowPrivate *p = window->priv;
+	GList *tabs, *l;
+	gint active = -1;
+	gint n, i;
 
-		tab = gtk_notebook_get_nth_page (GTK_NOTEBOOK (p->notebook), i);
+	gedit_debug (DEBUG_WINDOW);
 
-		/* NOTE: the action is associated to the position of the tab in
-		 * the notebook not to the tab itself! This is needed to work
-		 * around the gtk+ bug #170727: gtk leaves around the accels
-		 * of the action. Since the accel depends on the tab position
-		 * the problem is worked around, action with the same name always
-		 * get the same accel.
-		 */
-		action_name = g_strdup_printf ("Tab_%d", i);
-		tab_name = _gedit_tab_get_name (GEDIT_TAB (tab));
-		name = gedit_utils_escape_underscores (tab_name, -1);
-		tip =  get_menu_tip_for_tab (GEDIT_TAB (tab));
+	g_return_if_fail (p->documents_list_action_group != NULL);
 
-		/* alt + 1, 2, 3... 0 to switch to the first ten tabs */
-		accel = (i < 10) ? g_strdup_printf ("<alt>%d", (i + 1) % 10) : NULL;
+	n = gtk_notebook_get_n_pages (GTK_NOTEBOOK (p->notebook));
 
-		action = gtk_radio_action_new (action_name,
-					       name,
-					       tip,
-					       NULL,
-					       i);
+	while (p->documents_list_menu_ui_ids->len > (guint) n)
+		remove_documents_list_item (window);
 
-		if (group != NULL)
-			gtk_radio_action_set_group (action, group);
+	while (p->documents_list_menu_ui_ids->len < (guint) n)
+		add_documents_list_item (window);
 
-		/* note that group changes each time we add an action, so it must be updated */
-		group = gtk_radio_action_get_group (action);
+	tabs = gtk_container_get_children (GTK_CONTAINER (p->notebook));
 
-		gtk_action_group_add_action_with_accel (p->documents_list_action_group,
-							GTK_ACTION (action),
-							accel);
+	for (l = tabs, i = 0; l != NULL; l = g_list_next (l), i++)
+	{
+		GeditTab *tab = GEDIT_TAB (l->data);
 
-		g_signal_connect (action,
-				  "activate",
-				  G_CALLBACK (documents_list_menu_activate),
-				  window);
+		if (g_ptr_array_index (p->documents_list_tabs, i) != tab)
+		{
+			sync_documents_list_item (window, tab, i);
+			g_ptr_array_index (p->documents_list_tabs, i) = tab;
+		}
 
-		gtk_ui_manager_add_ui (p->manager,
-				       id,
-				       "/MenuBar/DocumentsMenu/DocumentsListPlaceholder",
-				       action_name, action_name,
-				       GTK_UI_MANAGER_MENUITEM,
-				       FALSE);
+		if (tab == p->active_tab)
+			active = i;
+	}
 
-		if (GEDIT_TAB (tab) == p->active_tab)
-			gtk_toggle_action_set_active (GTK_TOGGLE_ACTION (action), TRUE);
+	g_list_free (tabs);
 
-		g_object_unref (action);
+	if (active != -1)
+	{
+		GtkAction *action;
+		gchar *action_name;
 
+		action_name = g_strdup_printf ("Tab_%d", active);
+		action = gtk_action_group_get_action (p->documents_list_action_group,
+						      action_name);
 		g_free (action_name);
-		g_free (tab_name);
-		g_free (name);
-		g_free (tip);
-		g_free (accel);
+
+		gtk_toggle_action_set_active (GTK_TOGGLE_ACTION (action), TRUE);
 	}
+}
+
+/* Forgets @tab in the documents list menu, so that a new tab allocated
+ * at the same address is not taken for it */
+static void
+forget_documents_list_tab (GeditWindow *window,
+			   GeditTab    *tab)
+{
+	GPtrArray *tabs = window->priv->documents_list_tabs;
+	guint i;
 
-	p->documents_list_menu_ui_id = id;
+	for (i = 0; i < tabs->len; i++)
+	{
+		if (g_ptr_array_index (tabs, i) == tab)
+		{
+			g_ptr_array_index (tabs, i) = NULL;
+			break;
+		}
+	}
 }
 
 /* Returns TRUE if status bar is visible */
@@ -2131,9 +2253,9 @@ update_cursor_position_statusbar (GtkTextBuffer *buffer,
 {
 	gint row, col;
 	GtkTextIter iter;
-	GtkTextIter start;
 	guint tab_size;
 	GeditView *view;
+	GeditColumnTracker *tracker;
 
 	gedit_debug (DEBUG_WINDOW);
   
@@ -2147,24 +2269,21 @@ update_cursor_position_statusbar (GtkTextBuffer *buffer,
 					  gtk_text_buffer_get_insert (buffer));
 	
 	row = gtk_text_iter_get_line (&iter);
-	
-	start = iter;
-	gtk_text_iter_set_line_offset (&start, 0);
-	col = 0;
-
-	tab_size = gtk_source_view_get_tab_width (GTK_SOURCE_VIEW (view));
 
-	while (!gtk_text_iter_equal (&start, &iter))
+	tracker = g_object_get_data (G_OBJECT (buffer), COLUMN_TRACKER_KEY);
+	if (tracker == NULL)
 	{
-		/* FIXME: Are we Unicode compliant here? */
-		if (gtk_text_iter_get_char (&start) == '\t')
-					
-			col += (tab_size - (col  % tab_size));
-		else
-			++col;
-
-		gtk_text_iter_forward_char (&start);
+		tracker = gedit_column_tracker_new (buffer);
+		g_object_set_data_full (G_OBJECT (buffer),
+					COLUMN_TRACKER_KEY,
+					tracker,
+					(GDestroyNotify) gedit_column_tracker_free);
 	}
+
+	tab_size = gtk_source_view_get_tab_width (GTK_SOURCE_VIEW (view));
+
+	/* FIXME: Are we Unicode compliant here? */
+	col = gedit_column_tracker_get_column (tracker, &iter, tab_size);
 	
 	gedit_statusbar_set_cursor_position (
 				GEDIT_STATUSBAR (window->priv->statusbar),
@@ -2754,10 +2873,6 @@ sync_name (GeditTab    *tab,
 	   GeditWindow *window)
 {
 	GtkAction *action;
-	gchar *action_name;
-	gchar *tab_name;
-	gchar *escaped_name;
-	gchar *tip;
 	gint n;
 	GeditDocument *doc;
 
@@ -2775,22 +2890,7 @@ sync_name (GeditTab    *tab,
 	/* sync the item in the documents list menu */
 	n = gtk_notebook_page_num (GTK_NOTEBOOK (window->priv->notebook),
 				   GTK_WIDGET (tab));
-	action_name = g_strdup_printf ("Tab_%d", n);
-	action = gtk_action_group_get_action (window->priv->documents_list_action_group,
-					      action_name);
-	g_return_if_fail (action != NULL);
-
-	tab_name = _gedit_tab_get_name (tab);
-	escaped_name = gedit_utils_escape_underscores (tab_name, -1);
-	tip =  get_menu_tip_for_tab (tab);
-
-	g_object_set (action, "label", escaped_name, NULL);
-	g_object_set (action, "tooltip", tip, NULL);
-
-	g_free (action_name);
-	g_free (tab_name);
-	g_free (escaped_name);
-	g_free (tip);
+	sync_documents_list_item (window, tab, n);
 
 	gedit_plugins_engine_update_plugins_ui (gedit_plugins_engine_get_default (),
 						 window);
@@ -3151,6 +3251,7 @@ selection_changed (GeditDocument *doc,
 	GtkAction *action;
 	GeditTabState state;
 	gboolean state_normal;
+	gboolean editing_allowed;
 	gboolean editable;
 
 	gedit_debug (DEBUG_WINDOW);
@@ -3161,6 +3262,7 @@ selection_changed (GeditDocument *doc,
 	tab = gedit_tab_get_from_document (doc);
 	state = gedit_tab_get_state (tab);
 	state_normal = (state == GEDIT_TAB_STATE_NORMAL);
+	editing_allowed = state_normal || (state == GEDIT_TAB_STATE_SAVING);
 
 	view = gedit_tab_get_view (tab);
 	editable = gtk_text_view_get_editable (GTK_TEXT_VIEW (view));
@@ -3168,7 +3270,7 @@ selection_changed (GeditDocument *doc,
 	action = gtk_action_group_get_action (window->priv->action_group,
 					      "EditCut");
 	gtk_action_set_sensitive (action,
-				  state_normal &&
+				  editing_allowed &&
 				  editable &&
 				  gtk_text_buffer_get_has_selection (GTK_TEXT_BUFFER (doc)));
 
@@ -3182,7 +3284,7 @@ selection_changed (GeditDocument *doc,
 	action = gtk_action_group_get_action (window->priv->action_group,
 					      "EditDelete");
 	gtk_action_set_sensitive (action,
-				  state_normal &&
+				  editing_allowed &&
 				  editable &&
 				  gtk_text_buffer_get_has_selection (GTK_TEXT_BUFFER (doc)));
 
@@ -3243,6 +3345,66 @@ update_sensitivity_according_to_open_tabs (GeditWindow *window)
 #endif
 }
 
+static void
+unindex_tab_location (GeditWindow *window,
+		      GeditTab    *tab)
+{
+	GFile *location;
+	GSList *tabs;
+
+	location = g_object_get_data (G_OBJECT (tab), TAB_LOCATION_KEY);
+	if (location == NULL)
+		return;
+
+	tabs = g_hash_table_lookup (window->priv->tabs_by_location, location);
+	tabs = g_slist_remove (tabs, tab);
+
+	if (tabs != NULL)
+		g_hash_table_insert (window->priv->tabs_by_location,
+				     g_object_ref (location),
+				     tabs);
+	else
+		g_hash_table_remove (window->priv->tabs_by_location, location);
+
+	g_object_set_data (G_OBJECT (tab), TAB_LOCATION_KEY, NULL);
+}
+
+/* The same location can be open in more than one tab, e.g. when a tab
+ * is dragged from another window, so each location maps to a list */
+static void
+index_tab_location (GeditWindow *window,
+		    GeditTab    *tab)
+{
+	GFile *location;
+	GSList *tabs;
+
+	unindex_tab_location (window, tab);
+
+	location = gedit_document_get_location (gedit_tab_get_document (tab));
+	if (location == NULL)
+		return;
+
+	tabs = g_hash_table_lookup (window->priv->tabs_by_location, location);
+	tabs = g_slist_append (tabs, tab);
+
+	g_hash_table_insert (window->priv->tabs_by_location,
+			     g_object_ref (location),
+			     tabs);
+
+	g_object_set_data_full (G_OBJECT (tab),
+				TAB_LOCATION_KEY,
+				location,
+				(GDestroyNotify) g_object_unref);
+}
+
+static void
+sync_location (GeditDocument *doc,
+	       GParamSpec    *pspec,
+	       GeditWindow   *window)
+{
+	index_tab_location (window, gedit_tab_get_from_document (doc));
+}
+
 static void
 notebook_tab_added (GeditNotebook *notebook,
 		    GeditTab      *tab,
@@ -3302,6 +3464,10 @@ notebook_tab_added (GeditNotebook *notebook,
 			  "notify::read-only",
 			  G_CALLBACK (readonly_changed),
 			  window);
+	g_signal_connect (doc,
+			  "notify::uri",
+			  G_CALLBACK (sync_location),
+			  window);
 	g_signal_connect (view,
 			  "toggle_overwrite",
 			  G_CALLBACK (update_overwrite_mode_statusbar),
@@ -3311,6 +3477,7 @@ notebook_tab_added (GeditNotebook *notebook,
 			  G_CALLBACK (editable_changed),
 			  window);
 
+	index_tab_location (window, tab);
 	update_documents_list_menu (window);
 	
 	g_signal_connect (view,
@@ -3367,6 +3534,9 @@ notebook_tab_removed (GeditNotebook *notebook,
 	g_signal_handlers_disconnect_by_func (doc,
 					      G_CALLBACK (readonly_changed),
 					      window);
+	g_signal_handlers_disconnect_by_func (doc,
+					      G_CALLBACK (sync_location),
+					      window);
 	g_signal_handlers_disconnect_by_func (view, 
 					      G_CALLBACK (update_overwrite_mode_statusbar),
 					      window);
@@ -3395,6 +3565,9 @@ notebook_tab_removed (GeditNotebook *notebook,
 		window->priv->language_changed_id = 0;
 	}
 
+	unindex_tab_location (window, tab);
+	forget_documents_list_tab (window, tab);
+
 	g_return_if_fail (window->priv->num_tabs >= 0);
 	if (window->priv->num_tabs == 0)
 	{
@@ -3899,6 +4072,13 @@ gedit_window_init (GeditWindow *window)
 	window->priv->fullscreen_controls = NULL;
 	window->priv->fullscreen_animation_timeout_id = 0;
 
+	window->priv->documents_list_menu_ui_ids = g_array_new (FALSE, FALSE, sizeof (guint));
+	window->priv->documents_list_tabs = g_ptr_array_new ();
+	window->priv->tabs_by_location = g_hash_table_new_full (g_file_hash,
+								(GEqualFunc) g_file_equal,
+								g_object_unref,
+								NULL);
+
 	window->priv->message_bus = gedit_message_bus_new ();
 
 	window->priv->window_group = gtk_window_group_new ();
@@ -4143,6 +4323,30 @@ gedit_window_create_tab (GeditWindow *window,
 	return tab;
 }
 
+static GeditTab *
+add_tab (GeditWindow *window,
+	 GtkWidget   *tab,
+	 gboolean     jump_to)
+{
+	if (tab == NULL)
+		return NULL;
+
+	gtk_widget_show (tab);	
+	
+	gedit_notebook_add_tab (GEDIT_NOTEBOOK (window->priv->notebook),
+				GEDIT_TAB (tab),
+				-1,
+				jump_to);
+
+
+	if (!GTK_WIDGET_VISIBLE (window))
+	{
+		gtk_window_present (GTK_WINDOW (window));
+	}
+
+	return GEDIT_TAB (tab);
+}
+
 /**
  * gedit_window_create_tab_from_uri:
  * @window: a #GeditWindow
@@ -4176,24 +4380,31 @@ gedit_window_create_tab_from_uri (GeditWindow         *window,
 				       encoding,
 				       line_pos,
 				       create);	
-	if (tab == NULL)
-		return NULL;
 
-	gtk_widget_show (tab);	
-	
-	gedit_notebook_add_tab (GEDIT_NOTEBOOK (window->priv->notebook),
-				GEDIT_TAB (tab),
-				-1,
-				jump_to);
+	return add_tab (window, tab, jump_to);
+}				  
+
+/* Like gedit_window_create_tab_from_uri, but the document is only
+ * loaded when the tab is shown, see _gedit_tab_new_dormant */
+GeditTab *
+_gedit_window_create_dormant_tab (GeditWindow         *window,
+				  const gchar         *uri,
+				  const GeditEncoding *encoding,
+				  gint                 line_pos,
+				  gboolean             create)
+{
+	GtkWidget *tab;
 
+	g_return_val_if_fail (GEDIT_IS_WINDOW (window), NULL);
+	g_return_val_if_fail (uri != NULL, NULL);
 
-	if (!GTK_WIDGET_VISIBLE (window))
-	{
-		gtk_window_present (GTK_WINDOW (window));
-	}
+	tab = _gedit_tab_new_dormant (uri,
+				      encoding,
+				      line_pos,
+				      create);
 
-	return GEDIT_TAB (tab);
-}				  
+	return add_tab (window, tab, FALSE);
+}
 
 /**
  * gedit_window_get_active_tab:
@@ -4698,43 +4909,14 @@ GeditTab *
 gedit_window_get_tab_from_location (GeditWindow *window,
 				    GFile       *location)
 {
-	GList *tabs;
-	GList *l;
-	GeditTab *ret = NULL;
+	GSList *tabs;
 
 	g_return_val_if_fail (GEDIT_IS_WINDOW (window), NULL);
 	g_return_val_if_fail (G_IS_FILE (location), NULL);
 
-	tabs = gtk_container_get_children (GTK_CONTAINER (window->priv->notebook));
-	
-	for (l = tabs; l != NULL; l = g_list_next (l))
-	{
-		GeditDocument *d;
-		GeditTab *t;
-		GFile *f;
-
-		t = GEDIT_TAB (l->data);
-		d = gedit_tab_get_document (t);
-
-		f = gedit_document_get_location (d);
+	tabs = g_hash_table_lookup (window->priv->tabs_by_location, location);
 
-		if ((f != NULL))
-		{
-			gboolean found = g_file_equal (location, f);
-
-			g_object_unref (f);
-
-			if (found)
-			{
-				ret = t;
-				break;
-			}
-		}
-	}
-	
-	g_list_free (tabs);
-	
-	return ret;
+	return (tabs != NULL) ? GEDIT_TAB (tabs->data) : NULL;
 }
 
 /**
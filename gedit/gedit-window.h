@@ -169,6 +169,12 @@ GeditWindow	*_gedit_window_move_tab_to_new_window	(GeditWindow         *window,
 							 GeditTab            *tab);
 gboolean	 _gedit_window_is_removing_tabs		(GeditWindow         *window);
 
+GeditTab	*_gedit_window_create_dormant_tab	(GeditWindow         *window,
+							 const gchar         *uri,
+							 const GeditEncoding *encoding,
+							 gint                 line_pos,
+							 gboolean             create);
+
 GFile		*_gedit_window_get_default_location 	(GeditWindow         *window);
 
 void		 _gedit_window_set_default_location 	(GeditWindow         *window,
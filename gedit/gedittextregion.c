@@ -47,9 +47,14 @@ typedef struct _Subregion {
 	GtkTextMark *end;
 } Subregion;
 
+/* The subregions are kept sorted in a GSequence, which is a balanced
+ * tree: lookups, insertions and removals are O(log n). The marks move
+ * with the text but never cross each other, so the order of the
+ * subregions stays valid across buffer changes even if their offsets
+ * do not. */
 struct _GeditTextRegion {
 	GtkTextBuffer *buffer;
-	GList         *subregions;
+	GSequence     *subregions;
 	guint32        time_stamp;
 };
 
@@ -59,60 +64,148 @@ struct _GeditTextRegionIteratorReal {
 	GeditTextRegion *region;
 	guint32        region_time_stamp;
 	
-	GList         *subregions;
+	GSequenceIter *subregions;
 };
 
+typedef struct _Probe {
+	GeditTextRegion   *region;
+	const GtkTextIter *iter;
+	gboolean           leftmost;
+	gboolean           include_edges;
+} Probe;
+
 
 /* ----------------------------------------------------------------------
    Private interface
    ---------------------------------------------------------------------- */
 
+/* Returns > 0 if the subregion is past the one we are looking for */
+static gint
+compare_subregion_with_probe (Subregion *sr,
+			      Probe     *probe)
+{
+	GtkTextIter sr_iter;
+	gint cmp;
+
+	if (!probe->leftmost) {
+		gtk_text_buffer_get_iter_at_mark (probe->region->buffer, &sr_iter, sr->end);
+		cmp = gtk_text_iter_compare (probe->iter, &sr_iter);
+		if (cmp < 0 || (cmp == 0 && probe->include_edges))
+			return 1;
+
+	} else {
+		gtk_text_buffer_get_iter_at_mark (probe->region->buffer, &sr_iter, sr->start);
+		cmp = gtk_text_iter_compare (probe->iter, &sr_iter);
+		if (!(cmp > 0 || (cmp == 0 && probe->include_edges)))
+			return 1;
+	}
+
+	return -1;
+}
+
+static gint
+compare_func (gconstpointer a,
+	      gconstpointer b,
+	      gpointer      data)
+{
+	if (b == data)
+		return compare_subregion_with_probe ((Subregion *) a, data);
+	else
+		return -compare_subregion_with_probe ((Subregion *) b, data);
+}
+
 /* Find and return a subregion node which contains the given text
    iter.  If left_side is TRUE, return the subregion which contains
    the text iter or which is the leftmost; else return the rightmost
    subregion */
-static GList * 
+static GSequenceIter * 
 find_nearest_subregion (GeditTextRegion     *region,
 			const GtkTextIter *iter,
-			GList             *begin,
 			gboolean           leftmost,
 			gboolean           include_edges)
 {
-	GList *l, *retval;
+	GSequenceIter *node;
+	Probe probe;
 	
 	g_return_val_if_fail (region != NULL && iter != NULL, NULL);
 
-	if (!begin)
-		begin = region->subregions;
-	
-	if (begin)
-		retval = begin->prev;
+	probe.region = region;
+	probe.iter = iter;
+	probe.leftmost = leftmost;
+	probe.include_edges = include_edges;
+
+	/* first subregion past the probe */
+	node = g_sequence_search (region->subregions, &probe, compare_func, &probe);
+
+	if (!leftmost)
+		return g_sequence_iter_is_end (node) ? NULL : node;
 	else
-		retval = NULL;
-	
-	for (l = begin; l; l = l->next) {
-		GtkTextIter sr_iter;
-		Subregion *sr = l->data;
-		gint cmp;
-
-		if (!leftmost) {
-			gtk_text_buffer_get_iter_at_mark (region->buffer, &sr_iter, sr->end);
-			cmp = gtk_text_iter_compare (iter, &sr_iter);
-			if (cmp < 0 || (cmp == 0 && include_edges)) {
-				retval = l;
-				break;
-			}
+		return g_sequence_iter_is_begin (node) ? NULL : g_sequence_iter_prev (node);
+}
 
-		} else {
-			gtk_text_buffer_get_iter_at_mark (region->buffer, &sr_iter, sr->start);
-			cmp = gtk_text_iter_compare (iter, &sr_iter);
-			if (cmp > 0 || (cmp == 0 && include_edges))
-				retval = l;
-			else
-				break;
+/* Whether the subregions between the two bounding nodes are empty */
+static gboolean
+no_subregions_between (GSequenceIter *start_node,
+		       GSequenceIter *end_node)
+{
+	return start_node == NULL || end_node == NULL ||
+	       g_sequence_iter_compare (end_node, start_node) < 0;
+}
+
+static void
+delete_subregion (GeditTextRegion *region,
+		  GSequenceIter   *node)
+{
+	Subregion *sr = g_sequence_get (node);
+
+	gtk_text_buffer_delete_mark (region->buffer, sr->start);
+	gtk_text_buffer_delete_mark (region->buffer, sr->end);
+	g_free (sr);
+
+	g_sequence_remove (node);
+}
+
+/* Deletes the subregions emptied by buffer deletions among the ones
+   touching [start, end] and their neighbours, which are the only ones
+   a subtract may reach, without walking the whole region */
+static void
+clear_zero_length_subregions (GeditTextRegion   *region,
+			      const GtkTextIter *start,
+			      const GtkTextIter *end)
+{
+	GSequenceIter *node, *last;
+	GtkTextIter sr_start, sr_end;
+
+	node = find_nearest_subregion (region, start, FALSE, TRUE);
+	last = find_nearest_subregion (region, end, TRUE, TRUE);
+
+	if (node == NULL)
+		node = g_sequence_get_end_iter (region->subregions);
+	if (!g_sequence_iter_is_begin (node))
+		node = g_sequence_iter_prev (node);
+
+	/* stop after the neighbour of the last one */
+	if (last == NULL)
+		last = g_sequence_get_begin_iter (region->subregions);
+	if (!g_sequence_iter_is_end (last))
+		last = g_sequence_iter_next (last);
+	if (!g_sequence_iter_is_end (last))
+		last = g_sequence_iter_next (last);
+
+	while (node != last) {
+		GSequenceIter *next = g_sequence_iter_next (node);
+		Subregion *sr = g_sequence_get (node);
+
+		gtk_text_buffer_get_iter_at_mark (region->buffer, &sr_start, sr->start);
+		gtk_text_buffer_get_iter_at_mark (region->buffer, &sr_end, sr->end);
+
+		if (gtk_text_iter_equal (&sr_start, &sr_end)) {
+			delete_subregion (region, node);
+			++region->time_stamp;
 		}
+
+		node = next;
 	}
-	return retval;
 }
 
 /* ----------------------------------------------------------------------
@@ -128,7 +221,7 @@ gedit_text_region_new (GtkTextBuffer *buffer)
 	
 	region = g_new (GeditTextRegion, 1);
 	region->buffer = buffer;
-	region->subregions = NULL;
+	region->subregions = g_sequence_new (NULL);
 	region->time_stamp = 0;
 	
 	return region;
@@ -137,18 +230,22 @@ gedit_text_region_new (GtkTextBuffer *buffer)
 void 
 gedit_text_region_destroy (GeditTextRegion *region, gboolean delete_marks)
 {
+	GSequenceIter *node;
+
 	g_return_if_fail (region != NULL);
 
-	while (region->subregions) {
-		Subregion *sr = region->subregions->data;
+	for (node = g_sequence_get_begin_iter (region->subregions);
+	     !g_sequence_iter_is_end (node);
+	     node = g_sequence_iter_next (node)) {
+		Subregion *sr = g_sequence_get (node);
 		if (delete_marks) {
 			gtk_text_buffer_delete_mark (region->buffer, sr->start);
 			gtk_text_buffer_delete_mark (region->buffer, sr->end);
 		}
 		g_free (sr);
-		region->subregions = g_list_delete_link (region->subregions,
-							 region->subregions);
 	}
+	g_sequence_free (region->subregions);
+
 	region->buffer = NULL;
 	region->time_stamp = 0;
 	
@@ -163,41 +260,12 @@ gedit_text_region_get_buffer (GeditTextRegion *region)
 	return region->buffer;
 }
 
-static void
-gedit_text_region_clear_zero_length_subregions (GeditTextRegion *region)
-{
-	GtkTextIter start, end;
-	GList *node;
-	
-	g_return_if_fail (region != NULL);
-
-	for (node = region->subregions; node; ) {
-		Subregion *sr = node->data;
-		gtk_text_buffer_get_iter_at_mark (region->buffer, &start, sr->start);
-		gtk_text_buffer_get_iter_at_mark (region->buffer, &end, sr->end);
-		if (gtk_text_iter_equal (&start, &end)) {
-			gtk_text_buffer_delete_mark (region->buffer, sr->start);
-			gtk_text_buffer_delete_mark (region->buffer, sr->end);
-			g_free (sr);
-			if (node == region->subregions)
-				region->subregions = node = g_list_delete_link (node, node);
-			else
-				node = g_list_delete_link (node, node);
-
-			++region->time_stamp;
-			
-		} else {
-			node = node->next;
-		}
-	}
-}
-
 void 
 gedit_text_region_add (GeditTextRegion     *region,
 		     const GtkTextIter *_start,
 		     const GtkTextIter *_end)
 {
-	GList *start_node, *end_node;
+	GSequenceIter *start_node, *end_node;
 	GtkTextIter start, end;
 	
 	g_return_if_fail (region != NULL && _start != NULL && _end != NULL);
@@ -218,10 +286,10 @@ gedit_text_region_add (GeditTextRegion     *region,
 		return;
 
 	/* find bounding subregions */
-	start_node = find_nearest_subregion (region, &start, NULL, FALSE, TRUE);
-	end_node = find_nearest_subregion (region, &end, start_node, TRUE, TRUE);
+	start_node = find_nearest_subregion (region, &start, FALSE, TRUE);
+	end_node = find_nearest_subregion (region, &end, TRUE, TRUE);
 
-	if (start_node == NULL || end_node == NULL || end_node == start_node->prev) {
+	if (no_subregions_between (start_node, end_node)) {
 		/* create the new subregion */
 		Subregion *sr = g_new0 (Subregion, 1);
 		sr->start = gtk_text_buffer_create_mark (region->buffer, NULL, &start, TRUE);
@@ -229,39 +297,36 @@ gedit_text_region_add (GeditTextRegion     *region,
 		
 		if (start_node == NULL) {
 			/* append the new region */
-			region->subregions = g_list_append (region->subregions, sr);
+			g_sequence_append (region->subregions, sr);
 			
 		} else if (end_node == NULL) {
 			/* prepend the new region */
-			region->subregions = g_list_prepend (region->subregions, sr);
+			g_sequence_prepend (region->subregions, sr);
 
 		} else {
 			/* we are in the middle of two subregions */
-			region->subregions = g_list_insert_before (region->subregions,
-								   start_node, sr);
+			g_sequence_insert_before (start_node, sr);
 		}
 	}
 	else {
 		GtkTextIter iter;
-		Subregion *sr = start_node->data;
+		Subregion *sr = g_sequence_get (start_node);
 		if (start_node != end_node) {
 			/* we need to merge some subregions */
-			GList *l = start_node->next;
+			GSequenceIter *l = g_sequence_iter_next (start_node);
 			Subregion *q;
 			
 			gtk_text_buffer_delete_mark (region->buffer, sr->end);
 			while (l != end_node) {
-				q = l->data;
-				gtk_text_buffer_delete_mark (region->buffer, q->start);
-				gtk_text_buffer_delete_mark (region->buffer, q->end);
-				g_free (q);
-				l = g_list_delete_link (l, l);
+				GSequenceIter *next = g_sequence_iter_next (l);
+				delete_subregion (region, l);
+				l = next;
 			}
-			q = l->data;
+			q = g_sequence_get (l);
 			gtk_text_buffer_delete_mark (region->buffer, q->start);
 			sr->end = q->end;
 			g_free (q);
-			l = g_list_delete_link (l, l);
+			g_sequence_remove (l);
 		}
 		/* now move marks if that action expands the region */
 		gtk_text_buffer_get_iter_at_mark (region->buffer, &iter, sr->start);
@@ -282,7 +347,7 @@ gedit_text_region_subtract (GeditTextRegion     *region,
 			  const GtkTextIter *_start,
 			  const GtkTextIter *_end)
 {
-	GList *start_node, *end_node, *node;
+	GSequenceIter *start_node, *end_node, *node;
 	GtkTextIter sr_start_iter, sr_end_iter;
 	gboolean done;
 	gboolean start_is_outside, end_is_outside;
@@ -303,17 +368,17 @@ gedit_text_region_subtract (GeditTextRegion     *region,
 	gtk_text_iter_order (&start, &end);
 	
 	/* find bounding subregions */
-	start_node = find_nearest_subregion (region, &start, NULL, FALSE, FALSE);
-	end_node = find_nearest_subregion (region, &end, start_node, TRUE, FALSE);
+	start_node = find_nearest_subregion (region, &start, FALSE, FALSE);
+	end_node = find_nearest_subregion (region, &end, TRUE, FALSE);
 
 	/* easy case first */
-	if (start_node == NULL || end_node == NULL || end_node == start_node->prev)
+	if (no_subregions_between (start_node, end_node))
 		return;
 	
 	/* deal with the start point */
 	start_is_outside = end_is_outside = FALSE;
 	
-	sr = start_node->data;
+	sr = g_sequence_get (start_node);
 	gtk_text_buffer_get_iter_at_mark (region->buffer, &sr_start_iter, sr->start);
 	gtk_text_buffer_get_iter_at_mark (region->buffer, &sr_end_iter, sr->end);
 
@@ -328,11 +393,13 @@ gedit_text_region_subtract (GeditTextRegion     *region,
 			new_sr->end = sr->end;
 			new_sr->start = gtk_text_buffer_create_mark (region->buffer,
 								     NULL, &end, TRUE);
-			start_node = g_list_insert_before (start_node, start_node->next, new_sr);
+			g_sequence_insert_before (g_sequence_iter_next (start_node), new_sr);
 
 			sr->end = gtk_text_buffer_create_mark (region->buffer,
 							       NULL, &start, FALSE);
 
+			++region->time_stamp;
+
 			/* no further processing needed */
 			DEBUG (g_message ("subregion splitted"));
 			
@@ -352,7 +419,7 @@ gedit_text_region_subtract (GeditTextRegion     *region,
 	
 	/* deal with the end point */
 	if (start_node != end_node) {
-		sr = end_node->data;
+		sr = g_sequence_get (end_node);
 		gtk_text_buffer_get_iter_at_mark (region->buffer, &sr_start_iter, sr->start);
 		gtk_text_buffer_get_iter_at_mark (region->buffer, &sr_end_iter, sr->end);
 	}
@@ -379,15 +446,10 @@ gedit_text_region_subtract (GeditTextRegion     *region,
 		if ((node == start_node && !start_is_outside) ||
 		    (node == end_node && !end_is_outside)) {
 			/* skip starting or ending node */
-			node = node->next;
+			node = g_sequence_iter_next (node);
 		} else {
-			GList *l = node->next;
-			sr = node->data;
-			gtk_text_buffer_delete_mark (region->buffer, sr->start);
-			gtk_text_buffer_delete_mark (region->buffer, sr->end);
-			g_free (sr);
-			region->subregions = g_list_delete_link (region->subregions,
-								 node);
+			GSequenceIter *l = g_sequence_iter_next (node);
+			delete_subregion (region, node);
 			node = l;
 		}
 	}
@@ -397,7 +459,7 @@ gedit_text_region_subtract (GeditTextRegion     *region,
 	DEBUG (gedit_text_region_debug_print (region));
 
 	/* now get rid of empty subregions */
-	gedit_text_region_clear_zero_length_subregions (region);
+	clear_zero_length_subregions (region, &start, &end);
 
 	DEBUG (gedit_text_region_debug_print (region));
 }
@@ -407,7 +469,7 @@ gedit_text_region_subregions (GeditTextRegion *region)
 {
 	g_return_val_if_fail (region != NULL, 0);
 
-	return g_list_length (region->subregions);
+	return g_sequence_get_length (region->subregions);
 }
 
 gboolean 
@@ -416,14 +478,17 @@ gedit_text_region_nth_subregion (GeditTextRegion *region,
 			       GtkTextIter   *start,
 			       GtkTextIter   *end)
 {
+	GSequenceIter *node;
 	Subregion *sr;
 	
 	g_return_val_if_fail (region != NULL, FALSE);
 
-	sr = g_list_nth_data (region->subregions, subregion);
-	if (sr == NULL)
+	if (subregion >= (guint) g_sequence_get_length (region->subregions))
 		return FALSE;
 
+	node = g_sequence_get_iter_at_pos (region->subregions, subregion);
+	sr = g_sequence_get (node);
+
 	if (start)
 		gtk_text_buffer_get_iter_at_mark (region->buffer, start, sr->start);
 	if (end)
@@ -437,7 +502,7 @@ gedit_text_region_intersect (GeditTextRegion     *region,
 			   const GtkTextIter *_start,
 			   const GtkTextIter *_end)
 {
-	GList *start_node, *end_node, *node;
+	GSequenceIter *start_node, *end_node, *node;
 	GtkTextIter sr_start_iter, sr_end_iter;
 	Subregion *sr, *new_sr;
 	gboolean done;
@@ -452,24 +517,24 @@ gedit_text_region_intersect (GeditTextRegion     *region,
 	gtk_text_iter_order (&start, &end);
 	
 	/* find bounding subregions */
-	start_node = find_nearest_subregion (region, &start, NULL, FALSE, FALSE);
-	end_node = find_nearest_subregion (region, &end, start_node, TRUE, FALSE);
+	start_node = find_nearest_subregion (region, &start, FALSE, FALSE);
+	end_node = find_nearest_subregion (region, &end, TRUE, FALSE);
 
 	/* easy case first */
-	if (start_node == NULL || end_node == NULL || end_node == start_node->prev)
+	if (no_subregions_between (start_node, end_node))
 		return NULL;
 	
 	new_region = gedit_text_region_new (region->buffer);
 	done = FALSE;
 	
-	sr = start_node->data;
+	sr = g_sequence_get (start_node);
 	gtk_text_buffer_get_iter_at_mark (region->buffer, &sr_start_iter, sr->start);
 	gtk_text_buffer_get_iter_at_mark (region->buffer, &sr_end_iter, sr->end);
 
 	/* starting node */
 	if (gtk_text_iter_in_range (&start, &sr_start_iter, &sr_end_iter)) {
 		new_sr = g_new0 (Subregion, 1);
-		new_region->subregions = g_list_prepend (new_region->subregions, new_sr);
+		g_sequence_append (new_region->subregions, new_sr);
 
 		new_sr->start = gtk_text_buffer_create_mark (new_region->buffer, NULL,
 							     &start, TRUE);
@@ -487,7 +552,7 @@ gedit_text_region_intersect (GeditTextRegion     *region,
 			new_sr->end = gtk_text_buffer_create_mark (new_region->buffer, NULL,
 								   &sr_end_iter, FALSE);
 		}
-		node = start_node->next;
+		node = g_sequence_iter_next (start_node);
 	} else {
 		/* start should be the same as the subregion, so copy it in the loop */
 		node = start_node;
@@ -496,28 +561,28 @@ gedit_text_region_intersect (GeditTextRegion     *region,
 	if (!done) {
 		while (node != end_node) {
 			/* copy intermediate subregions verbatim */
-			sr = node->data;
+			sr = g_sequence_get (node);
 			gtk_text_buffer_get_iter_at_mark (region->buffer, &sr_start_iter,
 							  sr->start);
 			gtk_text_buffer_get_iter_at_mark (region->buffer, &sr_end_iter, sr->end);
 			
 			new_sr = g_new0 (Subregion, 1);
-			new_region->subregions = g_list_prepend (new_region->subregions, new_sr);
+			g_sequence_append (new_region->subregions, new_sr);
 			new_sr->start = gtk_text_buffer_create_mark (new_region->buffer, NULL,
 								     &sr_start_iter, TRUE);
 			new_sr->end = gtk_text_buffer_create_mark (new_region->buffer, NULL,
 								   &sr_end_iter, FALSE);
 			/* next node */
-			node = node->next;
+			node = g_sequence_iter_next (node);
 		}
 
 		/* ending node */
-		sr = node->data;
+		sr = g_sequence_get (node);
 		gtk_text_buffer_get_iter_at_mark (region->buffer, &sr_start_iter, sr->start);
 		gtk_text_buffer_get_iter_at_mark (region->buffer, &sr_end_iter, sr->end);
 		
 		new_sr = g_new0 (Subregion, 1);
-		new_region->subregions = g_list_prepend (new_region->subregions, new_sr);
+		g_sequence_append (new_region->subregions, new_sr);
 		
 		new_sr->start = gtk_text_buffer_create_mark (new_region->buffer, NULL,
 							     &sr_start_iter, TRUE);
@@ -530,7 +595,6 @@ gedit_text_region_intersect (GeditTextRegion     *region,
 								   &sr_end_iter, FALSE);
 	}
 
-	new_region->subregions = g_list_reverse (new_region->subregions);
 	return new_region;
 }
 
@@ -563,10 +627,10 @@ gedit_text_region_get_iterator (GeditTextRegion         *region,
 
 	real = (GeditTextRegionIteratorReal *)iter;
 
-	/* region->subregions may be NULL, -> end iter */
+	/* positions past the last subregion give the end iter */
 
 	real->region = region;
-	real->subregions = g_list_nth (region->subregions, start);
+	real->subregions = g_sequence_get_iter_at_pos (region->subregions, start);
 	real->region_time_stamp = region->time_stamp;
 }
 
@@ -580,7 +644,7 @@ gedit_text_region_iterator_is_end (GeditTextRegionIterator *iter)
 	real = (GeditTextRegionIteratorReal *)iter;
 	g_return_val_if_fail (check_iterator (real), FALSE);
 
-	return (real->subregions == NULL);
+	return g_sequence_iter_is_end (real->subregions);
 }
 
 gboolean
@@ -593,8 +657,8 @@ gedit_text_region_iterator_next (GeditTextRegionIterator *iter)
 	real = (GeditTextRegionIteratorReal *)iter;
 	g_return_val_if_fail (check_iterator (real), FALSE);
 
-	if (real->subregions != NULL) {
-		real->subregions = g_list_next (real->subregions);
+	if (!g_sequence_iter_is_end (real->subregions)) {
+		real->subregions = g_sequence_iter_next (real->subregions);
 		return TRUE;
 	}
 	else
@@ -613,9 +677,9 @@ gedit_text_region_iterator_get_subregion (GeditTextRegionIterator *iter,
 
 	real = (GeditTextRegionIteratorReal *)iter;
 	g_return_if_fail (check_iterator (real));
-	g_return_if_fail (real->subregions != NULL);
+	g_return_if_fail (!g_sequence_iter_is_end (real->subregions));
 
-	sr = (Subregion*)real->subregions->data;
+	sr = (Subregion*)g_sequence_get (real->subregions);
 	g_return_if_fail (sr != NULL);
 
 	if (start)
@@ -627,21 +691,20 @@ gedit_text_region_iterator_get_subregion (GeditTextRegionIterator *iter,
 void 
 gedit_text_region_debug_print (GeditTextRegion *region)
 {
-	GList *l;
+	GSequenceIter *l;
 	
 	g_return_if_fail (region != NULL);
 
 	g_print ("Subregions: ");
-	l = region->subregions;
-	while (l) {
-		Subregion *sr = l->data;
+	l = g_sequence_get_begin_iter (region->subregions);
+	while (!g_sequence_iter_is_end (l)) {
+		Subregion *sr = g_sequence_get (l);
 		GtkTextIter iter1, iter2;
 		gtk_text_buffer_get_iter_at_mark (region->buffer, &iter1, sr->start);
 		gtk_text_buffer_get_iter_at_mark (region->buffer, &iter2, sr->end);
 		g_print ("%d-%d ", gtk_text_iter_get_offset (&iter1),
 			 gtk_text_iter_get_offset (&iter2));
-		l = l->next;
+		l = g_sequence_iter_next (l);
 	}
 	g_print ("\n");
 }
-
@@ -25,17 +25,16 @@
 #endif
 
 #include "gedit-docinfo-plugin.h"
-
-#include <string.h> /* For strlen (...) */
+#include "gedit-docinfo-stats.h"
 
 #include <glib/gi18n-lib.h>
-#include <pango/pango-break.h>
 #include <gmodule.h>
 
 #include <gedit/gedit-debug.h>
 #include <gedit/gedit-utils.h>
 
 #define WINDOW_DATA_KEY "GeditDocInfoWindowData"
+#define COUNTER_KEY "GeditDocInfoCounter"
 #define MENU_PATH "/MenuBar/ToolsMenu/ToolsOps_2"
 
 GEDIT_PLUGIN_REGISTER_TYPE(GeditDocInfoPlugin, gedit_docinfo_plugin)
@@ -65,11 +64,18 @@ typedef struct
 	guint ui_id;
 
 	DocInfoDialog *dialog;
+
+	/* The document shown in the dialog, its stats are kept up to
+	 * date while the dialog is open */
+	GeditDocument *doc;
+	guint update_id;
 } WindowData;
 
 static void docinfo_dialog_response_cb (GtkDialog   *widget,
 					gint	    res_id,
 					GeditWindow *window);
+static void set_document (WindowData    *data,
+			  GeditDocument *doc);
 
 static void
 docinfo_dialog_destroy_cb (GtkObject  *obj,
@@ -79,6 +85,8 @@ docinfo_dialog_destroy_cb (GtkObject  *obj,
 
 	if (data != NULL)
 	{
+		set_document (data, NULL);
+
 		g_free (data->dialog);
 		data->dialog = NULL;
 	}
@@ -153,85 +161,42 @@ get_docinfo_dialog (GeditWindow *window,
 	return dialog;
 }
 
-static void 
-calculate_info (GeditDocument *doc,
-		GtkTextIter   *start,
-		GtkTextIter   *end, 
-		gint          *chars,
-		gint          *words,
-		gint          *white_chars,
-		gint          *bytes)
-{	
-	gchar *text;
-
-	gedit_debug (DEBUG_PLUGINS);
-
-	text = gtk_text_buffer_get_slice (GTK_TEXT_BUFFER (doc),
-					  start,
-					  end,
-					  TRUE);
-
-	*chars = g_utf8_strlen (text, -1);
-	*bytes = strlen (text);
-
-	if (*chars > 0)
-	{
-		PangoLogAttr *attrs;
-		gint i;
-
-		attrs = g_new0 (PangoLogAttr, *chars + 1);
-
-		pango_get_log_attrs (text,
-				     -1,
-				     0,
-				     pango_language_from_string ("C"),
-				     attrs,
-				     *chars + 1);
-
-		for (i = 0; i < (*chars); i++)
-		{
-			if (attrs[i].is_white)
-				++(*white_chars);
-
-			if (attrs[i].is_word_start)
-				++(*words);
-		}
-
-		g_free (attrs);
-	}
-	else
-	{
-		*white_chars = 0;
-		*words = 0;
-	}
-
-	g_free (text);
-}
-
 static void
 docinfo_real (GeditDocument *doc,
 	      DocInfoDialog *dialog)
 {
-	GtkTextIter start, end;
-	gint words = 0;
-	gint chars = 0;
-	gint white_chars = 0;
-	gint lines = 0;
-	gint bytes = 0;
+	GeditDocInfoCounter *counter;
+	const GeditDocInfoStats *stats;
+	gint words;
+	gint chars;
+	gint white_chars;
+	gint lines;
+	gint bytes;
 	gchar *tmp_str;
 	gchar *doc_name;
 
 	gedit_debug (DEBUG_PLUGINS);
 
-	gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (doc),
-				    &start,
-				    &end);
+	counter = g_object_get_data (G_OBJECT (doc), COUNTER_KEY);
 
-	lines = gtk_text_buffer_get_line_count (GTK_TEXT_BUFFER (doc));
+	if (counter == NULL)
+	{
+		counter = gedit_docinfo_counter_new (GTK_TEXT_BUFFER (doc));
+
+		g_object_set_data_full (G_OBJECT (doc),
+					COUNTER_KEY,
+					counter,
+					(GDestroyNotify) gedit_docinfo_counter_free);
+	}
 
-	calculate_info (doc,
-			&start, &end,
-			&chars, &words, &white_chars, &bytes);
+	stats = gedit_docinfo_counter_get_stats (counter);
+
+	chars = stats->chars;
+	words = stats->words;
+	white_chars = stats->white_chars;
+	bytes = stats->bytes;
+
+	lines = gtk_text_buffer_get_line_count (GTK_TEXT_BUFFER (doc));
 
 	if (chars == 0)
 		lines = 0;
@@ -290,11 +255,18 @@ selectioninfo_real (GeditDocument *doc,
 
 	if (sel)
 	{
+		GeditDocInfoStats stats;
+
 		lines = gtk_text_iter_get_line (&end) - gtk_text_iter_get_line (&start) + 1;
 	
-		calculate_info (doc,
-				&start, &end,
-				&chars, &words, &white_chars, &bytes);
+		gedit_docinfo_stats_count (GTK_TEXT_BUFFER (doc),
+					   &start, &end,
+					   &stats);
+
+		chars = stats.chars;
+		words = stats.words;
+		white_chars = stats.white_chars;
+		bytes = stats.bytes;
 
 		gedit_debug_message (DEBUG_PLUGINS, "Selected chars: %d", chars);
 		gedit_debug_message (DEBUG_PLUGINS, "Selected lines: %d", lines);
@@ -335,6 +307,72 @@ selectioninfo_real (GeditDocument *doc,
 	g_free (tmp_str);
 }
 
+static gboolean
+update_dialog (WindowData *data)
+{
+	data->update_id = 0;
+
+	if (data->dialog != NULL && data->doc != NULL)
+	{
+		docinfo_real (data->doc,
+			      data->dialog);
+		selectioninfo_real (data->doc,
+				    data->dialog);
+	}
+
+	return FALSE;
+}
+
+static void
+document_changed_cb (GeditDocument *doc,
+		     WindowData    *data)
+{
+	if (data->update_id == 0)
+	{
+		data->update_id = g_idle_add_full (G_PRIORITY_LOW,
+						   (GSourceFunc) update_dialog,
+						   data,
+						   NULL);
+	}
+}
+
+/* Only the document shown in the dialog keeps its stats up to date */
+static void
+set_document (WindowData    *data,
+	      GeditDocument *doc)
+{
+	if (data->doc == doc)
+		return;
+
+	if (data->doc != NULL)
+	{
+		g_signal_handlers_disconnect_by_func (data->doc,
+						      document_changed_cb,
+						      data);
+		g_object_set_data (G_OBJECT (data->doc), COUNTER_KEY, NULL);
+		g_object_remove_weak_pointer (G_OBJECT (data->doc),
+					      (gpointer *) &data->doc);
+	}
+
+	if (data->update_id != 0)
+	{
+		g_source_remove (data->update_id);
+		data->update_id = 0;
+	}
+
+	data->doc = doc;
+
+	if (doc != NULL)
+	{
+		g_object_add_weak_pointer (G_OBJECT (doc),
+					   (gpointer *) &data->doc);
+		g_signal_connect (doc,
+				  "changed",
+				  G_CALLBACK (document_changed_cb),
+				  data);
+	}
+}
+
 static void
 docinfo_cb (GtkAction	*action,
 	    GeditWindow *window)
@@ -366,6 +404,8 @@ docinfo_cb (GtkAction	*action,
 
 		gtk_widget_show (GTK_WIDGET (dialog->dialog));
 	}
+
+	set_document (data, doc);
 	
 	docinfo_real (doc, 
 		      data->dialog);	
@@ -403,6 +443,8 @@ docinfo_dialog_response_cb (GtkDialog	*widget,
 			
 			doc = gedit_window_get_active_document (window);
 			g_return_if_fail (doc != NULL);
+
+			set_document (data, doc);
 			
 			docinfo_real (doc,
 				      data->dialog);
@@ -462,6 +504,20 @@ update_ui_real (GeditWindow  *window,
 		gtk_dialog_set_response_sensitive (GTK_DIALOG (data->dialog->dialog),
 						   GTK_RESPONSE_OK,
 						   (view != NULL));
+
+		/* follow the active document */
+		if (view != NULL)
+		{
+			GeditDocument *doc;
+
+			doc = gedit_window_get_active_document (window);
+
+			if (doc != data->doc)
+			{
+				set_document (data, doc);
+				document_changed_cb (doc, data);
+			}
+		}
 	}
 }
 
@@ -492,6 +548,8 @@ impl_activate (GeditPlugin *plugin,
 
 	data->plugin = g_object_ref (plugin);
 	data->dialog = NULL;
+	data->doc = NULL;
+	data->update_id = 0;
 	data->ui_action_group = gtk_action_group_new ("GeditDocInfoPluginActions");
 	
 	gtk_action_group_set_translation_domain (data->ui_action_group, 
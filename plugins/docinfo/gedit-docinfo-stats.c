@@ -0,0 +1,393 @@
+/*
+ * gedit-docinfo-stats.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gedit-docinfo-stats.h"
+
+#include <string.h>
+#include <pango/pango-break.h>
+
+/* Chars copied out of the buffer at once. A segment ends after a white
+ * char, where the word breaks do not depend on the text before, if there
+ * is one in the next SEGMENT_CHARS. Otherwise it is cut there and the
+ * next segment is analyzed with WORD_CONTEXT_CHARS of the text before,
+ * which are not counted again. */
+#define SEGMENT_CHARS (64 * 1024)
+#define WORD_CONTEXT_CHARS 16
+
+struct _GeditDocInfoCounter
+{
+	GtkTextBuffer *buffer;
+
+	GeditDocInfoStats stats;
+};
+
+typedef enum
+{
+	WORD_NONE,
+	WORD_LETTERS,
+	WORD_NUMBERS
+} WordType;
+
+static gboolean
+is_white (gunichar ch,
+	  gpointer data)
+{
+	return g_unichar_isspace (ch);
+}
+
+static gboolean
+is_ascii (const gchar *text,
+	  gsize        len)
+{
+	gsize i;
+
+	for (i = 0; i < len; i++)
+	{
+		if ((guchar) text[i] >= 0x80)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* The word starts of pango for ascii text: a word is a run of letters
+ * or a run of digits. The first @context chars are not counted. */
+static void
+count_ascii (const gchar       *text,
+	     gsize              len,
+	     gsize              context,
+	     GeditDocInfoStats *stats)
+{
+	WordType type = WORD_NONE;
+	gsize i;
+
+	for (i = 0; i < len; i++)
+	{
+		gchar c = text[i];
+		WordType new_type;
+
+		if (i >= context &&
+		    (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f'))
+			stats->white_chars++;
+
+		if (g_ascii_isalpha (c))
+			new_type = WORD_LETTERS;
+		else if (g_ascii_isdigit (c))
+			new_type = WORD_NUMBERS;
+		else
+			new_type = WORD_NONE;
+
+		if (i >= context && new_type != WORD_NONE && new_type != type)
+			stats->words++;
+
+		type = new_type;
+	}
+}
+
+/* Counts @text but its first @context chars, which are only there for
+ * the word breaks */
+static void
+count_text (const gchar       *text,
+	    gsize              len,
+	    gint               n_chars,
+	    gint               context,
+	    GeditDocInfoStats *stats)
+{
+	PangoLogAttr *attrs;
+	gint i;
+
+	stats->chars += n_chars - context;
+	stats->bytes += len - (g_utf8_offset_to_pointer (text, context) - text);
+
+	if (is_ascii (text, len))
+	{
+		count_ascii (text, len, context, stats);
+		return;
+	}
+
+	attrs = g_new0 (PangoLogAttr, n_chars + 1);
+
+	pango_get_log_attrs (text,
+			     len,
+			     0,
+			     pango_language_from_string ("C"),
+			     attrs,
+			     n_chars + 1);
+
+	for (i = context; i < n_chars; i++)
+	{
+		if (attrs[i].is_white)
+			++stats->white_chars;
+
+		if (attrs[i].is_word_start)
+			++stats->words;
+	}
+
+	g_free (attrs);
+}
+
+/* If @in_word, @start can be in the middle of a word and the text before
+ * is used for the word breaks */
+static void
+count_range (GtkTextBuffer     *buffer,
+	     const GtkTextIter *start,
+	     const GtkTextIter *end,
+	     gboolean           in_word,
+	     GeditDocInfoStats *stats)
+{
+	GtkTextIter segment_start;
+	GtkTextIter segment_end;
+	GtkTextIter limit;
+	gint context = in_word ? WORD_CONTEXT_CHARS : 0;
+
+	segment_start = *start;
+
+	while (gtk_text_iter_compare (&segment_start, end) < 0)
+	{
+		gchar *text;
+		gboolean cut = FALSE;
+
+		segment_end = segment_start;
+		gtk_text_iter_forward_chars (&segment_end, SEGMENT_CHARS);
+
+		limit = segment_end;
+		gtk_text_iter_forward_chars (&limit, SEGMENT_CHARS);
+
+		if (gtk_text_iter_compare (&limit, end) > 0)
+			limit = *end;
+
+		if (gtk_text_iter_compare (&segment_end, end) >= 0)
+		{
+			segment_end = *end;
+		}
+		else if (is_white (gtk_text_iter_get_char (&segment_end), NULL) ||
+			 gtk_text_iter_forward_find_char (&segment_end, is_white, NULL, &limit))
+		{
+			gtk_text_iter_forward_char (&segment_end);
+		}
+		else
+		{
+			/* no white char, segment_end is at limit */
+			cut = TRUE;
+		}
+
+		context = MIN (context, gtk_text_iter_get_offset (&segment_start));
+		gtk_text_iter_backward_chars (&segment_start, context);
+
+		text = gtk_text_buffer_get_slice (buffer,
+						  &segment_start,
+						  &segment_end,
+						  TRUE);
+
+		count_text (text,
+			    strlen (text),
+			    gtk_text_iter_get_offset (&segment_end) -
+			    gtk_text_iter_get_offset (&segment_start),
+			    context,
+			    stats);
+
+		g_free (text);
+
+		context = cut ? WORD_CONTEXT_CHARS : 0;
+
+		segment_start = segment_end;
+	}
+}
+
+void
+gedit_docinfo_stats_count (GtkTextBuffer     *buffer,
+			   const GtkTextIter *start,
+			   const GtkTextIter *end,
+			   GeditDocInfoStats *stats)
+{
+	g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer));
+	g_return_if_fail (start != NULL && end != NULL);
+	g_return_if_fail (stats != NULL);
+
+	memset (stats, 0, sizeof (GeditDocInfoStats));
+
+	count_range (buffer, start, end, FALSE, stats);
+}
+
+/* The text around a change that must be counted again, from the white
+ * char before @start to the one after @end, or SEGMENT_CHARS away from
+ * the change if there is none, so that an edit in a text without white
+ * chars does not scan all of it. Returns whether the region starts in
+ * the middle of a word. */
+static gboolean
+get_region (const GtkTextIter *start,
+	    const GtkTextIter *end,
+	    GtkTextIter       *region_start,
+	    GtkTextIter       *region_end)
+{
+	GtkTextIter limit;
+	gboolean in_word = FALSE;
+
+	*region_start = *start;
+
+	limit = *start;
+	gtk_text_iter_backward_chars (&limit, SEGMENT_CHARS);
+
+	if (gtk_text_iter_backward_find_char (region_start, is_white, NULL, &limit))
+	{
+		gtk_text_iter_forward_char (region_start);
+	}
+	else
+	{
+		*region_start = limit;
+		in_word = !gtk_text_iter_is_start (&limit);
+	}
+
+	*region_end = *end;
+
+	if (!is_white (gtk_text_iter_get_char (region_end), NULL))
+	{
+		limit = *end;
+		gtk_text_iter_forward_chars (&limit, SEGMENT_CHARS);
+
+		if (!gtk_text_iter_forward_find_char (region_end, is_white, NULL, &limit))
+			*region_end = limit;
+	}
+
+	return in_word;
+}
+
+static void
+add_region (GeditDocInfoCounter *counter,
+	    const GtkTextIter   *start,
+	    const GtkTextIter   *end,
+	    gint                 sign)
+{
+	GtkTextIter region_start;
+	GtkTextIter region_end;
+	GeditDocInfoStats stats = { 0, };
+	gboolean in_word;
+
+	in_word = get_region (start, end, &region_start, &region_end);
+
+	count_range (counter->buffer, &region_start, &region_end, in_word, &stats);
+
+	counter->stats.chars += sign * stats.chars;
+	counter->stats.words += sign * stats.words;
+	counter->stats.white_chars += sign * stats.white_chars;
+	counter->stats.bytes += sign * stats.bytes;
+}
+
+static void
+insert_text_cb (GtkTextBuffer       *buffer,
+		GtkTextIter         *location,
+		const gchar         *text,
+		gint                 len,
+		GeditDocInfoCounter *counter)
+{
+	add_region (counter, location, location, -1);
+}
+
+static void
+insert_text_after_cb (GtkTextBuffer       *buffer,
+		      GtkTextIter         *location,
+		      const gchar         *text,
+		      gint                 len,
+		      GeditDocInfoCounter *counter)
+{
+	GtkTextIter start;
+
+	/* location is now at the end of the inserted text */
+	start = *location;
+	gtk_text_iter_backward_chars (&start, g_utf8_strlen (text, len));
+
+	add_region (counter, &start, location, 1);
+}
+
+static void
+delete_range_cb (GtkTextBuffer       *buffer,
+		 GtkTextIter         *start,
+		 GtkTextIter         *end,
+		 GeditDocInfoCounter *counter)
+{
+	add_region (counter, start, end, -1);
+}
+
+static void
+delete_range_after_cb (GtkTextBuffer       *buffer,
+		       GtkTextIter         *start,
+		       GtkTextIter         *end,
+		       GeditDocInfoCounter *counter)
+{
+	add_region (counter, start, start, 1);
+}
+
+GeditDocInfoCounter *
+gedit_docinfo_counter_new (GtkTextBuffer *buffer)
+{
+	GeditDocInfoCounter *counter;
+	GtkTextIter start, end;
+
+	g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), NULL);
+
+	counter = g_slice_new0 (GeditDocInfoCounter);
+	counter->buffer = buffer;
+
+	gtk_text_buffer_get_bounds (buffer, &start, &end);
+	count_range (buffer, &start, &end, FALSE, &counter->stats);
+
+	g_signal_connect (buffer,
+			  "insert-text",
+			  G_CALLBACK (insert_text_cb),
+			  counter);
+	g_signal_connect_after (buffer,
+				"insert-text",
+				G_CALLBACK (insert_text_after_cb),
+				counter);
+	g_signal_connect (buffer,
+			  "delete-range",
+			  G_CALLBACK (delete_range_cb),
+			  counter);
+	g_signal_connect_after (buffer,
+				"delete-range",
+				G_CALLBACK (delete_range_after_cb),
+				counter);
+
+	return counter;
+}
+
+void
+gedit_docinfo_counter_free (GeditDocInfoCounter *counter)
+{
+	if (counter == NULL)
+		return;
+
+	g_signal_handlers_disconnect_matched (counter->buffer,
+					      G_SIGNAL_MATCH_DATA,
+					      0, 0, NULL, NULL,
+					      counter);
+
+	g_slice_free (GeditDocInfoCounter, counter);
+}
+
+const GeditDocInfoStats *
+gedit_docinfo_counter_get_stats (GeditDocInfoCounter *counter)
+{
+	g_return_val_if_fail (counter != NULL, NULL);
+
+	return &counter->stats;
+}
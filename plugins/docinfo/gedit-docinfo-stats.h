@@ -0,0 +1,55 @@
+/*
+ * gedit-docinfo-stats.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GEDIT_DOCINFO_STATS_H__
+#define __GEDIT_DOCINFO_STATS_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+typedef struct
+{
+	gint chars;
+	gint words;
+	gint white_chars;
+	gint bytes;
+} GeditDocInfoStats;
+
+/* Counts the text between @start and @end a segment at a time, giving
+ * the same words and white chars as pango_get_log_attrs on the whole
+ * text */
+void	 gedit_docinfo_stats_count		(GtkTextBuffer     *buffer,
+						 const GtkTextIter *start,
+						 const GtkTextIter *end,
+						 GeditDocInfoStats *stats);
+
+/* Keeps the stats of a whole buffer, updated on each change */
+typedef struct _GeditDocInfoCounter		GeditDocInfoCounter;
+
+GeditDocInfoCounter
+	*gedit_docinfo_counter_new		(GtkTextBuffer       *buffer);
+
+void	 gedit_docinfo_counter_free		(GeditDocInfoCounter *counter);
+
+const GeditDocInfoStats
+	*gedit_docinfo_counter_get_stats	(GeditDocInfoCounter *counter);
+
+G_END_DECLS
+
+#endif /* __GEDIT_DOCINFO_STATS_H__ */
@@ -38,6 +38,7 @@
 #include "gedit-file-browser-error.h"
 #include "gedit-file-browser-widget.h"
 #include "gedit-file-browser-messages.h"
+#include "gedit-file-browser-type-cache.h"
 
 #define WINDOW_DATA_KEY	        	"GeditFileBrowserPluginWindowData"
 #define FILE_BROWSER_BASE_KEY 		"/apps/gedit-2/plugins/filebrowser"
@@ -817,6 +818,10 @@ impl_deactivate (GeditPlugin * plugin, GeditWindow * window)
 	g_object_unref (client);
 	remove_popup_ui (window);
 
+	/* The cache is read again by the stores of the other windows, its
+	 * save timeout must not run once the module is unloaded */
+	gedit_file_browser_type_cache_shutdown ();
+
 	panel = gedit_window_get_side_panel (window);
 	gedit_panel_remove_item (panel, GTK_WIDGET (data->tree_widget));
 
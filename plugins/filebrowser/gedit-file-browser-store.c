@@ -28,12 +28,14 @@
 #include <gio/gio.h>
 #include <gedit/gedit-plugin.h>
 #include <gedit/gedit-utils.h>
+#include <gedit/gedit-debug.h>
 
 #include "gedit-file-browser-store.h"
 #include "gedit-file-browser-marshal.h"
 #include "gedit-file-browser-enum-types.h"
 #include "gedit-file-browser-error.h"
 #include "gedit-file-browser-utils.h"
+#include "gedit-file-browser-type-cache.h"
 
 #define GEDIT_FILE_BROWSER_STORE_GET_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE((object), \
 						     GEDIT_TYPE_FILE_BROWSER_STORE, \
@@ -49,6 +51,14 @@
 #define FILE_BROWSER_NODE_DIR(node)	((FileBrowserNodeDir *)(node))
 
 #define DIRECTORY_LOAD_ITEMS_PER_CALLBACK 100
+
+/* The directory monitor events are handled together, at most this
+ * number of ms after the first one */
+#define MONITOR_EVENTS_TIMEOUT 100
+
+/* Composited emblem icons kept before the cache is emptied */
+#define EMBLEM_ICONS_MAX 64
+
 #define STANDARD_ATTRIBUTE_TYPES G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
 				 G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
 			 	 G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP "," \
@@ -56,6 +66,20 @@
 				 G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE "," \
 				 G_FILE_ATTRIBUTE_STANDARD_ICON
 
+/* Local directories are listed without sniffing the content types, they
+ * come from the type cache or are sniffed afterwards in a thread */
+#define LOCAL_ATTRIBUTE_TYPES G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+			      G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
+			      G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP "," \
+			      G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+			      G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE "," \
+			      G_FILE_ATTRIBUTE_STANDARD_SIZE "," \
+			      G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
+			      G_FILE_ATTRIBUTE_STANDARD_ICON
+
+/* Set on the infos classified with the type cache */
+#define ATTRIBUTE_IS_TEXT "filebrowser::is-text"
+
 typedef struct _FileBrowserNode    FileBrowserNode;
 typedef struct _FileBrowserNodeDir FileBrowserNodeDir;
 typedef struct _AsyncData	   AsyncData;
@@ -78,9 +102,42 @@ struct _AsyncNode
 {
 	FileBrowserNodeDir *dir;
 	GCancellable *cancellable;
-	GSList *original_children;
 };
 
+/* The content types of a batch of enumerated files, sniffed in a thread */
+typedef struct
+{
+	AsyncNode *async;
+	GFileEnumerator *enumerator;
+	GFile *dir_file;
+
+	/* All the infos of the batch, and the ones to sniff */
+	GList *files;
+	GList *unknown;
+} ClassifyJob;
+
+/* The info queries of the files created during a monitor events window */
+typedef struct
+{
+	FileBrowserNodeDir *dir;
+	GCancellable *cancellable;
+	GList *infos;
+	gint pending;
+	GTimer *timer;
+} MonitorBatch;
+
+/* A created file not in the type cache, sniffed in a second query */
+typedef struct
+{
+	MonitorBatch *batch;
+	GFileInfo *info;
+} MonitorSniff;
+
+typedef struct {
+	GdkPixbuf * icon;
+	GdkPixbuf * emblem;
+} EmblemKey;
+
 typedef struct {
 	GeditFileBrowserStore * model;
 	gchar * virtual_root;
@@ -93,24 +150,47 @@ struct _FileBrowserNode
 	GFile *file;
 	guint flags;
 	gchar *name;
+	gchar *collate_key;
 
+	/* The icon pixbuf is only looked up when the row is shown */
+	GIcon *gicon;
 	GdkPixbuf *icon;
 	GdkPixbuf *emblem;
 
 	FileBrowserNode *parent;
 	gint pos;
-	gboolean inserted;
+
+	/* Position in the children of the parent, and in its inserted
+	 * children if the node was inserted in the model */
+	GSequenceIter *iter;
+	GSequenceIter *inserted_iter;
 };
 
 struct _FileBrowserNodeDir 
 {
 	FileBrowserNode node;
-	GSList *children;
+
+	/* All the children sorted with the sort func, the ones inserted
+	 * in the model (the rows) and the children by file basename */
+	GSequence *children;
+	GSequence *inserted;
+	GHashTable *children_hash;
+
 	GHashTable *hidden_file_hash;
 
 	GCancellable *cancellable;
 	GFileMonitor *monitor;
 	GeditFileBrowserStore *model;
+
+	/* The monitor events not handled yet, by file, the last one wins */
+	GHashTable *monitor_events;
+	guint monitor_events_id;
+	GTimer *monitor_events_timer;
+
+	/* Cancels the info queries of the created files, and the
+	 * MonitorBatch querying each of them */
+	GCancellable *monitor_cancellable;
+	GHashTable *monitor_created;
 };
 
 struct _GeditFileBrowserStorePrivate 
@@ -125,6 +205,10 @@ struct _GeditFileBrowserStorePrivate
 
 	SortFunc sort_func;
 
+	/* Icons with an emblem, by EmblemKey */
+	GHashTable *emblem_icons;
+	gulong icon_theme_changed_id;
+
 	GSList *async_handles;
 	MountInfo *mount_info;
 };
@@ -196,6 +280,9 @@ static void model_check_dummy                               (GeditFileBrowserSto
 							     FileBrowserNode * node);
 static void next_files_async 				    (GFileEnumerator * enumerator,
 							     AsyncNode * async);
+static void model_stop_monitor				    (FileBrowserNodeDir * dir);
+static void on_icon_theme_changed			    (GtkIconTheme * theme,
+							     GeditFileBrowserStore * model);
 
 GEDIT_PLUGIN_DEFINE_TYPE_WITH_CODE (GeditFileBrowserStore, gedit_file_browser_store,
 			G_TYPE_OBJECT,
@@ -263,6 +350,11 @@ gedit_file_browser_store_finalize (GObject * object)
 	cancel_mount_operation (obj);
 
 	g_slist_free (obj->priv->async_handles);
+
+	g_signal_handler_disconnect (gtk_icon_theme_get_default (),
+				     obj->priv->icon_theme_changed_id);
+	g_hash_table_destroy (obj->priv->emblem_icons);
+
 	G_OBJECT_CLASS (gedit_file_browser_store_parent_class)->finalize (object);
 }
 
@@ -453,6 +545,34 @@ gedit_file_browser_store_drag_source_init (GtkTreeDragSourceIface * iface)
 	iface->drag_data_get = gedit_file_browser_store_drag_data_get;
 }
 
+static guint
+emblem_key_hash (gconstpointer key)
+{
+	const EmblemKey *k = key;
+
+	return g_direct_hash (k->icon) ^ g_direct_hash (k->emblem);
+}
+
+static gboolean
+emblem_key_equal (gconstpointer a,
+		  gconstpointer b)
+{
+	const EmblemKey *k1 = a;
+	const EmblemKey *k2 = b;
+
+	return k1->icon == k2->icon && k1->emblem == k2->emblem;
+}
+
+static void
+emblem_key_free (EmblemKey * key)
+{
+	if (key->icon)
+		g_object_unref (key->icon);
+
+	g_object_unref (key->emblem);
+	g_slice_free (EmblemKey, key);
+}
+
 static void
 gedit_file_browser_store_init (GeditFileBrowserStore * obj)
 {
@@ -472,6 +592,17 @@ gedit_file_browser_store_init (GeditFileBrowserStore * obj)
 	// Default filter mode is hiding the hidden files
 	obj->priv->filter_mode = gedit_file_browser_store_filter_mode_get_default ();
 	obj->priv->sort_func = model_sort_default;
+
+	obj->priv->emblem_icons = g_hash_table_new_full (emblem_key_hash,
+							 emblem_key_equal,
+							 (GDestroyNotify) emblem_key_free,
+							 g_object_unref);
+
+	obj->priv->icon_theme_changed_id =
+		g_signal_connect (gtk_icon_theme_get_default (),
+				  "changed",
+				  G_CALLBACK (on_icon_theme_changed),
+				  obj);
 }
 
 static gboolean
@@ -511,11 +642,302 @@ model_node_visibility (GeditFileBrowserStore * model,
 	return !NODE_IS_FILTERED (node);
 }
 
-static gboolean
-model_node_inserted (GeditFileBrowserStore * model,
+static gint
+model_compare_nodes (gconstpointer a,
+		     gconstpointer b,
+		     gpointer user_data)
+{
+	GeditFileBrowserStore *model = GEDIT_FILE_BROWSER_STORE (user_data);
+	gboolean dummy1 = NODE_IS_DUMMY ((FileBrowserNode *) a);
+	gboolean dummy2 = NODE_IS_DUMMY ((FileBrowserNode *) b);
+
+	/* The dummy always comes first */
+	if (dummy1 != dummy2)
+		return dummy1 ? -1 : 1;
+
+	/* Without sort func the nodes are appended */
+	if (model->priv->sort_func == NULL)
+		return 0;
+
+	return model->priv->sort_func ((FileBrowserNode *) a,
+				       (FileBrowserNode *) b);
+}
+
+static FileBrowserNode *
+node_get_child (FileBrowserNode * node,
+		GSequenceIter * iter)
+{
+	if (g_sequence_iter_is_end (iter))
+		return NULL;
+
+	return (FileBrowserNode *) g_sequence_get (iter);
+}
+
+/* The children of @node in a list, to be able to change them while
+ * going through the list */
+static GSList *
+node_copy_children (FileBrowserNode * node)
+{
+	GSequenceIter *item;
+	GSList *list = NULL;
+
+	item = g_sequence_get_end_iter (FILE_BROWSER_NODE_DIR (node)->children);
+
+	while (!g_sequence_iter_is_begin (item)) {
+		item = g_sequence_iter_prev (item);
+		list = g_slist_prepend (list, g_sequence_get (item));
+	}
+
+	return list;
+}
+
+static FileBrowserNode *
+node_find_child (FileBrowserNode * node,
+		 GFile * file)
+{
+	FileBrowserNode *child;
+	gchar *name;
+
+	name = g_file_get_basename (file);
+	child = g_hash_table_lookup (FILE_BROWSER_NODE_DIR (node)->children_hash,
+				     name);
+	g_free (name);
+
+	if (child != NULL && g_file_equal (child->file, file))
+		return child;
+
+	return NULL;
+}
+
+static void
+node_hash_child (FileBrowserNode * node,
+		 FileBrowserNode * child)
+{
+	if (child->file != NULL)
+		g_hash_table_insert (FILE_BROWSER_NODE_DIR (node)->children_hash,
+				     g_file_get_basename (child->file),
+				     child);
+}
+
+static void
+node_unhash_child (FileBrowserNode * node,
+		   FileBrowserNode * child,
+		   GFile * file)
+{
+	GHashTable *hash = FILE_BROWSER_NODE_DIR (node)->children_hash;
+	gchar *name;
+
+	if (file == NULL)
+		return;
+
+	name = g_file_get_basename (file);
+
+	if (g_hash_table_lookup (hash, name) == child)
+		g_hash_table_remove (hash, name);
+
+	g_free (name);
+}
+
+static void
+node_remove_child (FileBrowserNode * node,
+		   FileBrowserNode * child)
+{
+	node_unhash_child (node, child, child->file);
+
+	if (child->inserted_iter != NULL) {
+		g_sequence_remove (child->inserted_iter);
+		child->inserted_iter = NULL;
+	}
+
+	g_sequence_remove (child->iter);
+	child->iter = NULL;
+}
+
+static void
+model_node_set_inserted (GeditFileBrowserStore * model,
+			 FileBrowserNode * node,
+			 gboolean inserted)
+{
+	FileBrowserNodeDir *dir;
+
+	if (node->parent == NULL || inserted == (node->inserted_iter != NULL))
+		return;
+
+	dir = FILE_BROWSER_NODE_DIR (node->parent);
+
+	if (inserted) {
+		node->inserted_iter = g_sequence_insert_sorted (dir->inserted,
+								node,
+								model_compare_nodes,
+								model);
+	} else {
+		g_sequence_remove (node->inserted_iter);
+		node->inserted_iter = NULL;
+	}
+}
+
+/* Position of the node among the inserted children of its parent, or
+ * the position it will have once inserted */
+static gint
+model_node_position (GeditFileBrowserStore * model,
+		     FileBrowserNode * node)
+{
+	GSequenceIter *iter;
+
+	if (node->inserted_iter != NULL)
+		return g_sequence_iter_get_position (node->inserted_iter);
+
+	iter = g_sequence_search (FILE_BROWSER_NODE_DIR (node->parent)->inserted,
+				  node,
+				  model_compare_nodes,
+				  model);
+
+	return g_sequence_iter_get_position (iter);
+}
+
+/* The icon composited with the emblem, shared by the nodes with the same
+ * icon and emblem */
+static GdkPixbuf *
+model_get_emblem_icon (GeditFileBrowserStore * model,
+		       GdkPixbuf * icon,
+		       GdkPixbuf * emblem)
+{
+	EmblemKey key;
+	EmblemKey *new_key;
+	GdkPixbuf *ret;
+	gint icon_size;
+
+	key.icon = icon;
+	key.emblem = emblem;
+
+	ret = g_hash_table_lookup (model->priv->emblem_icons, &key);
+
+	if (ret != NULL)
+		return ret;
+
+	gtk_icon_size_lookup (GTK_ICON_SIZE_MENU, NULL, &icon_size);
+
+	if (icon == NULL) {
+		ret = gdk_pixbuf_new (gdk_pixbuf_get_colorspace (emblem),
+				      gdk_pixbuf_get_has_alpha (emblem),
+				      gdk_pixbuf_get_bits_per_sample (emblem),
+				      icon_size,
+				      icon_size);
+	} else {
+		ret = gdk_pixbuf_copy (icon);
+	}
+
+	gdk_pixbuf_composite (emblem, ret,
+			      icon_size - 10, icon_size - 10, 10,
+			      10, icon_size - 10, icon_size - 10,
+			      1, 1, GDK_INTERP_NEAREST, 255);
+
+	/* The nodes keep their icon, the composited icons of files that
+	 * are gone can be dropped */
+	if (g_hash_table_size (model->priv->emblem_icons) >= EMBLEM_ICONS_MAX)
+		g_hash_table_remove_all (model->priv->emblem_icons);
+
+	new_key = g_slice_new (EmblemKey);
+	new_key->icon = icon ? g_object_ref (icon) : NULL;
+	new_key->emblem = g_object_ref (emblem);
+
+	g_hash_table_insert (model->priv->emblem_icons, new_key, ret);
+
+	return ret;
+}
+
+static GdkPixbuf *
+model_node_get_icon (GeditFileBrowserStore * model,
 		     FileBrowserNode * node)
 {
-	return node == model->priv->virtual_root || (model_node_visibility (model, node) && node->inserted);
+	GdkPixbuf *icon;
+
+	if (node->icon != NULL || node->file == NULL)
+		return node->icon;
+
+	icon = gedit_file_browser_utils_pixbuf_from_icon (node->gicon,
+							  GTK_ICON_SIZE_MENU);
+
+	if (node->emblem) {
+		node->icon = g_object_ref (model_get_emblem_icon (model,
+								  icon,
+								  node->emblem));
+
+		if (icon)
+			g_object_unref (icon);
+	} else {
+		node->icon = icon;
+	}
+
+	return node->icon;
+}
+
+/* Forgets the pixbufs of @node and its children, they are looked up
+ * again when the rows are shown */
+static void
+model_forget_icons (FileBrowserNode * node)
+{
+	GSequenceIter *item;
+
+	if (node->icon) {
+		g_object_unref (node->icon);
+		node->icon = NULL;
+	}
+
+	if (!NODE_IS_DIR (node))
+		return;
+
+	for (item = g_sequence_get_begin_iter (FILE_BROWSER_NODE_DIR (node)->children);
+	     !g_sequence_iter_is_end (item);
+	     item = g_sequence_iter_next (item)) {
+		model_forget_icons ((FileBrowserNode *) g_sequence_get (item));
+	}
+}
+
+/* Emits row-changed for all the rows below @node */
+static void
+model_rows_changed (GeditFileBrowserStore * model,
+		    FileBrowserNode * node,
+		    GtkTreePath * path)
+{
+	GSequenceIter *item;
+	GtkTreeIter iter;
+
+	if (!NODE_IS_DIR (node))
+		return;
+
+	gtk_tree_path_down (path);
+
+	for (item = g_sequence_get_begin_iter (FILE_BROWSER_NODE_DIR (node)->inserted);
+	     !g_sequence_iter_is_end (item);
+	     item = g_sequence_iter_next (item)) {
+		iter.user_data = g_sequence_get (item);
+
+		gtk_tree_model_row_changed (GTK_TREE_MODEL (model), path, &iter);
+		model_rows_changed (model, (FileBrowserNode *) iter.user_data, path);
+
+		gtk_tree_path_next (path);
+	}
+
+	gtk_tree_path_up (path);
+}
+
+static void
+on_icon_theme_changed (GtkIconTheme * theme,
+		       GeditFileBrowserStore * model)
+{
+	GtkTreePath *path;
+
+	g_hash_table_remove_all (model->priv->emblem_icons);
+
+	if (model->priv->root == NULL || model->priv->virtual_root == NULL)
+		return;
+
+	model_forget_icons (model->priv->root);
+
+	path = gtk_tree_path_new ();
+	model_rows_changed (model, model->priv->virtual_root, path);
+	gtk_tree_path_free (path);
 }
 
 /* Interface implementation */
@@ -555,7 +977,6 @@ gedit_file_browser_store_get_iter (GtkTreeModel * tree_model,
 	gint * indices, depth, i;
 	FileBrowserNode * node;
 	GeditFileBrowserStore * model;
-	gint num;
 
 	g_assert (GEDIT_IS_FILE_BROWSER_STORE (tree_model));
 	g_assert (path != NULL);
@@ -566,35 +987,15 @@ gedit_file_browser_store_get_iter (GtkTreeModel * tree_model,
 	node = model->priv->virtual_root;
 
 	for (i = 0; i < depth; ++i) {
-		GSList * item;
-
 		if (node == NULL)
 			return FALSE;
 
-		num = 0;
-
 		if (!NODE_IS_DIR (node))
 			return FALSE;
 
-		for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next) {
-			FileBrowserNode * child;
-
-			child = (FileBrowserNode *) (item->data);
-
-			if (model_node_inserted (model, child)) {
-				if (num == indices[i]) {
-					node = child;
-					break;
-				}
-
-				num++;
-			}
-		}
-
-		if (item == NULL)
-			return FALSE;
-
-		node = (FileBrowserNode *) (item->data);
+		node = node_get_child (node,
+				       g_sequence_get_iter_at_pos (FILE_BROWSER_NODE_DIR (node)->inserted,
+								   indices[i]));
 	}
 
 	iter->user_data = node;
@@ -609,42 +1010,26 @@ gedit_file_browser_store_get_path_real (GeditFileBrowserStore * model,
 					FileBrowserNode * node)
 {
 	GtkTreePath *path;
-	gint num = 0;
 
 	path = gtk_tree_path_new ();
 
 	while (node != model->priv->virtual_root) {
-		GSList *item;
-
 		if (node->parent == NULL) {
 			gtk_tree_path_free (path);
 			return NULL;
 		}
 
-		num = 0;
-
-		for (item = FILE_BROWSER_NODE_DIR (node->parent)->children; item; item = item->next) {
-			FileBrowserNode *check;
-
-			check = (FileBrowserNode *) (item->data);
-
-			if (model_node_visibility (model, check) && (check == node || check->inserted)) {
-				if (check == node) {
-					gtk_tree_path_prepend_index (path,
-								     num);
-					break;
-				}
-
-				++num;
-			} else if (check == node) {
-				if (NODE_IS_DUMMY (node))
-					g_warning ("Dummy not visible???");
+		if (!model_node_visibility (model, node)) {
+			if (NODE_IS_DUMMY (node))
+				g_warning ("Dummy not visible???");
 
-				gtk_tree_path_free (path);
-				return NULL;
-			}
+			gtk_tree_path_free (path);
+			return NULL;
 		}
 
+		gtk_tree_path_prepend_index (path,
+					     model_node_position (model, node));
+
 		node = node->parent;
 	}
 
@@ -690,7 +1075,9 @@ gedit_file_browser_store_get_value (GtkTreeModel * tree_model,
 		g_value_set_uint (value, node->flags);
 		break;
 	case GEDIT_FILE_BROWSER_STORE_COLUMN_ICON:
-		g_value_set_object (value, node->icon);
+		g_value_set_object (value,
+				    model_node_get_icon (GEDIT_FILE_BROWSER_STORE (tree_model),
+							 node));
 		break;
 	case GEDIT_FILE_BROWSER_STORE_COLUMN_EMBLEM:
 		g_value_set_object (value, node->emblem);
@@ -704,32 +1091,26 @@ static gboolean
 gedit_file_browser_store_iter_next (GtkTreeModel * tree_model,
 				    GtkTreeIter * iter)
 {
-	GeditFileBrowserStore * model;
 	FileBrowserNode * node;
-	GSList * item;
-	GSList * first;
 
 	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model),
 			      FALSE);
 	g_return_val_if_fail (iter != NULL, FALSE);
 	g_return_val_if_fail (iter->user_data != NULL, FALSE);
 
-	model = GEDIT_FILE_BROWSER_STORE (tree_model);
 	node = (FileBrowserNode *) (iter->user_data);
 
-	if (node->parent == NULL)
+	if (node->parent == NULL || node->inserted_iter == NULL)
 		return FALSE;
 
-	first = g_slist_next (g_slist_find (FILE_BROWSER_NODE_DIR (node->parent)->children, node));
+	node = node_get_child (node->parent,
+			       g_sequence_iter_next (node->inserted_iter));
 
-	for (item = first; item; item = item->next) {
-		if (model_node_inserted (model, (FileBrowserNode *) (item->data))) {
-			iter->user_data = item->data;
-			return TRUE;
-		}
-	}
+	if (node == NULL)
+		return FALSE;
 
-	return FALSE;
+	iter->user_data = node;
+	return TRUE;
 }
 
 static gboolean
@@ -738,8 +1119,8 @@ gedit_file_browser_store_iter_children (GtkTreeModel * tree_model,
 					GtkTreeIter * parent)
 {
 	FileBrowserNode * node;
+	FileBrowserNode * child;
 	GeditFileBrowserStore * model;
-	GSList * item;
 
 	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model),
 			      FALSE);
@@ -759,31 +1140,24 @@ gedit_file_browser_store_iter_children (GtkTreeModel * tree_model,
 	if (!NODE_IS_DIR (node))
 		return FALSE;
 
-	for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next) {
-		if (model_node_inserted (model, (FileBrowserNode *) (item->data))) {
-			iter->user_data = item->data;
-			return TRUE;
-		}
-	}
+	child = node_get_child (node,
+				g_sequence_get_begin_iter (FILE_BROWSER_NODE_DIR (node)->inserted));
 
-	return FALSE;
+	if (child == NULL)
+		return FALSE;
+
+	iter->user_data = child;
+	return TRUE;
 }
 
 static gboolean
 filter_tree_model_iter_has_child_real (GeditFileBrowserStore * model,
 				       FileBrowserNode * node)
 {
-	GSList *item;
-	
 	if (!NODE_IS_DIR (node))
 		return FALSE;
 
-	for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next) {
-		if (model_node_inserted (model, (FileBrowserNode *) (item->data)))
-			return TRUE;
-	}
-
-	return FALSE;
+	return g_sequence_get_length (FILE_BROWSER_NODE_DIR (node)->inserted) > 0;
 }
 
 static gboolean
@@ -814,8 +1188,6 @@ gedit_file_browser_store_iter_n_children (GtkTreeModel * tree_model,
 {
 	FileBrowserNode *node;
 	GeditFileBrowserStore *model;
-	GSList *item;
-	gint num = 0;
 
 	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model),
 			      FALSE);
@@ -832,11 +1204,7 @@ gedit_file_browser_store_iter_n_children (GtkTreeModel * tree_model,
 	if (!NODE_IS_DIR (node))
 		return 0;
 
-	for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
-		if (model_node_inserted (model, (FileBrowserNode *) (item->data)))
-			++num;
-
-	return num;
+	return g_sequence_get_length (FILE_BROWSER_NODE_DIR (node)->inserted);
 }
 
 static gboolean
@@ -845,9 +1213,8 @@ gedit_file_browser_store_iter_nth_child (GtkTreeModel * tree_model,
 					 GtkTreeIter * parent, gint n)
 {
 	FileBrowserNode *node;
+	FileBrowserNode *child;
 	GeditFileBrowserStore *model;
-	GSList *item;
-	gint num = 0;
 
 	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model),
 			      FALSE);
@@ -861,22 +1228,17 @@ gedit_file_browser_store_iter_nth_child (GtkTreeModel * tree_model,
 	else
 		node = (FileBrowserNode *) (parent->user_data);
 
-	if (!NODE_IS_DIR (node))
+	if (!NODE_IS_DIR (node) || n < 0)
 		return FALSE;
 
-	for (item = FILE_BROWSER_NODE_DIR (node)->children; item;
-	     item = item->next) {
-		if (model_node_inserted (model, (FileBrowserNode *) (item->data))) {
-			if (num == n) {
-				iter->user_data = item->data;
-				return TRUE;
-			}
+	child = node_get_child (node,
+				g_sequence_get_iter_at_pos (FILE_BROWSER_NODE_DIR (node)->inserted, n));
 
-			++num;
-		}
-	}
+	if (child == NULL)
+		return FALSE;
 
-	return FALSE;
+	iter->user_data = child;
+	return TRUE;
 }
 
 static gboolean
@@ -911,7 +1273,7 @@ gedit_file_browser_store_row_inserted (GtkTreeModel * tree_model,
 {
 	FileBrowserNode * node = (FileBrowserNode *)(iter->user_data);
 	
-	node->inserted = TRUE;
+	model_node_set_inserted (GEDIT_FILE_BROWSER_STORE (tree_model), node, TRUE);
 }
 
 static gboolean
@@ -1021,24 +1383,12 @@ model_node_update_visibility (GeditFileBrowserStore * model,
 static gint
 collate_nodes (FileBrowserNode * node1, FileBrowserNode * node2)
 {
-	if (node1->name == NULL)
+	if (node1->collate_key == NULL)
 		return -1;
-	else if (node2->name == NULL)
+	else if (node2->collate_key == NULL)
 		return 1;
-	else {
-		gchar *k1, *k2;
-		gint result;
-
-		k1 = g_utf8_collate_key_for_filename (node1->name, -1);
-		k2 = g_utf8_collate_key_for_filename (node2->name, -1);
-
-		result = strcmp (k1, k2);
-
-		g_free (k1);
-		g_free (k2);
-
-		return result;
-	}
+	else
+		return strcmp (node1->collate_key, node2->collate_key);
 }
 
 static gint
@@ -1078,11 +1428,24 @@ model_sort_default (FileBrowserNode * node1, FileBrowserNode * node2)
 	return collate_nodes (node1, node2);
 }
 
+/* Moves @node to its place after something it is sorted on changed */
+static void
+model_node_sort_changed (GeditFileBrowserStore * model,
+			 FileBrowserNode * node)
+{
+	g_sequence_sort_changed (node->iter, model_compare_nodes, model);
+
+	if (node->inserted_iter != NULL)
+		g_sequence_sort_changed (node->inserted_iter,
+					 model_compare_nodes,
+					 model);
+}
+
 static void
 model_resort_node (GeditFileBrowserStore * model, FileBrowserNode * node)
 {
 	FileBrowserNodeDir *dir;
-	GSList *item;
+	GSequenceIter *item;
 	FileBrowserNode *child;
 	gint pos = 0;
 	GtkTreeIter iter;
@@ -1092,31 +1455,28 @@ model_resort_node (GeditFileBrowserStore * model, FileBrowserNode * node)
 	dir = FILE_BROWSER_NODE_DIR (node->parent);
 
 	if (!model_node_visibility (model, node->parent)) {
-		/* Just sort the children of the parent */
-		dir->children = g_slist_sort (dir->children,
-					      (GCompareFunc) (model->priv->
-							      sort_func));
+		/* Just move the node among the children of the parent */
+		model_node_sort_changed (model, node);
 	} else {
 		/* Store current positions */
-		for (item = dir->children; item; item = item->next) {
-			child = (FileBrowserNode *) (item->data);
-
-			if (model_node_visibility (model, child))
-				child->pos = pos++;
+		for (item = g_sequence_get_begin_iter (dir->inserted);
+		     !g_sequence_iter_is_end (item);
+		     item = g_sequence_iter_next (item)) {
+			child = (FileBrowserNode *) g_sequence_get (item);
+			child->pos = pos++;
 		}
 
-		dir->children = g_slist_sort (dir->children,
-					      (GCompareFunc) (model->priv->
-							      sort_func));
+		model_node_sort_changed (model, node);
+
 		neworder = g_new (gint, pos);
 		pos = 0;
 
 		/* Store the new positions */
-		for (item = dir->children; item; item = item->next) {
-			child = (FileBrowserNode *) (item->data);
-
-			if (model_node_visibility (model, child))
-				neworder[pos++] = child->pos;
+		for (item = g_sequence_get_begin_iter (dir->inserted);
+		     !g_sequence_iter_is_end (item);
+		     item = g_sequence_iter_next (item)) {
+			child = (FileBrowserNode *) g_sequence_get (item);
+			neworder[pos++] = child->pos;
 		}
 
 		iter.user_data = node->parent;
@@ -1199,7 +1559,7 @@ model_refilter_node (GeditFileBrowserStore * model,
 	gboolean old_visible;
 	gboolean new_visible;
 	FileBrowserNodeDir *dir;
-	GSList *item;
+	GSequenceIter *item;
 	GtkTreeIter iter;
 	GtkTreePath *tmppath = NULL;
 	gboolean in_tree;
@@ -1229,9 +1589,11 @@ model_refilter_node (GeditFileBrowserStore * model,
 
 		dir = FILE_BROWSER_NODE_DIR (node);
 
-		for (item = dir->children; item; item = item->next) {
+		for (item = g_sequence_get_begin_iter (dir->children);
+		     !g_sequence_iter_is_end (item);
+		     item = g_sequence_iter_next (item)) {
 			model_refilter_node (model,
-					     (FileBrowserNode *) (item->data),
+					     (FileBrowserNode *) g_sequence_get (item),
 					     path);
 		}
 
@@ -1244,7 +1606,7 @@ model_refilter_node (GeditFileBrowserStore * model,
 
 		if (old_visible != new_visible) {
 			if (old_visible) {
-				node->inserted = FALSE;
+				model_node_set_inserted (model, node, FALSE);
 				row_deleted (model, *path);
 			} else {
 				iter.user_data = node;
@@ -1272,11 +1634,14 @@ static void
 file_browser_node_set_name (FileBrowserNode * node)
 {
 	g_free (node->name);
+	g_free (node->collate_key);
 
 	if (node->file) {
 		node->name = gedit_file_browser_utils_file_basename (node->file);
+		node->collate_key = g_utf8_collate_key_for_filename (node->name, -1);
 	} else {
 		node->name = NULL;
+		node->collate_key = NULL;
 	}
 }
 
@@ -1313,6 +1678,10 @@ file_browser_node_dir_new (GeditFileBrowserStore * model,
 	node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_DIRECTORY;
 
 	FILE_BROWSER_NODE_DIR (node)->model = model;
+	FILE_BROWSER_NODE_DIR (node)->children = g_sequence_new (NULL);
+	FILE_BROWSER_NODE_DIR (node)->inserted = g_sequence_new (NULL);
+	FILE_BROWSER_NODE_DIR (node)->children_hash =
+		g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
 	return node;
 }
@@ -1321,20 +1690,40 @@ static void
 file_browser_node_free_children (GeditFileBrowserStore * model,
 				 FileBrowserNode * node)
 {
-	GSList *item;
+	FileBrowserNodeDir *dir;
+	GSequence *children;
+	GSequence *inserted;
+	GSequenceIter *item;
 
 	if (node == NULL)
 		return;
 
 	if (NODE_IS_DIR (node)) {
-		for (item = FILE_BROWSER_NODE_DIR (node)->children; item;
-		     item = item->next)
-			file_browser_node_free (model,
-						(FileBrowserNode *) (item->
-								     data));
+		dir = FILE_BROWSER_NODE_DIR (node);
+
+		/* Detach the children first, freeing them must not
+		 * change the sequences we go through */
+		children = dir->children;
+		inserted = dir->inserted;
+
+		dir->children = g_sequence_new (NULL);
+		dir->inserted = g_sequence_new (NULL);
+		g_hash_table_remove_all (dir->children_hash);
 
-		g_slist_free (FILE_BROWSER_NODE_DIR (node)->children);
-		FILE_BROWSER_NODE_DIR (node)->children = NULL;
+		for (item = g_sequence_get_begin_iter (children);
+		     !g_sequence_iter_is_end (item);
+		     item = g_sequence_iter_next (item)) {
+			FileBrowserNode *child;
+
+			child = (FileBrowserNode *) g_sequence_get (item);
+			child->iter = NULL;
+			child->inserted_iter = NULL;
+
+			file_browser_node_free (model, child);
+		}
+
+		g_sequence_free (children);
+		g_sequence_free (inserted);
 
 		/* This node is no longer loaded */
 		node->flags &= ~GEDIT_FILE_BROWSER_STORE_FLAG_LOADED;
@@ -1365,13 +1754,14 @@ file_browser_node_free (GeditFileBrowserStore * model,
 
 		file_browser_node_free_children (model, node);
 
-		if (dir->monitor) {
-			g_file_monitor_cancel (dir->monitor);
-			g_object_unref (dir->monitor);
-		}
+		model_stop_monitor (dir);
 
 		if (dir->hidden_file_hash)
 			g_hash_table_destroy (dir->hidden_file_hash);
+
+		g_sequence_free (dir->children);
+		g_sequence_free (dir->inserted);
+		g_hash_table_destroy (dir->children_hash);
 	}
 	
 	if (node->file)
@@ -1383,6 +1773,9 @@ file_browser_node_free (GeditFileBrowserStore * model,
 		g_object_unref (node->file);
 	}
 
+	if (node->gicon)
+		g_object_unref (node->gicon);
+
 	if (node->icon)
 		g_object_unref (node->icon);
 
@@ -1390,6 +1783,7 @@ file_browser_node_free (GeditFileBrowserStore * model,
 		g_object_unref (node->emblem);
 
 	g_free (node->name);
+	g_free (node->collate_key);
 	
 	if (NODE_IS_DIR (node))
 		g_slice_free (FileBrowserNodeDir, (FileBrowserNodeDir *)node);
@@ -1424,7 +1818,7 @@ model_remove_node_children (GeditFileBrowserStore * model,
 
 	dir = FILE_BROWSER_NODE_DIR (node);
 
-	if (dir->children == NULL)
+	if (g_sequence_get_length (dir->children) == 0)
 		return;
 
 	if (!model_node_visibility (model, node)) {
@@ -1444,7 +1838,7 @@ model_remove_node_children (GeditFileBrowserStore * model,
 
 	gtk_tree_path_down (path_child);
 
-	list = g_slist_copy (dir->children);
+	list = node_copy_children (node);
 
 	for (item = list; item; item = item->next) {
 		model_remove_node (model, (FileBrowserNode *) (item->data),
@@ -1468,10 +1862,11 @@ model_remove_node_children (GeditFileBrowserStore * model,
  * a node.
  **/
 static void
-model_remove_node (GeditFileBrowserStore * model,
-		   FileBrowserNode * node,
-		   GtkTreePath * path,
-		   gboolean free_nodes)
+model_remove_node_real (GeditFileBrowserStore * model,
+			FileBrowserNode * node,
+			GtkTreePath * path,
+			gboolean free_nodes,
+			gboolean check_dummy)
 {
 	gboolean free_path = FALSE;
 	FileBrowserNode *parent;
@@ -1488,7 +1883,7 @@ model_remove_node (GeditFileBrowserStore * model,
 	   not the virtual root) */
 	if (model_node_visibility (model, node) && node != model->priv->virtual_root)
 	{
-		node->inserted = FALSE;
+		model_node_set_inserted (model, node, FALSE);
 		row_deleted (model, path);
 	}
 
@@ -1500,16 +1895,13 @@ model_remove_node (GeditFileBrowserStore * model,
 	if (free_nodes) {
 		/* Remove the node from the parents children list */
 		if (parent)
-			FILE_BROWSER_NODE_DIR (node->parent)->children =
-			    g_slist_remove (FILE_BROWSER_NODE_DIR
-					    (node->parent)->children,
-					    node);
+			node_remove_child (parent, node);
 	}
 	
 	/* If this is the virtual root, than set the parent as the virtual root */
 	if (node == model->priv->virtual_root)
 		set_virtual_root_from_node (model, parent);
-	else if (parent && model_node_visibility (model, parent) && !(free_nodes && NODE_IS_DUMMY(node)))
+	else if (check_dummy && parent && model_node_visibility (model, parent) && !(free_nodes && NODE_IS_DUMMY(node)))
 		model_check_dummy (model, parent);
 
 	/* Now free the node if necessary */
@@ -1517,6 +1909,47 @@ model_remove_node (GeditFileBrowserStore * model,
 		file_browser_node_free (model, node);
 }
 
+static void
+model_remove_node (GeditFileBrowserStore * model,
+		   FileBrowserNode * node,
+		   GtkTreePath * path,
+		   gboolean free_nodes)
+{
+	model_remove_node_real (model, node, path, free_nodes, TRUE);
+}
+
+/* Removes and frees the @nodes children of @parent, checking the dummy
+ * of @parent only once */
+static void
+model_remove_nodes_batch (GeditFileBrowserStore * model,
+			  GSList * nodes,
+			  FileBrowserNode * parent)
+{
+	GSList *item;
+	gboolean virtual_root = FALSE;
+
+	for (item = nodes; item; item = item->next) {
+		FileBrowserNode *node = (FileBrowserNode *) (item->data);
+
+		if (node == model->priv->virtual_root) {
+			virtual_root = TRUE;
+			continue;
+		}
+
+		model_remove_node_real (model, node, NULL, TRUE, FALSE);
+	}
+
+	if (virtual_root) {
+		/* This changes the virtual root, do it once the others
+		 * are gone */
+		model_remove_node (model, model->priv->virtual_root, NULL, TRUE);
+		return;
+	}
+
+	if (model_node_visibility (model, parent))
+		model_check_dummy (model, parent);
+}
+
 /**
  * model_clear:
  * @model: the #GeditFileBrowserStore
@@ -1542,14 +1975,17 @@ model_clear (GeditFileBrowserStore * model, gboolean free_nodes)
 	if (model->priv->virtual_root) {
 		dir = FILE_BROWSER_NODE_DIR (model->priv->virtual_root);
 
-		if (dir->children != NULL) {
-			dummy = (FileBrowserNode *) (dir->children->data);
+		dummy = node_get_child (model->priv->virtual_root,
+					g_sequence_get_begin_iter (dir->children));
 
+		if (dummy != NULL) {
 			if (NODE_IS_DUMMY (dummy)
 			    && model_node_visibility (model, dummy)) {
 				path = gtk_tree_path_new_first ();
 				
-				dummy->inserted = FALSE;
+				dummy->flags |=
+				    GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
+				model_node_set_inserted (model, dummy, FALSE);
 				row_deleted (model, path);
 				gtk_tree_path_free (path);
 			}
@@ -1582,22 +2018,19 @@ file_browser_node_unload (GeditFileBrowserStore * model,
 		dir->cancellable = NULL;
 	}
 
-	if (dir->monitor) {
-		g_file_monitor_cancel (dir->monitor);
-		g_object_unref (dir->monitor);
-		
-		dir->monitor = NULL;
-	}
+	model_stop_monitor (dir);
 
 	node->flags &= ~GEDIT_FILE_BROWSER_STORE_FLAG_LOADED;
 }
 
+/* Only forgets the pixbuf, it is looked up again when the row is shown.
+ * Without @info the icon is queried from the file. */
 static void
 model_recomposite_icon_real (GeditFileBrowserStore * tree_model,
 			     FileBrowserNode * node,
 			     GFileInfo * info)
 {
-	GdkPixbuf *icon;
+	gboolean free_info = FALSE;
 
 	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model));
 	g_return_if_fail (node != NULL);
@@ -1605,42 +2038,28 @@ model_recomposite_icon_real (GeditFileBrowserStore * tree_model,
 	if (node->file == NULL)
 		return;
 
-	if (info) {
-		GIcon *gicon = g_file_info_get_icon (info);
-		if (gicon != NULL)
-			icon = gedit_file_browser_utils_pixbuf_from_icon (gicon, GTK_ICON_SIZE_MENU);
-		else
-			icon = NULL;
-	} else {
-		icon = gedit_file_browser_utils_pixbuf_from_file (node->file, GTK_ICON_SIZE_MENU);
+	if (info == NULL) {
+		info = g_file_query_info (node->file,
+					  G_FILE_ATTRIBUTE_STANDARD_ICON,
+					  G_FILE_QUERY_INFO_NONE,
+					  NULL,
+					  NULL);
+		free_info = TRUE;
 	}
 
-	if (node->icon)
-		g_object_unref (node->icon);
-
-	if (node->emblem) {
-		gint icon_size;
+	if (info) {
+		if (node->gicon)
+			g_object_unref (node->gicon);
 
-		gtk_icon_size_lookup (GTK_ICON_SIZE_MENU, NULL, &icon_size);
+		node->gicon = gedit_file_browser_utils_icon_intern (g_file_info_get_icon (info));
 
-		if (icon == NULL) {
-			node->icon =
-			    gdk_pixbuf_new (gdk_pixbuf_get_colorspace (node->emblem),
-					    gdk_pixbuf_get_has_alpha (node->emblem),
-					    gdk_pixbuf_get_bits_per_sample (node->emblem),
-					    icon_size,
-					    icon_size);
-		} else {
-			node->icon = gdk_pixbuf_copy (icon);
-			g_object_unref (icon);
-		}
+		if (free_info)
+			g_object_unref (info);
+	}
 
-		gdk_pixbuf_composite (node->emblem, node->icon,
-				      icon_size - 10, icon_size - 10, 10,
-				      10, icon_size - 10, icon_size - 10,
-				      1, 1, GDK_INTERP_NEAREST, 255);
-	} else {
-		node->icon = icon;
+	if (node->icon) {
+		g_object_unref (node->icon);
+		node->icon = NULL;
 	}
 }
 
@@ -1688,6 +2107,22 @@ model_add_dummy_node (GeditFileBrowserStore * model,
 	return dummy;
 }
 
+static void
+insert_node_sorted (GeditFileBrowserStore * model,
+		    FileBrowserNode * child,
+		    FileBrowserNode * parent)
+{
+	FileBrowserNodeDir *dir;
+
+	dir = FILE_BROWSER_NODE_DIR (parent);
+
+	child->iter = g_sequence_insert_sorted (dir->children,
+						child,
+						model_compare_nodes,
+						model);
+	node_hash_child (parent, child);
+}
+
 static void
 model_check_dummy (GeditFileBrowserStore * model, FileBrowserNode * node)
 {
@@ -1697,34 +2132,41 @@ model_check_dummy (GeditFileBrowserStore * model, FileBrowserNode * node)
 		GtkTreeIter iter;
 		GtkTreePath *path;
 		guint flags;
+		gint n_children;
 		FileBrowserNodeDir *dir;
 
 		dir = FILE_BROWSER_NODE_DIR (node);
 
-		if (dir->children == NULL) {
+		if (g_sequence_get_length (dir->children) == 0) {
 			model_add_dummy_node (model, node);
 			return;
 		}
 
-		dummy = (FileBrowserNode *) (dir->children->data);
+		dummy = node_get_child (node,
+					g_sequence_get_begin_iter (dir->children));
 
 		if (!NODE_IS_DUMMY (dummy)) {
 			dummy = model_create_dummy_node (model, node);
-			dir->children = g_slist_prepend (dir->children, dummy);
+			insert_node_sorted (model, dummy, node);
 		}
 
 		if (!model_node_visibility (model, node)) {
+			/* The node is not a row, the dummy can just go */
 			dummy->flags |=
 			    GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
+			model_node_set_inserted (model, dummy, FALSE);
 			return;
 		}
 
-		/* Temporarily set the node to invisible to check
-		 * for real children */
+		/* The rows other than the dummy are the real children */
+		n_children = g_sequence_get_length (dir->inserted);
+
+		if (dummy->inserted_iter != NULL)
+			n_children--;
+
 		flags = dummy->flags;
-		dummy->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
 
-		if (!filter_tree_model_iter_has_child_real (model, node)) {
+		if (n_children == 0) {
 			dummy->flags &=
 			    ~GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
 
@@ -1742,16 +2184,13 @@ model_check_dummy (GeditFileBrowserStore * model, FileBrowserNode * node)
 			if (!FILE_IS_HIDDEN (flags)) {
 				// Was shown, needs to be removed
 
-				// To get the path we need to set it to visible temporarily
-				dummy->flags &=
-				    ~GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
 				path =
 				    gedit_file_browser_store_get_path_real
 				    (model, dummy);
 				dummy->flags |=
 				    GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
 				    
-				dummy->inserted = FALSE;
+				model_node_set_inserted (model, dummy, FALSE);
 				row_deleted (model, path);
 				gtk_tree_path_free (path);
 			}
@@ -1759,25 +2198,6 @@ model_check_dummy (GeditFileBrowserStore * model, FileBrowserNode * node)
 	}
 }
 
-static void
-insert_node_sorted (GeditFileBrowserStore * model,
-		    FileBrowserNode * child,
-		    FileBrowserNode * parent)
-{
-	FileBrowserNodeDir *dir;
-
-	dir = FILE_BROWSER_NODE_DIR (parent);
-
-	if (model->priv->sort_func == NULL) {
-		dir->children = g_slist_append (dir->children, child);
-	} else {
-		dir->children =
-		    g_slist_insert_sorted (dir->children, child,
-					   (GCompareFunc) (model->priv->
-							   sort_func));
-	}
-}
-
 static void
 model_add_node (GeditFileBrowserStore * model, FileBrowserNode * child,
 		FileBrowserNode * parent)
@@ -1807,101 +2227,176 @@ model_add_nodes_batch (GeditFileBrowserStore * model,
 		       GSList * children,
 		       FileBrowserNode * parent)
 {
-	GSList *sorted_children;
 	GSList *child;
-	GSList *prev;
-	GSList *l;
-	FileBrowserNodeDir *dir;
-
-	dir = FILE_BROWSER_NODE_DIR (parent);
-
-	sorted_children = g_slist_sort (children, (GCompareFunc) model->priv->sort_func);
-
-	child = sorted_children;
-	l = dir->children;
-	prev = NULL;
 
 	model_check_dummy (model, parent);
 
-	while (child) {
+	for (child = children; child; child = child->next) {
 		FileBrowserNode *node = child->data;
 		GtkTreeIter iter;
 		GtkTreePath *path;
 
-		/* reached the end of the first list, just append the second */
-		if (l == NULL) {
+		insert_node_sorted (model, node, parent);
 
-			dir->children = g_slist_concat (dir->children, child);
+		if (model_node_visibility (model, parent) &&
+		    model_node_visibility (model, node)) {
+			iter.user_data = node;
+			path = gedit_file_browser_store_get_path_real (model, node);
 
-			for (l = child; l; l = l->next) {
-				if (model_node_visibility (model, parent) &&
-				    model_node_visibility (model, l->data)) {
-					iter.user_data = l->data;
-					path = gedit_file_browser_store_get_path_real (model, l->data);
+			// Emit row inserted
+			row_inserted (model, &path, &iter);
+			gtk_tree_path_free (path);
+		}
 
-					// Emit row inserted
-					row_inserted (model, &path, &iter);
-					gtk_tree_path_free (path);
-				}
+		model_check_dummy (model, node);
+	}
 
-				model_check_dummy (model, l->data);
-			}
+	g_slist_free (children);
+}
 
-			break;
-		}
+static gchar const *
+backup_content_type (GFileInfo * info)
+{
+	gchar const * content;
+	
+	if (!g_file_info_get_is_backup (info))
+		return NULL;
+	
+	content = g_file_info_get_content_type (info);
+	
+	if (!content || g_content_type_equals (content, "application/x-trash"))
+		return "text/plain";
+	
+	return content;
+}
+
+static gboolean
+content_type_is_text (gchar const * content)
+{
+	return !content || 
+	       g_content_type_is_unknown (content) ||
+	       g_content_type_is_a (content, "text/plain");
+}
+
+static void
+classify_set_type (GFileInfo * info,
+		   gchar const * content_type,
+		   gboolean is_text)
+{
+	GIcon *icon;
+
+	g_file_info_set_content_type (info, content_type);
+	g_file_info_set_attribute_boolean (info, ATTRIBUTE_IS_TEXT, is_text);
+
+	/* The icon was guessed from the fast content type */
+	icon = g_content_type_get_icon (content_type);
+	g_file_info_set_icon (info, icon);
+	g_object_unref (icon);
+}
+
+/* Sets the content type of @info, listed without sniffing, from the type
+ * cache. Returns FALSE when the file has to be sniffed. */
+static gboolean
+classify_from_cache (gchar const * path,
+		     GFileInfo * info)
+{
+	gchar const *content;
+	gboolean is_text;
+
+	if (g_file_info_get_file_type (info) != G_FILE_TYPE_REGULAR)
+		return TRUE;
+
+	content = gedit_file_browser_type_cache_lookup (path,
+							g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED),
+							g_file_info_get_size (info),
+							&is_text);
+
+	if (content == NULL)
+		return FALSE;
+
+	classify_set_type (info, content, is_text);
+
+	return TRUE;
+}
+
+/* Remembers the sniffed content type of @info in the type cache */
+static void
+classify_remember (gchar const * path,
+		   GFileInfo * info)
+{
+	gchar const *content;
+	gchar *content_type;
+	gboolean is_text;
+
+	if (!g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE))
+		return;
+
+	if (!(content = backup_content_type (info)))
+		content = g_file_info_get_content_type (info);
+
+	is_text = content_type_is_text (content);
+
+	/* Setting it again frees the string of the info */
+	content_type = g_strdup (g_file_info_get_content_type (info));
+
+	gedit_file_browser_type_cache_insert (path,
+					      g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED),
+					      g_file_info_get_size (info),
+					      content_type,
+					      is_text);
+
+	classify_set_type (info, content_type, is_text);
+
+	g_free (content_type);
+}
 
-		if (model->priv->sort_func (l->data, node) > 0) {
-			GSList *next_child;
+/* Queries the info of @file. The content type of a local file comes from
+ * the type cache when the file was seen before. */
+static GFileInfo *
+model_query_info (GFile * file,
+		  GError ** error)
+{
+	GFileInfo *info;
+	GFileInfo *sniffed;
+	gchar *path;
 
-			if (prev == NULL) {
-				/* prepend to the list */
-				dir->children = g_slist_prepend (dir->children, child);
-			} else {
-				prev->next = child;
-			}
+	if (!g_file_is_native (file))
+		return g_file_query_info (file,
+					  STANDARD_ATTRIBUTE_TYPES,
+					  G_FILE_QUERY_INFO_NONE,
+					  NULL,
+					  error);
 
-			next_child = child->next;
-			prev = child;
-			child->next = l;
-			child = next_child;
+	info = g_file_query_info (file,
+				  LOCAL_ATTRIBUTE_TYPES,
+				  G_FILE_QUERY_INFO_NONE,
+				  NULL,
+				  error);
 
-			if (model_node_visibility (model, parent) &&
-			    model_node_visibility (model, node)) {
-				iter.user_data = node;
-				path = gedit_file_browser_store_get_path_real (model, node);
+	if (info == NULL)
+		return NULL;
 
-				// Emit row inserted
-				row_inserted (model, &path, &iter);
-				gtk_tree_path_free (path);
-			}
+	path = g_file_get_path (file);
 
-			model_check_dummy (model, node);
+	if (!classify_from_cache (path, info)) {
+		sniffed = g_file_query_info (file,
+					     G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE,
+					     G_FILE_QUERY_INFO_NONE,
+					     NULL,
+					     NULL);
 
-			/* try again at the same l position with the
-			 * next child */
-		} else {
+		if (sniffed != NULL) {
+			g_file_info_set_content_type (info,
+						      g_file_info_get_content_type (sniffed));
+			g_object_unref (sniffed);
 
-			/* Move to the next item in the list */
-			prev = l;
-			l = l->next;
+			classify_remember (path, info);
 		}
 	}
-}
 
-static gchar const *
-backup_content_type (GFileInfo * info)
-{
-	gchar const * content;
-	
-	if (!g_file_info_get_is_backup (info))
-		return NULL;
-	
-	content = g_file_info_get_content_type (info);
-	
-	if (!content || g_content_type_equals (content, "application/x-trash"))
-		return "text/plain";
-	
-	return content;
+	g_free (path);
+
+	return info;
 }
 
 static void
@@ -1919,11 +2414,7 @@ file_browser_node_set_from_info (GeditFileBrowserStore * model,
 	GError * error = NULL;
 
 	if (info == NULL) {
-		info = g_file_query_info (node->file,  
-					  STANDARD_ATTRIBUTE_TYPES,
-					  G_FILE_QUERY_INFO_NONE,
-					  NULL,
-					  &error);
+		info = model_query_info (node->file, &error);
 					  
 		if (!info) {
 			if (!(error->domain == G_IO_ERROR && error->code == G_IO_ERROR_NOT_FOUND)) {
@@ -1950,13 +2441,14 @@ file_browser_node_set_from_info (GeditFileBrowserStore * model,
 
 	if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
 		node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_DIRECTORY;
-	else {
+	else if (g_file_info_has_attribute (info, ATTRIBUTE_IS_TEXT)) {
+		if (g_file_info_get_attribute_boolean (info, ATTRIBUTE_IS_TEXT))
+			node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_TEXT;
+	} else {
 		if (!(content = backup_content_type (info)))
 			content = g_file_info_get_content_type (info);
 		
-		if (!content || 
-		    g_content_type_is_unknown (content) ||
-		    g_content_type_is_a (content, "text/plain"))
+		if (content_type_is_text (content))
 			node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_TEXT;		
 	}
 	
@@ -1976,24 +2468,6 @@ file_browser_node_set_from_info (GeditFileBrowserStore * model,
 	}
 }
 
-static FileBrowserNode *
-node_list_contains_file (GSList *children, GFile * file)
-{
-	GSList *item;
-
-	for (item = children; item; item = item->next) {
-		FileBrowserNode *node;
-
-		node = (FileBrowserNode *) (item->data);
-
-		if (node->file != NULL
-		    && g_file_equal (node->file, file))
-			return node;
-	}
-
-	return NULL;
-}
-
 static FileBrowserNode *
 model_add_node_from_file (GeditFileBrowserStore * model,
 			  FileBrowserNode * parent,
@@ -2004,13 +2478,9 @@ model_add_node_from_file (GeditFileBrowserStore * model,
 	gboolean free_info = FALSE;
 	GError * error = NULL;
 
-	if ((node = node_list_contains_file (FILE_BROWSER_NODE_DIR (parent)->children, file)) == NULL) {
+	if ((node = node_find_child (parent, file)) == NULL) {
 		if (info == NULL) {
-			info = g_file_query_info (file,
-						  STANDARD_ATTRIBUTE_TYPES,
-						  G_FILE_QUERY_INFO_NONE,
-						  NULL,
-						  &error);
+			info = model_query_info (file, &error);
 			free_info = TRUE;
 		}
 	
@@ -2036,13 +2506,9 @@ model_add_node_from_file (GeditFileBrowserStore * model,
 	return node;
 }
 
-/* We pass in a copy of the list of parent->children so that we do
- * not have to check if a file already exists among the ones we just
- * added */
 static void
 model_add_nodes_from_files (GeditFileBrowserStore * model,
 			    FileBrowserNode * parent,
-			    GSList * original_children,
 			    GList * files)
 {
 	GList *item;
@@ -2076,7 +2542,7 @@ model_add_nodes_from_files (GeditFileBrowserStore * model,
 
 		file = g_file_get_child (parent->file, name);
 
-		if ((node = node_list_contains_file (original_children, file)) == NULL) {
+		if ((node = node_find_child (parent, file)) == NULL) {
 
 			if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY) {
 				node = file_browser_node_dir_new (model, file, parent);
@@ -2105,7 +2571,7 @@ model_add_node_from_dir (GeditFileBrowserStore * model,
 	FileBrowserNode *node;
 
 	/* Check if it already exists */
-	if ((node = node_list_contains_file (FILE_BROWSER_NODE_DIR (parent)->children, file)) == NULL) {	
+	if ((node = node_find_child (parent, file)) == NULL) {	
 		node = file_browser_node_dir_new (model, file, parent);
 		file_browser_node_set_from_info (model, node, NULL, FALSE);
 
@@ -2113,8 +2579,8 @@ model_add_node_from_dir (GeditFileBrowserStore * model,
 			file_browser_node_set_name (node);
 		}
 
-		if (node->icon == NULL) {
-			node->icon = gedit_file_browser_utils_pixbuf_from_theme ("folder", GTK_ICON_SIZE_MENU);
+		if (node->gicon == NULL) {
+			node->gicon = g_themed_icon_new ("folder");
 		}
 
 		model_add_node (model, node, parent);
@@ -2194,6 +2660,257 @@ parse_dot_hidden_file (FileBrowserNode *directory)
 	g_free (file_contents);
 }
 
+static void
+monitor_batch_free (MonitorBatch * batch)
+{
+	g_list_foreach (batch->infos, (GFunc) g_object_unref, NULL);
+	g_list_free (batch->infos);
+
+	g_object_unref (batch->cancellable);
+	g_timer_destroy (batch->timer);
+
+	g_slice_free (MonitorBatch, batch);
+}
+
+/* Whether the info of @file queried by @batch is still wanted */
+static gboolean
+monitor_batch_wants (MonitorBatch * batch,
+		     GFile * file)
+{
+	/* Deleted or created again since the query started, the dir is
+	 * gone if the batch was cancelled */
+	return !g_cancellable_is_cancelled (batch->cancellable) &&
+	       g_hash_table_lookup (batch->dir->monitor_created, file) == batch;
+}
+
+static void
+monitor_batch_add_info (MonitorBatch * batch,
+			GFile * file,
+			GFileInfo * info)
+{
+	g_hash_table_remove (batch->dir->monitor_created, file);
+	batch->infos = g_list_prepend (batch->infos, info);
+}
+
+/* Adds the files once all the queries of @batch are done */
+static void
+monitor_batch_query_done (MonitorBatch * batch)
+{
+	FileBrowserNodeDir *dir = batch->dir;
+
+	if (--batch->pending > 0)
+		return;
+
+	if (!g_cancellable_is_cancelled (batch->cancellable) &&
+	    batch->infos != NULL) {
+		gint n = g_list_length (batch->infos);
+
+		/* Takes the infos */
+		model_add_nodes_from_files (dir->model,
+					    (FileBrowserNode *) dir,
+					    batch->infos);
+
+		g_list_free (batch->infos);
+		batch->infos = NULL;
+
+		gedit_debug_message (DEBUG_PLUGINS,
+				     "%d files added %f s after the first event",
+				     n,
+				     g_timer_elapsed (batch->timer, NULL));
+	}
+
+	monitor_batch_free (batch);
+}
+
+static void
+monitor_batch_sniff_ready (GFile * file,
+			   GAsyncResult * result,
+			   MonitorSniff * sniff)
+{
+	MonitorBatch *batch = sniff->batch;
+	GFileInfo *info = sniff->info;
+	GFileInfo *sniffed;
+
+	g_slice_free (MonitorSniff, sniff);
+
+	sniffed = g_file_query_info_finish (file, result, NULL);
+
+	if (monitor_batch_wants (batch, file)) {
+		if (sniffed != NULL) {
+			gchar *path;
+
+			g_file_info_set_content_type (info,
+						      g_file_info_get_content_type (sniffed));
+
+			path = g_file_get_path (file);
+			classify_remember (path, info);
+			g_free (path);
+		}
+
+		monitor_batch_add_info (batch, file, info);
+	} else {
+		g_object_unref (info);
+	}
+
+	if (sniffed != NULL)
+		g_object_unref (sniffed);
+
+	monitor_batch_query_done (batch);
+}
+
+static void
+monitor_batch_info_ready (GFile * file,
+			  GAsyncResult * result,
+			  MonitorBatch * batch)
+{
+	GFileInfo *info;
+
+	/* The file may be gone already, it is just skipped */
+	info = g_file_query_info_finish (file, result, NULL);
+
+	if (info != NULL && monitor_batch_wants (batch, file)) {
+		gchar *path = NULL;
+
+		if (g_file_is_native (file))
+			path = g_file_get_path (file);
+
+		/* Local files are listed without sniffing, like when
+		 * loading the directory */
+		if (path != NULL && !classify_from_cache (path, info)) {
+			MonitorSniff *sniff;
+
+			sniff = g_slice_new (MonitorSniff);
+			sniff->batch = batch;
+			sniff->info = info;
+
+			g_file_query_info_async (file,
+						 G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE,
+						 G_FILE_QUERY_INFO_NONE,
+						 G_PRIORITY_DEFAULT,
+						 batch->cancellable,
+						 (GAsyncReadyCallback) monitor_batch_sniff_ready,
+						 sniff);
+			g_free (path);
+
+			/* Still pending */
+			return;
+		}
+
+		g_free (path);
+		monitor_batch_add_info (batch, file, info);
+	} else if (info != NULL) {
+		g_object_unref (info);
+	}
+
+	monitor_batch_query_done (batch);
+}
+
+static void
+monitor_events_query_created (FileBrowserNodeDir * dir,
+			      GSList * created)
+{
+	MonitorBatch *batch;
+	GSList *item;
+
+	if (dir->monitor_cancellable == NULL)
+		dir->monitor_cancellable = g_cancellable_new ();
+
+	if (dir->monitor_created == NULL)
+		dir->monitor_created = g_hash_table_new_full (g_file_hash,
+							      (GEqualFunc) g_file_equal,
+							      g_object_unref,
+							      NULL);
+
+	batch = g_slice_new0 (MonitorBatch);
+	batch->dir = dir;
+	batch->cancellable = g_object_ref (dir->monitor_cancellable);
+	batch->pending = g_slist_length (created);
+
+	/* Latency is measured from the first event of the window */
+	batch->timer = dir->monitor_events_timer;
+	dir->monitor_events_timer = NULL;
+
+	for (item = created; item; item = item->next) {
+		g_hash_table_replace (dir->monitor_created,
+				      g_object_ref (item->data),
+				      batch);
+
+		g_file_query_info_async (G_FILE (item->data),
+					 g_file_is_native (G_FILE (item->data)) ? LOCAL_ATTRIBUTE_TYPES
+										: STANDARD_ATTRIBUTE_TYPES,
+					 G_FILE_QUERY_INFO_NONE,
+					 G_PRIORITY_DEFAULT,
+					 batch->cancellable,
+					 (GAsyncReadyCallback) monitor_batch_info_ready,
+					 batch);
+	}
+}
+
+static gboolean
+monitor_events_timeout (FileBrowserNodeDir * dir)
+{
+	FileBrowserNode *parent = (FileBrowserNode *) dir;
+	GHashTableIter iter;
+	gpointer file;
+	gpointer event;
+	GSList *created = NULL;
+	GSList *deleted = NULL;
+
+	dir->monitor_events_id = 0;
+
+	g_hash_table_iter_init (&iter, dir->monitor_events);
+
+	while (g_hash_table_iter_next (&iter, &file, &event)) {
+		FileBrowserNode *node;
+
+		node = node_find_child (parent, G_FILE (file));
+
+		switch (GPOINTER_TO_INT (event)) {
+		case G_FILE_MONITOR_EVENT_DELETED:
+			if (node != NULL)
+				deleted = g_slist_prepend (deleted, node);
+
+			/* A query still running must not add it back */
+			if (dir->monitor_created != NULL)
+				g_hash_table_remove (dir->monitor_created, file);
+			break;
+		case G_FILE_MONITOR_EVENT_CREATED:
+			if (node == NULL)
+				created = g_slist_prepend (created,
+							   g_object_ref (file));
+			break;
+		default:
+			break;
+		}
+	}
+
+	g_hash_table_remove_all (dir->monitor_events);
+
+	gedit_debug_message (DEBUG_PLUGINS,
+			     "%d created, %d deleted",
+			     g_slist_length (created),
+			     g_slist_length (deleted));
+
+	if (deleted != NULL) {
+		model_remove_nodes_batch (dir->model, deleted, parent);
+		g_slist_free (deleted);
+	}
+
+	if (created != NULL) {
+		monitor_events_query_created (dir, created);
+
+		g_slist_foreach (created, (GFunc) g_object_unref, NULL);
+		g_slist_free (created);
+	}
+
+	if (dir->monitor_events_timer != NULL) {
+		g_timer_destroy (dir->monitor_events_timer);
+		dir->monitor_events_timer = NULL;
+	}
+
+	return FALSE;
+}
+
 static void
 on_directory_monitor_event (GFileMonitor * monitor,
 			    GFile * file,
@@ -2201,25 +2918,68 @@ on_directory_monitor_event (GFileMonitor * monitor,
 			    GFileMonitorEvent event_type,
 			    FileBrowserNode * parent)
 {
-	FileBrowserNode *node;
 	FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (parent);
 
-	switch (event_type) {
-	case G_FILE_MONITOR_EVENT_DELETED:
-		node = node_list_contains_file (dir->children, file);
+	if (event_type != G_FILE_MONITOR_EVENT_DELETED &&
+	    event_type != G_FILE_MONITOR_EVENT_CREATED)
+		return;
+
+	/* A burst of events, like a build or a checkout creating many
+	 * files, is handled at once */
+	if (dir->monitor_events == NULL)
+		dir->monitor_events = g_hash_table_new_full (g_file_hash,
+							     (GEqualFunc) g_file_equal,
+							     g_object_unref,
+							     NULL);
+
+	g_hash_table_replace (dir->monitor_events,
+			      g_object_ref (file),
+			      GINT_TO_POINTER (event_type));
+
+	if (dir->monitor_events_id == 0) {
+		dir->monitor_events_timer = g_timer_new ();
+		dir->monitor_events_id =
+			g_timeout_add (MONITOR_EVENTS_TIMEOUT,
+				       (GSourceFunc) monitor_events_timeout,
+				       dir);
+	}
+}
 
-		if (node != NULL) {
-			model_remove_node (dir->model, node, NULL, TRUE);
-		}
-		break;
-	case G_FILE_MONITOR_EVENT_CREATED:
-		if (g_file_query_exists (file, NULL)) {
-			model_add_node_from_file (dir->model, parent, file, NULL);
-		}
+static void
+model_stop_monitor (FileBrowserNodeDir * dir)
+{
+	if (dir->monitor) {
+		g_file_monitor_cancel (dir->monitor);
+		g_object_unref (dir->monitor);
 		
-		break;
-	default:
-		break;
+		dir->monitor = NULL;
+	}
+
+	if (dir->monitor_events_id != 0) {
+		g_source_remove (dir->monitor_events_id);
+		dir->monitor_events_id = 0;
+	}
+
+	if (dir->monitor_events_timer != NULL) {
+		g_timer_destroy (dir->monitor_events_timer);
+		dir->monitor_events_timer = NULL;
+	}
+
+	if (dir->monitor_events != NULL) {
+		g_hash_table_destroy (dir->monitor_events);
+		dir->monitor_events = NULL;
+	}
+
+	/* The pending queries free themselves */
+	if (dir->monitor_cancellable != NULL) {
+		g_cancellable_cancel (dir->monitor_cancellable);
+		g_object_unref (dir->monitor_cancellable);
+		dir->monitor_cancellable = NULL;
+	}
+
+	if (dir->monitor_created != NULL) {
+		g_hash_table_destroy (dir->monitor_created);
+		dir->monitor_created = NULL;
 	}
 }
 
@@ -2227,10 +2987,170 @@ static void
 async_node_free (AsyncNode *async)
 {
 	g_object_unref (async->cancellable);
-	g_slist_free (async->original_children);
 	g_free (async);
 }
 
+static void
+classify_job_free (ClassifyJob * job)
+{
+	g_list_foreach (job->files, (GFunc) g_object_unref, NULL);
+	g_list_free (job->files);
+	g_list_free (job->unknown);
+
+	g_object_unref (job->enumerator);
+	g_object_unref (job->dir_file);
+
+	g_slice_free (ClassifyJob, job);
+}
+
+/* Runs in a thread, only touches the infos of the job */
+static void
+classify_job_thread (GSimpleAsyncResult * result,
+		     GObject * object,
+		     GCancellable * cancellable)
+{
+	ClassifyJob *job;
+	GList *item;
+
+	job = g_simple_async_result_get_op_res_gpointer (result);
+
+	for (item = job->unknown; item; item = item->next) {
+		GFileInfo *info = G_FILE_INFO (item->data);
+		GFileInfo *sniffed;
+		GFile *file;
+
+		if (g_cancellable_is_cancelled (cancellable))
+			return;
+
+		file = g_file_get_child (job->dir_file,
+					 g_file_info_get_name (info));
+
+		sniffed = g_file_query_info (file,
+					     G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE,
+					     G_FILE_QUERY_INFO_NONE,
+					     cancellable,
+					     NULL);
+
+		if (sniffed != NULL) {
+			g_file_info_set_content_type (info,
+						      g_file_info_get_content_type (sniffed));
+			g_object_unref (sniffed);
+		}
+
+		g_object_unref (file);
+	}
+}
+
+static void
+classify_job_done (GObject * object,
+		   GAsyncResult * result,
+		   gpointer user_data)
+{
+	ClassifyJob *job;
+	AsyncNode *async;
+	FileBrowserNodeDir *dir;
+	gchar *dir_path;
+	GList *item;
+
+	job = g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (result));
+	async = job->async;
+
+	if (g_cancellable_is_cancelled (async->cancellable)) {
+		g_file_enumerator_close (job->enumerator, NULL, NULL);
+		async_node_free (async);
+		return;
+	}
+
+	dir = async->dir;
+	dir_path = g_file_get_path (job->dir_file);
+
+	for (item = job->unknown; item; item = item->next) {
+		GFileInfo *info = G_FILE_INFO (item->data);
+		gchar *path;
+
+		path = g_build_filename (dir_path, g_file_info_get_name (info), NULL);
+		classify_remember (path, info);
+		g_free (path);
+	}
+
+	g_free (dir_path);
+
+	/* Takes the infos */
+	model_add_nodes_from_files (dir->model, (FileBrowserNode *) dir, job->files);
+
+	g_list_free (job->files);
+	job->files = NULL;
+
+	next_files_async (job->enumerator, async);
+}
+
+/* Gets the content types of @files from the type cache, the other ones
+ * are sniffed in a thread before the files are added */
+static void
+model_classify_files (AsyncNode * async,
+		      GFileEnumerator * enumerator,
+		      GList * files)
+{
+	FileBrowserNode *parent = (FileBrowserNode *) async->dir;
+	GSimpleAsyncResult *result;
+	ClassifyJob *job;
+	gchar *dir_path;
+	GList *item;
+
+	job = g_slice_new0 (ClassifyJob);
+	job->async = async;
+	job->enumerator = g_object_ref (enumerator);
+	job->dir_file = g_object_ref (parent->file);
+	job->files = files;
+
+	dir_path = g_file_get_path (parent->file);
+
+	for (item = files; item; item = item->next) {
+		GFileInfo *info = G_FILE_INFO (item->data);
+		gchar *path;
+
+		if (g_file_info_get_file_type (info) != G_FILE_TYPE_REGULAR)
+			continue;
+
+		path = g_build_filename (dir_path, g_file_info_get_name (info), NULL);
+
+		if (!classify_from_cache (path, info))
+			job->unknown = g_list_prepend (job->unknown, info);
+
+		g_free (path);
+	}
+
+	g_free (dir_path);
+
+	if (job->unknown == NULL) {
+		model_add_nodes_from_files (async->dir->model, parent, files);
+
+		g_list_free (files);
+		job->files = NULL;
+
+		classify_job_free (job);
+		next_files_async (enumerator, async);
+
+		return;
+	}
+
+	result = g_simple_async_result_new (NULL,
+					    classify_job_done,
+					    NULL,
+					    model_classify_files);
+
+	g_simple_async_result_set_op_res_gpointer (result,
+						   job,
+						   (GDestroyNotify) classify_job_free);
+
+	g_simple_async_result_run_in_thread (result,
+					     classify_job_thread,
+					     G_PRIORITY_DEFAULT,
+					     async->cancellable);
+
+	g_object_unref (result);
+}
+
 static void
 model_iterate_next_files_cb (GFileEnumerator * enumerator, 
 			     GAsyncResult * result, 
@@ -2294,8 +3214,10 @@ model_iterate_next_files_cb (GFileEnumerator * enumerator,
 		/* Check cancel state manually */
 		g_file_enumerator_close (enumerator, NULL, NULL);
 		async_node_free (async);
+	} else if (g_file_is_native (parent->file)) {
+		model_classify_files (async, enumerator, files);
 	} else {
-		model_add_nodes_from_files (dir->model, parent, async->original_children, files);
+		model_add_nodes_from_files (dir->model, parent, files);
 		
 		g_list_free (files);
 		next_files_async (enumerator, async);
@@ -2376,11 +3298,11 @@ model_load_directory (GeditFileBrowserStore * model,
 	async = g_new (AsyncNode, 1);
 	async->dir = dir;
 	async->cancellable = g_object_ref (dir->cancellable);
-	async->original_children = g_slist_copy (dir->children);
 
 	/* Start loading async */
 	g_file_enumerate_children_async (node->file,
-					 STANDARD_ATTRIBUTE_TYPES,
+					 g_file_is_native (node->file) ? LOCAL_ATTRIBUTE_TYPES
+								       : STANDARD_ATTRIBUTE_TYPES,
 					 G_FILE_QUERY_INFO_NONE,
 					 G_PRIORITY_DEFAULT,
 					 async->cancellable,
@@ -2413,7 +3335,7 @@ model_fill (GeditFileBrowserStore * model, FileBrowserNode * node,
 {
 	gboolean free_path = FALSE;
 	GtkTreeIter iter = {0,};
-	GSList *item;
+	GSequenceIter *item;
 	FileBrowserNode *child;
 
 	if (node == NULL) {
@@ -2446,9 +3368,10 @@ model_fill (GeditFileBrowserStore * model, FileBrowserNode * node,
 		/* Go to the first child */
 		gtk_tree_path_down (*path);
 
-		for (item = FILE_BROWSER_NODE_DIR (node)->children; item;
-		     item = item->next) {
-			child = (FileBrowserNode *) (item->data);
+		for (item = g_sequence_get_begin_iter (FILE_BROWSER_NODE_DIR (node)->children);
+		     !g_sequence_iter_is_end (item);
+		     item = g_sequence_iter_next (item)) {
+			child = (FileBrowserNode *) g_sequence_get (item);
 
 			if (model_node_visibility (model, child)) {
 				model_fill (model, child, path);
@@ -2478,6 +3401,8 @@ set_virtual_root_from_node (GeditFileBrowserStore * model,
 	FileBrowserNodeDir *dir;
 	GSList *item;
 	GSList *copy;
+	GSequenceIter *child;
+	GSequenceIter *grandchild;
 	GtkTreePath *empty = NULL;
 
 	prev = node;
@@ -2486,7 +3411,7 @@ set_virtual_root_from_node (GeditFileBrowserStore * model,
 	/* Free all the nodes below that we don't need in cache */
 	while (prev != model->priv->root) {
 		dir = FILE_BROWSER_NODE_DIR (next);
-		copy = g_slist_copy (dir->children);
+		copy = node_copy_children (next);
 
 		for (item = copy; item; item = item->next) {
 			check = (FileBrowserNode *) (item->data);
@@ -2502,8 +3427,7 @@ set_virtual_root_from_node (GeditFileBrowserStore * model,
 				}
 			} else if (check != prev) {
 				/* Only free when the node is not in the chain */
-				dir->children =
-				    g_slist_remove (dir->children, check);
+				node_remove_child (next, check);
 				file_browser_node_free (model, check);
 			}
 		}
@@ -2517,27 +3441,27 @@ set_virtual_root_from_node (GeditFileBrowserStore * model,
 	}
 
 	/* Free all the nodes up that we don't need in cache */
-	for (item = FILE_BROWSER_NODE_DIR (node)->children; item;
-	     item = item->next) {
-		check = (FileBrowserNode *) (item->data);
+	for (child = g_sequence_get_begin_iter (FILE_BROWSER_NODE_DIR (node)->children);
+	     !g_sequence_iter_is_end (child);
+	     child = g_sequence_iter_next (child)) {
+		check = (FileBrowserNode *) g_sequence_get (child);
 			
 		if (NODE_IS_DIR (check)) {		
-			for (copy =
-			     FILE_BROWSER_NODE_DIR (check)->children; copy;
-			     copy = copy->next) {
-				file_browser_node_free_children (model,
-								 (FileBrowserNode
-								  *)
-								 (copy->
-								  data));
-				file_browser_node_unload (model,
-							  (FileBrowserNode
-							   *) (copy->data),
-							  FALSE);
+			for (grandchild =
+			     g_sequence_get_begin_iter (FILE_BROWSER_NODE_DIR (check)->children);
+			     !g_sequence_iter_is_end (grandchild);
+			     grandchild = g_sequence_iter_next (grandchild)) {
+				FileBrowserNode *n;
+
+				n = (FileBrowserNode *) g_sequence_get (grandchild);
+
+				file_browser_node_free_children (model, n);
+				file_browser_node_unload (model, n, FALSE);
 			}
 		} else if (NODE_IS_DUMMY (check)) {
 			check->flags |=
 			    GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
+			model_node_set_inserted (model, check, FALSE);
 		}
 	}
 
@@ -2589,15 +3513,17 @@ model_find_node_children (GeditFileBrowserStore * model,
 	FileBrowserNodeDir *dir;
 	FileBrowserNode *child;
 	FileBrowserNode *result;
-	GSList *children;
+	GSequenceIter *children;
 	
 	if (!NODE_IS_DIR (parent))
 		return NULL;
 	
 	dir = FILE_BROWSER_NODE_DIR (parent);
 	
-	for (children = dir->children; children; children = children->next) {
-		child = (FileBrowserNode *)(children->data);
+	for (children = g_sequence_get_begin_iter (dir->children);
+	     !g_sequence_iter_is_end (children);
+	     children = g_sequence_iter_next (children)) {
+		child = (FileBrowserNode *) g_sequence_get (children);
 		
 		result = model_find_node (model, child, file);
 		
@@ -3132,7 +4058,7 @@ _gedit_file_browser_store_iter_collapsed (GeditFileBrowserStore * model,
 					  GtkTreeIter * iter)
 {
 	FileBrowserNode *node;
-	GSList *item;
+	GSequenceIter *item;
 
 	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STORE (model));
 	g_return_if_fail (iter != NULL);
@@ -3143,9 +4069,10 @@ _gedit_file_browser_store_iter_collapsed (GeditFileBrowserStore * model,
 	if (NODE_IS_DIR (node) && NODE_LOADED (node)) {
 		/* Unload children of the children, keeping 1 depth in cache */
 
-		for (item = FILE_BROWSER_NODE_DIR (node)->children; item;
-		     item = item->next) {
-			node = (FileBrowserNode *) (item->data);
+		for (item = g_sequence_get_begin_iter (FILE_BROWSER_NODE_DIR (node)->children);
+		     !g_sequence_iter_is_end (item);
+		     item = g_sequence_iter_next (item)) {
+			node = (FileBrowserNode *) g_sequence_get (item);
 
 			if (NODE_IS_DIR (node) && NODE_LOADED (node)) {
 				file_browser_node_unload (model, node,
@@ -3221,7 +4148,7 @@ static void
 reparent_node (FileBrowserNode * node, gboolean reparent)
 {
 	FileBrowserNodeDir * dir;
-	GSList * child;
+	GSequenceIter * child;
 	GFile * parent;
 	gchar * base;
 
@@ -3241,8 +4168,10 @@ reparent_node (FileBrowserNode * node, gboolean reparent)
 	if (NODE_IS_DIR (node)) {
 		dir = FILE_BROWSER_NODE_DIR (node);
 		
-		for (child = dir->children; child; child = child->next) {
-			reparent_node ((FileBrowserNode *)child->data, TRUE);
+		for (child = g_sequence_get_begin_iter (dir->children);
+		     !g_sequence_iter_is_end (child);
+		     child = g_sequence_iter_next (child)) {
+			reparent_node ((FileBrowserNode *) g_sequence_get (child), TRUE);
 		}
 	}
 }
@@ -3283,6 +4212,9 @@ gedit_file_browser_store_rename (GeditFileBrowserStore * model,
 		previous = node->file;
 		node->file = file;
 
+		node_unhash_child (node->parent, node, previous);
+		node_hash_child (node->parent, node);
+
 		/* This makes sure the actual info for the node is requeried */
 		file_browser_node_set_name (node);
 		file_browser_node_set_from_info (model, node, NULL, TRUE);
@@ -3297,6 +4229,9 @@ gedit_file_browser_store_rename (GeditFileBrowserStore * model,
 			/* Reorder this item */
 			model_resort_node (model, node);
 		} else {
+			/* Not a row anymore, only keep the children sorted */
+			model_node_sort_changed (model, node);
+
 			g_object_unref (previous);
 			
 			if (error != NULL)
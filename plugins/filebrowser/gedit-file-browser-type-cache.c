@@ -0,0 +1,304 @@
+/*
+ * gedit-file-browser-type-cache.c - Gedit plugin providing easy file access 
+ * from the sidepanel
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gedit/gedit-dirs.h>
+#include <gedit/gedit-debug.h>
+
+#include "gedit-file-browser-type-cache.h"
+
+#define TYPE_CACHE_FILE "filebrowser-types"
+#define TYPE_CACHE_VERSION "1"
+
+/* Past this the cache is started over */
+#define MAX_ENTRIES 100000
+
+#define SAVE_TIMEOUT 5
+
+typedef struct
+{
+	guint64 mtime;
+	guint64 size;
+
+	/* interned */
+	const gchar *content_type;
+	gboolean is_text;
+} Entry;
+
+typedef struct
+{
+	/* path -> Entry */
+	GHashTable *entries;
+
+	gboolean dirty;
+	guint save_id;
+
+	guint hits;
+	guint misses;
+} TypeCache;
+
+static TypeCache *cache = NULL;
+
+static gchar *
+get_cache_filename (void)
+{
+	gchar *cache_dir;
+	gchar *filename;
+
+	cache_dir = gedit_dirs_get_user_cache_dir ();
+	filename = g_build_filename (cache_dir, TYPE_CACHE_FILE, NULL);
+	g_free (cache_dir);
+
+	return filename;
+}
+
+static void
+entry_free (Entry * entry)
+{
+	g_slice_free (Entry, entry);
+}
+
+static void
+add_entry (const gchar * path,
+	   guint64 mtime,
+	   guint64 size,
+	   const gchar * content_type,
+	   gboolean is_text)
+{
+	Entry *entry;
+
+	entry = g_slice_new (Entry);
+	entry->mtime = mtime;
+	entry->size = size;
+	entry->content_type = g_intern_string (content_type);
+	entry->is_text = is_text;
+
+	g_hash_table_replace (cache->entries, g_strdup (path), entry);
+}
+
+/* One entry per line: mtime, size, is text, content type and path
+ * separated by tabs. The path comes last, it may contain tabs. */
+static void
+load_cache (void)
+{
+	gchar *filename;
+	gchar *contents;
+	gchar **lines;
+	gint i;
+
+	filename = get_cache_filename ();
+
+	if (!g_file_get_contents (filename, &contents, NULL, NULL)) {
+		g_free (filename);
+		return;
+	}
+
+	g_free (filename);
+
+	lines = g_strsplit (contents, "\n", -1);
+	g_free (contents);
+
+	if (lines[0] == NULL || strcmp (lines[0], TYPE_CACHE_VERSION) != 0) {
+		g_strfreev (lines);
+		return;
+	}
+
+	for (i = 1; lines[i] != NULL && i <= MAX_ENTRIES; i++) {
+		gchar **fields;
+
+		fields = g_strsplit (lines[i], "\t", 5);
+
+		if (g_strv_length (fields) == 5) {
+			add_entry (fields[4],
+				   g_ascii_strtoull (fields[0], NULL, 10),
+				   g_ascii_strtoull (fields[1], NULL, 10),
+				   fields[3],
+				   fields[2][0] == '1');
+		}
+
+		g_strfreev (fields);
+	}
+
+	g_strfreev (lines);
+
+	gedit_debug_message (DEBUG_PLUGINS,
+			     "%d content types loaded",
+			     g_hash_table_size (cache->entries));
+}
+
+static TypeCache *
+get_cache (void)
+{
+	if (cache == NULL) {
+		cache = g_new0 (TypeCache, 1);
+		cache->entries = g_hash_table_new_full (g_str_hash,
+							g_str_equal,
+							g_free,
+							(GDestroyNotify) entry_free);
+
+		load_cache ();
+	}
+
+	return cache;
+}
+
+static gboolean
+save_timeout (gpointer data)
+{
+	cache->save_id = 0;
+	gedit_file_browser_type_cache_save ();
+
+	return FALSE;
+}
+
+const gchar *
+gedit_file_browser_type_cache_lookup (const gchar * path,
+				      guint64 mtime,
+				      guint64 size,
+				      gboolean * is_text)
+{
+	Entry *entry;
+
+	g_return_val_if_fail (path != NULL, NULL);
+
+	entry = g_hash_table_lookup (get_cache ()->entries, path);
+
+	if (entry == NULL || entry->mtime != mtime || entry->size != size) {
+		cache->misses++;
+		return NULL;
+	}
+
+	cache->hits++;
+
+	if (is_text != NULL)
+		*is_text = entry->is_text;
+
+	return entry->content_type;
+}
+
+void
+gedit_file_browser_type_cache_insert (const gchar * path,
+				      guint64 mtime,
+				      guint64 size,
+				      const gchar * content_type,
+				      gboolean is_text)
+{
+	g_return_if_fail (path != NULL);
+	g_return_if_fail (content_type != NULL);
+
+	/* would break the file format */
+	if (strchr (path, '\n') != NULL || strchr (content_type, '\t') != NULL)
+		return;
+
+	get_cache ();
+
+	if (g_hash_table_size (cache->entries) >= MAX_ENTRIES)
+		g_hash_table_remove_all (cache->entries);
+
+	add_entry (path, mtime, size, content_type, is_text);
+
+	cache->dirty = TRUE;
+
+	if (cache->save_id == 0)
+		cache->save_id = g_timeout_add_seconds_full (G_PRIORITY_DEFAULT_IDLE,
+							     SAVE_TIMEOUT,
+							     save_timeout,
+							     NULL,
+							     NULL);
+}
+
+void
+gedit_file_browser_type_cache_save (void)
+{
+	GString *contents;
+	GHashTableIter iter;
+	gpointer path;
+	gpointer value;
+	gchar *filename;
+	gchar *cache_dir;
+	GError *error = NULL;
+
+	if (cache == NULL || !cache->dirty)
+		return;
+
+	contents = g_string_new (TYPE_CACHE_VERSION "\n");
+
+	g_hash_table_iter_init (&iter, cache->entries);
+
+	while (g_hash_table_iter_next (&iter, &path, &value)) {
+		Entry *entry = value;
+
+		g_string_append_printf (contents,
+					"%" G_GUINT64_FORMAT "\t%" G_GUINT64_FORMAT "\t%d\t%s\t%s\n",
+					entry->mtime,
+					entry->size,
+					entry->is_text ? 1 : 0,
+					entry->content_type,
+					(const gchar *) path);
+	}
+
+	cache_dir = gedit_dirs_get_user_cache_dir ();
+	g_mkdir_with_parents (cache_dir, 0700);
+	g_free (cache_dir);
+
+	filename = get_cache_filename ();
+
+	if (!g_file_set_contents (filename, contents->str, contents->len, &error)) {
+		g_warning ("Could not save the file browser content types: %s",
+			   error->message);
+		g_error_free (error);
+	}
+
+	g_free (filename);
+	g_string_free (contents, TRUE);
+
+	cache->dirty = FALSE;
+}
+
+void
+gedit_file_browser_type_cache_shutdown (void)
+{
+	if (cache == NULL)
+		return;
+
+	if (cache->save_id != 0)
+		g_source_remove (cache->save_id);
+
+	gedit_file_browser_type_cache_save ();
+
+	g_hash_table_destroy (cache->entries);
+	g_free (cache);
+	cache = NULL;
+}
+
+void
+gedit_file_browser_type_cache_get_stats (guint * hits,
+					 guint * misses)
+{
+	if (hits != NULL)
+		*hits = cache != NULL ? cache->hits : 0;
+
+	if (misses != NULL)
+		*misses = cache != NULL ? cache->misses : 0;
+}
+
+// ex:ts=8:noet:
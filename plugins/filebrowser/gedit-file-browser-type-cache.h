@@ -0,0 +1,61 @@
+/*
+ * gedit-file-browser-type-cache.h - Gedit plugin providing easy file access 
+ * from the sidepanel
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GEDIT_FILE_BROWSER_TYPE_CACHE_H__
+#define __GEDIT_FILE_BROWSER_TYPE_CACHE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Remembers the sniffed content type of local files, and whether they
+ * are text, by path, modification time and size. Kept in the user cache
+ * dir, so that a directory seen before can be listed without reading
+ * the files. */
+
+/* Returns the content type, or NULL if the file is not in the cache or
+ * changed since */
+const gchar *gedit_file_browser_type_cache_lookup	(const gchar *path,
+							 guint64      mtime,
+							 guint64      size,
+							 gboolean    *is_text);
+
+void	     gedit_file_browser_type_cache_insert	(const gchar *path,
+							 guint64      mtime,
+							 guint64      size,
+							 const gchar *content_type,
+							 gboolean     is_text);
+
+/* Writes the cache now if it changed, it is otherwise written a few
+ * seconds after a change */
+void	     gedit_file_browser_type_cache_save		(void);
+
+/* Saves and forgets the cache, it is read again on the next lookup */
+void	     gedit_file_browser_type_cache_shutdown	(void);
+
+void	     gedit_file_browser_type_cache_get_stats	(guint       *hits,
+							 guint       *misses);
+
+G_END_DECLS
+
+#endif /* __GEDIT_FILE_BROWSER_TYPE_CACHE_H__ */
+
+// ex:ts=8:noet:
@@ -70,6 +70,100 @@ gedit_file_browser_utils_pixbuf_from_theme (gchar const * name,
 	return pixbuf;
 }
 
+typedef struct
+{
+	GIcon *icon;
+	gint width;
+} IconKey;
+
+/* The pixbufs loaded for a GIcon and a size, shared by all the files
+ * with the same icon. Dropped when the icon theme changes. */
+static GHashTable *icon_cache = NULL;
+
+/* One instance of each GIcon, see gedit_file_browser_utils_icon_intern */
+static GHashTable *interned_icons = NULL;
+
+static guint
+icon_key_hash (gconstpointer key)
+{
+	const IconKey *k = key;
+
+	return g_icon_hash ((gpointer) k->icon) ^ k->width;
+}
+
+static gboolean
+icon_key_equal (gconstpointer a,
+		gconstpointer b)
+{
+	const IconKey *k1 = a;
+	const IconKey *k2 = b;
+
+	return k1->width == k2->width && g_icon_equal (k1->icon, k2->icon);
+}
+
+static void
+icon_key_free (IconKey * key)
+{
+	g_object_unref (key->icon);
+	g_slice_free (IconKey, key);
+}
+
+static void
+unref_pixbuf (GdkPixbuf * pixbuf)
+{
+	if (pixbuf != NULL)
+		g_object_unref (pixbuf);
+}
+
+static void
+on_icon_theme_changed (GtkIconTheme * theme,
+		       gpointer user_data)
+{
+	g_hash_table_remove_all (icon_cache);
+}
+
+static GHashTable *
+get_icon_cache (void)
+{
+	if (icon_cache == NULL) {
+		icon_cache = g_hash_table_new_full (icon_key_hash,
+						    icon_key_equal,
+						    (GDestroyNotify) icon_key_free,
+						    (GDestroyNotify) unref_pixbuf);
+
+		g_signal_connect (gtk_icon_theme_get_default (),
+				  "changed",
+				  G_CALLBACK (on_icon_theme_changed),
+				  NULL);
+	}
+
+	return icon_cache;
+}
+
+GIcon *
+gedit_file_browser_utils_icon_intern (GIcon * icon)
+{
+	GIcon *ret;
+
+	if (icon == NULL)
+		return NULL;
+
+	if (interned_icons == NULL)
+		interned_icons = g_hash_table_new_full (g_icon_hash,
+							(GEqualFunc) g_icon_equal,
+							g_object_unref,
+							NULL);
+
+	ret = g_hash_table_lookup (interned_icons, icon);
+
+	if (ret == NULL) {
+		ret = g_object_ref (icon);
+		g_hash_table_insert (interned_icons, ret, ret);
+	}
+
+	return g_object_ref (ret);
+}
+
 GdkPixbuf *
 gedit_file_browser_utils_pixbuf_from_icon (GIcon * icon,
                                            GtkIconSize size)
@@ -77,6 +171,10 @@ gedit_file_browser_utils_pixbuf_from_icon (GIcon * icon,
 	GdkPixbuf * ret = NULL;
 	GtkIconTheme *theme;
 	GtkIconInfo *info;
+	GHashTable *cache;
+	IconKey key;
+	IconKey *new_key;
+	gpointer cached;
 	gint width;
 
 	if (!icon)
@@ -84,17 +182,32 @@ gedit_file_browser_utils_pixbuf_from_icon (GIcon * icon,
 
 	theme = gtk_icon_theme_get_default ();
 	gtk_icon_size_lookup (size, &width, NULL);
+
+	cache = get_icon_cache ();
+	key.icon = icon;
+	key.width = width;
+
+	/* Icons that failed to load are cached too, as NULL */
+	if (g_hash_table_lookup_extended (cache, &key, NULL, &cached))
+		return cached != NULL ? g_object_ref (cached) : NULL;
 	
 	info = gtk_icon_theme_lookup_by_gicon (theme,
 					       icon,
 					       width,
 					       GTK_ICON_LOOKUP_USE_BUILTIN);
 
-	if (!info)
-		return NULL;
-		
-	ret = gtk_icon_info_load_icon (info, NULL);
-	gtk_icon_info_free (info);
+	if (info) {
+		ret = gtk_icon_info_load_icon (info, NULL);
+		gtk_icon_info_free (info);
+	}
+
+	new_key = g_slice_new (IconKey);
+	new_key->icon = g_object_ref (icon);
+	new_key->width = width;
+
+	g_hash_table_insert (cache,
+			     new_key,
+			     ret != NULL ? g_object_ref (ret) : NULL);
 	
 	return ret;
 }
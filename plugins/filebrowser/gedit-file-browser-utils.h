@@ -7,11 +7,16 @@
 GdkPixbuf *gedit_file_browser_utils_pixbuf_from_theme     (gchar const *name,
                                                            GtkIconSize size);
 
+/* The pixbufs are shared by all the callers asking for the same icon */
 GdkPixbuf *gedit_file_browser_utils_pixbuf_from_icon	  (GIcon * icon,
                                                            GtkIconSize size);
 GdkPixbuf *gedit_file_browser_utils_pixbuf_from_file	  (GFile * file,
                                                            GtkIconSize size);
 
+/* Returns a reference to the one instance equal to @icon, to not keep
+ * a GIcon for each file */
+GIcon * gedit_file_browser_utils_icon_intern		  (GIcon * icon);
+
 gchar * gedit_file_browser_utils_file_basename		  (GFile * file);
 gchar * gedit_file_browser_utils_uri_basename             (gchar const * uri);
 
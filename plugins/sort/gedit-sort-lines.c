@@ -0,0 +1,291 @@
+/*
+ * gedit-sort-lines.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gedit-sort-lines.h"
+
+#include <math.h>
+#include <string.h>
+#include <pango/pango.h>
+
+/* The keys of bigger texts are built by a few threads */
+#define N_WORKERS 4
+#define MIN_LINES_PER_WORKER 4096
+
+typedef struct
+{
+	const gchar *str;	/* in the text, not nul terminated */
+	gsize len;
+	guint index;
+
+	/* NULL if the line is shorter than the starting column, or
+	 * when sorting numbers */
+	gchar *key;
+	gdouble number;
+
+	guint short_line : 1;
+	guint has_number : 1;
+} Line;
+
+typedef struct
+{
+	Line *lines;
+	guint n_lines;
+} KeyJob;
+
+/* Skips @column chars, returns NULL if the line is shorter */
+static const gchar *
+get_column (const Line *line,
+	    gint        column)
+{
+	const gchar *p = line->str;
+	const gchar *end = line->str + line->len;
+
+	for (; column > 0; column--)
+	{
+		if (p >= end)
+			return NULL;
+
+		p = g_utf8_next_char (p);
+	}
+
+	return p;
+}
+
+static void
+build_key (Line                *line,
+	   const GeditSortInfo *sort_info)
+{
+	const gchar *p;
+	const gchar *end = line->str + line->len;
+	gchar *folded = NULL;
+	gchar *endptr;
+
+	p = get_column (line, MAX (sort_info->starting_column, 0));
+
+	if (p == NULL)
+	{
+		line->short_line = TRUE;
+		return;
+	}
+
+	if (sort_info->mode == GEDIT_SORT_MODE_NUMERIC)
+	{
+		while (p < end && g_ascii_isspace (*p))
+			p++;
+
+		/* strtod would skip the line end, and a number cannot
+		 * span it */
+		if (p == end)
+			return;
+
+		line->number = g_ascii_strtod (p, &endptr);
+
+		/* NaN is not ordered, it is sorted as text without a
+		 * number */
+		line->has_number = (endptr != p) && !isnan (line->number);
+
+		return;
+	}
+
+	if (sort_info->ignore_case)
+	{
+		p = folded = g_utf8_casefold (p, end - p);
+		end = p + strlen (p);
+	}
+
+	if (sort_info->mode == GEDIT_SORT_MODE_NATURAL)
+		line->key = g_utf8_collate_key_for_filename (p, end - p);
+	else
+		line->key = g_utf8_collate_key (p, end - p);
+
+	g_free (folded);
+}
+
+static void
+key_job_thread (KeyJob              *job,
+		const GeditSortInfo *sort_info)
+{
+	guint i;
+
+	for (i = 0; i < job->n_lines; i++)
+		build_key (&job->lines[i], sort_info);
+}
+
+static void
+build_keys (Line                *lines,
+	    guint                n_lines,
+	    const GeditSortInfo *sort_info)
+{
+	GThreadPool *pool = NULL;
+	KeyJob jobs[N_WORKERS];
+	guint per_job;
+	guint i;
+
+	if (n_lines >= 2 * MIN_LINES_PER_WORKER && g_thread_supported ())
+	{
+		pool = g_thread_pool_new ((GFunc) key_job_thread,
+					  (gpointer) sort_info,
+					  N_WORKERS,
+					  TRUE,
+					  NULL);
+	}
+
+	if (pool == NULL)
+	{
+		for (i = 0; i < n_lines; i++)
+			build_key (&lines[i], sort_info);
+
+		return;
+	}
+
+	per_job = (n_lines + N_WORKERS - 1) / N_WORKERS;
+
+	for (i = 0; i < N_WORKERS && i * per_job < n_lines; i++)
+	{
+		jobs[i].lines = lines + i * per_job;
+		jobs[i].n_lines = MIN (per_job, n_lines - i * per_job);
+
+		g_thread_pool_push (pool, &jobs[i], NULL);
+	}
+
+	/* waits for the jobs */
+	g_thread_pool_free (pool, FALSE, TRUE);
+}
+
+static gint
+compare_lines (gconstpointer a,
+	       gconstpointer b,
+	       gpointer      data)
+{
+	const Line *line1 = a;
+	const Line *line2 = b;
+	const GeditSortInfo *sort_info = data;
+	gint ret;
+
+	if (line1->short_line || line2->short_line)
+	{
+		ret = line2->short_line - line1->short_line;
+	}
+	else if (sort_info->mode == GEDIT_SORT_MODE_NUMERIC)
+	{
+		/* lines without a number come first */
+		if (!line1->has_number || !line2->has_number)
+			ret = line1->has_number - line2->has_number;
+		else if (line1->number < line2->number)
+			ret = -1;
+		else
+			ret = line1->number > line2->number;
+	}
+	else
+	{
+		ret = strcmp (line1->key, line2->key);
+	}
+
+	if (sort_info->reverse_order)
+		ret = -ret;
+
+	/* equal lines keep their order */
+	if (ret == 0)
+		ret = (line1->index > line2->index) - (line1->index < line2->index);
+
+	return ret;
+}
+
+gchar *
+gedit_sort_lines (const gchar         *text,
+		  const GeditSortInfo *sort_info)
+{
+	GArray *lines;
+	const gchar *p;
+	const gchar *end;
+	gchar *ret;
+	gsize ret_len;
+	const Line *last = NULL;
+	guint i;
+
+	g_return_val_if_fail (text != NULL, NULL);
+	g_return_val_if_fail (sort_info != NULL, NULL);
+
+	end = text + strlen (text);
+
+	lines = g_array_new (FALSE, TRUE, sizeof (Line));
+
+	/* the text is split once, the lines point into it */
+	for (p = text; p < end;)
+	{
+		Line line = { 0, };
+		gint delim;
+		gint next;
+
+		pango_find_paragraph_boundary (p, end - p, &delim, &next);
+
+		line.str = p;
+		line.len = delim;
+		line.index = lines->len;
+
+		g_array_append_val (lines, line);
+
+		p += next;
+	}
+
+	build_keys ((Line *) lines->data, lines->len, sort_info);
+
+	g_qsort_with_data (lines->data,
+			   lines->len,
+			   sizeof (Line),
+			   compare_lines,
+			   (gpointer) sort_info);
+
+	/* the sorted text is rebuilt in a single buffer */
+	ret = g_malloc (end - text + lines->len + 1);
+	ret_len = 0;
+
+	for (i = 0; i < lines->len; i++)
+	{
+		const Line *line = &g_array_index (lines, Line, i);
+
+		if (!(sort_info->remove_duplicates &&
+		      last != NULL &&
+		      last->len == line->len &&
+		      memcmp (last->str, line->str, line->len) == 0))
+		{
+			memcpy (ret + ret_len, line->str, line->len);
+			ret_len += line->len;
+			ret[ret_len++] = '\n';
+		}
+
+		last = line;
+	}
+
+	ret[ret_len] = '\0';
+
+	for (i = 0; i < lines->len; i++)
+		g_free (g_array_index (lines, Line, i).key);
+
+	g_array_free (lines, TRUE);
+
+	return ret;
+}
@@ -0,0 +1,54 @@
+/*
+ * gedit-sort-lines.h
+ * This file is part of gedit
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GEDIT_SORT_LINES_H__
+#define __GEDIT_SORT_LINES_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+	GEDIT_SORT_MODE_TEXT,
+	GEDIT_SORT_MODE_NUMERIC,
+	GEDIT_SORT_MODE_NATURAL
+} GeditSortMode;
+
+typedef struct
+{
+	GeditSortMode mode;
+	gboolean ignore_case;
+	gboolean reverse_order;
+	gboolean remove_duplicates;
+	gint starting_column;
+} GeditSortInfo;
+
+/* Sorts the lines of @text, which can end with any of the line
+ * terminators of GtkTextBuffer. The returned text has each line
+ * followed by a "\n". */
+gchar	*gedit_sort_lines	(const gchar         *text,
+				 const GeditSortInfo *sort_info);
+
+G_END_DECLS
+
+#endif /* __GEDIT_SORT_LINES_H__ */
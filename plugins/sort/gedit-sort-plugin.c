@@ -26,6 +26,7 @@
 #endif
 
 #include "gedit-sort-plugin.h"
+#include "gedit-sort-lines.h"
 
 #include <string.h>
 #include <glib/gi18n-lib.h>
@@ -52,6 +53,8 @@ typedef struct
 	GtkWidget *reverse_order_checkbutton;
 	GtkWidget *ignore_case_checkbutton;
 	GtkWidget *remove_dups_checkbutton;
+	GtkWidget *numeric_radiobutton;
+	GtkWidget *natural_radiobutton;
 
 	GeditDocument *doc;
 } SortDialog;
@@ -68,14 +71,6 @@ typedef struct
 	GeditWindow *window;
 } ActionData;
 
-typedef struct
-{
-	gboolean ignore_case;
-	gboolean reverse_order;
-	gboolean remove_duplicates;
-	gint starting_column;
-} SortInfo;
-
 static void sort_cb (GtkAction *action, ActionData *action_data);
 static void sort_real (SortDialog *dialog);
 
@@ -148,6 +143,8 @@ get_sort_dialog (ActionData *action_data)
 					  "col_num_spinbutton", &dialog->col_num_spinbutton,
 					  "ignore_case_checkbutton", &dialog->ignore_case_checkbutton,
 					  "remove_dups_checkbutton", &dialog->remove_dups_checkbutton,
+					  "numeric_radiobutton", &dialog->numeric_radiobutton,
+					  "natural_radiobutton", &dialog->natural_radiobutton,
 					  NULL);
 	g_free (ui_file);
 	
@@ -212,136 +209,32 @@ sort_cb (GtkAction  *action,
 	gtk_widget_show (GTK_WIDGET (dialog->dialog));
 }
 
-/* Compares two strings for the sorting algorithm. Uses the UTF-8 processing
- * functions in GLib to be as correct as possible.*/
-static gint
-compare_algorithm (gconstpointer s1,
-		   gconstpointer s2,
-		   gpointer	 data)
-{
-	gint length1, length2;
-	gint ret;
-	gchar *string1, *string2;
-	gchar *substring1, *substring2;
-	gchar *key1, *key2;
-	SortInfo *sort_info;
-
-	gedit_debug (DEBUG_PLUGINS);
-
-	sort_info = (SortInfo *) data;
-	g_return_val_if_fail (sort_info != NULL, -1);
-
-	if (!sort_info->ignore_case)
-	{
-		string1 = *((gchar **) s1);
-		string2 = *((gchar **) s2);
-	}
-	else
-	{
-		string1 = g_utf8_casefold (*((gchar **) s1), -1);
-		string2 = g_utf8_casefold (*((gchar **) s2), -1);
-	}
-
-	length1 = g_utf8_strlen (string1, -1);
-	length2 = g_utf8_strlen (string2, -1);
-
-	if ((length1 < sort_info->starting_column) &&
-	    (length2 < sort_info->starting_column))
-	{
-		ret = 0;
-	}
-	else if (length1 < sort_info->starting_column)
-	{
-		ret = -1;
-	}
-	else if (length2 < sort_info->starting_column)
-	{
-		ret = 1;
-	}
-	else if (sort_info->starting_column < 1)
-	{
-		key1 = g_utf8_collate_key (string1, -1);
-		key2 = g_utf8_collate_key (string2, -1);
-		ret = strcmp (key1, key2);
-
-		g_free (key1);
-		g_free (key2);
-	}
-	else
-	{
-		/* A character column offset is required, so figure out
-		 * the correct offset into the UTF-8 string. */
-		substring1 = g_utf8_offset_to_pointer (string1, sort_info->starting_column);
-		substring2 = g_utf8_offset_to_pointer (string2, sort_info->starting_column);
-
-		key1 = g_utf8_collate_key (substring1, -1);
-		key2 = g_utf8_collate_key (substring2, -1);
-		ret = strcmp (key1, key2);
-
-		g_free (key1);
-		g_free (key2);
-	}
-
-	/* Do the necessary cleanup. */
-	if (sort_info->ignore_case)
-	{
-		g_free (string1);
-		g_free (string2);
-	}
-
-	if (sort_info->reverse_order)
-	{
-		ret = -1 * ret;
-	}
-
-	return ret;
-}
-
-static gchar *
-get_line_slice (GtkTextBuffer *buf,
-		gint           line)
-{
-	GtkTextIter start, end;
-	char *ret;
-
-	gtk_text_buffer_get_iter_at_line (buf, &start, line);
-	end = start;
-
-	if (!gtk_text_iter_ends_line (&start))
-		gtk_text_iter_forward_to_line_end (&end);
-
-	ret= gtk_text_buffer_get_slice (buf,
-					  &start,
-					  &end,
-					  TRUE);
-
-	g_assert (ret != NULL);
-
-	return ret;
-}
-
 static void
 sort_real (SortDialog *dialog)
 {
 	GeditDocument *doc;
 	GtkTextIter start, end;
 	gint start_line, end_line;
-	gint i;
-	gchar *last_row = NULL;
-	gint num_lines;
-	gchar **lines;
-	SortInfo *sort_info;
+	gchar *text;
+	gchar *sorted;
+	GeditSortInfo sort_info;
 
 	gedit_debug (DEBUG_PLUGINS);
 
 	doc = dialog->doc;
 	g_return_if_fail (doc != NULL);
 
-	sort_info = g_new0 (SortInfo, 1);
-	sort_info->ignore_case = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (dialog->ignore_case_checkbutton));
-	sort_info->reverse_order = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (dialog->reverse_order_checkbutton));
-	sort_info->remove_duplicates = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (dialog->remove_dups_checkbutton));
-	sort_info->starting_column = gtk_spin_button_get_value_as_int (GTK_SPIN_BUTTON (dialog->col_num_spinbutton)) - 1;
+	sort_info.ignore_case = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (dialog->ignore_case_checkbutton));
+	sort_info.reverse_order = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (dialog->reverse_order_checkbutton));
+	sort_info.remove_duplicates = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (dialog->remove_dups_checkbutton));
+	sort_info.starting_column = gtk_spin_button_get_value_as_int (GTK_SPIN_BUTTON (dialog->col_num_spinbutton)) - 1;
+
+	if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (dialog->numeric_radiobutton)))
+		sort_info.mode = GEDIT_SORT_MODE_NUMERIC;
+	else if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (dialog->natural_radiobutton)))
+		sort_info.mode = GEDIT_SORT_MODE_NATURAL;
+	else
+		sort_info.mode = GEDIT_SORT_MODE_TEXT;
 
 	if (!gtk_text_buffer_get_selection_bounds (GTK_TEXT_BUFFER (doc),
 						   &start,
@@ -353,36 +246,26 @@ sort_real (SortDialog *dialog)
 					    &end);
 	}
 
+	/* whole lines are sorted */
+	gtk_text_iter_set_line_offset (&start, 0);
+
 	start_line = gtk_text_iter_get_line (&start);
 	end_line = gtk_text_iter_get_line (&end);
 
 	/* if we are at line start our last line is the previus one.
 	 * Otherwise the last line is the current one but we try to
 	 * move the iter after the line terminator */
-	if (gtk_text_iter_get_line_offset (&end) == 0)
-		end_line = MAX (start_line, end_line - 1);
-	else
+	if (gtk_text_iter_get_line_offset (&end) != 0 || start_line == end_line)
 		gtk_text_iter_forward_line (&end);
 
-	num_lines = end_line - start_line + 1;
-	lines = g_new0 (gchar *, num_lines + 1);
-
-	gedit_debug_message (DEBUG_PLUGINS, "Building list...");
-
-	for (i = 0; i < num_lines; i++)
-	{
-		lines[i] = get_line_slice (GTK_TEXT_BUFFER (doc), start_line + i);
-	}
-
-	lines[num_lines] = NULL;
+	gedit_debug_message (DEBUG_PLUGINS, "Sort lines...");
 
-	gedit_debug_message (DEBUG_PLUGINS, "Sort list...");
+	text = gtk_text_buffer_get_slice (GTK_TEXT_BUFFER (doc),
+					  &start,
+					  &end,
+					  TRUE);
 
-	g_qsort_with_data (lines,
-			   num_lines,
-			   sizeof (gpointer),
-			   compare_algorithm,
-			   sort_info);
+	sorted = gedit_sort_lines (text, &sort_info);
 
 	gedit_debug_message (DEBUG_PLUGINS, "Rebuilding document...");
 
@@ -392,29 +275,15 @@ sort_real (SortDialog *dialog)
 				&start,
 				&end);
 
-	for (i = 0; i < num_lines; i++)
-	{
-		if (sort_info->remove_duplicates &&
-		    last_row != NULL &&
-		    (strcmp (last_row, lines[i]) == 0))
-			continue;
-
-		gtk_text_buffer_insert (GTK_TEXT_BUFFER (doc),
-					&start,
-					lines[i],
-					-1);
-		gtk_text_buffer_insert (GTK_TEXT_BUFFER (doc),
-					&start,
-					"\n",
-					-1);
-
-		last_row = lines[i];
-	}
+	gtk_text_buffer_insert (GTK_TEXT_BUFFER (doc),
+				&start,
+				sorted,
+				-1);
 
 	gtk_source_buffer_end_not_undoable_action (GTK_SOURCE_BUFFER (doc));
 
-	g_strfreev (lines);
-	g_free (sort_info);
+	g_free (text);
+	g_free (sorted);
 
 	gedit_debug_message (DEBUG_PLUGINS, "Done.");
 }
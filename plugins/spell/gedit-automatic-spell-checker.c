@@ -38,11 +38,33 @@
 
 #include <string.h>
 
+#include <enchant.h>
+
 #include <glib/gi18n.h>
 
+#include <gtksourceview/gtksourcebuffer.h>
+
+#include <gedit/gedit-debug.h>
+
 #include "gedit-automatic-spell-checker.h"
 #include "gedit-spell-utils.h"
 
+/* Time spent checking in each idle slice, in seconds */
+#define SLICE_BUDGET 0.010
+
+/* Text unchecked is checked by chunks of this many chars, the timer is
+ * looked at between two chunks */
+#define CHUNK_CHARS 1000
+
+/* Bigger insertions (a paste, a file being loaded) are checked in idle */
+#define MAX_SYNC_CHARS 1000
+
+/* Threads checking the text out of the views, and the size and number
+ * of jobs queued at once for each document */
+#define N_WORKERS 4
+#define JOB_CHARS (16 * 1024)
+#define MAX_JOBS (2 * N_WORKERS)
+
 struct _GeditAutomaticSpellChecker {
 	GeditDocument		*doc;
 	GSList 			*views;
@@ -54,6 +76,19 @@ struct _GeditAutomaticSpellChecker {
 	GtkTextTag 		*tag_highlight;
 	GtkTextMark		*mark_click;
 
+	/* Covers the text not checked yet, it follows the edits
+	 * like any other tag */
+	GtkTextTag		*tag_unchecked;
+	guint			 idle_id;
+	GTimer			*timer;
+	gdouble			 total_time;
+
+	/* The jobs queued and not applied yet, an edit discards the
+	 * ones whose text it touches and moves the ones after it */
+	GSList			*running_jobs;
+	gint			 jobs;
+	gboolean		 disposed;
+
        	GeditSpellChecker	*spell_checker;
 };
 
@@ -207,6 +242,556 @@ check_range (GeditAutomaticSpellChecker *spell,
 	}
 }
 
+/* Finds the next unchecked text after @iter, at most @max_chars long
+ * and not beyond @limit if not NULL */
+static gboolean
+get_unchecked_chunk (GeditAutomaticSpellChecker *spell,
+		     const GtkTextIter          *iter,
+		     const GtkTextIter          *limit,
+		     gint                        max_chars,
+		     GtkTextIter                *start,
+		     GtkTextIter                *end)
+{
+	*start = *iter;
+
+	if (!gtk_text_iter_has_tag (start, spell->tag_unchecked) &&
+	    !gtk_text_iter_forward_to_tag_toggle (start, spell->tag_unchecked))
+	{
+		return FALSE;
+	}
+
+	if (limit != NULL && gtk_text_iter_compare (start, limit) >= 0)
+		return FALSE;
+
+	*end = *start;
+	gtk_text_iter_forward_to_tag_toggle (end, spell->tag_unchecked);
+
+	if (gtk_text_iter_get_offset (end) - gtk_text_iter_get_offset (start) > max_chars)
+	{
+		*end = *start;
+		gtk_text_iter_forward_chars (end, max_chars);
+	}
+
+	if (limit != NULL && gtk_text_iter_compare (end, limit) > 0)
+		*end = *limit;
+
+	return TRUE;
+}
+
+static gboolean
+has_unchecked_text (GeditAutomaticSpellChecker *spell)
+{
+	GtkTextIter iter, start, end;
+
+	gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (spell->doc), &iter);
+
+	return get_unchecked_chunk (spell, &iter, NULL, 1, &start, &end);
+}
+
+/* Checks the unchecked text between @from and @limit until the slice
+ * budget is spent, returns the number of chars checked */
+static gint
+check_unchecked_text (GeditAutomaticSpellChecker *spell,
+		      const GtkTextIter          *from,
+		      const GtkTextIter          *limit)
+{
+	GtkTextIter iter = *from;
+	GtkTextIter start, end;
+	gint chars = 0;
+
+	while (g_timer_elapsed (spell->timer, NULL) < SLICE_BUDGET &&
+	       get_unchecked_chunk (spell, &iter, limit, CHUNK_CHARS, &start, &end))
+	{
+		chars += gtk_text_iter_get_offset (&end) -
+			 gtk_text_iter_get_offset (&start);
+
+		/* check_range moves the bounds to the words bounds, a
+		 * word cut at the end of a chunk is checked twice */
+		check_range (spell, start, end, TRUE);
+
+		gtk_text_buffer_remove_tag (GTK_TEXT_BUFFER (spell->doc),
+					    spell->tag_unchecked,
+					    &start,
+					    &end);
+
+		iter = end;
+	}
+
+	return chars;
+}
+
+/* The text out of the views is checked by a pool of threads, each one
+ * with its own enchant broker and dict since they are not thread safe.
+ * A job is a copy of some text of the buffer, the words that its dict
+ * does not know come back as char offsets to the main thread, which
+ * checks them again since the session and personal words are only known
+ * by the dict of the GeditSpellChecker. */
+typedef struct
+{
+	/* only used in the main thread */
+	GeditAutomaticSpellChecker *spell;
+	gint                        delta;
+	gboolean                    discarded;
+
+	gint                        start;
+	gint                        end;
+	gchar                      *text;
+	gchar                      *language;
+
+	/* pairs of start and end offsets, NULL if the worker has no dict */
+	GArray                     *misspelled;
+} CheckJob;
+
+typedef struct
+{
+	EnchantBroker *broker;
+	EnchantDict   *dict;
+	gchar         *language;
+} WorkerDict;
+
+/* The dicts not used by a job right now, at most one for each worker.
+ * They are owned by the pool and freed with it. */
+static GThreadPool *pool = NULL;
+static GAsyncQueue *worker_dicts = NULL;
+
+static void
+worker_dict_free (WorkerDict *wd)
+{
+	if (wd->dict != NULL)
+		enchant_broker_free_dict (wd->broker, wd->dict);
+
+	enchant_broker_free (wd->broker);
+	g_free (wd->language);
+
+	g_slice_free (WorkerDict, wd);
+}
+
+static WorkerDict *
+get_worker_dict (const gchar *language)
+{
+	WorkerDict *wd;
+
+	wd = g_async_queue_try_pop (worker_dicts);
+
+	if (wd == NULL)
+	{
+		wd = g_slice_new0 (WorkerDict);
+		wd->broker = enchant_broker_init ();
+	}
+
+	if (wd->language != NULL && strcmp (wd->language, language) != 0)
+	{
+		if (wd->dict != NULL)
+			enchant_broker_free_dict (wd->broker, wd->dict);
+
+		wd->dict = NULL;
+		g_free (wd->language);
+		wd->language = NULL;
+	}
+
+	if (wd->language == NULL)
+	{
+		wd->dict = enchant_broker_request_dict (wd->broker, language);
+		wd->language = g_strdup (language);
+	}
+
+	return wd;
+}
+
+/* Same as gedit_spell_checker_check_word without the session and the
+ * personal words */
+static gboolean
+worker_check_word (EnchantDict *dict,
+		   const gchar *word,
+		   gsize        len)
+{
+	if (len == strlen ("gedit") && strncmp (word, "gedit", len) == 0)
+		return TRUE;
+
+	if (gedit_spell_utils_is_digit (word, len))
+		return TRUE;
+
+	return enchant_dict_check (dict, word, len) == 0;
+}
+
+static gboolean job_done (CheckJob *job);
+
+static void
+check_job_thread (CheckJob *job,
+		  gpointer  data)
+{
+	WorkerDict *wd;
+	EnchantDict *dict;
+	PangoLogAttr *attrs;
+	const gchar *p;
+	const gchar *word = NULL;
+	gint word_start = -1;
+	gint n_chars;
+	gint i;
+
+	wd = get_worker_dict (job->language);
+	dict = wd->dict;
+
+	if (dict == NULL)
+	{
+		g_async_queue_push (worker_dicts, wd);
+		g_idle_add_full (G_PRIORITY_LOW, (GSourceFunc) job_done, job, NULL);
+		return;
+	}
+
+	job->misspelled = g_array_new (FALSE, FALSE, sizeof (gint));
+
+	/* the language specific breaks of pango_get_log_attrs are not
+	 * thread safe, the default ones are the same for most scripts */
+	n_chars = g_utf8_strlen (job->text, -1);
+	attrs = g_new (PangoLogAttr, n_chars + 1);
+	pango_default_break (job->text, -1, NULL, attrs, n_chars + 1);
+
+	p = job->text;
+
+	for (i = 0; i <= n_chars; i++)
+	{
+		if (attrs[i].is_word_end && word_start != -1)
+		{
+			if (!worker_check_word (dict, word, p - word))
+			{
+				gint offset;
+
+				offset = job->start + word_start;
+				g_array_append_val (job->misspelled, offset);
+				offset = job->start + i;
+				g_array_append_val (job->misspelled, offset);
+			}
+
+			word_start = -1;
+		}
+
+		if (attrs[i].is_word_start)
+		{
+			word_start = i;
+			word = p;
+		}
+
+		if (i < n_chars)
+			p = g_utf8_next_char (p);
+	}
+
+	g_free (attrs);
+
+	g_async_queue_push (worker_dicts, wd);
+	g_idle_add_full (G_PRIORITY_LOW, (GSourceFunc) job_done, job, NULL);
+}
+
+static GThreadPool *
+get_pool (void)
+{
+	if (pool == NULL && g_thread_supported ())
+	{
+		worker_dicts = g_async_queue_new ();
+		pool = g_thread_pool_new ((GFunc) check_job_thread,
+					  NULL,
+					  N_WORKERS,
+					  FALSE,
+					  NULL);
+	}
+
+	return pool;
+}
+
+/* Waits for the jobs queued, their results are applied by the main
+ * loop as usual */
+void
+gedit_automatic_spell_checker_shutdown (void)
+{
+	WorkerDict *wd;
+
+	if (pool == NULL)
+		return;
+
+	g_thread_pool_free (pool, FALSE, TRUE);
+	pool = NULL;
+
+	while ((wd = g_async_queue_try_pop (worker_dicts)) != NULL)
+		worker_dict_free (wd);
+
+	g_async_queue_unref (worker_dicts);
+	worker_dicts = NULL;
+}
+
+static void
+check_job_free (CheckJob *job)
+{
+	g_free (job->text);
+	g_free (job->language);
+
+	if (job->misspelled != NULL)
+		g_array_free (job->misspelled, TRUE);
+
+	g_slice_free (CheckJob, job);
+}
+
+/* Queues the unchecked text after @from, returns the number of jobs
+ * queued */
+static gint
+queue_jobs (GeditAutomaticSpellChecker *spell,
+	    GThreadPool                *pool,
+	    const gchar                *language,
+	    const GtkTextIter          *from)
+{
+	GtkTextIter iter = *from;
+	GtkTextIter start, end;
+	gint n = 0;
+
+	while (spell->jobs < MAX_JOBS &&
+	       get_unchecked_chunk (spell, &iter, NULL, JOB_CHARS, &start, &end))
+	{
+		CheckJob *job;
+
+		/* the words are not split between two jobs */
+		if (gtk_text_iter_inside_word (&start) &&
+		    !gtk_text_iter_starts_word (&start))
+		{
+			gtk_text_iter_backward_word_start (&start);
+		}
+
+		if (gtk_text_iter_inside_word (&end))
+			gtk_text_iter_forward_word_end (&end);
+
+		job = g_slice_new0 (CheckJob);
+		job->spell = spell;
+		job->start = gtk_text_iter_get_offset (&start);
+		job->end = gtk_text_iter_get_offset (&end);
+		job->language = g_strdup (language);
+
+		/* a slice has one char for each offset */
+		job->text = gtk_text_iter_get_slice (&start, &end);
+
+		g_thread_pool_push (pool, job, NULL);
+
+		spell->running_jobs = g_slist_prepend (spell->running_jobs, job);
+		spell->jobs++;
+		n++;
+
+		iter = end;
+	}
+
+	return n;
+}
+
+static void
+apply_job (GeditAutomaticSpellChecker *spell,
+	   CheckJob                   *job)
+{
+	GtkTextBuffer *buffer = GTK_TEXT_BUFFER (spell->doc);
+	GtkTextIter start, end;
+	guint i;
+
+	gtk_text_buffer_get_iter_at_offset (buffer, &start, job->start + job->delta);
+	gtk_text_buffer_get_iter_at_offset (buffer, &end, job->end + job->delta);
+
+	if (job->misspelled == NULL)
+	{
+		check_range (spell, start, end, TRUE);
+	}
+	else
+	{
+		gtk_text_buffer_remove_tag (buffer,
+					    spell->tag_highlight,
+					    &start,
+					    &end);
+
+		for (i = 0; i + 1 < job->misspelled->len; i += 2)
+		{
+			GtkTextIter wstart, wend;
+
+			gtk_text_buffer_get_iter_at_offset (buffer,
+							    &wstart,
+							    g_array_index (job->misspelled, gint, i) + job->delta);
+			gtk_text_buffer_get_iter_at_offset (buffer,
+							    &wend,
+							    g_array_index (job->misspelled, gint, i + 1) + job->delta);
+
+			if (!gtk_source_buffer_iter_has_context_class (GTK_SOURCE_BUFFER (buffer),
+								       &wstart,
+								       "no-spell-check"))
+			{
+				check_word (spell, &wstart, &wend);
+			}
+		}
+	}
+
+	gtk_text_buffer_remove_tag (buffer, spell->tag_unchecked, &start, &end);
+}
+
+static void
+check_done (GeditAutomaticSpellChecker *spell)
+{
+	guint lookups, hits;
+
+	gedit_spell_checker_get_cache_stats (spell->spell_checker, &lookups, &hits);
+
+	gedit_debug_message (DEBUG_PLUGINS,
+			     "Document checked in %.1f ms, cache hits: %u of %u lookups so far",
+			     spell->total_time * 1000, hits, lookups);
+
+	spell->total_time = 0;
+}
+
+static gboolean check_unchecked_idle (GeditAutomaticSpellChecker *spell);
+
+/* Lower priority than the redraws, so that they are not delayed. While
+ * some jobs are running the idle would queue their text again, it is
+ * scheduled when the last one is done. */
+static void
+schedule_check (GeditAutomaticSpellChecker *spell)
+{
+	if (spell->idle_id == 0 && spell->jobs == 0)
+	{
+		spell->idle_id = g_idle_add_full (G_PRIORITY_LOW,
+						  (GSourceFunc) check_unchecked_idle,
+						  spell,
+						  NULL);
+	}
+}
+
+static gboolean
+job_done (CheckJob *job)
+{
+	GeditAutomaticSpellChecker *spell = job->spell;
+
+	spell->jobs--;
+	spell->running_jobs = g_slist_remove (spell->running_jobs, job);
+
+	if (spell->disposed)
+	{
+		if (spell->jobs == 0)
+			g_free (spell);
+
+		check_job_free (job);
+
+		return FALSE;
+	}
+
+	/* the text of a discarded job changed in the meantime, it is
+	 * still tagged as unchecked and will be queued again */
+	if (!job->discarded)
+	{
+		g_timer_start (spell->timer);
+		apply_job (spell, job);
+		spell->total_time += g_timer_elapsed (spell->timer, NULL);
+	}
+	else
+	{
+		gedit_debug_message (DEBUG_PLUGINS,
+				     "Discarded the check of [%d - %d], the text changed",
+				     job->start, job->end);
+	}
+
+	check_job_free (job);
+
+	if (spell->jobs == 0)
+	{
+		if (has_unchecked_text (spell))
+			schedule_check (spell);
+		else
+			check_done (spell);
+	}
+
+	return FALSE;
+}
+
+static void
+get_visible_range (GtkTextView *view,
+		   GtkTextIter *start,
+		   GtkTextIter *end)
+{
+	GdkRectangle rect;
+
+	gtk_text_view_get_visible_rect (view, &rect);
+
+	gtk_text_view_get_line_at_y (view, start, rect.y, NULL);
+	gtk_text_view_get_line_at_y (view, end, rect.y + rect.height, NULL);
+	gtk_text_iter_forward_line (end);
+}
+
+/* Each slice first checks what the views are showing, so that the user
+ * sees the result at once even if the slices before were spent
+ * elsewhere: scrolling or editing somewhere else moves the work there.
+ * The rest of the buffer is queued to the threads from the start, or
+ * checked in the slice if there are no threads. */
+static gboolean
+check_unchecked_idle (GeditAutomaticSpellChecker *spell)
+{
+	const GeditSpellCheckerLanguage *lang;
+	GThreadPool *pool;
+	GtkTextIter start, end;
+	GSList *l;
+	gint chars = 0;
+	gint jobs = 0;
+	gdouble elapsed;
+
+	g_timer_start (spell->timer);
+
+	for (l = spell->views; l != NULL; l = g_slist_next (l))
+	{
+		get_visible_range (GTK_TEXT_VIEW (l->data), &start, &end);
+		chars += check_unchecked_text (spell, &start, &end);
+	}
+
+	gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (spell->doc), &start);
+
+	lang = gedit_spell_checker_get_language (spell->spell_checker);
+	pool = get_pool ();
+
+	if (lang != NULL && pool != NULL)
+	{
+		jobs = queue_jobs (spell,
+				   pool,
+				   gedit_spell_checker_language_to_key (lang),
+				   &start);
+	}
+	else
+	{
+		chars += check_unchecked_text (spell, &start, NULL);
+	}
+
+	elapsed = g_timer_elapsed (spell->timer, NULL);
+	spell->total_time += elapsed;
+
+	gedit_debug_message (DEBUG_PLUGINS,
+			     "Checked %d chars in %.1f ms (budget %.1f ms), %d jobs queued",
+			     chars, elapsed * 1000, SLICE_BUDGET * 1000, jobs);
+
+	/* job_done schedules the next slice */
+	if (spell->jobs > 0)
+	{
+		spell->idle_id = 0;
+		return FALSE;
+	}
+
+	if (has_unchecked_text (spell))
+		return TRUE;
+
+	check_done (spell);
+
+	spell->idle_id = 0;
+
+	return FALSE;
+}
+
+static void
+check_in_idle (GeditAutomaticSpellChecker *spell,
+	       const GtkTextIter          *start,
+	       const GtkTextIter          *end)
+{
+	gtk_text_buffer_apply_tag (GTK_TEXT_BUFFER (spell->doc),
+				   spell->tag_unchecked,
+				   start,
+				   end);
+
+	schedule_check (spell);
+}
+
 static void
 check_deferred_range (GeditAutomaticSpellChecker *spell, 
 		      gboolean                    force_all) 
@@ -230,10 +815,38 @@ check_deferred_range (GeditAutomaticSpellChecker *spell,
  *
  * this may be overkill for the common case (inserting one character). */
 
+/* Called before the text from @start to @end is replaced by @chars
+ * chars. The jobs after it are moved, the results of the ones it
+ * touches, even at their bounds since a word there may change, are
+ * discarded. */
+static void
+edit_running_jobs (GeditAutomaticSpellChecker *spell,
+		   gint                        start,
+		   gint                        end,
+		   gint                        chars)
+{
+	GSList *l;
+
+	for (l = spell->running_jobs; l != NULL; l = g_slist_next (l))
+	{
+		CheckJob *job = l->data;
+
+		if (end < job->start + job->delta)
+			job->delta += chars - (end - start);
+		else if (start <= job->end + job->delta)
+			job->discarded = TRUE;
+	}
+}
+
 static void
 insert_text_before (GtkTextBuffer *buffer, GtkTextIter *iter,
 		gchar *text, gint len, GeditAutomaticSpellChecker *spell) 
 {
+	gint offset;
+
+	offset = gtk_text_iter_get_offset (iter);
+	edit_running_jobs (spell, offset, offset, g_utf8_strlen (text, len));
+
 	gtk_text_buffer_move_mark (buffer, spell->mark_insert_start, iter);
 }
 
@@ -245,8 +858,11 @@ insert_text_after (GtkTextBuffer *buffer, GtkTextIter *iter,
 
 	/* we need to check a range of text. */
 	gtk_text_buffer_get_iter_at_mark (buffer, &start, spell->mark_insert_start);
-	
-	check_range (spell, start, *iter, FALSE);
+
+	if (gtk_text_iter_get_offset (iter) - gtk_text_iter_get_offset (&start) > MAX_SYNC_CHARS)
+		check_in_idle (spell, &start, iter);
+	else
+		check_range (spell, start, *iter, FALSE);
 
 	gtk_text_buffer_move_mark (buffer, spell->mark_insert_end, iter);
 }
@@ -258,6 +874,16 @@ insert_text_after (GtkTextBuffer *buffer, GtkTextIter *iter,
  * deletion.
  */
 
+static void
+delete_range_before (GtkTextBuffer *buffer, GtkTextIter *start, GtkTextIter *end, 
+		GeditAutomaticSpellChecker *spell) 
+{
+	edit_running_jobs (spell,
+			   gtk_text_iter_get_offset (start),
+			   gtk_text_iter_get_offset (end),
+			   0);
+}
+
 static void
 delete_range_after (GtkTextBuffer *buffer, GtkTextIter *start, GtkTextIter *end, 
 		GeditAutomaticSpellChecker *spell) 
@@ -565,12 +1191,26 @@ void
 gedit_automatic_spell_checker_recheck_all (GeditAutomaticSpellChecker *spell)
 {
 	GtkTextIter start, end;
+	GSList *l;
 
 	g_return_if_fail (spell != NULL);
 
 	gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (spell->doc), &start, &end);
 
-	check_range (spell, start, end, TRUE);
+	/* the jobs running use the old language */
+	for (l = spell->running_jobs; l != NULL; l = g_slist_next (l))
+		((CheckJob *) l->data)->discarded = TRUE;
+
+	/* the old highlights stay until their text is checked again */
+	check_in_idle (spell, &start, &end);
+}
+
+gboolean
+gedit_automatic_spell_checker_is_checking (GeditAutomaticSpellChecker *spell)
+{
+	g_return_val_if_fail (spell != NULL, FALSE);
+
+	return spell->idle_id != 0 || spell->jobs > 0;
 }
 
 static void 
@@ -731,6 +1371,10 @@ gedit_automatic_spell_checker_new (GeditDocument     *doc,
 			  "insert-text",
 			  G_CALLBACK (insert_text_after), 
 			  spell);
+	g_signal_connect (doc,
+			  "delete-range",
+			  G_CALLBACK (delete_range_before), 
+			  spell);
 	g_signal_connect_after (doc,
 			  "delete-range",
 			  G_CALLBACK (delete_range_after), 
@@ -763,6 +1407,11 @@ gedit_automatic_spell_checker_new (GeditDocument     *doc,
 				"underline", PANGO_UNDERLINE_ERROR,
 				NULL);
 
+	/* created before setting the priority, the highlight stays on top */
+	spell->tag_unchecked = gtk_text_buffer_create_tag (GTK_TEXT_BUFFER (doc),
+							   NULL,
+							   NULL);
+
 	tag_table = gtk_text_buffer_get_tag_table (GTK_TEXT_BUFFER (doc));
 
 	gtk_text_tag_set_priority (spell->tag_highlight, 
@@ -841,6 +1490,8 @@ gedit_automatic_spell_checker_new (GeditDocument     *doc,
 
 	spell->deferred_check = FALSE;
 
+	spell->timer = g_timer_new ();
+
 	return spell;
 }
 
@@ -876,6 +1527,11 @@ gedit_automatic_spell_checker_free_internal (GeditAutomaticSpellChecker *spell)
 	
 	g_return_if_fail (spell != NULL);
 
+	if (spell->idle_id != 0)
+		g_source_remove (spell->idle_id);
+
+	g_timer_destroy (spell->timer);
+
 	table = gtk_text_buffer_get_tag_table (GTK_TEXT_BUFFER (spell->doc));
 
 	if (table != NULL)
@@ -887,6 +1543,10 @@ gedit_automatic_spell_checker_free_internal (GeditAutomaticSpellChecker *spell)
 					    spell->tag_highlight, 
 					    &start, 
 					    &end);
+		gtk_text_buffer_remove_tag (GTK_TEXT_BUFFER (spell->doc),
+					    spell->tag_unchecked,
+					    &start,
+					    &end);
 
 		g_signal_handlers_disconnect_matched (G_OBJECT (table),
 					G_SIGNAL_MATCH_DATA,
@@ -894,6 +1554,7 @@ gedit_automatic_spell_checker_free_internal (GeditAutomaticSpellChecker *spell)
 					spell);
 
 		gtk_text_tag_table_remove (table, spell->tag_highlight);
+		gtk_text_tag_table_remove (table, spell->tag_unchecked);
 	}
 		
 	g_signal_handlers_disconnect_matched (G_OBJECT (spell->doc),
@@ -927,8 +1588,12 @@ gedit_automatic_spell_checker_free_internal (GeditAutomaticSpellChecker *spell)
 	}
 
 	g_slist_free (spell->views);
-	
-	g_free (spell);
+
+	/* the jobs still running free it when they are done */
+	if (spell->jobs > 0)
+		spell->disposed = TRUE;
+	else
+		g_free (spell);
 }
 
 void
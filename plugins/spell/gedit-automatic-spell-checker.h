@@ -63,5 +63,12 @@ void 				 gedit_automatic_spell_checker_detach_view (
 void				 gedit_automatic_spell_checker_recheck_all (
 							GeditAutomaticSpellChecker 	*spell);
 
+/* TRUE while some text is waiting to be checked */
+gboolean			 gedit_automatic_spell_checker_is_checking (
+							GeditAutomaticSpellChecker 	*spell);
+
+/* Frees the threads checking the text out of the views */
+void				 gedit_automatic_spell_checker_shutdown (void);
+
 #endif  /* __GEDIT_AUTOMATIC_SPELL_CHECKER_H__ */
 
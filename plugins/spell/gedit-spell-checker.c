@@ -49,8 +49,21 @@ struct _GeditSpellChecker
 	EnchantDict                     *dict;
 	EnchantBroker                   *broker;
 	const GeditSpellCheckerLanguage *active_lang;
+
+	/* word -> verdict of the dict, cleared when the dict changes or
+	 * when it has more than cache_size words */
+	GHashTable                      *cache;
+	guint                            cache_size;
+	guint                            lookups;
+	guint                            hits;
 };
 
+#define DEFAULT_CACHE_SIZE 10000
+
+/* The verdicts stored in the cache, NULL is a miss */
+#define VERDICT_CORRECT    GINT_TO_POINTER (1)
+#define VERDICT_MISSPELLED GINT_TO_POINTER (2)
+
 /* GObject properties */
 enum {
 	PROP_0 = 0,
@@ -125,6 +138,8 @@ gedit_spell_checker_finalize (GObject *object)
 	if (spell_checker->broker != NULL)
 		enchant_broker_free (spell_checker->broker);
 
+	g_hash_table_destroy (spell_checker->cache);
+
 	G_OBJECT_CLASS (gedit_spell_checker_parent_class)->finalize (object);
 }
 
@@ -199,6 +214,12 @@ gedit_spell_checker_init (GeditSpellChecker *spell_checker)
 	spell_checker->broker = enchant_broker_init ();
 	spell_checker->dict = NULL;
 	spell_checker->active_lang = NULL;
+
+	spell_checker->cache = g_hash_table_new_full (g_str_hash,
+						      g_str_equal,
+						      g_free,
+						      NULL);
+	spell_checker->cache_size = DEFAULT_CACHE_SIZE;
 }
 
 GeditSpellChecker *
@@ -214,6 +235,12 @@ gedit_spell_checker_new	(void)
 	return spell;
 }
 
+static void
+clear_cache (GeditSpellChecker *spell)
+{
+	g_hash_table_remove_all (spell->cache);
+}
+
 static gboolean
 lazy_init (GeditSpellChecker               *spell,
 	   const GeditSpellCheckerLanguage *language)
@@ -300,6 +327,8 @@ gedit_spell_checker_set_language (GeditSpellChecker               *spell,
 		spell->dict = NULL;
 	}
 
+	clear_cache (spell);
+
 	ret = lazy_init (spell, language);
 
 	if (ret)
@@ -329,6 +358,8 @@ gedit_spell_checker_check_word (GeditSpellChecker *spell,
 {
 	gint enchant_result;
 	gboolean res = FALSE;
+	gchar *key;
+	gpointer verdict;
 
 	g_return_val_if_fail (GEDIT_IS_SPELL_CHECKER (spell), FALSE);
 	g_return_val_if_fail (word != NULL, FALSE);
@@ -346,6 +377,20 @@ gedit_spell_checker_check_word (GeditSpellChecker *spell,
 		return TRUE;
 
 	g_return_val_if_fail (spell->dict != NULL, FALSE);
+
+	key = g_strndup (word, len);
+
+	spell->lookups++;
+	verdict = g_hash_table_lookup (spell->cache, key);
+
+	if (verdict != NULL)
+	{
+		spell->hits++;
+		g_free (key);
+
+		return verdict == VERDICT_CORRECT;
+	}
+
 	enchant_result = enchant_dict_check (spell->dict, word, len);
 
 	switch (enchant_result)
@@ -367,12 +412,55 @@ gedit_spell_checker_check_word (GeditSpellChecker *spell,
 			res = TRUE;
 			break;
 		default:
+			g_free (key);
 			g_return_val_if_reached (FALSE);
 	}
 
+	/* errors are not cached, the next check may succeed */
+	if (enchant_result == -1 || spell->cache_size == 0)
+	{
+		g_free (key);
+		return res;
+	}
+
+	/* a document has a few thousands different words at most, so
+	 * starting again is simpler than keeping track of the oldest */
+	if (g_hash_table_size (spell->cache) >= spell->cache_size)
+		clear_cache (spell);
+
+	g_hash_table_insert (spell->cache,
+			     key,
+			     res ? VERDICT_CORRECT : VERDICT_MISSPELLED);
+
 	return res;
 }
 
+void
+gedit_spell_checker_set_cache_size (GeditSpellChecker *spell,
+				    guint              size)
+{
+	g_return_if_fail (GEDIT_IS_SPELL_CHECKER (spell));
+
+	spell->cache_size = size;
+
+	if (g_hash_table_size (spell->cache) > size)
+		clear_cache (spell);
+}
+
+void
+gedit_spell_checker_get_cache_stats (GeditSpellChecker *spell,
+				     guint             *lookups,
+				     guint             *hits)
+{
+	g_return_if_fail (GEDIT_IS_SPELL_CHECKER (spell));
+
+	if (lookups != NULL)
+		*lookups = spell->lookups;
+
+	if (hits != NULL)
+		*hits = spell->hits;
+}
+
 
 /* return NULL on error or if no suggestions are found */
 GSList *
@@ -435,6 +523,9 @@ gedit_spell_checker_add_word_to_personal (GeditSpellChecker *spell,
 
 	enchant_dict_add_to_pwl (spell->dict, word, len);
 
+	/* enchant also accepts some case variants of the word */
+	clear_cache (spell);
+
 	g_signal_emit (G_OBJECT (spell), signals[ADD_WORD_TO_PERSONAL], 0, word, len);
 
 	return TRUE;
@@ -458,6 +549,8 @@ gedit_spell_checker_add_word_to_session (GeditSpellChecker *spell,
 
 	enchant_dict_add_to_session (spell->dict, word, len);
 
+	clear_cache (spell);
+
 	g_signal_emit (G_OBJECT (spell), signals[ADD_WORD_TO_SESSION], 0, word, len);
 
 	return TRUE;
@@ -475,6 +568,8 @@ gedit_spell_checker_clear_session (GeditSpellChecker *spell)
 		spell->dict = NULL;
 	}
 
+	clear_cache (spell);
+
 	if (!lazy_init (spell, spell->active_lang))
 		return FALSE;
 
@@ -103,6 +103,14 @@ gboolean		 gedit_spell_checker_set_correction 	(GeditSpellChecker
 								 gssize                           w_len,
 								 const gchar                     *replacement,
 								 gssize                           r_len);
+
+/* The verdicts of check_word are cached, a size of 0 disables the cache */
+void			 gedit_spell_checker_set_cache_size	(GeditSpellChecker               *spell,
+								 guint                            size);
+
+void			 gedit_spell_checker_get_cache_stats	(GeditSpellChecker               *spell,
+								 guint                           *lookups,
+								 guint                           *hits);
 G_END_DECLS
 
 #endif  /* __GEDIT_SPELL_CHECKER_H__ */
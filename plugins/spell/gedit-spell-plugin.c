@@ -137,6 +137,8 @@ gedit_spell_plugin_finalize (GObject *object)
 {
 	gedit_debug_message (DEBUG_PLUGINS, "GeditSpellPlugin finalizing");
 
+	gedit_automatic_spell_checker_shutdown ();
+
 	G_OBJECT_CLASS (gedit_spell_plugin_parent_class)->finalize (object);
 }
 
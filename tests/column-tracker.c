@@ -0,0 +1,233 @@
+/*
+ * column-tracker.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "gedit-column-tracker.h"
+#include <gtk/gtk.h>
+#include <string.h>
+
+static const gchar *pieces[] =
+{
+	"a", "bc", "\t", "\t\t", "\xc3\xa9", "\n", "\r", "\r\n", "\xe2\x80\xa9"
+};
+
+/* What the statusbar used to do */
+static gint
+get_column_slow (const GtkTextIter *iter,
+		 guint              tab_size)
+{
+	GtkTextIter start;
+	gint col = 0;
+
+	start = *iter;
+	gtk_text_iter_set_line_offset (&start, 0);
+
+	while (!gtk_text_iter_equal (&start, iter))
+	{
+		if (gtk_text_iter_get_char (&start) == '\t')
+			col += (tab_size - (col  % tab_size));
+		else
+			++col;
+
+		gtk_text_iter_forward_char (&start);
+	}
+
+	return col;
+}
+
+static void
+test_edits ()
+{
+	GtkTextBuffer *buffer;
+	GeditColumnTracker *tracker;
+	gint i;
+
+	buffer = gtk_text_buffer_new (NULL);
+	tracker = gedit_column_tracker_new (buffer);
+
+	for (i = 0; i < 5000; i++)
+	{
+		GtkTextIter iter, end;
+		guint tab_size;
+		gint length;
+
+		length = gtk_text_buffer_get_char_count (buffer);
+		gtk_text_buffer_get_iter_at_offset (buffer, &iter,
+						    g_random_int_range (0, length + 1));
+
+		/* mostly edits without line breaks */
+		switch (g_random_int_range (0, 4))
+		{
+			case 0:
+				gtk_text_buffer_insert (buffer, &iter,
+							pieces[g_random_int_range (0, G_N_ELEMENTS (pieces))],
+							-1);
+				break;
+			case 1:
+				gtk_text_buffer_insert (buffer, &iter,
+							pieces[g_random_int_range (0, 5)],
+							-1);
+				break;
+			case 2:
+				end = iter;
+				gtk_text_iter_forward_chars (&end, g_random_int_range (1, 4));
+				gtk_text_buffer_delete (buffer, &iter, &end);
+				break;
+			default:
+				break;
+		}
+
+		/* the tab size changes once in a while */
+		tab_size = (i / 500) % 2 == 0 ? 8 : 3;
+
+		length = gtk_text_buffer_get_char_count (buffer);
+		gtk_text_buffer_get_iter_at_offset (buffer, &iter,
+						    g_random_int_range (0, length + 1));
+
+		g_assert_cmpint (gedit_column_tracker_get_column (tracker, &iter, tab_size),
+				 ==,
+				 get_column_slow (&iter, tab_size));
+	}
+
+	gedit_column_tracker_free (tracker);
+	g_object_unref (buffer);
+}
+
+static void
+test_lines ()
+{
+	GtkTextBuffer *buffer;
+	GeditColumnTracker *tracker;
+	GtkTextIter iter;
+
+	buffer = gtk_text_buffer_new (NULL);
+	tracker = gedit_column_tracker_new (buffer);
+
+	gtk_text_buffer_set_text (buffer, "first\nab\tcd\t\tef\nlast", -1);
+
+	gtk_text_buffer_get_iter_at_line_offset (buffer, &iter, 1, 7);
+	g_assert_cmpint (gedit_column_tracker_get_column (tracker, &iter, 4), ==, 12);
+
+	/* a tab typed before the others moves them */
+	gtk_text_buffer_get_iter_at_line_offset (buffer, &iter, 1, 0);
+	gtk_text_buffer_insert (buffer, &iter, "\t", -1);
+
+	gtk_text_buffer_get_iter_at_line_offset (buffer, &iter, 1, 8);
+	g_assert_cmpint (gedit_column_tracker_get_column (tracker, &iter, 4), ==, 16);
+
+	/* joining the lines */
+	gtk_text_buffer_get_iter_at_line (buffer, &iter, 1);
+	gtk_text_buffer_backspace (buffer, &iter, FALSE, TRUE);
+
+	gtk_text_buffer_get_iter_at_line_offset (buffer, &iter, 0, 13);
+	g_assert_cmpint (gedit_column_tracker_get_column (tracker, &iter, 4), ==, 20);
+
+	gedit_column_tracker_free (tracker);
+	g_object_unref (buffer);
+}
+
+static void
+test_cursor_perf ()
+{
+	GtkTextBuffer *buffer;
+	GeditColumnTracker *tracker;
+	GtkTextIter iter;
+	GString *text;
+	GTimer *timer;
+	gdouble slow;
+	gint length;
+	gint i;
+
+	/* 10 MB of minified code on a single line */
+	text = g_string_new (NULL);
+
+	while (text->len < 10 * 1024 * 1024)
+		g_string_append (text, "function(a,b){return\ta+b;}");
+
+	buffer = gtk_text_buffer_new (NULL);
+	gtk_text_buffer_set_text (buffer, text->str, text->len);
+	g_string_free (text, TRUE);
+
+	length = gtk_text_buffer_get_char_count (buffer);
+	tracker = gedit_column_tracker_new (buffer);
+
+	/* the first one indexes the line */
+	timer = g_timer_new ();
+	gtk_text_buffer_get_iter_at_offset (buffer, &iter, length / 2);
+	gedit_column_tracker_get_column (tracker, &iter, 8);
+	g_test_message ("index of the line: %f s", g_timer_elapsed (timer, NULL));
+
+	/* moves and typing at the end of the line */
+	g_timer_start (timer);
+
+	for (i = 0; i < 1000; i++)
+	{
+		gtk_text_buffer_get_iter_at_offset (buffer, &iter,
+						    g_random_int_range (0, length));
+
+		if (i % 10 == 0)
+		{
+			gtk_text_buffer_insert (buffer, &iter, "x", -1);
+			length++;
+		}
+
+		gedit_column_tracker_get_column (tracker, &iter, 8);
+	}
+
+	g_timer_stop (timer);
+
+	g_test_message ("cursor move: %f ms", g_timer_elapsed (timer, NULL));
+	g_test_minimized_result (g_timer_elapsed (timer, NULL) / 1000,
+				 "cursor move on a 10 MB line");
+
+	/* the walk of the statusbar, a few times is enough */
+	g_timer_start (timer);
+
+	for (i = 0; i < 5; i++)
+	{
+		gtk_text_buffer_get_iter_at_offset (buffer, &iter,
+						    g_random_int_range (0, length));
+
+		get_column_slow (&iter, 8);
+	}
+
+	slow = g_timer_elapsed (timer, NULL) / 5;
+	g_test_message ("cursor move without the tracker: %f ms", slow * 1000);
+
+	g_timer_destroy (timer);
+	gedit_column_tracker_free (tracker);
+	g_object_unref (buffer);
+}
+
+int main (int   argc,
+          char *argv[])
+{
+	g_type_init ();
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/column-tracker/edits", test_edits);
+	g_test_add_func ("/column-tracker/lines", test_lines);
+
+	if (g_test_perf ())
+		g_test_add_func ("/column-tracker/cursor-perf", test_cursor_perf);
+
+	return g_test_run ();
+}
@@ -0,0 +1,333 @@
+/*
+ * docinfo-stats.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "gedit-docinfo-stats.h"
+#include <gtk/gtk.h>
+#include <pango/pango-break.h>
+#include <string.h>
+
+static const gchar *pieces[] =
+{
+	"word", "Gedit", "42", "abc123", "3.14", "don't", "foo_bar",
+	" ", " ", " ", "\n", "\t", ", ", "\r\n",
+	"\xc3\xa9t\xc3\xa9",			/* été */
+	"e\xcc\x81",				/* e + combining acute */
+	"\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e",	/* 日本語 */
+	"\xc2\xa0"				/* no-break space */
+};
+
+static gchar *
+get_random_text (gint n_pieces,
+		 gboolean ascii)
+{
+	GString *text;
+	gint i;
+
+	text = g_string_new (NULL);
+
+	for (i = 0; i < n_pieces; i++)
+	{
+		gint n = ascii ? 14 : G_N_ELEMENTS (pieces);
+
+		g_string_append (text, pieces[g_random_int_range (0, n)]);
+	}
+
+	return g_string_free (text, FALSE);
+}
+
+/* What the plugin used to do: pango on the whole text */
+static void
+count_reference (GtkTextBuffer     *buffer,
+		 GeditDocInfoStats *stats)
+{
+	GtkTextIter start, end;
+	PangoLogAttr *attrs;
+	gchar *text;
+	gint i;
+
+	gtk_text_buffer_get_bounds (buffer, &start, &end);
+	text = gtk_text_buffer_get_slice (buffer, &start, &end, TRUE);
+
+	memset (stats, 0, sizeof (GeditDocInfoStats));
+
+	stats->chars = g_utf8_strlen (text, -1);
+	stats->bytes = strlen (text);
+
+	attrs = g_new0 (PangoLogAttr, stats->chars + 1);
+
+	pango_get_log_attrs (text,
+			     -1,
+			     0,
+			     pango_language_from_string ("C"),
+			     attrs,
+			     stats->chars + 1);
+
+	for (i = 0; i < stats->chars; i++)
+	{
+		if (attrs[i].is_white)
+			++stats->white_chars;
+
+		if (attrs[i].is_word_start)
+			++stats->words;
+	}
+
+	g_free (attrs);
+	g_free (text);
+}
+
+static void
+check_stats (const GeditDocInfoStats *stats,
+	     const GeditDocInfoStats *expected)
+{
+	g_assert_cmpint (stats->chars, ==, expected->chars);
+	g_assert_cmpint (stats->words, ==, expected->words);
+	g_assert_cmpint (stats->white_chars, ==, expected->white_chars);
+	g_assert_cmpint (stats->bytes, ==, expected->bytes);
+}
+
+static void
+test_count ()
+{
+	GtkTextBuffer *buffer;
+	gint i;
+
+	buffer = gtk_text_buffer_new (NULL);
+
+	/* the longer texts have more than one segment */
+	for (i = 0; i < 8; i++)
+	{
+		GeditDocInfoStats stats;
+		GeditDocInfoStats expected;
+		GtkTextIter start, end;
+		gchar *text;
+
+		text = get_random_text (i < 4 ? 100 : 50000, i % 2 == 0);
+		gtk_text_buffer_set_text (buffer, text, -1);
+		g_free (text);
+
+		gtk_text_buffer_get_bounds (buffer, &start, &end);
+		gedit_docinfo_stats_count (buffer, &start, &end, &stats);
+
+		count_reference (buffer, &expected);
+		check_stats (&stats, &expected);
+	}
+
+	g_object_unref (buffer);
+}
+
+/* Without white chars the segments are cut inside the words */
+static void
+test_count_no_white ()
+{
+	static const gint words[] = { 0, 1, 2, 3, 4, 5, 6, 14, 15, 16 };
+	GtkTextBuffer *buffer;
+	gint i;
+
+	buffer = gtk_text_buffer_new (NULL);
+
+	for (i = 0; i < 2; i++)
+	{
+		GeditDocInfoStats stats;
+		GeditDocInfoStats expected;
+		GtkTextIter start, end;
+		GString *text;
+		gint n = i == 0 ? 7 : G_N_ELEMENTS (words);
+
+		text = g_string_new (NULL);
+
+		while (text->len < 512 * 1024)
+			g_string_append (text, pieces[words[g_random_int_range (0, n)]]);
+
+		gtk_text_buffer_set_text (buffer, text->str, text->len);
+		g_string_free (text, TRUE);
+
+		gtk_text_buffer_get_bounds (buffer, &start, &end);
+		gedit_docinfo_stats_count (buffer, &start, &end, &stats);
+
+		count_reference (buffer, &expected);
+		check_stats (&stats, &expected);
+	}
+
+	g_object_unref (buffer);
+}
+
+static void
+test_counter ()
+{
+	GtkTextBuffer *buffer;
+	GeditDocInfoCounter *counter;
+	GeditDocInfoStats expected;
+	gchar *text;
+	gint i;
+
+	buffer = gtk_text_buffer_new (NULL);
+
+	text = get_random_text (1000, FALSE);
+	gtk_text_buffer_set_text (buffer, text, -1);
+	g_free (text);
+
+	counter = gedit_docinfo_counter_new (buffer);
+
+	for (i = 0; i < 1000; i++)
+	{
+		GtkTextIter start, end;
+		gint length;
+
+		length = gtk_text_buffer_get_char_count (buffer);
+		gtk_text_buffer_get_iter_at_offset (buffer, &start,
+						    g_random_int_range (0, length + 1));
+
+		if (g_random_boolean ())
+		{
+			text = get_random_text (g_random_int_range (1, 4), FALSE);
+			gtk_text_buffer_insert (buffer, &start, text, -1);
+			g_free (text);
+		}
+		else
+		{
+			end = start;
+			gtk_text_iter_forward_chars (&end, g_random_int_range (1, 10));
+			gtk_text_buffer_delete (buffer, &start, &end);
+		}
+
+		count_reference (buffer, &expected);
+		check_stats (gedit_docinfo_counter_get_stats (counter), &expected);
+	}
+
+	gedit_docinfo_counter_free (counter);
+	g_object_unref (buffer);
+}
+
+/* Without white chars the region counted again around an edit is cut
+ * inside the words */
+static void
+test_counter_no_white ()
+{
+	GtkTextBuffer *buffer;
+	GeditDocInfoCounter *counter;
+	GeditDocInfoStats expected;
+	GString *text;
+	gint i;
+
+	buffer = gtk_text_buffer_new (NULL);
+
+	text = g_string_new (NULL);
+
+	while (text->len < 512 * 1024)
+		g_string_append (text, pieces[g_random_int_range (0, 7)]);
+
+	gtk_text_buffer_set_text (buffer, text->str, text->len);
+	g_string_free (text, TRUE);
+
+	counter = gedit_docinfo_counter_new (buffer);
+
+	for (i = 0; i < 20; i++)
+	{
+		GtkTextIter start, end;
+		gint length;
+
+		length = gtk_text_buffer_get_char_count (buffer);
+		gtk_text_buffer_get_iter_at_offset (buffer, &start,
+						    g_random_int_range (0, length + 1));
+
+		if (g_random_boolean ())
+		{
+			gtk_text_buffer_insert (buffer, &start,
+						pieces[g_random_int_range (0, 7)], -1);
+		}
+		else
+		{
+			end = start;
+			gtk_text_iter_forward_chars (&end, g_random_int_range (1, 10));
+			gtk_text_buffer_delete (buffer, &start, &end);
+		}
+
+		count_reference (buffer, &expected);
+		check_stats (gedit_docinfo_counter_get_stats (counter), &expected);
+	}
+
+	gedit_docinfo_counter_free (counter);
+	g_object_unref (buffer);
+}
+
+static void
+do_count_benchmark (gint megabytes)
+{
+	GtkTextBuffer *buffer;
+	GtkTextIter start, end;
+	GeditDocInfoStats stats;
+	GString *text;
+	GTimer *timer;
+
+	text = g_string_new (NULL);
+
+	while (text->len < megabytes * 1024 * 1024)
+	{
+		g_string_append (text, "The quick brown fox jumps over the lazy dog, 42 times.\n");
+	}
+
+	buffer = gtk_text_buffer_new (NULL);
+	gtk_text_buffer_set_text (buffer, text->str, text->len);
+	g_string_free (text, TRUE);
+
+	gtk_text_buffer_get_bounds (buffer, &start, &end);
+
+	timer = g_timer_new ();
+	gedit_docinfo_stats_count (buffer, &start, &end, &stats);
+	g_timer_stop (timer);
+
+	g_test_message ("%d MB: %d words, %f s",
+			megabytes, stats.words, g_timer_elapsed (timer, NULL));
+
+	g_test_minimized_result (g_timer_elapsed (timer, NULL),
+				 "count of %d MB", megabytes);
+
+	g_timer_destroy (timer);
+	g_object_unref (buffer);
+}
+
+static void
+test_count_perf ()
+{
+	do_count_benchmark (1);
+	do_count_benchmark (10);
+
+	if (g_test_thorough ())
+		do_count_benchmark (100);
+}
+
+int main (int   argc,
+          char *argv[])
+{
+	g_type_init ();
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/docinfo-stats/count", test_count);
+	g_test_add_func ("/docinfo-stats/count-no-white", test_count_no_white);
+	g_test_add_func ("/docinfo-stats/counter", test_counter);
+	g_test_add_func ("/docinfo-stats/counter-no-white", test_counter_no_white);
+
+	if (g_test_perf ())
+		g_test_add_func ("/docinfo-stats/count-perf", test_count_perf);
+
+	return g_test_run ();
+}
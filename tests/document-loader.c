@@ -0,0 +1,311 @@
+/*
+ * document-loader.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "gedit-document.h"
+#include "gedit-prefs-manager.h"
+#include "gedit-debug.h"
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LOG_LINE "2009-11-21 17:21:42 host kernel: [  123.456789] some log line, value=%d\n"
+
+/* READ_CHUNK_SIZE and INSERT_BATCH_SIZE of the gio loader */
+#define READ_CHUNK_SIZE 65536
+#define INSERT_BATCH_SIZE (4 * 1024 * 1024)
+
+static gchar *
+create_test_file (gsize size)
+{
+	gchar *filename;
+	GString *chunk;
+	FILE *f;
+	gsize written = 0;
+	gint fd;
+	gint i = 0;
+
+	fd = g_file_open_tmp ("gedit-loader-XXXXXX", &filename, NULL);
+	g_assert (fd != -1);
+
+	f = fdopen (fd, "w");
+	g_assert (f != NULL);
+
+	chunk = g_string_new (NULL);
+
+	while (written < size)
+	{
+		g_string_printf (chunk, LOG_LINE, i++);
+		fwrite (chunk->str, 1, chunk->len, f);
+		written += chunk->len;
+	}
+
+	g_string_free (chunk, TRUE);
+	fclose (f);
+
+	return filename;
+}
+
+/* Text mixing chars of 1 to 4 bytes, with a 3 bytes char split across
+ * each chunk boundary, which are also the insert batch boundaries */
+static gchar *
+create_multibyte_contents (gsize size)
+{
+	static const gchar *pieces[] = { "a", "\xc3\xa9", "\xe2\x82\xac", "\xf0\x9d\x84\x9e", "\n" };
+	GString *contents;
+	gsize boundary = READ_CHUNK_SIZE;
+	guint i = 0;
+
+	contents = g_string_sized_new (size + 8);
+
+	while (contents->len < size)
+	{
+		if (contents->len + 4 >= boundary)
+		{
+			while (contents->len < boundary - 1)
+				g_string_append_c (contents, 'x');
+
+			g_string_append (contents, "\xe2\x82\xac");
+			boundary += READ_CHUNK_SIZE;
+		}
+		else
+		{
+			g_string_append (contents, pieces[i++ % G_N_ELEMENTS (pieces)]);
+		}
+	}
+
+	/* the loader drops a trailing newline */
+	g_string_append_c (contents, 'x');
+
+	return g_string_free (contents, FALSE);
+}
+
+/* Peak RSS of the process in KB, reset between runs through clear_refs */
+static glong
+get_peak_rss (void)
+{
+	gchar *contents;
+	gchar *line;
+	glong peak = -1;
+
+	if (!g_file_get_contents ("/proc/self/status", &contents, NULL, NULL))
+		return -1;
+
+	line = strstr (contents, "VmHWM:");
+	if (line != NULL)
+		peak = strtol (line + strlen ("VmHWM:"), NULL, 10);
+
+	g_free (contents);
+
+	return peak;
+}
+
+static void
+reset_peak_rss (void)
+{
+	g_file_set_contents ("/proc/self/clear_refs", "5", -1, NULL);
+}
+
+static void
+loaded_cb (GeditDocument *doc,
+	   const GError  *error,
+	   GMainLoop     *loop)
+{
+	g_assert_no_error (error);
+
+	g_main_loop_quit (loop);
+}
+
+static void
+do_load_benchmark (gsize size)
+{
+	GeditDocument *doc;
+	GMainLoop *loop;
+	gchar *filename;
+	gchar *uri;
+	GTimer *timer;
+	glong rss_before;
+
+	filename = create_test_file (size);
+	uri = g_filename_to_uri (filename, NULL, NULL);
+
+	reset_peak_rss ();
+	rss_before = get_peak_rss ();
+
+	doc = gedit_document_new ();
+	loop = g_main_loop_new (NULL, FALSE);
+
+	g_signal_connect (doc, "loaded", G_CALLBACK (loaded_cb), loop);
+
+	timer = g_timer_new ();
+
+	gedit_document_load (doc, uri, gedit_encoding_get_utf8 (), 0, FALSE);
+	g_main_loop_run (loop);
+
+	g_timer_stop (timer);
+
+	g_test_message ("%" G_GSIZE_FORMAT " MB: loaded in %f s, peak RSS %ld KB (+%ld KB)",
+			size / (1024 * 1024),
+			g_timer_elapsed (timer, NULL),
+			get_peak_rss (),
+			get_peak_rss () - rss_before);
+
+	g_test_minimized_result (g_timer_elapsed (timer, NULL),
+				 "load time for %" G_GSIZE_FORMAT " MB", size / (1024 * 1024));
+
+	g_timer_destroy (timer);
+	g_main_loop_unref (loop);
+	g_object_unref (doc);
+
+	g_unlink (filename);
+	g_free (filename);
+	g_free (uri);
+}
+
+static void
+test_load_small ()
+{
+	do_load_benchmark (1024 * 1024);
+}
+
+static void
+test_load_contents ()
+{
+	GeditDocument *doc;
+	GMainLoop *loop;
+	GtkTextIter start, end;
+	gchar *contents;
+	gchar *filename;
+	gchar *uri;
+	gchar *text;
+	gint fd;
+
+	contents = create_multibyte_contents (INSERT_BATCH_SIZE + 4 * READ_CHUNK_SIZE);
+	g_assert (g_utf8_validate (contents, -1, NULL));
+
+	fd = g_file_open_tmp ("gedit-loader-XXXXXX", &filename, NULL);
+	g_assert (fd != -1);
+	close (fd);
+
+	g_assert (g_file_set_contents (filename, contents, -1, NULL));
+	uri = g_filename_to_uri (filename, NULL, NULL);
+
+	doc = gedit_document_new ();
+	loop = g_main_loop_new (NULL, FALSE);
+
+	g_signal_connect (doc, "loaded", G_CALLBACK (loaded_cb), loop);
+
+	gedit_document_load (doc, uri, gedit_encoding_get_utf8 (), 0, FALSE);
+	g_main_loop_run (loop);
+
+	gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (doc), &start, &end);
+	text = gtk_text_buffer_get_slice (GTK_TEXT_BUFFER (doc), &start, &end, TRUE);
+
+	g_assert_cmpuint (strlen (text), ==, strlen (contents));
+	g_assert (strcmp (text, contents) == 0);
+
+	g_free (text);
+	g_main_loop_unref (loop);
+	g_object_unref (doc);
+
+	g_unlink (filename);
+	g_free (filename);
+	g_free (uri);
+	g_free (contents);
+}
+
+static void
+cancel_loading_cb (GeditDocument *doc,
+		   goffset        size,
+		   goffset        total_size,
+		   gpointer       data)
+{
+	g_assert (gedit_document_load_cancel (doc));
+}
+
+static void
+cancel_loaded_cb (GeditDocument *doc,
+		  const GError  *error,
+		  GMainLoop     *loop)
+{
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+
+	g_main_loop_quit (loop);
+}
+
+static void
+test_load_cancel ()
+{
+	GeditDocument *doc;
+	GMainLoop *loop;
+	gchar *filename;
+	gchar *uri;
+
+	filename = create_test_file (32 * 1024 * 1024);
+	uri = g_filename_to_uri (filename, NULL, NULL);
+
+	doc = gedit_document_new ();
+	loop = g_main_loop_new (NULL, FALSE);
+
+	g_signal_connect (doc, "loading", G_CALLBACK (cancel_loading_cb), NULL);
+	g_signal_connect (doc, "loaded", G_CALLBACK (cancel_loaded_cb), loop);
+
+	gedit_document_load (doc, uri, gedit_encoding_get_utf8 (), 0, FALSE);
+	g_main_loop_run (loop);
+
+	g_main_loop_unref (loop);
+	g_object_unref (doc);
+
+	g_unlink (filename);
+	g_free (filename);
+	g_free (uri);
+}
+
+static void
+test_load_perf ()
+{
+	do_load_benchmark (16 * 1024 * 1024);
+	do_load_benchmark (64 * 1024 * 1024);
+	do_load_benchmark (256 * 1024 * 1024);
+}
+
+int main (int   argc,
+          char *argv[])
+{
+	g_thread_init (NULL);
+	g_type_init ();
+	g_test_init (&argc, &argv, NULL);
+
+	gedit_debug_init ();
+	gedit_prefs_manager_init ();
+
+	g_test_add_func ("/document-loader/load-small", test_load_small);
+	g_test_add_func ("/document-loader/load-contents", test_load_contents);
+	g_test_add_func ("/document-loader/load-cancel", test_load_cancel);
+
+	if (g_test_perf ())
+		g_test_add_func ("/document-loader/load-perf", test_load_perf);
+
+	return g_test_run ();
+}
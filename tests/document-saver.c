@@ -0,0 +1,608 @@
+/*
+ * document-saver.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "gedit-document.h"
+#include "gedit-prefs-manager.h"
+#include "gedit-debug.h"
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEXT_LINE "Le c\xc5\x93ur d\xc3\xa9\xc3\xa7u mais l'\xc3\xa2me plut\xc3\xb4t na\xc3\xafve, line %d\n"
+
+static void
+fill_document (GeditDocument *doc,
+	       gsize          size)
+{
+	GtkTextBuffer *buffer = GTK_TEXT_BUFFER (doc);
+	GtkTextIter end;
+	GString *text;
+	gsize inserted = 0;
+	gint i = 0;
+
+	text = g_string_new (NULL);
+
+	gtk_source_buffer_begin_not_undoable_action (GTK_SOURCE_BUFFER (doc));
+
+	while (inserted < size)
+	{
+		g_string_truncate (text, 0);
+
+		/* insert in big blocks, this is not what we measure */
+		while (text->len < 1024 * 1024 && inserted + text->len < size)
+			g_string_append_printf (text, TEXT_LINE, i++);
+
+		if (text->len == 0)
+			break;
+
+		gtk_text_buffer_get_end_iter (buffer, &end);
+		gtk_text_buffer_insert (buffer, &end, text->str, text->len);
+
+		inserted += text->len;
+	}
+
+	gtk_source_buffer_end_not_undoable_action (GTK_SOURCE_BUFFER (doc));
+
+	g_string_free (text, TRUE);
+}
+
+/* Peak RSS of the process in KB, reset between runs through clear_refs */
+static glong
+get_peak_rss (void)
+{
+	gchar *contents;
+	gchar *line;
+	glong peak = -1;
+
+	if (!g_file_get_contents ("/proc/self/status", &contents, NULL, NULL))
+		return -1;
+
+	line = strstr (contents, "VmHWM:");
+	if (line != NULL)
+		peak = strtol (line + strlen ("VmHWM:"), NULL, 10);
+
+	g_free (contents);
+
+	return peak;
+}
+
+static void
+reset_peak_rss (void)
+{
+	g_file_set_contents ("/proc/self/clear_refs", "5", -1, NULL);
+}
+
+static void
+saved_cb (GeditDocument *doc,
+	  const GError  *error,
+	  GMainLoop     *loop)
+{
+	g_assert_no_error (error);
+
+	g_main_loop_quit (loop);
+}
+
+static gchar *
+save_document (GeditDocument       *doc,
+	       const GeditEncoding *encoding,
+	       gdouble             *elapsed)
+{
+	GMainLoop *loop;
+	GTimer *timer;
+	gchar *filename;
+	gchar *uri;
+	gint fd;
+
+	fd = g_file_open_tmp ("gedit-saver-XXXXXX", &filename, NULL);
+	g_assert (fd != -1);
+	close (fd);
+
+	uri = g_filename_to_uri (filename, NULL, NULL);
+	loop = g_main_loop_new (NULL, FALSE);
+
+	g_signal_connect (doc, "saved", G_CALLBACK (saved_cb), loop);
+
+	timer = g_timer_new ();
+
+	gedit_document_save_as (doc, uri, encoding,
+				GEDIT_DOCUMENT_SAVE_IGNORE_MTIME |
+				GEDIT_DOCUMENT_SAVE_IGNORE_BACKUP);
+	g_main_loop_run (loop);
+
+	g_timer_stop (timer);
+
+	if (elapsed != NULL)
+		*elapsed = g_timer_elapsed (timer, NULL);
+
+	g_signal_handlers_disconnect_by_func (doc, saved_cb, loop);
+
+	g_timer_destroy (timer);
+	g_main_loop_unref (loop);
+	g_free (uri);
+
+	return filename;
+}
+
+static void
+check_saved (const gchar *text,
+	     const gchar *charset)
+{
+	GeditDocument *doc;
+	gchar *filename;
+	gchar *contents;
+	gchar *expected;
+	gsize len, expected_len;
+
+	doc = gedit_document_new ();
+	gtk_text_buffer_set_text (GTK_TEXT_BUFFER (doc), text, -1);
+
+	filename = save_document (doc, gedit_encoding_get_from_charset (charset), NULL);
+
+	g_assert (g_file_get_contents (filename, &contents, &len, NULL));
+
+	/* a newline is always added at the end */
+	if (*text != '\0')
+	{
+		gchar *aux;
+
+		aux = g_strconcat (text, "\n", NULL);
+		expected = g_convert (aux, -1, charset, "UTF-8", NULL, &expected_len, NULL);
+		g_free (aux);
+	}
+	else
+	{
+		expected = g_strdup ("");
+		expected_len = 0;
+	}
+
+	g_assert_cmpint (len, ==, expected_len);
+	g_assert (memcmp (contents, expected, len) == 0);
+
+	g_unlink (filename);
+	g_free (filename);
+	g_free (contents);
+	g_free (expected);
+	g_object_unref (doc);
+}
+
+static void
+test_save_contents ()
+{
+	check_saved ("", "UTF-8");
+	check_saved ("hello world", "UTF-8");
+	check_saved ("caf\xc3\xa9\ncr\xc3\xa8me\n", "UTF-8");
+	check_saved ("caf\xc3\xa9\ncr\xc3\xa8me\n", "ISO-8859-15");
+}
+
+static void
+conversion_error_cb (GeditDocument *doc,
+		     const GError  *error,
+		     GMainLoop     *loop)
+{
+	g_assert_error (error, G_CONVERT_ERROR, G_CONVERT_ERROR_ILLEGAL_SEQUENCE);
+
+	g_main_loop_quit (loop);
+}
+
+/* A conversion error must leave the file untouched */
+static void
+test_save_conversion_error ()
+{
+	GeditDocument *doc;
+	GMainLoop *loop;
+	gchar *filename;
+	gchar *uri;
+	gchar *contents;
+	gint fd;
+
+	fd = g_file_open_tmp ("gedit-saver-XXXXXX", &filename, NULL);
+	g_assert (fd != -1);
+	close (fd);
+
+	g_assert (g_file_set_contents (filename, "old contents", -1, NULL));
+
+	doc = gedit_document_new ();
+	gtk_text_buffer_set_text (GTK_TEXT_BUFFER (doc),
+				  "not in latin-1: \xe6\x96\x87", -1);
+
+	uri = g_filename_to_uri (filename, NULL, NULL);
+	loop = g_main_loop_new (NULL, FALSE);
+
+	g_signal_connect (doc, "saved", G_CALLBACK (conversion_error_cb), loop);
+
+	gedit_document_save_as (doc, uri,
+				gedit_encoding_get_from_charset ("ISO-8859-15"),
+				GEDIT_DOCUMENT_SAVE_IGNORE_MTIME |
+				GEDIT_DOCUMENT_SAVE_IGNORE_BACKUP);
+	g_main_loop_run (loop);
+
+	g_assert (g_file_get_contents (filename, &contents, NULL, NULL));
+	g_assert_cmpstr (contents, ==, "old contents");
+
+	g_unlink (filename);
+	g_free (filename);
+	g_free (contents);
+	g_free (uri);
+	g_main_loop_unref (loop);
+	g_object_unref (doc);
+}
+
+/* Edits made after the save started are not saved and leave the
+ * document modified */
+static void
+test_save_edit_while_saving ()
+{
+	GeditDocument *doc;
+	GMainLoop *loop;
+	GtkTextIter end;
+	gchar *filename;
+	gchar *uri;
+	gchar *contents;
+	gint fd;
+
+	fd = g_file_open_tmp ("gedit-saver-XXXXXX", &filename, NULL);
+	g_assert (fd != -1);
+	close (fd);
+
+	doc = gedit_document_new ();
+	gtk_text_buffer_set_text (GTK_TEXT_BUFFER (doc), "saved text", -1);
+
+	uri = g_filename_to_uri (filename, NULL, NULL);
+	loop = g_main_loop_new (NULL, FALSE);
+
+	g_signal_connect (doc, "saved", G_CALLBACK (saved_cb), loop);
+
+	gedit_document_save_as (doc, uri, gedit_encoding_get_utf8 (),
+				GEDIT_DOCUMENT_SAVE_IGNORE_MTIME |
+				GEDIT_DOCUMENT_SAVE_IGNORE_BACKUP);
+
+	gtk_text_buffer_get_end_iter (GTK_TEXT_BUFFER (doc), &end);
+	gtk_text_buffer_insert (GTK_TEXT_BUFFER (doc), &end, " and more", -1);
+
+	g_main_loop_run (loop);
+
+	g_assert (g_file_get_contents (filename, &contents, NULL, NULL));
+	g_assert_cmpstr (contents, ==, "saved text\n");
+	g_assert (gtk_text_buffer_get_modified (GTK_TEXT_BUFFER (doc)));
+
+	g_unlink (filename);
+	g_free (filename);
+	g_free (contents);
+	g_free (uri);
+	g_main_loop_unref (loop);
+	g_object_unref (doc);
+}
+
+/* The text of a long document is copied a part at a time, edits around
+ * and across the parts must not change what is saved */
+static void
+test_save_edits_across_segments ()
+{
+	GeditDocument *doc;
+	GMainLoop *loop;
+	GtkTextIter start;
+	GtkTextIter end;
+	GString *text;
+	gchar *filename;
+	gchar *uri;
+	gchar *contents;
+	gint fd;
+	gint i;
+
+	fd = g_file_open_tmp ("gedit-saver-XXXXXX", &filename, NULL);
+	g_assert (fd != -1);
+	close (fd);
+
+	text = g_string_new (NULL);
+	for (i = 0; i < 300000; i++)
+		g_string_append_c (text, 'a' + i % 26);
+
+	doc = gedit_document_new ();
+	gtk_text_buffer_set_text (GTK_TEXT_BUFFER (doc), text->str, text->len);
+
+	uri = g_filename_to_uri (filename, NULL, NULL);
+	loop = g_main_loop_new (NULL, FALSE);
+
+	g_signal_connect (doc, "saved", G_CALLBACK (saved_cb), loop);
+
+	gedit_document_save_as (doc, uri, gedit_encoding_get_utf8 (),
+				GEDIT_DOCUMENT_SAVE_IGNORE_MTIME |
+				GEDIT_DOCUMENT_SAVE_IGNORE_BACKUP);
+
+	gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (doc), &start, 65530);
+	gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (doc), &end, 140000);
+	gtk_text_buffer_delete (GTK_TEXT_BUFFER (doc), &start, &end);
+
+	gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (doc), &start);
+	gtk_text_buffer_insert (GTK_TEXT_BUFFER (doc), &start, "new ", -1);
+
+	gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (doc), &start, 131072);
+	gtk_text_buffer_insert (GTK_TEXT_BUFFER (doc), &start, "\xe6\x96\x87", -1);
+
+	g_main_loop_run (loop);
+
+	g_string_append_c (text, '\n');
+
+	g_assert (g_file_get_contents (filename, &contents, NULL, NULL));
+	g_assert_cmpstr (contents, ==, text->str);
+
+	g_unlink (filename);
+	g_free (filename);
+	g_free (contents);
+	g_free (uri);
+	g_string_free (text, TRUE);
+	g_main_loop_unref (loop);
+	g_object_unref (doc);
+}
+
+static gchar *
+get_backup_filename (const gchar *filename)
+{
+	gchar *ext;
+	gchar *backup_filename;
+
+	ext = gedit_prefs_manager_get_backup_extension ();
+	backup_filename = g_strconcat (filename,
+				       (ext != NULL && *ext != '\0') ? ext : "~",
+				       NULL);
+	g_free (ext);
+
+	return backup_filename;
+}
+
+/* Saves @text over the existing @filename keeping a backup. A hard
+ * linked file is rewritten in place, which makes the saver copy the old
+ * contents to the backup instead of renaming the file. */
+static gdouble
+save_with_backup (const gchar *filename,
+		  const gchar *text,
+		  gboolean     hardlinked)
+{
+	GeditDocument *doc;
+	GMainLoop *loop;
+	GTimer *timer;
+	gchar *link_filename = NULL;
+	gchar *uri;
+	gdouble elapsed;
+
+	if (hardlinked)
+	{
+		link_filename = g_strconcat (filename, ".link", NULL);
+		g_assert (link (filename, link_filename) == 0);
+	}
+
+	doc = gedit_document_new ();
+	gtk_text_buffer_set_text (GTK_TEXT_BUFFER (doc), text, -1);
+
+	uri = g_filename_to_uri (filename, NULL, NULL);
+	loop = g_main_loop_new (NULL, FALSE);
+
+	g_signal_connect (doc, "saved", G_CALLBACK (saved_cb), loop);
+
+	timer = g_timer_new ();
+
+	gedit_document_save_as (doc, uri, gedit_encoding_get_utf8 (),
+				GEDIT_DOCUMENT_SAVE_IGNORE_MTIME);
+	g_main_loop_run (loop);
+
+	elapsed = g_timer_elapsed (timer, NULL);
+
+	if (hardlinked)
+	{
+		gchar *contents;
+		gchar *expected;
+
+		/* the other name must see the new contents */
+		g_assert (g_file_get_contents (link_filename, &contents, NULL, NULL));
+		expected = g_strconcat (text, "\n", NULL);
+		g_assert_cmpstr (contents, ==, expected);
+
+		g_unlink (link_filename);
+		g_free (link_filename);
+		g_free (contents);
+		g_free (expected);
+	}
+
+	g_timer_destroy (timer);
+	g_main_loop_unref (loop);
+	g_free (uri);
+	g_object_unref (doc);
+
+	return elapsed;
+}
+
+static void
+check_backup (gboolean hardlinked)
+{
+	gchar *filename;
+	gchar *backup_filename;
+	gchar *contents;
+	gint fd;
+
+	fd = g_file_open_tmp ("gedit-saver-XXXXXX", &filename, NULL);
+	g_assert (fd != -1);
+	close (fd);
+
+	backup_filename = get_backup_filename (filename);
+
+	/* an old backup must be replaced */
+	g_assert (g_file_set_contents (backup_filename, "old backup", -1, NULL));
+	g_assert (g_file_set_contents (filename, "old contents", -1, NULL));
+
+	save_with_backup (filename, "new contents", hardlinked);
+
+	g_assert (g_file_get_contents (filename, &contents, NULL, NULL));
+	g_assert_cmpstr (contents, ==, "new contents\n");
+	g_free (contents);
+
+	g_assert (g_file_get_contents (backup_filename, &contents, NULL, NULL));
+	g_assert_cmpstr (contents, ==, "old contents");
+	g_free (contents);
+
+	g_unlink (filename);
+	g_unlink (backup_filename);
+	g_free (filename);
+	g_free (backup_filename);
+}
+
+static void
+test_save_backup ()
+{
+	gboolean create_backup;
+
+	if (!gedit_prefs_manager_create_backup_copy_can_set ())
+		return;
+
+	create_backup = gedit_prefs_manager_get_create_backup_copy ();
+	gedit_prefs_manager_set_create_backup_copy (TRUE);
+
+	check_backup (FALSE);
+	check_backup (TRUE);
+
+	gedit_prefs_manager_set_create_backup_copy (create_backup);
+}
+
+static void
+do_save_benchmark (gsize        size,
+		   const gchar *charset)
+{
+	GeditDocument *doc;
+	gchar *filename;
+	gdouble elapsed;
+	glong rss_before;
+
+	doc = gedit_document_new ();
+	fill_document (doc, size);
+
+	reset_peak_rss ();
+	rss_before = get_peak_rss ();
+
+	filename = save_document (doc, gedit_encoding_get_from_charset (charset), &elapsed);
+
+	g_test_message ("%" G_GSIZE_FORMAT " MB in %s: saved in %f s, peak RSS %ld KB (+%ld KB)",
+			size / (1024 * 1024),
+			charset,
+			elapsed,
+			get_peak_rss (),
+			get_peak_rss () - rss_before);
+
+	g_test_minimized_result (get_peak_rss () - rss_before,
+				 "peak memory saving %" G_GSIZE_FORMAT " MB in %s",
+				 size / (1024 * 1024), charset);
+
+	g_unlink (filename);
+	g_free (filename);
+	g_object_unref (doc);
+}
+
+static void
+test_save_perf ()
+{
+	do_save_benchmark (64 * 1024 * 1024, "UTF-8");
+	do_save_benchmark (64 * 1024 * 1024, "ISO-8859-15");
+	do_save_benchmark (256 * 1024 * 1024, "UTF-8");
+}
+
+static void
+do_backup_benchmark (gsize    size,
+		     gboolean hardlinked)
+{
+	gchar *filename;
+	gchar *backup_filename;
+	gchar *contents;
+	gdouble elapsed;
+	gint fd;
+
+	fd = g_file_open_tmp ("gedit-saver-XXXXXX", &filename, NULL);
+	g_assert (fd != -1);
+	close (fd);
+
+	contents = g_malloc (size);
+	memset (contents, 'a', size);
+	g_assert (g_file_set_contents (filename, contents, size, NULL));
+	g_free (contents);
+
+	elapsed = save_with_backup (filename, "new contents", hardlinked);
+
+	g_test_message ("%" G_GSIZE_FORMAT " MB, %s: backup and save in %f s",
+			size / (1024 * 1024),
+			hardlinked ? "copied" : "linked",
+			elapsed);
+
+	g_test_minimized_result (elapsed,
+				 "backup of %" G_GSIZE_FORMAT " MB, %s",
+				 size / (1024 * 1024),
+				 hardlinked ? "copied" : "linked");
+
+	backup_filename = get_backup_filename (filename);
+	g_unlink (backup_filename);
+	g_unlink (filename);
+	g_free (backup_filename);
+	g_free (filename);
+}
+
+static void
+test_backup_perf ()
+{
+	gboolean create_backup;
+
+	if (!gedit_prefs_manager_create_backup_copy_can_set ())
+		return;
+
+	create_backup = gedit_prefs_manager_get_create_backup_copy ();
+	gedit_prefs_manager_set_create_backup_copy (TRUE);
+
+	do_backup_benchmark (64 * 1024 * 1024, FALSE);
+	do_backup_benchmark (64 * 1024 * 1024, TRUE);
+	do_backup_benchmark (256 * 1024 * 1024, FALSE);
+	do_backup_benchmark (256 * 1024 * 1024, TRUE);
+
+	gedit_prefs_manager_set_create_backup_copy (create_backup);
+}
+
+int main (int   argc,
+          char *argv[])
+{
+	g_thread_init (NULL);
+	g_type_init ();
+	g_test_init (&argc, &argv, NULL);
+
+	gedit_debug_init ();
+	gedit_prefs_manager_init ();
+
+	g_test_add_func ("/document-saver/save-contents", test_save_contents);
+	g_test_add_func ("/document-saver/save-conversion-error", test_save_conversion_error);
+	g_test_add_func ("/document-saver/save-edit-while-saving", test_save_edit_while_saving);
+	g_test_add_func ("/document-saver/save-edits-across-segments", test_save_edits_across_segments);
+	g_test_add_func ("/document-saver/save-backup", test_save_backup);
+
+	if (g_test_perf ())
+	{
+		g_test_add_func ("/document-saver/save-perf", test_save_perf);
+		g_test_add_func ("/document-saver/backup-perf", test_backup_perf);
+	}
+
+	return g_test_run ();
+}
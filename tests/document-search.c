@@ -0,0 +1,571 @@
+/*
+ * document-search.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "gedit-document.h"
+#include "gedit-prefs-manager.h"
+#include "gedit-debug.h"
+#include "gedit-text-search.h"
+#include <gtksourceview/gtksourceiter.h>
+#include <glib.h>
+#include <string.h>
+
+/* gtksourceview matches ascii chars inside decomposed chars when the
+ * search is not case sensitive, so that text has no accents */
+#define ASCII_LINE "The Quick brown FOX jumps over the lazy dog, line %d \xe6\x96\x87\xe5\xad\x97\n"
+/* U+212A KELVIN SIGN casefolds to "k" */
+#define KELVIN_LINE "Kept at 273 \xe2\x84\xaa, the kettle line %d\n"
+#define UTF8_LINE "Le c\xc5\x93ur d\xc3\xa9\xc3\xa7u mais l'\xc3\xa2me plut\xc3\xb4t na\xc3\xafve, line %d\n"
+
+static void
+fill_document (GeditDocument *doc,
+	       const gchar   *line,
+	       gsize          size)
+{
+	GtkTextBuffer *buffer = GTK_TEXT_BUFFER (doc);
+	GtkTextIter end;
+	GString *text;
+	gsize inserted = 0;
+	gint i = 0;
+
+	text = g_string_new (NULL);
+
+	gtk_source_buffer_begin_not_undoable_action (GTK_SOURCE_BUFFER (doc));
+
+	while (inserted < size)
+	{
+		g_string_truncate (text, 0);
+
+		/* insert in big blocks, this is not what we measure */
+		while (text->len < 1024 * 1024 && inserted + text->len < size)
+			g_string_append_printf (text, line, i++);
+
+		if (text->len == 0)
+			break;
+
+		gtk_text_buffer_get_end_iter (buffer, &end);
+		gtk_text_buffer_insert (buffer, &end, text->str, text->len);
+
+		inserted += text->len;
+	}
+
+	gtk_source_buffer_end_not_undoable_action (GTK_SOURCE_BUFFER (doc));
+
+	g_string_free (text, TRUE);
+}
+
+/* Offsets of all the matches, with the current gtksourceview search */
+static GArray *
+find_all_source (GeditDocument *doc,
+		 const gchar   *text,
+		 gboolean       case_sensitive,
+		 gboolean       backward)
+{
+	GtkSourceSearchFlags flags;
+	GArray *offsets;
+	GtkTextIter iter;
+	GtkTextIter m_start;
+	GtkTextIter m_end;
+
+	flags = GTK_SOURCE_SEARCH_VISIBLE_ONLY | GTK_SOURCE_SEARCH_TEXT_ONLY;
+
+	if (!case_sensitive)
+		flags |= GTK_SOURCE_SEARCH_CASE_INSENSITIVE;
+
+	offsets = g_array_new (FALSE, FALSE, sizeof (gint));
+
+	if (backward)
+		gtk_text_buffer_get_end_iter (GTK_TEXT_BUFFER (doc), &iter);
+	else
+		gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (doc), &iter);
+
+	while (backward ?
+	       gtk_source_iter_backward_search (&iter, text, flags, &m_start, &m_end, NULL) :
+	       gtk_source_iter_forward_search (&iter, text, flags, &m_start, &m_end, NULL))
+	{
+		gint offset = gtk_text_iter_get_offset (&m_start);
+
+		g_array_append_val (offsets, offset);
+
+		iter = backward ? m_start : m_end;
+	}
+
+	return offsets;
+}
+
+static GArray *
+find_all (GeditDocument *doc,
+	  const gchar   *text,
+	  gboolean       case_sensitive,
+	  gboolean       backward)
+{
+	GArray *offsets;
+	GtkTextIter iter;
+	GtkTextIter m_start;
+	GtkTextIter m_end;
+
+	gedit_document_set_search_text (doc,
+					text,
+					case_sensitive ? GEDIT_SEARCH_CASE_SENSITIVE : 0);
+
+	offsets = g_array_new (FALSE, FALSE, sizeof (gint));
+
+	if (backward)
+		gtk_text_buffer_get_end_iter (GTK_TEXT_BUFFER (doc), &iter);
+	else
+		gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (doc), &iter);
+
+	while (backward ?
+	       gedit_document_search_backward (doc, NULL, &iter, &m_start, &m_end) :
+	       gedit_document_search_forward (doc, &iter, NULL, &m_start, &m_end))
+	{
+		gint offset = gtk_text_iter_get_offset (&m_start);
+
+		g_array_append_val (offsets, offset);
+
+		iter = backward ? m_start : m_end;
+	}
+
+	return offsets;
+}
+
+static void
+check_search (GeditDocument *doc,
+	      const gchar   *text,
+	      gboolean       case_sensitive)
+{
+	gboolean backward;
+
+	for (backward = FALSE; backward <= TRUE; backward++)
+	{
+		GArray *expected;
+		GArray *offsets;
+
+		expected = find_all_source (doc, text, case_sensitive, backward);
+		offsets = find_all (doc, text, case_sensitive, backward);
+
+		g_assert_cmpint (offsets->len, ==, expected->len);
+		g_assert (memcmp (offsets->data,
+				  expected->data,
+				  offsets->len * sizeof (gint)) == 0);
+
+		g_array_free (expected, TRUE);
+		g_array_free (offsets, TRUE);
+	}
+}
+
+static void
+test_search_ascii ()
+{
+	GeditDocument *doc;
+
+	doc = gedit_document_new ();
+	fill_document (doc, ASCII_LINE, 300 * 1024);
+
+	check_search (doc, "o", TRUE);
+	check_search (doc, "o", FALSE);
+	check_search (doc, "fox", TRUE);
+	check_search (doc, "fox", FALSE);
+	check_search (doc, "the lazy", FALSE);
+	check_search (doc, "line 99", TRUE);
+	check_search (doc, "\xe5\xad\x97\nThe", TRUE);
+	check_search (doc, "dog, LINE 1234 ", FALSE);
+	check_search (doc, "not there", FALSE);
+
+	g_object_unref (doc);
+}
+
+static void
+test_search_utf8 ()
+{
+	GeditDocument *doc;
+
+	doc = gedit_document_new ();
+	fill_document (doc, UTF8_LINE, 300 * 1024);
+
+	check_search (doc, "\xc3\xa9", TRUE);
+	check_search (doc, "\xc3\xa9\xc3\xa7u mais", TRUE);
+	check_search (doc, "na\xc3\xafve, line 7", TRUE);
+	check_search (doc, "line", TRUE);
+	check_search (doc, "\nLe", TRUE);
+
+	/* these are not searched as bytes */
+	check_search (doc, "C\xc5\x92UR", FALSE);
+	check_search (doc, "\xc3\x82me", FALSE);
+
+	g_object_unref (doc);
+}
+
+static void
+test_search_folding ()
+{
+	GeditDocument *doc;
+	GeditTextSearch *search;
+	GtkTextIter iter;
+	GtkTextIter m_start, m_end;
+
+	doc = gedit_document_new ();
+	fill_document (doc, KELVIN_LINE, 300 * 1024);
+
+	/* the ascii needle also matches the kelvin sign */
+	check_search (doc, "k", FALSE);
+	check_search (doc, "K", FALSE);
+	check_search (doc, "k,", FALSE);
+	check_search (doc, "k", TRUE);
+
+	search = gedit_text_search_new (GTK_TEXT_BUFFER (doc), "k,", FALSE);
+
+	gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (doc), &iter);
+	g_assert (gedit_text_search_forward (search, &iter, NULL, &m_start, &m_end));
+	g_assert_cmpint (gtk_text_iter_get_offset (&m_start), ==, 12);
+
+	gedit_text_search_free (search);
+	g_object_unref (doc);
+}
+
+static void
+test_search_limits ()
+{
+	GeditDocument *doc;
+	GeditTextSearch *search;
+	GtkTextIter iter, limit;
+	GtkTextIter m_start, m_end;
+
+	doc = gedit_document_new ();
+	gtk_text_buffer_set_text (GTK_TEXT_BUFFER (doc), "abc abc abc", -1);
+
+	search = gedit_text_search_new (GTK_TEXT_BUFFER (doc), "abc", TRUE);
+
+	/* a match must end before the limit */
+	gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (doc), &iter, 1);
+	gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (doc), &limit, 6);
+	g_assert (!gedit_text_search_forward (search, &iter, &limit, &m_start, &m_end));
+
+	gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (doc), &limit, 7);
+	g_assert (gedit_text_search_forward (search, &iter, &limit, &m_start, &m_end));
+	g_assert_cmpint (gtk_text_iter_get_offset (&m_start), ==, 4);
+	g_assert_cmpint (gtk_text_iter_get_offset (&m_end), ==, 7);
+
+	/* and start after the limit when searching backward */
+	gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (doc), &iter, 10);
+	gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (doc), &limit, 5);
+	g_assert (!gedit_text_search_backward (search, &iter, &limit, &m_start, &m_end));
+
+	gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (doc), &limit, 4);
+	g_assert (gedit_text_search_backward (search, &iter, &limit, &m_start, &m_end));
+	g_assert_cmpint (gtk_text_iter_get_offset (&m_start), ==, 4);
+
+	/* the text changed, the old segment must not be used */
+	gtk_text_buffer_set_text (GTK_TEXT_BUFFER (doc), "xyz abc", -1);
+	gedit_text_search_invalidate (search);
+
+	gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (doc), &iter);
+	g_assert (gedit_text_search_forward (search, &iter, NULL, &m_start, &m_end));
+	g_assert_cmpint (gtk_text_iter_get_offset (&m_start), ==, 4);
+
+	gedit_text_search_free (search);
+	g_object_unref (doc);
+}
+
+/* Matches in hidden text are not found, even if the text is hidden
+ * after a first search */
+static void
+test_search_invisible ()
+{
+	GeditDocument *doc;
+	GtkTextTag *tag;
+	GtkTextIter start;
+	GtkTextIter end;
+
+	doc = gedit_document_new ();
+	fill_document (doc, ASCII_LINE, 64 * 1024);
+
+	check_search (doc, "fox", FALSE);
+
+	tag = gtk_text_buffer_create_tag (GTK_TEXT_BUFFER (doc), NULL, NULL);
+
+	gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (doc), &start, 1000);
+	gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (doc), &end, 5000);
+	gtk_text_buffer_apply_tag (GTK_TEXT_BUFFER (doc), tag, &start, &end);
+
+	g_object_set (tag, "invisible", TRUE, NULL);
+
+	check_search (doc, "fox", FALSE);
+
+	g_object_unref (doc);
+}
+
+static gchar *
+get_text (GeditDocument *doc)
+{
+	GtkTextIter start, end;
+
+	gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (doc), &start, &end);
+
+	return gtk_text_buffer_get_slice (GTK_TEXT_BUFFER (doc), &start, &end, TRUE);
+}
+
+static void
+check_replace_all (const gchar *text,
+		   const gchar *find,
+		   const gchar *replace,
+		   guint        flags,
+		   gint         expected_count,
+		   const gchar *expected)
+{
+	GeditDocument *doc;
+	gchar *result;
+
+	doc = gedit_document_new ();
+	gtk_text_buffer_set_text (GTK_TEXT_BUFFER (doc), text, -1);
+
+	g_assert_cmpint (gedit_document_replace_all (doc, find, replace, flags), ==, expected_count);
+
+	result = get_text (doc);
+	g_assert_cmpstr (result, ==, expected);
+	g_free (result);
+
+	/* the whole replace is undone at once */
+	if (expected_count > 0)
+	{
+		g_assert (gtk_source_buffer_can_undo (GTK_SOURCE_BUFFER (doc)));
+		gtk_source_buffer_undo (GTK_SOURCE_BUFFER (doc));
+
+		result = get_text (doc);
+		g_assert_cmpstr (result, ==, text);
+		g_free (result);
+	}
+
+	g_object_unref (doc);
+}
+
+static void
+test_replace_all ()
+{
+	GString *text;
+	GString *expected;
+	gint i;
+
+	check_replace_all ("", "foo", "bar", 0, 0, "");
+	check_replace_all ("foo", "foo", "", 0, 1, "");
+	check_replace_all ("Foo foo FOO", "foo", "bar", 0, 3, "bar bar bar");
+	check_replace_all ("Foo foo FOO", "foo", "bar", GEDIT_SEARCH_CASE_SENSITIVE, 1, "Foo bar FOO");
+	check_replace_all ("foo foobar foo", "foo", "x", GEDIT_SEARCH_ENTIRE_WORD, 2, "x foobar x");
+	check_replace_all ("aaaa", "aa", "a", 0, 2, "aa");
+	check_replace_all ("caf\xc3\xa9 caf\xc3\xa9", "\xc3\xa9", "e\xcc\x81", 0, 2,
+			   "cafe\xcc\x81 cafe\xcc\x81");
+
+	/* matches close and far apart */
+	text = g_string_new (NULL);
+	expected = g_string_new (NULL);
+
+	for (i = 0; i < 20; i++)
+	{
+		g_string_append (text, "needle");
+		g_string_append (expected, "pin");
+
+		g_string_append_printf (text, "%*d\n", i * 100, i);
+		g_string_append_printf (expected, "%*d\n", i * 100, i);
+	}
+
+	check_replace_all (text->str, "needle", "pin", 0, 20, expected->str);
+
+	g_string_free (text, TRUE);
+	g_string_free (expected, TRUE);
+}
+
+static void
+test_replace_all_marks ()
+{
+	GeditDocument *doc;
+	GtkTextBuffer *buffer;
+	GtkTextMark *mark;
+	GtkTextTag *tag;
+	GtkTextIter start;
+	GtkTextIter iter;
+	gchar *result;
+
+	doc = gedit_document_new ();
+	buffer = GTK_TEXT_BUFFER (doc);
+	gtk_text_buffer_set_text (buffer, "foo between foo", -1);
+
+	/* the mark is on "between", the text between the matches */
+	gtk_text_buffer_get_iter_at_offset (buffer, &iter, 6);
+	mark = gtk_text_buffer_create_mark (buffer, "between", &iter, TRUE);
+
+	g_assert_cmpint (gedit_document_replace_all (doc, "foo", "x", 0), ==, 2);
+
+	result = get_text (doc);
+	g_assert_cmpstr (result, ==, "x between x");
+	g_free (result);
+
+	g_assert (gtk_text_buffer_get_mark (buffer, "between") == mark);
+	g_assert (!gtk_text_mark_get_deleted (mark));
+
+	gtk_text_buffer_get_iter_at_mark (buffer, &iter, mark);
+	g_assert_cmpint (gtk_text_iter_get_offset (&iter), ==, 4);
+
+	g_object_unref (doc);
+
+	/* and so are the tags */
+	doc = gedit_document_new ();
+	buffer = GTK_TEXT_BUFFER (doc);
+	gtk_text_buffer_set_text (buffer, "foo between foo", -1);
+
+	tag = gtk_text_buffer_create_tag (buffer, "between", NULL);
+	gtk_text_buffer_get_iter_at_offset (buffer, &start, 4);
+	gtk_text_buffer_get_iter_at_offset (buffer, &iter, 11);
+	gtk_text_buffer_apply_tag (buffer, tag, &start, &iter);
+
+	g_assert_cmpint (gedit_document_replace_all (doc, "foo", "x", 0), ==, 2);
+
+	gtk_text_buffer_get_iter_at_offset (buffer, &iter, 2);
+	g_assert (gtk_text_iter_begins_tag (&iter, tag));
+	gtk_text_buffer_get_iter_at_offset (buffer, &iter, 9);
+	g_assert (gtk_text_iter_ends_tag (&iter, tag));
+
+	g_object_unref (doc);
+}
+
+static void
+do_search_benchmark (gsize        size,
+		     const gchar *line,
+		     const gchar *text,
+		     gboolean     case_sensitive)
+{
+	GeditDocument *doc;
+	GArray *expected;
+	GArray *offsets;
+	GTimer *timer;
+	gdouble source_time;
+
+	doc = gedit_document_new ();
+	fill_document (doc, line, size);
+
+	timer = g_timer_new ();
+	expected = find_all_source (doc, text, case_sensitive, FALSE);
+	source_time = g_timer_elapsed (timer, NULL);
+
+	g_timer_start (timer);
+	offsets = find_all (doc, text, case_sensitive, FALSE);
+	g_timer_stop (timer);
+
+	g_assert_cmpint (offsets->len, ==, expected->len);
+
+	g_test_message ("%" G_GSIZE_FORMAT " MB, \"%s\"%s: %u hits, "
+			"%f s (gtksourceview: %f s)",
+			size / (1024 * 1024),
+			text,
+			case_sensitive ? "" : " (case insensitive)",
+			offsets->len,
+			g_timer_elapsed (timer, NULL),
+			source_time);
+
+	g_test_minimized_result (g_timer_elapsed (timer, NULL),
+				 "search \"%s\" in %" G_GSIZE_FORMAT " MB",
+				 text, size / (1024 * 1024));
+
+	g_array_free (expected, TRUE);
+	g_array_free (offsets, TRUE);
+	g_timer_destroy (timer);
+	g_object_unref (doc);
+}
+
+static void
+test_search_perf ()
+{
+	do_search_benchmark (16 * 1024 * 1024, ASCII_LINE, "line 12345 ", TRUE);
+	do_search_benchmark (16 * 1024 * 1024, ASCII_LINE, "lazy", FALSE);
+	do_search_benchmark (16 * 1024 * 1024, UTF8_LINE, "mais", TRUE);
+	do_search_benchmark (100 * 1024 * 1024, ASCII_LINE, "fox", FALSE);
+}
+
+static void
+do_replace_benchmark (gint n)
+{
+	GeditDocument *doc;
+	GString *text;
+	GTimer *timer;
+	gint count;
+	gint i;
+
+	doc = gedit_document_new ();
+
+	text = g_string_new (NULL);
+
+	for (i = 0; i < n; i++)
+		g_string_append_printf (text, ASCII_LINE, i);
+
+	gtk_source_buffer_begin_not_undoable_action (GTK_SOURCE_BUFFER (doc));
+	gtk_text_buffer_set_text (GTK_TEXT_BUFFER (doc), text->str, text->len);
+	gtk_source_buffer_end_not_undoable_action (GTK_SOURCE_BUFFER (doc));
+
+	g_string_free (text, TRUE);
+
+	timer = g_timer_new ();
+	count = gedit_document_replace_all (doc, "fox", "cat", 0);
+	g_timer_stop (timer);
+
+	g_assert_cmpint (count, ==, n);
+
+	g_test_message ("%d replacements: %f s",
+			n, g_timer_elapsed (timer, NULL));
+
+	g_test_minimized_result (g_timer_elapsed (timer, NULL),
+				 "%d replacements", n);
+
+	g_timer_destroy (timer);
+	g_object_unref (doc);
+}
+
+static void
+test_replace_perf ()
+{
+	do_replace_benchmark (10000);
+	do_replace_benchmark (100000);
+	do_replace_benchmark (1000000);
+}
+
+int main (int   argc,
+          char *argv[])
+{
+	g_type_init ();
+	g_test_init (&argc, &argv, NULL);
+
+	gedit_debug_init ();
+	gedit_prefs_manager_init ();
+
+	g_test_add_func ("/document-search/search-ascii", test_search_ascii);
+	g_test_add_func ("/document-search/search-utf8", test_search_utf8);
+	g_test_add_func ("/document-search/search-folding", test_search_folding);
+	g_test_add_func ("/document-search/search-limits", test_search_limits);
+	g_test_add_func ("/document-search/search-invisible", test_search_invisible);
+	g_test_add_func ("/document-search/replace-all", test_replace_all);
+	g_test_add_func ("/document-search/replace-all-marks", test_replace_all_marks);
+
+	if (g_test_perf ())
+	{
+		g_test_add_func ("/document-search/search-perf", test_search_perf);
+		g_test_add_func ("/document-search/replace-perf", test_replace_perf);
+	}
+
+	return g_test_run ();
+}
@@ -0,0 +1,723 @@
+/*
+ * file-browser-store.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "gedit-file-browser-store.h"
+#include "gedit-file-browser-enum-types.h"
+#include "gedit-file-browser-type-cache.h"
+#include <gtk/gtk.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* The store is registered by the plugin module, use a module that
+ * never gets unloaded */
+typedef GTypeModule      TestModule;
+typedef GTypeModuleClass TestModuleClass;
+
+G_DEFINE_TYPE (TestModule, test_module, G_TYPE_TYPE_MODULE)
+
+static gboolean
+test_module_load (GTypeModule *module)
+{
+	return TRUE;
+}
+
+static void
+test_module_unload (GTypeModule *module)
+{
+}
+
+static void
+test_module_class_init (TestModuleClass *klass)
+{
+	klass->load = test_module_load;
+	klass->unload = test_module_unload;
+}
+
+static void
+test_module_init (TestModule *module)
+{
+}
+
+static void
+register_types ()
+{
+	GTypeModule *module;
+
+	module = g_object_new (test_module_get_type (), NULL);
+	g_type_module_use (module);
+
+	gedit_file_browser_enum_and_flag_register_type (module);
+	gedit_file_browser_store_register_type (module);
+}
+
+static gchar *
+create_directory (gint     n_files,
+		  gint     n_dirs)
+{
+	gchar *dir;
+	gint i;
+
+	dir = g_build_filename (g_get_tmp_dir (), "gedit-file-browser-store-XXXXXX", NULL);
+	g_assert (mkdtemp (dir) != NULL);
+
+	/* created in reverse order, the store has to sort them */
+	for (i = n_files - 1; i >= 0; i--)
+	{
+		gchar *name;
+		gchar *path;
+
+		name = g_strdup_printf ("file%07d.txt", i);
+		path = g_build_filename (dir, name, NULL);
+
+		g_assert (g_file_set_contents (path, "", 0, NULL));
+
+		g_free (path);
+		g_free (name);
+	}
+
+	for (i = n_dirs - 1; i >= 0; i--)
+	{
+		gchar *name;
+		gchar *path;
+
+		name = g_strdup_printf ("zdir%07d", i);
+		path = g_build_filename (dir, name, NULL);
+
+		g_assert (g_mkdir (path, 0700) == 0);
+
+		g_free (path);
+		g_free (name);
+	}
+
+	return dir;
+}
+
+static void
+remove_directory (const gchar *path)
+{
+	GDir *dir;
+	const gchar *name;
+
+	dir = g_dir_open (path, 0, NULL);
+	g_assert (dir != NULL);
+
+	while ((name = g_dir_read_name (dir)) != NULL)
+	{
+		gchar *child;
+
+		child = g_build_filename (path, name, NULL);
+
+		if (g_file_test (child, G_FILE_TEST_IS_DIR))
+			remove_directory (child);
+		else
+			g_unlink (child);
+
+		g_free (child);
+	}
+
+	g_dir_close (dir);
+	g_rmdir (path);
+}
+
+static void
+on_end_loading (GeditFileBrowserStore *store,
+		GtkTreeIter           *iter,
+		GMainLoop             *loop)
+{
+	GtkTreeIter root;
+
+	if (gedit_file_browser_store_get_iter_virtual_root (store, &root) &&
+	    root.user_data == iter->user_data)
+	{
+		g_main_loop_quit (loop);
+	}
+}
+
+static GeditFileBrowserStore *
+load_directory (const gchar *path)
+{
+	GeditFileBrowserStore *store;
+	GMainLoop *loop;
+	gchar *uri;
+
+	uri = g_filename_to_uri (path, NULL, NULL);
+	loop = g_main_loop_new (NULL, FALSE);
+
+	store = gedit_file_browser_store_new (NULL);
+
+	g_signal_connect (store,
+			  "end-loading",
+			  G_CALLBACK (on_end_loading),
+			  loop);
+
+	gedit_file_browser_store_set_root (store, uri);
+	g_main_loop_run (loop);
+
+	g_main_loop_unref (loop);
+	g_free (uri);
+
+	return store;
+}
+
+static void
+test_children ()
+{
+	GeditFileBrowserStore *store;
+	GtkTreeModel *model;
+	GtkTreeIter iter;
+	gchar *dir;
+	gchar *prev = NULL;
+	gboolean prev_dir = TRUE;
+	gint n = 0;
+
+	dir = create_directory (50, 10);
+	store = load_directory (dir);
+	model = GTK_TREE_MODEL (store);
+
+	g_assert_cmpint (gtk_tree_model_iter_n_children (model, NULL), ==, 60);
+
+	g_assert (gtk_tree_model_get_iter_first (model, &iter));
+
+	do
+	{
+		GtkTreeIter nth;
+		GtkTreePath *path;
+		gchar *name;
+		guint flags;
+
+		gtk_tree_model_get (model, &iter,
+				    GEDIT_FILE_BROWSER_STORE_COLUMN_NAME, &name,
+				    GEDIT_FILE_BROWSER_STORE_COLUMN_FLAGS, &flags,
+				    -1);
+
+		/* directories first, then sorted by name */
+		if (FILE_IS_DIR (flags))
+			g_assert (prev_dir);
+
+		if (prev != NULL && prev_dir == (FILE_IS_DIR (flags) != 0))
+			g_assert_cmpstr (prev, <, name);
+
+		prev_dir = (FILE_IS_DIR (flags) != 0);
+
+		path = gtk_tree_model_get_path (model, &iter);
+		g_assert_cmpint (gtk_tree_path_get_indices (path)[0], ==, n);
+
+		g_assert (gtk_tree_model_iter_nth_child (model, &nth, NULL, n));
+		g_assert (nth.user_data == iter.user_data);
+
+		gtk_tree_path_free (path);
+		g_free (prev);
+		prev = name;
+		n++;
+	} while (gtk_tree_model_iter_next (model, &iter));
+
+	g_assert_cmpint (n, ==, 60);
+	g_assert (!gtk_tree_model_iter_nth_child (model, &iter, NULL, 60));
+
+	g_free (prev);
+	g_object_unref (store);
+	remove_directory (dir);
+	g_free (dir);
+}
+
+/* The rows of @parent are the same whichever call walks them */
+static gint
+check_rows (GtkTreeModel *model,
+	    GtkTreeIter  *parent)
+{
+	GtkTreeIter iter;
+	gint n_children;
+	gint n = 0;
+
+	n_children = gtk_tree_model_iter_n_children (model, parent);
+
+	if (parent != NULL)
+		g_assert (gtk_tree_model_iter_has_child (model, parent) == (n_children > 0));
+
+	if (gtk_tree_model_iter_children (model, &iter, parent))
+	{
+		do
+		{
+			GtkTreeIter nth;
+
+			g_assert (gtk_tree_model_iter_nth_child (model, &nth, parent, n));
+			g_assert (nth.user_data == iter.user_data);
+			n++;
+		} while (gtk_tree_model_iter_next (model, &iter));
+	}
+
+	g_assert_cmpint (n, ==, n_children);
+
+	return n_children;
+}
+
+static void
+test_filter ()
+{
+	GeditFileBrowserStore *store;
+	GtkTreeModel *model;
+	GtkTreeIter iter;
+	guint flags;
+	gchar *dir;
+	gint i;
+
+	dir = create_directory (0, 0);
+
+	for (i = 0; i < 3; i++)
+	{
+		gchar *name;
+		gchar *path;
+
+		name = g_strdup_printf (".hidden%d.txt", i);
+		path = g_build_filename (dir, name, NULL);
+
+		g_assert (g_file_set_contents (path, "", 0, NULL));
+
+		g_free (path);
+		g_free (name);
+	}
+
+	store = load_directory (dir);
+	model = GTK_TREE_MODEL (store);
+
+	/* only the dummy is left when all the files are filtered */
+	for (i = 0; i < 2; i++)
+	{
+		gedit_file_browser_store_set_filter_mode (store,
+							  GEDIT_FILE_BROWSER_STORE_FILTER_MODE_HIDE_HIDDEN);
+
+		g_assert_cmpint (check_rows (model, NULL), ==, 1);
+		g_assert (gtk_tree_model_get_iter_first (model, &iter));
+		gtk_tree_model_get (model, &iter,
+				    GEDIT_FILE_BROWSER_STORE_COLUMN_FLAGS, &flags,
+				    -1);
+		g_assert (FILE_IS_DUMMY (flags));
+
+		gedit_file_browser_store_set_filter_mode (store,
+							  GEDIT_FILE_BROWSER_STORE_FILTER_MODE_NONE);
+
+		g_assert_cmpint (check_rows (model, NULL), ==, 3);
+		g_assert (gtk_tree_model_get_iter_first (model, &iter));
+		gtk_tree_model_get (model, &iter,
+				    GEDIT_FILE_BROWSER_STORE_COLUMN_FLAGS, &flags,
+				    -1);
+		g_assert (!FILE_IS_DUMMY (flags));
+	}
+
+	g_object_unref (store);
+	remove_directory (dir);
+	g_free (dir);
+}
+
+static guint
+get_row_flags (GtkTreeModel *model,
+	       const gchar  *name)
+{
+	GtkTreeIter iter;
+
+	if (!gtk_tree_model_get_iter_first (model, &iter))
+		return 0;
+
+	do
+	{
+		gchar *row_name;
+		guint flags;
+
+		gtk_tree_model_get (model, &iter,
+				    GEDIT_FILE_BROWSER_STORE_COLUMN_NAME, &row_name,
+				    GEDIT_FILE_BROWSER_STORE_COLUMN_FLAGS, &flags,
+				    -1);
+
+		if (strcmp (row_name, name) == 0)
+		{
+			g_free (row_name);
+			return flags;
+		}
+
+		g_free (row_name);
+	} while (gtk_tree_model_iter_next (model, &iter));
+
+	g_assert_not_reached ();
+
+	return 0;
+}
+
+static void
+test_type_cache ()
+{
+	GeditFileBrowserStore *store;
+	GtkTreeIter root;
+	GtkTreeIter iter;
+	gchar *dir;
+	gchar *path;
+	guint hits, misses;
+	gint i;
+
+	dir = create_directory (0, 0);
+
+	/* no extension, only sniffing tells them apart */
+	path = g_build_filename (dir, "text", NULL);
+	g_assert (g_file_set_contents (path, "some text\n", -1, NULL));
+	g_free (path);
+
+	path = g_build_filename (dir, "binary", NULL);
+	g_assert (g_file_set_contents (path, "\x7f" "ELF\x02\x01\x01\0\0\0\0\0", 16, NULL));
+	g_free (path);
+
+	/* the second time the types come from the cache file */
+	for (i = 0; i < 2; i++)
+	{
+		store = load_directory (dir);
+
+		g_assert (FILE_IS_TEXT (get_row_flags (GTK_TREE_MODEL (store), "text")));
+		g_assert (!FILE_IS_TEXT (get_row_flags (GTK_TREE_MODEL (store), "binary")));
+
+		gedit_file_browser_type_cache_get_stats (&hits, &misses);
+		g_assert_cmpint (hits, ==, i == 0 ? 0 : 2);
+		g_assert_cmpint (misses, ==, i == 0 ? 2 : 0);
+
+		g_object_unref (store);
+		gedit_file_browser_type_cache_shutdown ();
+	}
+
+	/* a file added later goes through the cache too */
+	store = load_directory (dir);
+
+	g_assert (gedit_file_browser_store_get_iter_virtual_root (store, &root));
+	g_assert (gedit_file_browser_store_new_file (store, &root, &iter));
+
+	gedit_file_browser_type_cache_get_stats (&hits, &misses);
+	g_assert_cmpint (hits, ==, 2);
+	g_assert_cmpint (misses, ==, 1);
+
+	g_object_unref (store);
+	gedit_file_browser_type_cache_shutdown ();
+
+	store = load_directory (dir);
+
+	gedit_file_browser_type_cache_get_stats (&hits, &misses);
+	g_assert_cmpint (hits, ==, 3);
+	g_assert_cmpint (misses, ==, 0);
+
+	g_object_unref (store);
+	gedit_file_browser_type_cache_shutdown ();
+
+	remove_directory (dir);
+	g_free (dir);
+}
+
+/* Resident memory in KB, 0 when it cannot be known */
+static gulong
+get_rss (void)
+{
+	gchar *contents;
+	gulong size = 0;
+	gulong resident = 0;
+
+	if (!g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL))
+		return 0;
+
+	sscanf (contents, "%lu %lu", &size, &resident);
+	g_free (contents);
+
+	return resident * (sysconf (_SC_PAGESIZE) / 1024);
+}
+
+static void
+do_load_benchmark (gint n_files)
+{
+	GeditFileBrowserStore *store;
+	GtkTreeModel *model;
+	GtkTreeIter iter;
+	GTimer *timer;
+	gdouble load_time;
+	gdouble walk_time;
+	gulong rss_start;
+	gulong rss_loaded;
+	gulong rss_shown;
+	gchar *dir;
+	gint n = 0;
+
+	dir = create_directory (n_files, 0);
+
+	rss_start = get_rss ();
+
+	timer = g_timer_new ();
+	store = load_directory (dir);
+	load_time = g_timer_elapsed (timer, NULL);
+
+	rss_loaded = get_rss ();
+
+	model = GTK_TREE_MODEL (store);
+
+	g_timer_start (timer);
+
+	if (gtk_tree_model_get_iter_first (model, &iter))
+	{
+		do
+		{
+			GtkTreePath *path;
+			GdkPixbuf *icon;
+
+			path = gtk_tree_model_get_path (model, &iter);
+			gtk_tree_path_free (path);
+
+			/* as if all the rows were shown */
+			gtk_tree_model_get (model, &iter,
+					    GEDIT_FILE_BROWSER_STORE_COLUMN_ICON, &icon,
+					    -1);
+
+			if (icon != NULL)
+				g_object_unref (icon);
+
+			n++;
+		} while (gtk_tree_model_iter_next (model, &iter));
+	}
+
+	walk_time = g_timer_elapsed (timer, NULL);
+
+	rss_shown = get_rss ();
+
+	g_assert_cmpint (n, ==, n_files);
+
+	g_test_message ("%d files: load %f s, walk %f s", n_files, load_time, walk_time);
+	g_test_message ("%d files: %lu KB loaded, %lu KB with the icons shown",
+			n_files, rss_loaded - rss_start, rss_shown - rss_start);
+	g_test_minimized_result (load_time, "load %d files", n_files);
+	g_test_minimized_result (walk_time, "walk %d files", n_files);
+
+	g_timer_destroy (timer);
+	g_object_unref (store);
+	remove_directory (dir);
+	g_free (dir);
+}
+
+typedef struct
+{
+	GMainLoop *loop;
+	gint expected;
+	gint inserted;
+} BurstData;
+
+static void
+on_burst_row_inserted (GtkTreeModel *model,
+		       GtkTreePath  *path,
+		       GtkTreeIter  *iter,
+		       BurstData    *data)
+{
+	guint flags;
+
+	gtk_tree_model_get (model, iter,
+			    GEDIT_FILE_BROWSER_STORE_COLUMN_FLAGS, &flags,
+			    -1);
+
+	if (!FILE_IS_DUMMY (flags) && ++data->inserted == data->expected)
+		g_main_loop_quit (data->loop);
+}
+
+static gboolean
+burst_timeout (BurstData *data)
+{
+	g_main_loop_quit (data->loop);
+
+	return FALSE;
+}
+
+static void
+do_burst_benchmark (gint n_files)
+{
+	GeditFileBrowserStore *store;
+	BurstData data;
+	GTimer *timer;
+	gdouble create_time;
+	gdouble latency;
+	clock_t cpu;
+	gchar *dir;
+	gint i;
+
+	dir = create_directory (0, 0);
+	store = load_directory (dir);
+
+	data.loop = g_main_loop_new (NULL, FALSE);
+	data.expected = n_files;
+	data.inserted = 0;
+
+	g_signal_connect (store,
+			  "row-inserted",
+			  G_CALLBACK (on_burst_row_inserted),
+			  &data);
+
+	cpu = clock ();
+	timer = g_timer_new ();
+
+	for (i = 0; i < n_files; i++)
+	{
+		gchar *name;
+		gchar *path;
+
+		name = g_strdup_printf ("file%07d.txt", i);
+		path = g_build_filename (dir, name, NULL);
+
+		g_assert (g_file_set_contents (path, "", 0, NULL));
+
+		g_free (path);
+		g_free (name);
+	}
+
+	create_time = g_timer_elapsed (timer, NULL);
+
+	/* the monitor may drop events, do not wait forever */
+	g_timeout_add_seconds (60, (GSourceFunc) burst_timeout, &data);
+	g_main_loop_run (data.loop);
+
+	latency = g_timer_elapsed (timer, NULL) - create_time;
+	cpu = clock () - cpu;
+
+	g_test_message ("%d files created in %f s: %d shown %f s later, %f s of cpu",
+			n_files,
+			create_time,
+			data.inserted,
+			latency,
+			(gdouble) cpu / CLOCKS_PER_SEC);
+
+	g_test_minimized_result (latency, "latency of %d created files", n_files);
+	g_test_minimized_result ((gdouble) cpu / CLOCKS_PER_SEC,
+				 "cpu for %d created files", n_files);
+
+	g_source_remove_by_user_data (&data);
+	g_main_loop_unref (data.loop);
+	g_timer_destroy (timer);
+	g_object_unref (store);
+	remove_directory (dir);
+	g_free (dir);
+}
+
+static void
+test_burst_perf ()
+{
+	do_burst_benchmark (1000);
+	do_burst_benchmark (10000);
+}
+
+static void
+do_type_cache_benchmark (gint n_files)
+{
+	GeditFileBrowserStore *store;
+	GTimer *timer;
+	gdouble cold;
+	gdouble warm;
+	guint hits, misses;
+	gchar *dir;
+
+	dir = create_directory (n_files, 0);
+
+	timer = g_timer_new ();
+	store = load_directory (dir);
+	cold = g_timer_elapsed (timer, NULL);
+
+	g_object_unref (store);
+
+	/* written and read again */
+	gedit_file_browser_type_cache_shutdown ();
+
+	g_timer_start (timer);
+	store = load_directory (dir);
+	warm = g_timer_elapsed (timer, NULL);
+
+	gedit_file_browser_type_cache_get_stats (&hits, &misses);
+	g_assert_cmpint (misses, ==, 0);
+	g_assert_cmpint (hits, ==, n_files);
+
+	g_test_message ("%d files: cold %f s, warm %f s", n_files, cold, warm);
+	g_test_minimized_result (warm, "warm listing of %d files", n_files);
+
+	g_object_unref (store);
+	gedit_file_browser_type_cache_shutdown ();
+
+	g_timer_destroy (timer);
+	remove_directory (dir);
+	g_free (dir);
+}
+
+static void
+test_type_cache_perf ()
+{
+	do_type_cache_benchmark (10000);
+	do_type_cache_benchmark (100000);
+}
+
+static void
+test_load_perf ()
+{
+	do_load_benchmark (10000);
+	do_load_benchmark (100000);
+
+	if (g_test_thorough ())
+		do_load_benchmark (1000000);
+}
+
+int main (int   argc,
+          char *argv[])
+{
+	gchar *cache_dir;
+	gint ret;
+
+	g_type_init ();
+	g_test_init (&argc, &argv, NULL);
+
+	/* keep the type cache of the user out of the tests */
+	cache_dir = g_build_filename (g_get_tmp_dir (), "gedit-file-browser-store-cache-XXXXXX", NULL);
+	g_assert (mkdtemp (cache_dir) != NULL);
+	g_setenv ("XDG_CACHE_HOME", cache_dir, TRUE);
+
+	/* the store loads icons from the theme */
+	if (!gtk_init_check (&argc, &argv))
+	{
+		g_test_message ("no display, skipping");
+		return 0;
+	}
+
+	register_types ();
+
+	g_test_add_func ("/file-browser-store/children", test_children);
+	g_test_add_func ("/file-browser-store/filter", test_filter);
+	g_test_add_func ("/file-browser-store/type-cache", test_type_cache);
+
+	if (g_test_perf ())
+	{
+		g_test_add_func ("/file-browser-store/load-perf", test_load_perf);
+		g_test_add_func ("/file-browser-store/burst-perf", test_burst_perf);
+		g_test_add_func ("/file-browser-store/type-cache-perf", test_type_cache_perf);
+	}
+
+	ret = g_test_run ();
+
+	remove_directory (cache_dir);
+	g_free (cache_dir);
+
+	return ret;
+}
@@ -0,0 +1,286 @@
+/*
+ * file-change-tracker.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "gedit-file-change-tracker.h"
+#include "gedit-debug.h"
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <unistd.h>
+
+typedef struct
+{
+	GMainLoop *loop;
+	gboolean   changed;
+} WaitData;
+
+static gboolean
+timeout_cb (WaitData *data)
+{
+	g_main_loop_quit (data->loop);
+	return FALSE;
+}
+
+static void
+changed_cb (GeditFileChangeTracker *tracker,
+	    GFile                  *location,
+	    WaitData               *data)
+{
+	data->changed = TRUE;
+	g_main_loop_quit (data->loop);
+}
+
+/* Returns FALSE if "changed" was not emitted within a few seconds */
+static gboolean
+wait_changed (GeditFileChangeTracker *tracker)
+{
+	WaitData data;
+	guint timeout;
+	gulong id;
+
+	data.loop = g_main_loop_new (NULL, FALSE);
+	data.changed = FALSE;
+
+	id = g_signal_connect (tracker, "changed", G_CALLBACK (changed_cb), &data);
+	timeout = g_timeout_add_seconds (5, (GSourceFunc) timeout_cb, &data);
+
+	g_main_loop_run (data.loop);
+
+	if (data.changed)
+		g_source_remove (timeout);
+
+	g_signal_handler_disconnect (tracker, id);
+	g_main_loop_unref (data.loop);
+
+	return data.changed;
+}
+
+static void
+wait_queries (GeditFileChangeTracker *tracker,
+	      guint                   queries)
+{
+	GeditFileChangeTrackerStats stats;
+
+	gedit_file_change_tracker_get_stats (tracker, &stats);
+
+	while (stats.queries < queries)
+	{
+		g_main_context_iteration (NULL, TRUE);
+		gedit_file_change_tracker_get_stats (tracker, &stats);
+	}
+}
+
+static GFile *
+create_file (gchar **filename)
+{
+	gint fd;
+
+	fd = g_file_open_tmp ("gedit-change-tracker-XXXXXX", filename, NULL);
+	g_assert (fd != -1);
+	close (fd);
+
+	return g_file_new_for_path (*filename);
+}
+
+static void
+get_file_mtime (GFile    *location,
+		GTimeVal *mtime)
+{
+	GFileInfo *info;
+
+	info = g_file_query_info (location,
+				  G_FILE_ATTRIBUTE_TIME_MODIFIED,
+				  G_FILE_QUERY_INFO_NONE,
+				  NULL,
+				  NULL);
+	g_assert (info != NULL);
+
+	g_file_info_get_modification_time (info, mtime);
+	g_object_unref (info);
+}
+
+static void
+test_mtime ()
+{
+	GeditFileChangeTracker *tracker;
+	GFile *location;
+	gchar *filename;
+	GTimeVal expected;
+	GTimeVal mtime;
+	gboolean ret;
+
+	tracker = gedit_file_change_tracker_get_default ();
+	location = create_file (&filename);
+
+	gedit_file_change_tracker_watch (tracker, location);
+
+	/* known once the first query is done */
+	g_assert (wait_changed (tracker));
+
+	get_file_mtime (location, &expected);
+	g_assert (gedit_file_change_tracker_get_mtime (tracker, location, &mtime));
+	g_assert_cmpint (mtime.tv_sec, ==, expected.tv_sec);
+	g_assert_cmpint (mtime.tv_usec, ==, expected.tv_usec);
+
+	/* a check sees the old mtime, and finds the new one in the
+	 * background */
+	ret = g_file_set_attribute_uint64 (location,
+					   G_FILE_ATTRIBUTE_TIME_MODIFIED,
+					   expected.tv_sec + 10,
+					   G_FILE_QUERY_INFO_NONE,
+					   NULL,
+					   NULL);
+	g_assert (ret);
+
+	g_assert (gedit_file_change_tracker_get_mtime (tracker, location, &mtime));
+	g_assert (wait_changed (tracker));
+
+	g_assert (gedit_file_change_tracker_get_mtime (tracker, location, &mtime));
+	g_assert_cmpint (mtime.tv_sec, ==, expected.tv_sec + 10);
+
+	gedit_file_change_tracker_unwatch (tracker, location);
+
+	g_unlink (filename);
+	g_free (filename);
+	g_object_unref (location);
+}
+
+static void
+test_unwatch ()
+{
+	GeditFileChangeTracker *tracker;
+	GFile *location;
+	gchar *filename;
+	GTimeVal mtime;
+
+	tracker = gedit_file_change_tracker_get_default ();
+	location = create_file (&filename);
+
+	gedit_file_change_tracker_watch (tracker, location);
+	gedit_file_change_tracker_watch (tracker, location);
+
+	g_assert (wait_changed (tracker));
+
+	/* the file is kept while a document still has it */
+	gedit_file_change_tracker_unwatch (tracker, location);
+	g_assert (gedit_file_change_tracker_get_mtime (tracker, location, &mtime));
+
+	/* unwatching while a query runs */
+	gedit_file_change_tracker_unwatch (tracker, location);
+	g_assert (!gedit_file_change_tracker_get_mtime (tracker, location, &mtime));
+
+	/* a file that cannot be read is not known */
+	g_unlink (filename);
+
+	gedit_file_change_tracker_watch (tracker, location);
+	g_assert (!wait_changed (tracker));
+	g_assert (!gedit_file_change_tracker_get_mtime (tracker, location, &mtime));
+	gedit_file_change_tracker_unwatch (tracker, location);
+
+	g_free (filename);
+	g_object_unref (location);
+}
+
+#define N_FILES 500
+
+/* Time to check all the files, as done when focusing their views */
+static void
+test_check_perf ()
+{
+	GeditFileChangeTracker *tracker;
+	GeditFileChangeTrackerStats stats;
+	GFile *locations[N_FILES];
+	gchar *filenames[N_FILES];
+	GTimeVal mtime;
+	GTimer *timer;
+	gdouble blocking;
+	gdouble tracked;
+	gint i;
+
+	tracker = gedit_file_change_tracker_get_default ();
+	gedit_file_change_tracker_get_stats (tracker, &stats);
+
+	for (i = 0; i < N_FILES; i++)
+	{
+		locations[i] = create_file (&filenames[i]);
+		gedit_file_change_tracker_watch (tracker, locations[i]);
+	}
+
+	/* the mtimes are known once the first queries are done */
+	wait_queries (tracker, stats.queries + N_FILES);
+
+	timer = g_timer_new ();
+
+	for (i = 0; i < N_FILES; i++)
+		get_file_mtime (locations[i], &mtime);
+
+	blocking = g_timer_elapsed (timer, NULL);
+
+	g_timer_start (timer);
+
+	for (i = 0; i < N_FILES; i++)
+		gedit_file_change_tracker_get_mtime (tracker, locations[i], &mtime);
+
+	tracked = g_timer_elapsed (timer, NULL);
+
+	/* and the checks queried the files again in the background */
+	wait_queries (tracker, stats.queries + 2 * N_FILES);
+
+	gedit_file_change_tracker_get_stats (tracker, &stats);
+
+	g_test_message ("%d checks: %.6f s blocking, %.6f s from the tracker",
+			N_FILES, blocking, tracked);
+	g_test_message ("%u queries: %.6f s on average, %.6f s at most",
+			stats.queries,
+			stats.queries > 0 ? stats.total_latency / stats.queries : 0.0,
+			stats.max_latency);
+
+	g_test_minimized_result (tracked, "%d checks from the tracker: %.6f s",
+				 N_FILES, tracked);
+
+	for (i = 0; i < N_FILES; i++)
+	{
+		gedit_file_change_tracker_unwatch (tracker, locations[i]);
+		g_unlink (filenames[i]);
+		g_free (filenames[i]);
+		g_object_unref (locations[i]);
+	}
+
+	g_timer_destroy (timer);
+}
+
+int main (int   argc,
+          char *argv[])
+{
+	g_type_init ();
+	g_test_init (&argc, &argv, NULL);
+
+	gedit_debug_init ();
+
+	g_test_add_func ("/file-change-tracker/mtime", test_mtime);
+	g_test_add_func ("/file-change-tracker/unwatch", test_unwatch);
+
+	if (g_test_perf ())
+		g_test_add_func ("/file-change-tracker/check-perf", test_check_perf);
+
+	return g_test_run ();
+}
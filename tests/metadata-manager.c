@@ -0,0 +1,360 @@
+/*
+ * metadata-manager.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "gedit-metadata-manager.h"
+#include "gedit-dirs.h"
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static gchar *
+get_cache_file (const gchar *name)
+{
+	gchar *cache_dir;
+	gchar *file_name;
+
+	cache_dir = gedit_dirs_get_user_cache_dir ();
+	file_name = g_build_filename (cache_dir, name, NULL);
+	g_free (cache_dir);
+
+	return file_name;
+}
+
+/* Starts every test without metadata */
+static void
+clear_metadata ()
+{
+	gchar *file_name;
+
+	gedit_metadata_manager_shutdown ();
+
+	file_name = get_cache_file ("gedit-metadata");
+	g_unlink (file_name);
+	g_free (file_name);
+
+	file_name = get_cache_file ("gedit-metadata.xml");
+	g_unlink (file_name);
+	g_free (file_name);
+}
+
+static gchar *
+get_uri (gint i)
+{
+	return g_strdup_printf ("file:///tmp/gedit-metadata-test/file%d.txt", i);
+}
+
+static void
+check_value (const gchar *uri,
+	     const gchar *key,
+	     const gchar *expected)
+{
+	gchar *value;
+
+	value = gedit_metadata_manager_get (uri, key);
+	g_assert_cmpstr (value, ==, expected);
+	g_free (value);
+}
+
+static void
+test_set_get ()
+{
+	gint i;
+
+	clear_metadata ();
+
+	gedit_metadata_manager_set ("file:///a", "position", "10");
+	gedit_metadata_manager_set ("file:///a", "encoding", "UTF-8");
+	gedit_metadata_manager_set ("file:///b", "position", "20");
+
+	check_value ("file:///a", "position", "10");
+	check_value ("file:///a", "encoding", "UTF-8");
+	check_value ("file:///b", "position", "20");
+	check_value ("file:///b", "encoding", NULL);
+	check_value ("file:///c", "position", NULL);
+
+	/* each session appends its changes to the file */
+	for (i = 0; i < 3; i++)
+	{
+		gchar *position;
+
+		gedit_metadata_manager_shutdown ();
+
+		position = g_strdup_printf ("%d", i);
+		gedit_metadata_manager_set ("file:///b", "position", position);
+		gedit_metadata_manager_set ("file:///a", "encoding", NULL);
+		g_free (position);
+
+		gedit_metadata_manager_shutdown ();
+
+		check_value ("file:///a", "position", "10");
+		check_value ("file:///a", "encoding", NULL);
+	}
+
+	check_value ("file:///b", "position", "2");
+}
+
+static void
+test_damaged ()
+{
+	gchar *file_name;
+	gchar *contents;
+	gsize length;
+	FILE *file;
+
+	clear_metadata ();
+
+	gedit_metadata_manager_set ("file:///a", "position", "10");
+	gedit_metadata_manager_shutdown ();
+
+	gedit_metadata_manager_set ("file:///b", "position", "20");
+	gedit_metadata_manager_shutdown ();
+
+	/* cut the last record in the middle */
+	file_name = get_cache_file ("gedit-metadata");
+	g_assert (g_file_get_contents (file_name, &contents, &length, NULL));
+	g_assert (g_file_set_contents (file_name, contents, length - 3, NULL));
+
+	check_value ("file:///a", "position", "10");
+	check_value ("file:///b", "position", NULL);
+
+	/* the file is written again instead of appending after the
+	 * damaged record */
+	gedit_metadata_manager_set ("file:///c", "position", "30");
+	gedit_metadata_manager_shutdown ();
+
+	check_value ("file:///a", "position", "10");
+	check_value ("file:///c", "position", "30");
+
+	/* garbage is not a metadata file */
+	file = g_fopen (file_name, "wb");
+	fputs ("garbage", file);
+	fclose (file);
+
+	gedit_metadata_manager_shutdown ();
+	check_value ("file:///a", "position", NULL);
+
+	g_free (contents);
+	g_free (file_name);
+}
+
+static void
+test_removed_file ()
+{
+	gchar *file_name;
+
+	clear_metadata ();
+
+	gedit_metadata_manager_set ("file:///a", "position", "10");
+	gedit_metadata_manager_shutdown ();
+
+	/* the file goes away while the changes are not saved yet */
+	gedit_metadata_manager_set ("file:///b", "position", "20");
+
+	file_name = get_cache_file ("gedit-metadata");
+	g_assert (g_unlink (file_name) == 0);
+
+	gedit_metadata_manager_shutdown ();
+
+	check_value ("file:///a", "position", NULL);
+	check_value ("file:///b", "position", "20");
+
+	g_free (file_name);
+}
+
+static void
+test_import ()
+{
+	gchar *file_name;
+	gchar *cache_dir;
+
+	clear_metadata ();
+
+	cache_dir = gedit_dirs_get_user_cache_dir ();
+	g_assert (g_mkdir_with_parents (cache_dir, 0755) == 0);
+	g_free (cache_dir);
+
+	file_name = get_cache_file ("gedit-metadata.xml");
+	g_assert (g_file_set_contents (file_name,
+				       "<?xml version=\"1.0\"?>\n"
+				       "<metadata>\n"
+				       "  <document uri=\"file:///a\" atime=\"1234\">\n"
+				       "    <entry key=\"position\" value=\"10\"/>\n"
+				       "    <entry key=\"encoding\" value=\"ISO-8859-15\"/>\n"
+				       "  </document>\n"
+				       "  <document uri=\"file:///b\" atime=\"1235\">\n"
+				       "    <entry key=\"position\" value=\"20\"/>\n"
+				       "  </document>\n"
+				       "</metadata>\n",
+				       -1, NULL));
+
+	check_value ("file:///a", "position", "10");
+	check_value ("file:///a", "encoding", "ISO-8859-15");
+	check_value ("file:///b", "position", "20");
+
+	gedit_metadata_manager_shutdown ();
+
+	/* once imported the binary file wins */
+	g_unlink (file_name);
+	g_free (file_name);
+
+	check_value ("file:///a", "position", "10");
+	check_value ("file:///b", "position", "20");
+}
+
+static void
+test_lru ()
+{
+	gchar *first;
+	gchar *uri;
+	gint i;
+
+	clear_metadata ();
+
+	/* the first uri is kept used, the second one is the oldest */
+	first = get_uri (0);
+
+	for (i = 0; i <= 10000; i++)
+	{
+		uri = get_uri (i);
+		gedit_metadata_manager_set (uri, "position", "1");
+		g_free (uri);
+
+		check_value (first, "position", "1");
+	}
+
+	uri = get_uri (1);
+	check_value (uri, "position", NULL);
+	g_free (uri);
+
+	uri = get_uri (2);
+	check_value (uri, "position", "1");
+	g_free (uri);
+
+	gedit_metadata_manager_shutdown ();
+
+	check_value (first, "position", "1");
+
+	uri = get_uri (1);
+	check_value (uri, "position", NULL);
+	g_free (uri);
+
+	g_free (first);
+}
+
+static void
+do_metadata_benchmark (gint n_uris)
+{
+	GTimer *timer;
+	gchar *file_name;
+	gdouble full, startup, delta;
+	gint i;
+
+	clear_metadata ();
+
+	for (i = 0; i < n_uris; i++)
+	{
+		gchar *uri;
+
+		uri = get_uri (i);
+		gedit_metadata_manager_set (uri, "position", "1234");
+		gedit_metadata_manager_set (uri, "encoding", "UTF-8");
+		g_free (uri);
+	}
+
+	/* the first save writes the whole file */
+	timer = g_timer_new ();
+	gedit_metadata_manager_shutdown ();
+	full = g_timer_elapsed (timer, NULL);
+
+	g_timer_start (timer);
+	check_value ("file:///nothing", "position", NULL);
+	startup = g_timer_elapsed (timer, NULL);
+
+	for (i = 0; i < 10; i++)
+	{
+		gchar *uri;
+
+		uri = get_uri (i);
+		gedit_metadata_manager_set (uri, "position", "4321");
+		g_free (uri);
+	}
+
+	g_timer_start (timer);
+	gedit_metadata_manager_shutdown ();
+	delta = g_timer_elapsed (timer, NULL);
+
+	g_test_message ("%d uris: full save %f s, startup %f s, save of 10 changes %f s",
+			n_uris, full, startup, delta);
+
+	g_test_minimized_result (startup, "startup with %d uris", n_uris);
+	g_test_minimized_result (delta, "save of 10 changes with %d uris", n_uris);
+
+	g_timer_destroy (timer);
+
+	file_name = get_cache_file ("gedit-metadata");
+	g_unlink (file_name);
+	g_free (file_name);
+}
+
+static void
+test_metadata_perf ()
+{
+	do_metadata_benchmark (1000);
+	do_metadata_benchmark (10000);
+}
+
+int main (int   argc,
+          char *argv[])
+{
+	gchar *cache_dir;
+	gint ret;
+
+	g_type_init ();
+	g_test_init (&argc, &argv, NULL);
+
+	/* keep the metadata of the user out of the tests */
+	cache_dir = g_build_filename (g_get_tmp_dir (), "gedit-metadata-manager-XXXXXX", NULL);
+	g_assert (mkdtemp (cache_dir) != NULL);
+	g_setenv ("XDG_CACHE_HOME", cache_dir, TRUE);
+
+	g_test_add_func ("/metadata-manager/set-get", test_set_get);
+	g_test_add_func ("/metadata-manager/damaged", test_damaged);
+	g_test_add_func ("/metadata-manager/removed-file", test_removed_file);
+	g_test_add_func ("/metadata-manager/import", test_import);
+	g_test_add_func ("/metadata-manager/lru", test_lru);
+
+	if (g_test_perf ())
+		g_test_add_func ("/metadata-manager/metadata-perf", test_metadata_perf);
+
+	ret = g_test_run ();
+
+	clear_metadata ();
+	g_free (cache_dir);
+
+	cache_dir = gedit_dirs_get_user_cache_dir ();
+	g_rmdir (cache_dir);
+	g_rmdir (g_get_user_cache_dir ());
+	g_free (cache_dir);
+
+	return ret;
+}
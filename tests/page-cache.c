@@ -0,0 +1,158 @@
+/*
+ * page-cache.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+
+#include "gedit-page-cache.h"
+#include <gtk/gtk.h>
+#include <glib.h>
+
+/* 100 x 100 ARGB32 surfaces take 40000 bytes */
+#define SURFACE_SIZE (100 * 100 * 4)
+
+static cairo_surface_t *
+create_surface ()
+{
+	return cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 100, 100);
+}
+
+static void
+insert_page (GeditPageCache *cache,
+	     gint            page,
+	     double          scale)
+{
+	cairo_surface_t *surface;
+
+	surface = create_surface ();
+	gedit_page_cache_insert (cache, page, scale,
+				 GTK_PAGE_ORIENTATION_PORTRAIT,
+				 surface);
+	cairo_surface_destroy (surface);
+}
+
+static gboolean
+has_page (GeditPageCache *cache,
+	  gint            page)
+{
+	return gedit_page_cache_lookup (cache, page,
+					GTK_PAGE_ORIENTATION_PORTRAIT,
+					NULL) != NULL;
+}
+
+static void
+test_lookup ()
+{
+	GeditPageCache *cache;
+	cairo_surface_t *surface;
+	double scale;
+
+	cache = gedit_page_cache_new (10 * SURFACE_SIZE);
+
+	g_assert (!has_page (cache, 0));
+
+	surface = create_surface ();
+	gedit_page_cache_insert (cache, 0, 1.0,
+				 GTK_PAGE_ORIENTATION_PORTRAIT,
+				 surface);
+
+	g_assert (gedit_page_cache_lookup (cache, 0,
+					   GTK_PAGE_ORIENTATION_PORTRAIT,
+					   &scale) == surface);
+	g_assert_cmpfloat (scale, ==, 1.0);
+
+	/* the cache holds its own reference */
+	g_assert_cmpint (cairo_surface_get_reference_count (surface), ==, 2);
+
+	/* a page rendered with another orientation is not used */
+	g_assert (gedit_page_cache_lookup (cache, 0,
+					   GTK_PAGE_ORIENTATION_LANDSCAPE,
+					   NULL) == NULL);
+
+	/* a page rendered again replaces the old surface */
+	insert_page (cache, 0, 1.2);
+
+	g_assert_cmpint (cairo_surface_get_reference_count (surface), ==, 1);
+	g_assert (gedit_page_cache_lookup (cache, 0,
+					   GTK_PAGE_ORIENTATION_PORTRAIT,
+					   &scale) != surface);
+	g_assert_cmpfloat (scale, ==, 1.2);
+	g_assert_cmpuint (gedit_page_cache_get_size (cache), ==, SURFACE_SIZE);
+
+	cairo_surface_destroy (surface);
+
+	gedit_page_cache_clear (cache);
+
+	g_assert (!has_page (cache, 0));
+	g_assert_cmpuint (gedit_page_cache_get_size (cache), ==, 0);
+
+	gedit_page_cache_free (cache);
+}
+
+static void
+test_budget ()
+{
+	GeditPageCache *cache;
+	gint i;
+
+	cache = gedit_page_cache_new (3 * SURFACE_SIZE);
+
+	for (i = 0; i < 3; i++)
+		insert_page (cache, i, 1.0);
+
+	g_assert_cmpuint (gedit_page_cache_get_size (cache), ==, 3 * SURFACE_SIZE);
+
+	/* using page 0 makes page 1 the least recently used */
+	g_assert (has_page (cache, 0));
+
+	insert_page (cache, 3, 1.0);
+
+	g_assert_cmpuint (gedit_page_cache_get_size (cache), ==, 3 * SURFACE_SIZE);
+	g_assert (has_page (cache, 0));
+	g_assert (!has_page (cache, 1));
+	g_assert (has_page (cache, 2));
+	g_assert (has_page (cache, 3));
+
+	gedit_page_cache_free (cache);
+
+	/* a page bigger than the budget is still kept, alone */
+	cache = gedit_page_cache_new (SURFACE_SIZE / 2);
+
+	insert_page (cache, 0, 1.0);
+	insert_page (cache, 1, 1.0);
+
+	g_assert (!has_page (cache, 0));
+	g_assert (has_page (cache, 1));
+	g_assert_cmpuint (gedit_page_cache_get_size (cache), ==, SURFACE_SIZE);
+
+	gedit_page_cache_free (cache);
+}
+
+int main (int   argc,
+          char *argv[])
+{
+	g_type_init ();
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/page-cache/lookup", test_lookup);
+	g_test_add_func ("/page-cache/budget", test_budget);
+
+	return g_test_run ();
+}
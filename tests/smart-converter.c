@@ -22,6 +22,7 @@
 
 
 #include "gedit-smart-charset-converter.h"
+#include "gedit-encoding-detector.h"
 #include "gedit-encodings.h"
 #include <gio/gio.h>
 #include <glib.h>
@@ -30,6 +31,9 @@
 #define TEXT_TO_CONVERT "this is some text to make the tests"
 #define TEXT_TO_GUESS "hello \xe6\x96\x87 world"
 
+#define PERF_TEXT_SIZE (16 * 1024 * 1024)
+#define PERF_CHUNK_SIZE 65536
+
 static void
 print_hex (gchar *ptr, gint len)
 {
@@ -317,6 +321,279 @@ test_guessed ()
 	g_assert (guessed == gedit_encoding_get_from_charset ("UTF-16"));
 }
 
+static gchar *
+create_perf_text (const gchar *pattern,
+		  const gchar *rare,
+		  gint         rare_every)
+{
+	GString *text;
+	gint i = 0;
+
+	text = g_string_sized_new (PERF_TEXT_SIZE);
+
+	while (text->len < PERF_TEXT_SIZE)
+	{
+		if (rare != NULL && (++i % rare_every) == 0)
+			g_string_append (text, rare);
+		else
+			g_string_append (text, pattern);
+	}
+
+	return g_string_free (text, FALSE);
+}
+
+/* Runs the whole text through a new converter, in chunks as the
+ * loader does, and returns the throughput in MB/s */
+static gdouble
+measure_throughput (const gchar *text,
+		    GSList      *encodings,
+		    const GeditEncoding **guessed)
+{
+	GeditSmartCharsetConverter *converter;
+	gchar *out;
+	gsize len, nread;
+	GTimer *timer;
+	gdouble elapsed;
+
+	len = strlen (text);
+	out = g_malloc (PERF_CHUNK_SIZE * 4);
+	nread = 0;
+
+	timer = g_timer_new ();
+
+	converter = gedit_smart_charset_converter_new (encodings);
+
+	while (nread < len)
+	{
+		GConverterResult res;
+		gsize chunk, bytes_read, bytes_written;
+		GError *err = NULL;
+
+		chunk = MIN (PERF_CHUNK_SIZE, len - nread);
+
+		res = g_converter_convert (G_CONVERTER (converter),
+					   text + nread,
+					   chunk,
+					   out,
+					   PERF_CHUNK_SIZE * 4,
+					   nread + chunk == len ? G_CONVERTER_INPUT_AT_END : 0,
+					   &bytes_read,
+					   &bytes_written,
+					   &err);
+
+		g_assert_no_error (err);
+		g_assert (res != G_CONVERTER_ERROR);
+
+		nread += bytes_read;
+	}
+
+	*guessed = gedit_smart_charset_converter_get_guessed (converter);
+
+	g_timer_stop (timer);
+	elapsed = g_timer_elapsed (timer, NULL);
+
+	g_object_unref (converter);
+	g_timer_destroy (timer);
+	g_free (out);
+
+	return (len / (1024.0 * 1024.0)) / elapsed;
+}
+
+static void
+do_perf_test (const gchar *name,
+	      const gchar *text,
+	      const gchar *expected)
+{
+	GSList *encs = NULL;
+	const GeditEncoding *guessed;
+	gdouble mbs;
+
+	/* the default candidates */
+	encs = g_slist_append (encs, (gpointer)gedit_encoding_get_utf8 ());
+	encs = g_slist_append (encs, (gpointer)gedit_encoding_get_from_charset ("ISO-8859-15"));
+
+	mbs = measure_throughput (text, encs, &guessed);
+
+	g_assert (guessed == gedit_encoding_get_from_charset (expected));
+
+	g_test_maximized_result (mbs, "%s: %.1f MB/s", name, mbs);
+	g_test_message ("%s: %.1f MB/s", name, mbs);
+
+	g_slist_free (encs);
+}
+
+static void
+test_perf_detection ()
+{
+	gchar *text;
+
+	text = create_perf_text ("the quick brown fox jumps over the lazy dog\n", NULL, 0);
+	do_perf_test ("ascii", text, "UTF-8");
+	g_free (text);
+
+	text = create_perf_text ("the quick brown fox jumps over the lazy dog\n",
+				 "caf\xc3\xa9 cr\xc3\xa8me br\xc3\xbbl\xc3\xa9e\n", 20);
+	do_perf_test ("mostly-ascii", text, "UTF-8");
+	g_free (text);
+
+	text = create_perf_text ("\xe6\x96\x87\xe5\xad\x97\xe5\x8c\x96\xe3\x81\x91\n", NULL, 0);
+	do_perf_test ("cjk", text, "UTF-8");
+	g_free (text);
+
+	text = create_perf_text ("the quick brown fox jumps over the lazy dog\n",
+				 "caf\xe9 cr\xe8me br\xfbl\xe9e\n", 20);
+	do_perf_test ("latin-1", text, "ISO-8859-15");
+	g_free (text);
+}
+
+static const GeditEncoding *
+detect (const gchar *text,
+	gsize        len,
+	GSList      *encodings)
+{
+	GSList *guesses;
+	GeditEncodingGuess *best;
+	const GeditEncoding *enc;
+
+	guesses = gedit_encoding_detector_guess (text, len, 0, encodings);
+	g_assert (guesses != NULL);
+
+	best = guesses->data;
+	enc = best->confidence > 0.0 ? best->encoding : NULL;
+
+	gedit_encoding_detector_free_guesses (guesses);
+
+	return enc;
+}
+
+static void
+test_detector ()
+{
+	GSList *encs = NULL;
+	gchar *aux;
+	gsize aux_len;
+
+	encs = g_slist_append (encs, (gpointer)gedit_encoding_get_utf8 ());
+	encs = g_slist_append (encs, (gpointer)gedit_encoding_get_from_charset ("ISO-8859-15"));
+	encs = g_slist_append (encs, (gpointer)gedit_encoding_get_from_charset ("UTF-16"));
+
+	/* ties keep the order of the candidates */
+	g_assert (detect (TEXT_TO_CONVERT, strlen (TEXT_TO_CONVERT), encs) ==
+		  gedit_encoding_get_utf8 ());
+
+	g_assert (detect (TEXT_TO_GUESS, strlen (TEXT_TO_GUESS), encs) ==
+		  gedit_encoding_get_utf8 ());
+
+	aux = get_encoded_text (TEXT_TO_GUESS, -1,
+	                        gedit_encoding_get_from_charset ("UTF-16"),
+	                        gedit_encoding_get_from_charset ("UTF-8"),
+	                        &aux_len,
+	                        TRUE);
+
+	g_assert (detect (aux, aux_len, encs) ==
+		  gedit_encoding_get_from_charset ("UTF-16"));
+	g_free (aux);
+
+	/* invalid utf8 */
+	g_assert (detect ("caf\xe9 cr\xe8me", 10, encs) ==
+		  gedit_encoding_get_from_charset ("ISO-8859-15"));
+
+	g_slist_free (encs);
+}
+
+/* Text in several languages, with the encoding usually found for it */
+static const gchar *detector_corpus[][2] =
+{
+	{ "Le c\xc5\x93ur d\xc3\xa9\xc3\xa7u mais l'\xc3\xa2me plut\xc3\xb4t na\xc3\xafve, "
+	  "Lou\xc3\xbfs r\xc3\xaava de crapa\xc3\xbcter en cano\xc3\xab au del\xc3\xa0 des "
+	  "\xc3\xaeles, pr\xc3\xa8s du m\xc3\xa4lstr\xc3\xb6m o\xc3\xb9 br\xc3\xbblent les nov\xc3\xa6.\n",
+	  "ISO-8859-15" },
+	{ "\xd0\xa1\xd1\x8a\xd0\xb5\xd1\x88\xd1\x8c \xd0\xb6\xd0\xb5 \xd0\xb5\xd1\x89\xd1\x91 "
+	  "\xd1\x8d\xd1\x82\xd0\xb8\xd1\x85 \xd0\xbc\xd1\x8f\xd0\xb3\xd0\xba\xd0\xb8\xd1\x85 "
+	  "\xd1\x84\xd1\x80\xd0\xb0\xd0\xbd\xd1\x86\xd1\x83\xd0\xb7\xd1\x81\xd0\xba\xd0\xb8\xd1\x85 "
+	  "\xd0\xb1\xd1\x83\xd0\xbb\xd0\xbe\xd0\xba, \xd0\xb4\xd0\xb0 \xd0\xb2\xd1\x8b\xd0\xbf\xd0\xb5\xd0\xb9 "
+	  "\xd1\x87\xd0\xb0\xd1\x8e.\n",
+	  "KOI8-R" },
+	{ NULL, "WINDOWS-1251" },
+	{ "\xe3\x81\x84\xe3\x82\x8d\xe3\x81\xaf\xe3\x81\xab\xe3\x81\xbb\xe3\x81\xb8\xe3\x81\xa8 "
+	  "\xe3\x81\xa1\xe3\x82\x8a\xe3\x81\xac\xe3\x82\x8b\xe3\x82\x92 "
+	  "\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e\xe3\x81\xae\xe6\x96\x87\xe7\xab\xa0\xe3\x81\xa7\xe3\x81\x99\xe3\x80\x82\n",
+	  "EUC-JP" },
+	{ NULL, "SHIFT_JIS" },
+	{ "\xe6\x88\x91\xe8\x83\xbd\xe5\x90\x9e\xe4\xb8\x8b\xe7\x8e\xbb\xe7\x92\x83\xe8\x80\x8c"
+	  "\xe4\xb8\x8d\xe4\xbc\xa4\xe8\xba\xab\xe4\xbd\x93\xe3\x80\x82\xe5\xa4\xa9\xe5\x9c\xb0"
+	  "\xe7\x8e\x84\xe9\xbb\x84\xef\xbc\x8c\xe5\xae\x87\xe5\xae\x99\xe6\xb4\xaa\xe8\x8d\x92\xe3\x80\x82\n",
+	  "GB2312" },
+	{ "\xeb\x8b\xa4\xeb\x9e\x8c\xec\xa5\x90 \xed\x97\x8c \xec\xb3\x87\xeb\xb0\x94\xed\x80\xb4\xec\x97\x90 "
+	  "\xed\x83\x80\xea\xb3\xa0\xed\x8c\x8c.\n",
+	  "EUC-KR" },
+	{ TEXT_TO_GUESS, "UTF-16LE" },
+	{ TEXT_TO_GUESS, "UTF-16BE" }
+};
+
+/* Measures how often the detector is right on the corpus and how long
+ * each detection takes. Some of these are ambiguous by nature (e.g.
+ * KOI8-R and WINDOWS-1251 on short text), so we only report them. */
+static void
+test_perf_detector_accuracy ()
+{
+	GSList *encs = NULL;
+	const gchar *charsets[] = { "UTF-8", "ISO-8859-15", "WINDOWS-1251", "KOI8-R",
+				    "EUC-JP", "SHIFT_JIS", "GB2312", "EUC-KR",
+				    "UTF-16LE", "UTF-16BE" };
+	const gchar *utf8 = NULL;
+	GTimer *timer;
+	gint right = 0;
+	guint i;
+	gint j;
+
+	for (i = 0; i < G_N_ELEMENTS (charsets); i++)
+		encs = g_slist_append (encs, (gpointer)gedit_encoding_get_from_charset (charsets[i]));
+
+	timer = g_timer_new ();
+
+	for (i = 0; i < G_N_ELEMENTS (detector_corpus); i++)
+	{
+		const GeditEncoding *expected;
+		const GeditEncoding *guessed = NULL;
+		gchar *text;
+		gsize len;
+		gdouble elapsed;
+
+		/* NULL means the same text as the previous entry */
+		if (detector_corpus[i][0] != NULL)
+			utf8 = detector_corpus[i][0];
+
+		expected = gedit_encoding_get_from_charset (detector_corpus[i][1]);
+		text = g_convert (utf8, -1, detector_corpus[i][1], "UTF-8", NULL, &len, NULL);
+		g_assert (text != NULL);
+
+		g_timer_start (timer);
+
+		for (j = 0; j < 1000; j++)
+			guessed = detect (text, len, encs);
+
+		elapsed = g_timer_elapsed (timer, NULL) * 1000.0;
+
+		if (guessed == expected)
+			right++;
+
+		g_test_message ("%s: guessed %s, %f us per detection",
+				detector_corpus[i][1],
+				guessed != NULL ? gedit_encoding_get_charset (guessed) : "nothing",
+				elapsed);
+
+		g_free (text);
+	}
+
+	g_test_maximized_result (100.0 * right / G_N_ELEMENTS (detector_corpus),
+				 "detector accuracy: %d of %d",
+				 right, (gint)G_N_ELEMENTS (detector_corpus));
+
+	g_timer_destroy (timer);
+	g_slist_free (encs);
+}
+
 int main (int   argc,
           char *argv[])
 {
@@ -326,6 +603,13 @@ int main (int   argc,
 	g_test_add_func ("/smart-converter/utf8-utf8", test_utf8_utf8);
 	//g_test_add_func ("/smart-converter/xxx-xxx", test_xxx_xxx);
 	g_test_add_func ("/smart-converter/guessed", test_guessed);
+	g_test_add_func ("/smart-converter/detector", test_detector);
+
+	if (g_test_perf ())
+	{
+		g_test_add_func ("/smart-converter/perf-detection", test_perf_detection);
+		g_test_add_func ("/smart-converter/perf-detector-accuracy", test_perf_detector_accuracy);
+	}
 
 	return g_test_run ();
 }
@@ -0,0 +1,194 @@
+/*
+ * sort-lines.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "gedit-sort-lines.h"
+#include <glib.h>
+#include <locale.h>
+#include <string.h>
+
+static void
+check_sort (const gchar   *text,
+	    GeditSortMode  mode,
+	    gboolean       ignore_case,
+	    gboolean       reverse_order,
+	    gboolean       remove_duplicates,
+	    gint           starting_column,
+	    const gchar   *expected)
+{
+	GeditSortInfo sort_info;
+	gchar *sorted;
+
+	sort_info.mode = mode;
+	sort_info.ignore_case = ignore_case;
+	sort_info.reverse_order = reverse_order;
+	sort_info.remove_duplicates = remove_duplicates;
+	sort_info.starting_column = starting_column;
+
+	sorted = gedit_sort_lines (text, &sort_info);
+	g_assert_cmpstr (sorted, ==, expected);
+	g_free (sorted);
+}
+
+static void
+test_text ()
+{
+	check_sort ("c\nb\na\n", GEDIT_SORT_MODE_TEXT, FALSE, FALSE, FALSE, 0,
+		    "a\nb\nc\n");
+	check_sort ("c\nb\na\n", GEDIT_SORT_MODE_TEXT, FALSE, TRUE, FALSE, 0,
+		    "c\nb\na\n");
+
+	/* all the terminators of GtkTextBuffer, the last one is added */
+	check_sort ("c\r\nb\ra\xe2\x80\xa9" "d", GEDIT_SORT_MODE_TEXT, FALSE, FALSE, FALSE, 0,
+		    "a\nb\nc\nd\n");
+
+	check_sort ("", GEDIT_SORT_MODE_TEXT, FALSE, FALSE, FALSE, 0, "");
+
+	check_sort ("b\nB\na\nb\nb\n", GEDIT_SORT_MODE_TEXT, TRUE, FALSE, TRUE, 0,
+		    "a\nb\nB\nb\n");
+	check_sort ("b\nB\nA\nb\n", GEDIT_SORT_MODE_TEXT, TRUE, FALSE, FALSE, 0,
+		    "A\nb\nB\nb\n");
+
+	/* lines shorter than the column come first */
+	check_sort ("xb\nya\nz\n\nwc\n", GEDIT_SORT_MODE_TEXT, FALSE, FALSE, FALSE, 1,
+		    "\nz\nya\nxb\nwc\n");
+
+	/* the column is in chars */
+	check_sort ("xb\n\xc3\xa8" "a\n", GEDIT_SORT_MODE_TEXT, FALSE, FALSE, FALSE, 1,
+		    "\xc3\xa8" "a\nxb\n");
+}
+
+static void
+test_numeric ()
+{
+	check_sort ("10\n9\n-1.5\nfoo\n 2 apples\n100\n", GEDIT_SORT_MODE_NUMERIC, FALSE, FALSE, FALSE, 0,
+		    "foo\n-1.5\n 2 apples\n9\n10\n100\n");
+	check_sort ("10\n9\n100\n", GEDIT_SORT_MODE_NUMERIC, FALSE, TRUE, FALSE, 0,
+		    "100\n10\n9\n");
+	check_sort ("a 10\nb 9\n", GEDIT_SORT_MODE_NUMERIC, FALSE, FALSE, FALSE, 2,
+		    "b 9\na 10\n");
+
+	/* nan is not a number, blank lines do not take the next number */
+	check_sort ("2\nnan\n1\n  \n-3\n", GEDIT_SORT_MODE_NUMERIC, FALSE, FALSE, FALSE, 0,
+		    "nan\n  \n-3\n1\n2\n");
+}
+
+static void
+test_natural ()
+{
+	check_sort ("file10\nfile9\nfile1\n", GEDIT_SORT_MODE_NATURAL, FALSE, FALSE, FALSE, 0,
+		    "file1\nfile9\nfile10\n");
+	check_sort ("File10\nfile9\n", GEDIT_SORT_MODE_NATURAL, TRUE, FALSE, FALSE, 0,
+		    "file9\nFile10\n");
+}
+
+static void
+test_parallel ()
+{
+	GString *text;
+	GString *expected;
+	gint i;
+
+	/* enough lines to build the keys in threads */
+	text = g_string_new (NULL);
+	expected = g_string_new (NULL);
+
+	for (i = 0; i < 100000; i++)
+	{
+		g_string_append_printf (text, "%d\n", 99999 - i);
+		g_string_append_printf (expected, "%d\n", i);
+	}
+
+	check_sort (text->str, GEDIT_SORT_MODE_NUMERIC, FALSE, FALSE, FALSE, 0,
+		    expected->str);
+	check_sort (text->str, GEDIT_SORT_MODE_NATURAL, FALSE, FALSE, FALSE, 0,
+		    expected->str);
+
+	g_string_free (text, TRUE);
+	g_string_free (expected, TRUE);
+}
+
+static void
+do_sort_benchmark (gint          n_lines,
+		   GeditSortMode mode)
+{
+	GeditSortInfo sort_info = { 0, };
+	GString *text;
+	GTimer *timer;
+	gchar *sorted;
+	gint i;
+
+	text = g_string_new (NULL);
+
+	for (i = 0; i < n_lines; i++)
+	{
+		g_string_append_printf (text, "Line %u of the text, %u\n",
+					g_random_int (),
+					g_random_int ());
+	}
+
+	sort_info.mode = mode;
+	sort_info.ignore_case = TRUE;
+	sort_info.starting_column = 5;
+
+	timer = g_timer_new ();
+	sorted = gedit_sort_lines (text->str, &sort_info);
+	g_timer_stop (timer);
+
+	g_test_message ("%d lines, mode %d: %f s",
+			n_lines, mode, g_timer_elapsed (timer, NULL));
+
+	g_test_minimized_result (g_timer_elapsed (timer, NULL),
+				 "sort of %d lines, mode %d", n_lines, mode);
+
+	g_timer_destroy (timer);
+	g_free (sorted);
+	g_string_free (text, TRUE);
+}
+
+static void
+test_sort_perf ()
+{
+	do_sort_benchmark (10000, GEDIT_SORT_MODE_TEXT);
+	do_sort_benchmark (1000000, GEDIT_SORT_MODE_TEXT);
+	do_sort_benchmark (1000000, GEDIT_SORT_MODE_NUMERIC);
+	do_sort_benchmark (1000000, GEDIT_SORT_MODE_NATURAL);
+}
+
+int main (int   argc,
+          char *argv[])
+{
+	/* the expected orders are the ones of the C locale */
+	setlocale (LC_ALL, "C");
+
+	g_thread_init (NULL);
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/sort-lines/text", test_text);
+	g_test_add_func ("/sort-lines/numeric", test_numeric);
+	g_test_add_func ("/sort-lines/natural", test_natural);
+	g_test_add_func ("/sort-lines/parallel", test_parallel);
+
+	if (g_test_perf ())
+		g_test_add_func ("/sort-lines/sort-perf", test_sort_perf);
+
+	return g_test_run ();
+}
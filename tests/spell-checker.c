@@ -0,0 +1,443 @@
+/*
+ * spell-checker.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "gedit-document.h"
+#include "gedit-prefs-manager.h"
+#include "gedit-debug.h"
+#include "gedit-spell-checker.h"
+#include "gedit-automatic-spell-checker.h"
+#include <glib.h>
+#include <string.h>
+
+/* The most frequent english words first, and some misspelled ones */
+static const gchar *words[] = {
+	"the", "of", "and", "to", "in", "is", "that", "it", "was", "for",
+	"on", "are", "with", "as", "his", "they", "be", "at", "one", "have",
+	"this", "from", "or", "had", "by", "word", "but", "what", "some", "we",
+	"can", "out", "other", "were", "all", "there", "when", "up", "use", "your",
+	"how", "said", "each", "she", "which", "their", "time", "will", "way", "about",
+	"many", "then", "them", "write", "would", "like", "these", "long", "make", "thing",
+	"see", "him", "two", "has", "look", "more", "day", "could", "come", "did",
+	"number", "sound", "most", "people", "over", "know", "water", "than", "call", "first",
+	"document", "editor", "language", "dictionary", "paragraph", "sentence", "window", "letter",
+	"teh", "recieve", "seperate", "occured", "definately", "untill", "wierd", "acheive"
+};
+
+static GeditSpellChecker *
+create_spell_checker ()
+{
+	GeditSpellChecker *spell;
+	const GeditSpellCheckerLanguage *lang;
+
+	spell = gedit_spell_checker_new ();
+
+	lang = gedit_spell_checker_language_from_key ("en_US");
+
+	if (lang == NULL || !gedit_spell_checker_set_language (spell, lang))
+	{
+		g_test_message ("no en_US dictionary, skipping");
+		g_object_unref (spell);
+
+		return NULL;
+	}
+
+	return spell;
+}
+
+/* Words picked with a zipfian distribution, about like in real text */
+static gchar *
+create_text (gsize size)
+{
+	GString *text;
+	gint i = 0;
+
+	text = g_string_sized_new (size + 32);
+
+	while (text->len < size)
+	{
+		gint n;
+
+		n = (gint) (G_N_ELEMENTS (words) /
+			    g_random_double_range (1, G_N_ELEMENTS (words))) - 1;
+
+		g_string_append (text, words[n]);
+		g_string_append_c (text, (++i % 12 == 0) ? '\n' : ' ');
+	}
+
+	return g_string_free (text, FALSE);
+}
+
+static void
+fill_document (GeditDocument *doc,
+	       gsize          size)
+{
+	gchar *text;
+
+	text = create_text (size);
+
+	gtk_source_buffer_begin_not_undoable_action (GTK_SOURCE_BUFFER (doc));
+	gtk_text_buffer_set_text (GTK_TEXT_BUFFER (doc), text, -1);
+	gtk_source_buffer_end_not_undoable_action (GTK_SOURCE_BUFFER (doc));
+
+	g_free (text);
+}
+
+static void
+test_cache ()
+{
+	GeditSpellChecker *spell;
+	guint i;
+
+	spell = create_spell_checker ();
+
+	if (spell == NULL)
+		return;
+
+	/* the same verdicts with and without the cache */
+	for (i = 0; i < G_N_ELEMENTS (words); i++)
+	{
+		gboolean uncached;
+
+		gedit_spell_checker_set_cache_size (spell, 0);
+		uncached = gedit_spell_checker_check_word (spell, words[i], -1);
+
+		gedit_spell_checker_set_cache_size (spell, 10000);
+
+		g_assert_cmpint (gedit_spell_checker_check_word (spell, words[i], -1), ==, uncached);
+		g_assert_cmpint (gedit_spell_checker_check_word (spell, words[i], -1), ==, uncached);
+	}
+
+	/* the verdicts change with the session words */
+	g_assert (!gedit_spell_checker_check_word (spell, "geditish", -1));
+
+	gedit_spell_checker_add_word_to_session (spell, "geditish", -1);
+	g_assert (gedit_spell_checker_check_word (spell, "geditish", -1));
+
+	gedit_spell_checker_clear_session (spell);
+	g_assert (!gedit_spell_checker_check_word (spell, "geditish", -1));
+
+	/* the words not in the dictionary are cached too */
+	gedit_spell_checker_add_word_to_session (spell, "teh", 2);
+	g_assert (!gedit_spell_checker_check_word (spell, "teh", -1));
+	g_assert (gedit_spell_checker_check_word (spell, "teh", 2));
+
+	g_object_unref (spell);
+}
+
+static void
+wait_for_check (GeditAutomaticSpellChecker *autospell)
+{
+	while (gedit_automatic_spell_checker_is_checking (autospell))
+		g_main_context_iteration (NULL, TRUE);
+}
+
+static gboolean
+is_highlighted (GeditDocument *doc,
+		gint           offset)
+{
+	GtkTextTagTable *table;
+	GtkTextTag *tag;
+	GtkTextIter iter;
+
+	table = gtk_text_buffer_get_tag_table (GTK_TEXT_BUFFER (doc));
+	tag = gtk_text_tag_table_lookup (table, "gtkspell-misspelled");
+	g_assert (tag != NULL);
+
+	gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (doc), &iter, offset);
+
+	return gtk_text_iter_has_tag (&iter, tag);
+}
+
+static void
+test_idle_check ()
+{
+	GeditSpellChecker *spell;
+	GeditAutomaticSpellChecker *autospell;
+	GeditDocument *doc;
+	GtkTextIter end;
+	GString *text;
+	gint offset;
+
+	spell = create_spell_checker ();
+
+	if (spell == NULL)
+		return;
+
+	doc = gedit_document_new ();
+	autospell = gedit_automatic_spell_checker_new (doc, spell);
+
+	/* small insertions are checked at once */
+	gtk_text_buffer_get_end_iter (GTK_TEXT_BUFFER (doc), &end);
+	gtk_text_buffer_insert (GTK_TEXT_BUFFER (doc), &end, "teh cat ", -1);
+
+	g_assert (is_highlighted (doc, 1));
+	g_assert (!is_highlighted (doc, 5));
+	g_assert (!gedit_automatic_spell_checker_is_checking (autospell));
+
+	/* big ones in idle */
+	text = g_string_new (NULL);
+
+	while (text->len < 4000)
+		g_string_append (text, "the dictionary of the editor ");
+
+	offset = 8 + g_utf8_strlen (text->str, -1);
+	g_string_append (text, "recieve the letter");
+
+	gtk_text_buffer_get_end_iter (GTK_TEXT_BUFFER (doc), &end);
+	gtk_text_buffer_insert (GTK_TEXT_BUFFER (doc), &end, text->str, text->len);
+
+	g_assert (gedit_automatic_spell_checker_is_checking (autospell));
+	g_assert (!is_highlighted (doc, offset + 1));
+
+	wait_for_check (autospell);
+
+	g_assert (is_highlighted (doc, offset + 1));
+	g_assert (!is_highlighted (doc, offset - 3));
+	g_assert (is_highlighted (doc, 1));
+
+	g_string_free (text, TRUE);
+	gedit_automatic_spell_checker_free (autospell);
+	g_object_unref (doc);
+	g_object_unref (spell);
+}
+
+/* Start and end offsets of the highlighted words */
+static GArray *
+get_highlights (GeditDocument *doc)
+{
+	GtkTextTag *tag;
+	GtkTextIter iter;
+	GArray *offsets;
+
+	tag = gtk_text_tag_table_lookup (gtk_text_buffer_get_tag_table (GTK_TEXT_BUFFER (doc)),
+					 "gtkspell-misspelled");
+	g_assert (tag != NULL);
+
+	offsets = g_array_new (FALSE, FALSE, sizeof (gint));
+
+	gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (doc), &iter);
+
+	while (gtk_text_iter_has_tag (&iter, tag) ||
+	       gtk_text_iter_forward_to_tag_toggle (&iter, tag))
+	{
+		gint offset;
+
+		offset = gtk_text_iter_get_offset (&iter);
+		g_array_append_val (offsets, offset);
+
+		gtk_text_iter_forward_to_tag_toggle (&iter, tag);
+
+		offset = gtk_text_iter_get_offset (&iter);
+		g_array_append_val (offsets, offset);
+
+		if (gtk_text_iter_is_end (&iter))
+			break;
+	}
+
+	return offsets;
+}
+
+/* Each line is small enough to be checked when inserted */
+static void
+insert_lines (GeditDocument *doc,
+	      const gchar   *text)
+{
+	gchar **lines;
+	gint i;
+
+	lines = g_strsplit (text, "\n", -1);
+
+	for (i = 0; lines[i] != NULL; i++)
+	{
+		GtkTextIter end;
+
+		gtk_text_buffer_get_end_iter (GTK_TEXT_BUFFER (doc), &end);
+		gtk_text_buffer_insert (GTK_TEXT_BUFFER (doc), &end, lines[i], -1);
+
+		if (lines[i + 1] != NULL)
+		{
+			gtk_text_buffer_get_end_iter (GTK_TEXT_BUFFER (doc), &end);
+			gtk_text_buffer_insert (GTK_TEXT_BUFFER (doc), &end, "\n", 1);
+		}
+	}
+
+	g_strfreev (lines);
+}
+
+/* The threads mark the same words as the checks done at once, even if
+ * the text is edited while they run */
+static void
+test_threaded_check ()
+{
+	GeditSpellChecker *spell;
+	GeditAutomaticSpellChecker *autospell;
+	GeditAutomaticSpellChecker *threaded;
+	GeditDocument *doc;
+	GeditDocument *threaded_doc;
+	GtkTextIter iter;
+	GArray *expected;
+	GArray *highlights;
+	gchar *text;
+
+	spell = create_spell_checker ();
+
+	if (spell == NULL)
+		return;
+
+	/* a few jobs */
+	text = create_text (64 * 1024);
+
+	doc = gedit_document_new ();
+	autospell = gedit_automatic_spell_checker_new (doc, spell);
+	insert_lines (doc, text);
+	g_assert (!gedit_automatic_spell_checker_is_checking (autospell));
+
+	threaded_doc = gedit_document_new ();
+	gtk_text_buffer_set_text (GTK_TEXT_BUFFER (threaded_doc), text, -1);
+	threaded = gedit_automatic_spell_checker_new (threaded_doc, spell);
+
+	gedit_automatic_spell_checker_recheck_all (threaded);
+	wait_for_check (threaded);
+
+	expected = get_highlights (doc);
+	highlights = get_highlights (threaded_doc);
+
+	g_assert_cmpuint (expected->len, >, 0);
+	g_assert_cmpuint (highlights->len, ==, expected->len);
+	g_assert (memcmp (highlights->data, expected->data, expected->len * sizeof (gint)) == 0);
+
+	g_array_free (highlights, TRUE);
+	g_array_free (expected, TRUE);
+
+	/* an edit at the start while the jobs run: the first one is
+	 * checked again, the others are moved */
+	gedit_automatic_spell_checker_recheck_all (threaded);
+	g_main_context_iteration (NULL, TRUE);
+
+	gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (threaded_doc), &iter);
+	gtk_text_buffer_insert (GTK_TEXT_BUFFER (threaded_doc), &iter, "teh ", -1);
+	wait_for_check (threaded);
+
+	gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (doc), &iter);
+	gtk_text_buffer_insert (GTK_TEXT_BUFFER (doc), &iter, "teh ", -1);
+
+	expected = get_highlights (doc);
+	highlights = get_highlights (threaded_doc);
+
+	g_assert_cmpuint (highlights->len, ==, expected->len);
+	g_assert (memcmp (highlights->data, expected->data, expected->len * sizeof (gint)) == 0);
+
+	g_array_free (highlights, TRUE);
+	g_array_free (expected, TRUE);
+
+	g_free (text);
+	gedit_automatic_spell_checker_free (threaded);
+	gedit_automatic_spell_checker_free (autospell);
+	g_object_unref (threaded_doc);
+	g_object_unref (doc);
+	g_object_unref (spell);
+}
+
+static void
+do_check_benchmark (gsize    size,
+		    gboolean cache)
+{
+	GeditSpellChecker *spell;
+	GeditAutomaticSpellChecker *autospell;
+	GeditDocument *doc;
+	GTimer *timer;
+	guint lookups, hits;
+
+	spell = create_spell_checker ();
+
+	if (spell == NULL)
+		return;
+
+	if (!cache)
+		gedit_spell_checker_set_cache_size (spell, 0);
+
+	doc = gedit_document_new ();
+	fill_document (doc, size);
+
+	autospell = gedit_automatic_spell_checker_new (doc, spell);
+
+	timer = g_timer_new ();
+
+	gedit_automatic_spell_checker_recheck_all (autospell);
+	wait_for_check (autospell);
+
+	g_timer_stop (timer);
+
+	gedit_spell_checker_get_cache_stats (spell, &lookups, &hits);
+
+	g_test_message ("check %" G_GSIZE_FORMAT " bytes, %s: %f s, %u lookups, %u hits",
+			size,
+			cache ? "cache" : "no cache",
+			g_timer_elapsed (timer, NULL),
+			lookups,
+			hits);
+
+	g_test_minimized_result (g_timer_elapsed (timer, NULL),
+				 "check %" G_GSIZE_FORMAT " bytes, %s",
+				 size,
+				 cache ? "cache" : "no cache");
+
+	g_timer_destroy (timer);
+	gedit_automatic_spell_checker_free (autospell);
+	g_object_unref (doc);
+	g_object_unref (spell);
+}
+
+static void
+test_check_perf ()
+{
+	do_check_benchmark (1024 * 1024, FALSE);
+	do_check_benchmark (1024 * 1024, TRUE);
+	do_check_benchmark (10 * 1024 * 1024, FALSE);
+	do_check_benchmark (10 * 1024 * 1024, TRUE);
+}
+
+int main (int   argc,
+          char *argv[])
+{
+	gint ret;
+
+	g_thread_init (NULL);
+	g_type_init ();
+	g_test_init (&argc, &argv, NULL);
+
+	gedit_debug_init ();
+	gedit_prefs_manager_init ();
+
+	g_test_add_func ("/spell-checker/cache", test_cache);
+	g_test_add_func ("/spell-checker/idle-check", test_idle_check);
+	g_test_add_func ("/spell-checker/threaded-check", test_threaded_check);
+
+	if (g_test_perf ())
+		g_test_add_func ("/spell-checker/check-perf", test_check_perf);
+
+	ret = g_test_run ();
+
+	gedit_automatic_spell_checker_shutdown ();
+
+	return ret;
+}
@@ -0,0 +1,327 @@
+/*
+ * text-region.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2009 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "gedittextregion.h"
+#include <gtk/gtk.h>
+#include <glib.h>
+#include <string.h>
+
+#define BUFFER_LENGTH 1000
+
+static GtkTextBuffer *
+create_buffer (gint length)
+{
+	GtkTextBuffer *buffer;
+	gchar *text;
+
+	text = g_malloc (length);
+	memset (text, 'a', length);
+
+	buffer = gtk_text_buffer_new (NULL);
+	gtk_text_buffer_set_text (buffer, text, length);
+
+	g_free (text);
+
+	return buffer;
+}
+
+/* Checks that the subregions are sorted, non empty and cover exactly
+ * the offsets set in @covered */
+static void
+check_region (GeditTextRegion *region,
+	      const gboolean  *covered,
+	      gint             length)
+{
+	GeditTextRegionIterator iter;
+	gboolean *found;
+	gint last_end = -1;
+	gint n = 0;
+	gint i;
+
+	found = g_new0 (gboolean, length);
+
+	gedit_text_region_get_iterator (region, &iter, 0);
+
+	while (!gedit_text_region_iterator_is_end (&iter))
+	{
+		GtkTextIter start, end;
+		GtkTextIter nth_start, nth_end;
+		gint s, e;
+
+		gedit_text_region_iterator_get_subregion (&iter, &start, &end);
+
+		g_assert (gedit_text_region_nth_subregion (region, n, &nth_start, &nth_end));
+		g_assert (gtk_text_iter_equal (&start, &nth_start));
+		g_assert (gtk_text_iter_equal (&end, &nth_end));
+
+		s = gtk_text_iter_get_offset (&start);
+		e = gtk_text_iter_get_offset (&end);
+
+		g_assert_cmpint (s, <, e);
+		g_assert_cmpint (s, >=, last_end);
+
+		for (i = s; i < e; i++)
+			found[i] = TRUE;
+
+		last_end = e;
+		n++;
+
+		gedit_text_region_iterator_next (&iter);
+	}
+
+	g_assert_cmpint (gedit_text_region_subregions (region), ==, n);
+	g_assert (!gedit_text_region_nth_subregion (region, n, NULL, NULL));
+
+	for (i = 0; i < length; i++)
+		g_assert_cmpint (found[i], ==, covered[i]);
+
+	g_free (found);
+}
+
+static void
+get_random_range (GtkTextBuffer *buffer,
+		  gint           length,
+		  gint           max_range,
+		  GtkTextIter   *start,
+		  GtkTextIter   *end,
+		  gint          *s,
+		  gint          *e)
+{
+	*s = g_random_int_range (0, length);
+	*e = MIN (length, *s + g_random_int_range (1, max_range + 1));
+
+	gtk_text_buffer_get_iter_at_offset (buffer, start, *s);
+	gtk_text_buffer_get_iter_at_offset (buffer, end, *e);
+}
+
+static void
+test_add_subtract ()
+{
+	GtkTextBuffer *buffer;
+	GeditTextRegion *region;
+	gboolean covered[BUFFER_LENGTH] = { FALSE, };
+	gint i, j;
+
+	buffer = create_buffer (BUFFER_LENGTH);
+	region = gedit_text_region_new (buffer);
+
+	for (i = 0; i < 2000; i++)
+	{
+		GtkTextIter start, end;
+		gboolean add;
+		gint s, e;
+
+		get_random_range (buffer, BUFFER_LENGTH, 50, &start, &end, &s, &e);
+
+		/* more adds than subtracts so that regions get merged */
+		add = g_random_int_range (0, 3) != 0;
+
+		if (add)
+			gedit_text_region_add (region, &start, &end);
+		else
+			gedit_text_region_subtract (region, &start, &end);
+
+		for (j = s; j < e; j++)
+			covered[j] = add;
+
+		check_region (region, covered, BUFFER_LENGTH);
+	}
+
+	gedit_text_region_destroy (region, TRUE);
+	g_object_unref (buffer);
+}
+
+static void
+test_intersect ()
+{
+	GtkTextBuffer *buffer;
+	GeditTextRegion *region;
+	gboolean covered[BUFFER_LENGTH] = { FALSE, };
+	gint i, j;
+
+	buffer = create_buffer (BUFFER_LENGTH);
+	region = gedit_text_region_new (buffer);
+
+	for (i = 0; i < 100; i++)
+	{
+		GtkTextIter start, end;
+		gint s, e;
+
+		get_random_range (buffer, BUFFER_LENGTH, 20, &start, &end, &s, &e);
+		gedit_text_region_add (region, &start, &end);
+
+		for (j = s; j < e; j++)
+			covered[j] = TRUE;
+	}
+
+	for (i = 0; i < 500; i++)
+	{
+		GeditTextRegion *intersection;
+		GtkTextIter start, end;
+		gboolean expected[BUFFER_LENGTH] = { FALSE, };
+		gboolean empty = TRUE;
+		gint s, e;
+
+		get_random_range (buffer, BUFFER_LENGTH, 200, &start, &end, &s, &e);
+
+		for (j = s; j < e; j++)
+		{
+			expected[j] = covered[j];
+			empty = empty && !covered[j];
+		}
+
+		intersection = gedit_text_region_intersect (region, &start, &end);
+
+		if (intersection == NULL)
+		{
+			g_assert (empty);
+			continue;
+		}
+
+		check_region (intersection, expected, BUFFER_LENGTH);
+		gedit_text_region_destroy (intersection, TRUE);
+	}
+
+	gedit_text_region_destroy (region, TRUE);
+	g_object_unref (buffer);
+}
+
+static void
+add_range (GeditTextRegion *region,
+	   gint             s,
+	   gint             e)
+{
+	GtkTextBuffer *buffer = gedit_text_region_get_buffer (region);
+	GtkTextIter start, end;
+
+	gtk_text_buffer_get_iter_at_offset (buffer, &start, s);
+	gtk_text_buffer_get_iter_at_offset (buffer, &end, e);
+	gedit_text_region_add (region, &start, &end);
+}
+
+static void
+test_clear_empty ()
+{
+	GtkTextBuffer *buffer;
+	GeditTextRegion *region;
+	GtkTextIter start, end;
+	gboolean covered[100] = { FALSE, };
+	gint i;
+
+	buffer = create_buffer (100);
+	region = gedit_text_region_new (buffer);
+
+	add_range (region, 10, 20);
+	add_range (region, 30, 40);
+	add_range (region, 50, 60);
+
+	/* deleting the text of [30, 40] leaves it empty at 25 */
+	gtk_text_buffer_get_iter_at_offset (buffer, &start, 25);
+	gtk_text_buffer_get_iter_at_offset (buffer, &end, 45);
+	gtk_text_buffer_delete (buffer, &start, &end);
+
+	g_assert_cmpint (gedit_text_region_subregions (region), ==, 3);
+
+	/* a subtract from its neighbour drops it */
+	gtk_text_buffer_get_iter_at_offset (buffer, &start, 15);
+	gtk_text_buffer_get_iter_at_offset (buffer, &end, 22);
+	gedit_text_region_subtract (region, &start, &end);
+
+	for (i = 10; i < 15; i++)
+		covered[i] = TRUE;
+	for (i = 30; i < 40; i++)
+		covered[i] = TRUE;
+
+	check_region (region, covered, 80);
+
+	gedit_text_region_destroy (region, TRUE);
+	g_object_unref (buffer);
+}
+
+static void
+do_region_benchmark (gint n)
+{
+	GtkTextBuffer *buffer;
+	GeditTextRegion *region;
+	GTimer *timer;
+	gint length;
+	gint i;
+
+	/* enough room for about n small subregions */
+	length = n * 20;
+
+	buffer = create_buffer (length);
+	region = gedit_text_region_new (buffer);
+
+	timer = g_timer_new ();
+
+	for (i = 0; i < n; i++)
+	{
+		GtkTextIter start, end;
+		gint s, e;
+
+		get_random_range (buffer, length, 10, &start, &end, &s, &e);
+
+		if (g_random_int_range (0, 3) != 0)
+			gedit_text_region_add (region, &start, &end);
+		else
+			gedit_text_region_subtract (region, &start, &end);
+	}
+
+	g_timer_stop (timer);
+
+	g_test_message ("%d random add/subtract: %f s, %d subregions",
+			n,
+			g_timer_elapsed (timer, NULL),
+			gedit_text_region_subregions (region));
+
+	g_test_minimized_result (g_timer_elapsed (timer, NULL),
+				 "%d random add/subtract", n);
+
+	g_timer_destroy (timer);
+	gedit_text_region_destroy (region, TRUE);
+	g_object_unref (buffer);
+}
+
+static void
+test_region_perf ()
+{
+	do_region_benchmark (1000);
+	do_region_benchmark (10000);
+	do_region_benchmark (100000);
+}
+
+int main (int   argc,
+          char *argv[])
+{
+	g_type_init ();
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/text-region/add-subtract", test_add_subtract);
+	g_test_add_func ("/text-region/intersect", test_intersect);
+	g_test_add_func ("/text-region/clear-empty", test_clear_empty);
+
+	if (g_test_perf ())
+		g_test_add_func ("/text-region/region-perf", test_region_perf);
+
+	return g_test_run ();
+}
@@ -0,0 +1,521 @@
+/*
+ * window.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2010 - The gedit Team
+ *
+ * gedit is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * gedit is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gedit; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "gedit-app.h"
+#include "gedit-commands.h"
+#include "gedit-debug.h"
+#include "gedit-prefs-manager-app.h"
+#include "gedit-utils.h"
+#include "gedit-window.h"
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Peak RSS of the process in KB, reset between runs through clear_refs */
+static glong
+get_peak_rss (void)
+{
+	gchar *contents;
+	gchar *line;
+	glong peak = -1;
+
+	if (!g_file_get_contents ("/proc/self/status", &contents, NULL, NULL))
+		return -1;
+
+	line = strstr (contents, "VmHWM:");
+	if (line != NULL)
+		peak = strtol (line + strlen ("VmHWM:"), NULL, 10);
+
+	g_free (contents);
+
+	return peak;
+}
+
+static void
+reset_peak_rss (void)
+{
+	g_file_set_contents ("/proc/self/clear_refs", "5", -1, NULL);
+}
+
+static gchar *
+create_test_dir ()
+{
+	gchar *dir;
+
+	dir = g_build_filename (g_get_tmp_dir (), "gedit-window-test-XXXXXX", NULL);
+	g_assert (mkdtemp (dir) != NULL);
+
+	return dir;
+}
+
+/* Returns a list of @n uris of files of @lines lines in @dir */
+static GSList *
+create_test_files (const gchar *dir,
+		   gint         n,
+		   gint         lines)
+{
+	GSList *uris = NULL;
+	gint i;
+
+	for (i = n - 1; i >= 0; i--)
+	{
+		gchar *name;
+		gchar *filename;
+		GString *text;
+		gint j;
+
+		name = g_strdup_printf ("file-%04d.txt", i);
+		filename = g_build_filename (dir, name, NULL);
+
+		text = g_string_new (NULL);
+		for (j = 0; j < lines; j++)
+			g_string_append_printf (text, "This is line %d of file %d\n", j, i);
+
+		g_assert (g_file_set_contents (filename, text->str, text->len, NULL));
+
+		uris = g_slist_prepend (uris, g_filename_to_uri (filename, NULL, NULL));
+
+		g_free (name);
+		g_free (filename);
+		g_string_free (text, TRUE);
+	}
+
+	return uris;
+}
+
+static void
+remove_test_files (const gchar *dir,
+		   GSList      *uris)
+{
+	GSList *l;
+
+	for (l = uris; l != NULL; l = g_slist_next (l))
+	{
+		gchar *filename;
+
+		filename = g_filename_from_uri (l->data, NULL, NULL);
+		g_unlink (filename);
+		g_free (filename);
+	}
+
+	g_rmdir (dir);
+
+	g_slist_foreach (uris, (GFunc) g_free, NULL);
+	g_slist_free (uris);
+}
+
+/* Runs the main loop until the documents are loaded and the menus
+ * are built, i.e. until the user can interact with the window */
+static void
+wait_interactive (GeditWindow *window)
+{
+	while (gedit_window_get_state (window) & GEDIT_WINDOW_STATE_LOADING)
+		gtk_main_iteration ();
+
+	gtk_ui_manager_ensure_update (gedit_window_get_ui_manager (window));
+
+	while (gtk_events_pending ())
+		gtk_main_iteration ();
+}
+
+static void
+close_window (GeditWindow *window)
+{
+	gedit_window_close_all_tabs (window);
+	gtk_widget_destroy (GTK_WIDGET (window));
+
+	while (gtk_events_pending ())
+		gtk_main_iteration ();
+}
+
+static GtkAction *
+get_documents_list_action (GeditWindow *window,
+			   gint         n)
+{
+	GList *groups;
+	GList *l;
+	GtkAction *action = NULL;
+	gchar *name;
+
+	name = g_strdup_printf ("Tab_%d", n);
+	groups = gtk_ui_manager_get_action_groups (gedit_window_get_ui_manager (window));
+
+	for (l = groups; l != NULL; l = g_list_next (l))
+	{
+		if (strcmp (gtk_action_group_get_name (l->data), "DocumentsListActions") == 0)
+		{
+			action = gtk_action_group_get_action (l->data, name);
+			break;
+		}
+	}
+
+	g_free (name);
+
+	return action;
+}
+
+/* Checks that the documents menu has one item for each tab, labeled
+ * with its name, and that the active tab is the active item */
+static void
+check_documents_list (GeditWindow *window)
+{
+	GtkNotebook *notebook;
+	gint n, i;
+
+	notebook = GTK_NOTEBOOK (_gedit_window_get_notebook (window));
+	n = gtk_notebook_get_n_pages (notebook);
+
+	for (i = 0; i < n; i++)
+	{
+		GtkAction *action;
+		GeditTab *tab;
+		gchar *label;
+		gchar *name;
+		gchar *escaped;
+
+		tab = GEDIT_TAB (gtk_notebook_get_nth_page (notebook, i));
+		action = get_documents_list_action (window, i);
+		g_assert (action != NULL);
+
+		g_object_get (action, "label", &label, NULL);
+		name = _gedit_tab_get_name (tab);
+		escaped = gedit_utils_escape_underscores (name, -1);
+
+		g_assert_cmpstr (label, ==, escaped);
+
+		g_assert_cmpint (gtk_toggle_action_get_active (GTK_TOGGLE_ACTION (action)),
+				 ==,
+				 tab == gedit_window_get_active_tab (window));
+
+		g_free (label);
+		g_free (name);
+		g_free (escaped);
+	}
+
+	g_assert (get_documents_list_action (window, n) == NULL);
+}
+
+static void
+test_tab_from_location ()
+{
+	GeditWindow *window;
+	GtkNotebook *notebook;
+	GeditTab *tab;
+	GSList *uris;
+	GSList *l;
+	GFile *location;
+	gchar *dir;
+
+	dir = create_test_dir ();
+	uris = create_test_files (dir, 5, 1);
+
+	window = gedit_app_create_window (gedit_app_get_default (), NULL);
+	notebook = GTK_NOTEBOOK (_gedit_window_get_notebook (window));
+
+	g_assert_cmpint (gedit_commands_load_uris (window, uris, NULL, 0), ==, 5);
+	wait_interactive (window);
+
+	g_assert_cmpint (gtk_notebook_get_n_pages (notebook), ==, 5);
+
+	for (l = uris; l != NULL; l = g_slist_next (l))
+	{
+		gchar *uri;
+
+		location = g_file_new_for_uri (l->data);
+		tab = gedit_window_get_tab_from_location (window, location);
+		g_assert (tab != NULL);
+
+		uri = gedit_document_get_uri (gedit_tab_get_document (tab));
+		g_assert_cmpstr (uri, ==, l->data);
+
+		g_free (uri);
+		g_object_unref (location);
+	}
+
+	check_documents_list (window);
+
+	/* files already open only switch to their tab */
+	g_assert_cmpint (gedit_commands_load_uris (window, uris->next, NULL, 0), ==, 4);
+	wait_interactive (window);
+
+	g_assert_cmpint (gtk_notebook_get_n_pages (notebook), ==, 5);
+
+	/* moving a tab shifts the items after it */
+	tab = GEDIT_TAB (gtk_notebook_get_nth_page (notebook, 4));
+	gtk_notebook_reorder_child (notebook, GTK_WIDGET (tab), 1);
+	g_signal_emit_by_name (notebook, "tabs_reordered");
+
+	check_documents_list (window);
+
+	/* a closed tab is not found anymore */
+	location = g_file_new_for_uri (uris->data);
+	tab = gedit_window_get_tab_from_location (window, location);
+	gedit_window_close_tab (window, tab);
+
+	g_assert (gedit_window_get_tab_from_location (window, location) == NULL);
+	g_object_unref (location);
+
+	check_documents_list (window);
+
+	close_window (window);
+	remove_test_files (dir, uris);
+	g_free (dir);
+}
+
+static void
+test_dormant_tabs ()
+{
+	GeditWindow *window;
+	GtkNotebook *notebook;
+	GeditTab *tab;
+	GeditDocument *doc;
+	GSList *uris;
+	gchar *dir;
+	gchar *name;
+	gchar *untitled;
+	gchar *uri;
+	gchar *filename;
+	gchar *renamed;
+
+	dir = create_test_dir ();
+	uris = create_test_files (dir, 3, 1);
+
+	window = gedit_app_create_window (gedit_app_get_default (), NULL);
+	notebook = GTK_NOTEBOOK (_gedit_window_get_notebook (window));
+
+	/* the first free untitled number */
+	doc = gedit_document_new ();
+	untitled = gedit_document_get_short_name_for_display (doc);
+	g_object_unref (doc);
+
+	g_assert_cmpint (gedit_commands_load_uris (window, uris, NULL, 0), ==, 3);
+	wait_interactive (window);
+
+	/* only the active tab is loaded */
+	tab = GEDIT_TAB (gtk_notebook_get_nth_page (notebook, 0));
+	g_assert (tab == gedit_window_get_active_tab (window));
+	g_assert (!_gedit_tab_is_dormant (tab));
+
+	tab = GEDIT_TAB (gtk_notebook_get_nth_page (notebook, 2));
+	doc = gedit_tab_get_document (tab);
+
+	g_assert (_gedit_tab_is_dormant (tab));
+	g_assert_cmpint (gtk_text_buffer_get_char_count (GTK_TEXT_BUFFER (doc)), ==, 0);
+
+	/* but their documents already have their uri */
+	uri = gedit_document_get_uri (doc);
+	g_assert_cmpstr (uri, ==, g_slist_nth_data (uris, 2));
+	g_free (uri);
+
+	name = _gedit_tab_get_name (tab);
+	g_assert_cmpstr (name, ==, "file-0002.txt");
+	g_free (name);
+
+	check_documents_list (window);
+
+	/* so they do not hold an untitled number */
+	tab = gedit_window_create_tab (window, FALSE);
+	name = gedit_document_get_short_name_for_display (gedit_tab_get_document (tab));
+	g_assert_cmpstr (name, ==, untitled);
+	g_free (name);
+	g_free (untitled);
+
+	gedit_window_close_tab (window, tab);
+
+	/* a dormant document which is renamed is loaded from its new uri */
+	tab = GEDIT_TAB (gtk_notebook_get_nth_page (notebook, 1));
+
+	filename = g_filename_from_uri (g_slist_nth_data (uris, 1), NULL, NULL);
+	renamed = g_build_filename (dir, "renamed.txt", NULL);
+	g_assert_cmpint (g_rename (filename, renamed), ==, 0);
+
+	uri = g_filename_to_uri (renamed, NULL, NULL);
+	gedit_document_set_uri (gedit_tab_get_document (tab), uri);
+	g_free (uri);
+
+	gedit_window_set_active_tab (window, tab);
+	wait_interactive (window);
+
+	g_assert_cmpint (gtk_text_buffer_get_char_count (GTK_TEXT_BUFFER (gedit_tab_get_document (tab))), ==,
+			 strlen ("This is line 0 of file 1\n"));
+
+	g_assert_cmpint (g_rename (renamed, filename), ==, 0);
+	g_free (filename);
+	g_free (renamed);
+
+	/* and the others are loaded when shown */
+	tab = GEDIT_TAB (gtk_notebook_get_nth_page (notebook, 2));
+
+	gedit_window_set_active_tab (window, tab);
+	wait_interactive (window);
+
+	g_assert (!_gedit_tab_is_dormant (tab));
+
+	uri = gedit_document_get_uri (doc);
+	g_assert_cmpstr (uri, ==, g_slist_nth_data (uris, 2));
+	g_free (uri);
+
+	g_assert_cmpint (gtk_text_buffer_get_char_count (GTK_TEXT_BUFFER (doc)), ==,
+			 strlen ("This is line 0 of file 2\n"));
+
+	check_documents_list (window);
+
+	close_window (window);
+	remove_test_files (dir, uris);
+	g_free (dir);
+}
+
+static void
+do_open_benchmark (gint n)
+{
+	GeditWindow *window;
+	GTimer *timer;
+	GSList *uris;
+	gchar *dir;
+
+	dir = create_test_dir ();
+	uris = create_test_files (dir, n, 1);
+
+	window = gedit_app_create_window (gedit_app_get_default (), NULL);
+
+	timer = g_timer_new ();
+
+	gedit_commands_load_uris (window, uris, NULL, 0);
+	wait_interactive (window);
+
+	g_timer_stop (timer);
+
+	g_test_message ("%d files: interactive after %f s",
+			n,
+			g_timer_elapsed (timer, NULL));
+
+	g_test_minimized_result (g_timer_elapsed (timer, NULL),
+				 "time to interactive with %d files", n);
+
+	g_timer_destroy (timer);
+
+	close_window (window);
+	remove_test_files (dir, uris);
+	g_free (dir);
+}
+
+static void
+test_open_perf ()
+{
+	do_open_benchmark (10);
+	do_open_benchmark (100);
+	do_open_benchmark (1000);
+}
+
+/* Restores @n documents like a session does, the active one first */
+static void
+do_restore_benchmark (GSList   *uris,
+		      gboolean  dormant)
+{
+	GeditWindow *window;
+	GTimer *timer;
+	GSList *l;
+	glong rss_before;
+	gint n;
+
+	n = g_slist_length (uris);
+
+	reset_peak_rss ();
+	rss_before = get_peak_rss ();
+
+	window = gedit_app_create_window (gedit_app_get_default (), NULL);
+
+	timer = g_timer_new ();
+
+	for (l = uris; l != NULL; l = g_slist_next (l))
+	{
+		if (l == uris)
+			gedit_window_create_tab_from_uri (window, l->data, NULL, 0, FALSE, TRUE);
+		else if (dormant)
+			_gedit_window_create_dormant_tab (window, l->data, NULL, 0, FALSE);
+		else
+			gedit_window_create_tab_from_uri (window, l->data, NULL, 0, FALSE, FALSE);
+	}
+
+	wait_interactive (window);
+
+	g_timer_stop (timer);
+
+	g_test_message ("%d documents, %s: restored in %f s, peak RSS %ld KB (+%ld KB)",
+			n,
+			dormant ? "dormant" : "loaded",
+			g_timer_elapsed (timer, NULL),
+			get_peak_rss (),
+			get_peak_rss () - rss_before);
+
+	g_test_minimized_result (g_timer_elapsed (timer, NULL),
+				 "restore time for %d %s documents",
+				 n, dormant ? "dormant" : "loaded");
+
+	g_timer_destroy (timer);
+
+	close_window (window);
+}
+
+static void
+test_restore_perf ()
+{
+	GSList *uris;
+	gchar *dir;
+
+	dir = create_test_dir ();
+	uris = create_test_files (dir, 500, 1000);
+
+	do_restore_benchmark (uris, FALSE);
+	do_restore_benchmark (uris, TRUE);
+
+	remove_test_files (dir, uris);
+	g_free (dir);
+}
+
+int main (int   argc,
+          char *argv[])
+{
+	g_thread_init (NULL);
+	g_test_init (&argc, &argv, NULL);
+
+	/* the window tests need a display */
+	if (!gtk_init_check (&argc, &argv))
+		return 0;
+
+	gedit_debug_init ();
+	gedit_prefs_manager_app_init ();
+
+	g_test_add_func ("/window/tab-from-location", test_tab_from_location);
+	g_test_add_func ("/window/dormant-tabs", test_dormant_tabs);
+
+	if (g_test_perf ())
+	{
+		g_test_add_func ("/window/open-perf", test_open_perf);
+		g_test_add_func ("/window/restore-perf", test_restore_perf);
+	}
+
+	return g_test_run ();
+}